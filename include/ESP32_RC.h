@@ -1,43 +1,138 @@
 #pragma once
 #include <Arduino.h>
 #include <ESP32_RC_Common.h>
+#include <ESP32_RC_Codec.h>
+#include <ESP32_RC_Ring.h>
+#include <ESP32_RC_Mailbox.h>
+#include <ESP32_RC_Window.h>
+#include <ESP32_RC_Stats.h>
+#include <ESP32_RC_Peers.h>
 #include <Task.h>
 #include <freertos/timers.h>
-#include <queue>
+#include <atomic>
+#include <type_traits>
 
 
 /*
  *
  * Remote Control Library
  * 
- * ESP32RemoteControl : Abstract Class
+ * ESP32RemoteControl : Abstract Class, works on raw payload bytes of a fixed length
+ * ESP32_RC<Transport, T> : Typed front-end, checks the payload type at compile time
  * Support below protocols :
  * - ESPNOW
  * - Wifi 
+ * - BLE, see ESP32_RC_BLE.h
+ * - nRF24L01+, see ESP32_RC_NRF24.h
+ * - UART (wired, COBS framing), see ESP32_RC_UART.h
+ * - Bond of two of the above, see ESP32_RC_Bond.h
  * 
- * - BLE (to do)
  * - Bluetooth Serial (to do)
- * - NRD24 (to do)
  *
 */
 
 
+class ESP32RemoteControl;
+
+/*
+ *
+ * Sender task
+ *
+ * Drains send_queue (or send_mailbox) to the radio, one frame right after the other.
+ * Sleeps on a task notification while there is nothing to send, and is woken by
+ * send() and by the send-complete callback. Runs outside the timer daemon task,
+ * so a slow radio never stalls the heartbeat timer.
+ *
+ */
+class ESP32_RC_SendTask : public Task {
+  public:
+    ESP32_RC_SendTask(ESP32RemoteControl *rc);
+
+  private:
+    ESP32RemoteControl *rc;
+    void run(void *data) override;                        // loops in rc->send_loop()
+};
+
+/*
+ *
+ * Receive task
+ *
+ * Only started when a handler is registered with on_message(). Sleeps on recv_signal
+ * and calls the handler for every received message, straight from the receive pool.
+ *
+ */
+class ESP32_RC_RecvTask : public Task {
+  public:
+    ESP32_RC_RecvTask(ESP32RemoteControl *rc);
+
+  private:
+    ESP32RemoteControl *rc;
+    void run(void *data) override;                        // loops in rc->recv_loop()
+};
+
+
 class ESP32RemoteControl : public Task {
+  friend class ESP32_RC_SendTask;
+  friend class ESP32_RC_RecvTask;
+
+
   public:
     // pointer function 
     typedef void (*funcPtrType)(void);                    // a function pointer type
+    typedef void (*msgFuncType)(const void *data, uint8_t lane, void *context);  // message handler, data = payload_len bytes
         
+    typedef void (*linkFuncType)(uint8_t state, void *context);  // _RC_LINK_UP, _RC_LINK_LOST, _RC_LINK_DOWN, _RC_LINK_HANDSHAKE
+
+    // borrowed receive buffer (zero-copy), must be given back with release()
+    struct RecvView {
+      const uint8_t *data = nullptr;                      // payload_len bytes, nullptr if nothing received
+      int handle          = -1;                           // index in the receive pool
+      uint8_t lane        = 0;                            // lane the message came in on
+    };
+
     // constructor
-    ESP32RemoteControl(bool fast_mode, bool debug_mode);  
+    ESP32RemoteControl(bool fast_mode, bool debug_mode, size_t payload_len = sizeof(Message));  
+    virtual ~ESP32RemoteControl();
     
     // common functions
     virtual void init(void)               = 0;            // general wrapper to init the RC configuration
     virtual void connect(void)            = 0;            // general wrapper to establish the connection
-    virtual void send(Message data)       = 0;            // general wrapper to send data
-    virtual Message recv(void)            = 0;            // general wrapper to receive data
+    virtual void send(const void *data, uint8_t lane = _RC_LANE_CONTROL) = 0;  // general wrapper to send data, payload_len bytes
+    virtual bool recv(void *data)         = 0;            // general wrapper to receive data, false if none
+
+    bool recv_wait(void *data, uint32_t timeout_ms);      // block until a message arrives, false on timeout
+    bool recv_lane(void *data, uint8_t lane);             // receive from one lane only, false if none
+    bool recv_view(RecvView &view);                       // receive without copy, highest lane first, false if none
+    bool recv_view(RecvView &view, uint8_t lane);         // receive without copy from one lane only
+    void release(RecvView &view);                         // give the borrowed buffer back to the pool
+    void get_link_stats(ESP32_RC_LinkStats::Snapshot &snap);  // loss, duplicates, reorders, latency histograms
+    const ESP32_RC_LinkClock &get_link_clock(void) const { return link_clock; }  // RTT, clock offset to the peer
     
     void enable_fast(bool mode);                          // fast mode enabled, non-blocking
     void enable_debug(bool mode);                         // debug mode enabled, output debug info
+    void enable_mailbox(bool mode);                       // latest-value mode, call before init()
+    void enable_multi_peer(bool mode);                    // controller only: accept more peers next to the primary link
+    void set_quant_profiles(const ESP32_RC_QuantProfile *profiles, int count); // quantized channels, call before connect()
+    void set_send_task(BaseType_t core, uint8_t priority);  // core / priority of the sender task, call before connect()
+    void set_send_window(int size);                       // frames in flight [1, _RC_SEND_WINDOW_MAX], 1 = stop-and-wait
+    void set_lane(uint8_t lane, int depth, uint8_t policy);  // queue depth / drop policy of a lane, call before init()
+    void set_heartbeat_rate(float rate);                  // heartbeats / second, any time
+    void set_recv_task(BaseType_t core, uint8_t priority);  // core / priority of the on_message() task, call before on_message()
+    void on_message(msgFuncType handler, void *context = nullptr);  // push-style receive, replaces recv(), also before init()
+    void set_link_timeout(uint32_t timeout_ms);           // no frame from the peer for this long = link lost
+    void set_reconnect_budget(uint32_t budget_ms);        // fast re-handshake time after a loss, then _RC_LINK_DOWN
+    void on_link_state(linkFuncType handler, void *context = nullptr);  // called on every link state change, handshake and UP after connect(), must not block
+    uint8_t get_link_state(void) const { return link_state.load(); }
+    bool is_connected(void);                              // handshake done and the link not lost
+
+    // multi-peer, peer 0 is the primary link, see ESP32_RC_Peers.h
+    bool send_to(uint8_t peer_id, const void *data);      // addressed message, peer 0 = send(data), false if dropped
+    int broadcast(const void *data);                      // send to every connected peer, number of peers reached
+    bool recv_from(uint8_t peer_id, void *data);          // message of one peer, peer 0 = recv(data), false if none
+    int find_peer(const uint8_t *mac_addr);               // peer id, -1 if unknown
+    int peer_count(void) const { return peers.count(); }
+    bool get_peer(uint8_t peer_id, ESP32_RC_PeerInfo &info);  // false if not in use
+    virtual void remove_peer(uint8_t peer_id);            // secondary peers only, it may say hello again
 
     funcPtrType custom_handler            = nullptr;      // A Custom Exception Handler.
 
@@ -53,35 +148,138 @@ class ESP32RemoteControl : public Task {
     Metric send_metric  = {0, 0, 0};
     Metric recv_metric  = {0, 0, 0};
 
-    int connection_status;                                // connection status
-    int send_status;                                      // send status
+    struct Lane {
+      int     depth;                                      // send / recv queue depth
+      uint8_t policy;                                     // _RC_LANE_BLOCK, _RC_LANE_DROP_OLDEST ...
+    };
+    Lane lanes[_RC_LANE_COUNT];
+
+    ESP32_RC_LinkStats link_stats;                        // filled by the radio callbacks, reset on handshake
+    ESP32_RC_LinkClock link_clock;                        // filled by the heartbeat exchange, reset on handshake
+    ESP32_RC_PeerTable peers;                             // peer 0 = primary link, others addressed only
+    float heartbeat_rate = ESP32_RC_HEARTBEAT_RATE;
+
+    std::atomic<uint8_t>  link_state{_RC_LINK_UP};
+    std::atomic<uint32_t> last_rx_ms{0};                  // millis() of the last frame from the peer
+    uint32_t link_timeout     = _RC_LINK_TIMEOUT;
+    uint32_t reconnect_budget = _RC_RECONNECT_BUDGET;
+    TimerHandle_t link_timer  = nullptr;                  // failure detector, see check_link()
+    linkFuncType link_handler = nullptr;
+    void *link_context        = nullptr;
+
+    std::atomic<int> connection_status{_STATUS_CONN_ERR}; // connection status, read by the radio callbacks
+    std::atomic<int> send_status{_STATUS_SEND_READY};     // send status
 
     bool fast_mode      = false;                          // enable or disable quick mode
     bool debug_mode     = false;                          // enable or disable debug mode
+    bool mailbox_mode   = false;                          // send / recv only the newest message, no queue
+    bool multi_peer_mode = false;                         // hello of another peer adds it instead of being ignored
+
+    size_t payload_len;                                   // length of user payload, fixed at construction
+
+    uint8_t peer_caps   = 0;                              // capabilities agreed with peer during handshake
+    ESP32_RC_Quantizer quantizer;                         // quantized channel profiles
+    ESP32_RC_DeltaEncoder delta_encoder;                  // delta codec, see ESP32_RC_Codec.h
+    ESP32_RC_DeltaDecoder delta_decoder;
 
-    SemaphoreHandle_t mutex;                              // for access varible locking
+    SemaphoreHandle_t mutex = nullptr;                    // for access varible locking, created by init()
       
-    TimerHandle_t send_timer;                             // Timer task to send message
-    TimerHandle_t recv_timer;                             // Timer task to recieve message
-    TimerHandle_t heartbeat_timer;                        // Timer task to send heartbeat message
+    ESP32_RC_SendTask send_task;                          // sends the queued messages, see send_loop()
+    TimerHandle_t heartbeat_timer = nullptr;              // Timer task to send heartbeat message
     
-    QueueHandle_t send_queue;                             // send message queue
-	  QueueHandle_t recv_queue;                             // recv message queue        
+    ESP32_RC_Ring send_queue[_RC_LANE_COUNT];             // send message queues, app -> radio
+    ESP32_RC_Ring recv_queue[_RC_LANE_COUNT];             // recv queues, radio -> app, carry indices of recv_pool buffers
+
+    uint8_t *recv_pool        = nullptr;                  // pool_size buffers of pool_stride bytes
+    size_t pool_stride        = 0;
+    int pool_size             = 0;                        // all lane depths + _RC_RECV_MAX_BORROWED
+    std::atomic<uint32_t> pool_free[(_RC_RECV_POOL_MAX + 31) / 32];  // bit set = recv_pool buffer unused
+
+    ESP32_RC_Mailbox send_mailbox;                        // mailbox_mode only, replaces send_queue of _RC_LANE_CONTROL
+    ESP32_RC_SendWindow send_window;                      // frames in flight, between send_queue and radio
+    bool keeps_frames   = false;                          // send_window keeps the sent frame, a retry resends it, set before init()
+    bool stalls_reader  = false;                          // the reader is a task of the transport, a full BLOCK lane waits, set before init()
+    SemaphoreHandle_t recv_room = nullptr;                // stalls_reader only, given whenever the application takes a message
+    ESP32_RC_Mailbox recv_mailbox;                        // mailbox_mode only, replaces recv_queue of _RC_LANE_CONTROL
+
+    // control frame posted by the receive side, sent by send_task, see post_ctrl()
+    struct CtrlPost {
+      uint8_t frame[_RC_CTRL_FRAME_LEN];
+      uint8_t frame_len;
+      uint8_t addr[_RC_PEER_ADDR_LEN];                    // peer key, see ESP32_RC_Peers.h
+      bool    has_addr;                                   // false = the primary
+    };
+    ESP32_RC_Ring ctrl_queue;                             // CtrlPost items, the receive side is the only producer
+    std::atomic<bool> is_reset_due{false};                // the peer started over, send_task drops the old frames, see post_reset()
+    std::atomic<bool> is_heartbeat_due{false};            // heartbeat_timer asks send_task for a heartbeat, see post_heartbeat()
+
+    ESP32_RC_RecvTask recv_task;                          // runs msg_handler, see recv_loop()
+    SemaphoreHandle_t recv_signal = nullptr;              // given for every received message
+    msgFuncType msg_handler       = nullptr;
+    void *msg_context             = nullptr;
+
+    size_t create_ctrl_frame(uint8_t type, uint8_t *frame);  // build HANDSHAKE / HEARTBEAT ... frames
+    size_t create_heartbeat_ack(const uint8_t *heartbeat, int heartbeat_len, uint32_t rx_us, uint8_t *frame);
+    void on_heartbeat_ack(const uint8_t *frame, int frame_len, uint32_t rx_us);  // feed link_clock
+    TickType_t heartbeat_period(void);                    // timer period for heartbeat_rate
+    uint32_t send_timeout(void);                          // us, a frame without send-complete counts as failed
+    uint8_t local_caps(void);                             // capabilities offered in handshake
+    uint8_t negotiate_caps(const uint8_t *frame, size_t frame_len); // capabilities both peers agree on
+
+    void set_value(std::atomic<int> *in_varible, int value);  // thread-safe to set varible, never blocks
+    void get_value(std::atomic<int> *in_varible, int *out_varible);  // thread-safe to get varible, never blocks
 
-    Message create_sys_msg(String data);                  // convert gaven String to Message
-    String extract_sys_msg(const Message &msg);           // extract Message.sys data to String
+    bool create_queues(void);                             // allocate send_queue, recv_queue, recv_pool (or mailboxes) and send_window
+    size_t add_trailer(uint8_t *frame, size_t frame_len, uint16_t seq);  // append sequence + micros(), returns new length
+    bool check_trailer(const uint8_t *frame, int frame_len);  // feed link_stats, false if too short or duplicate
+    bool check_trailer(const uint8_t *frame, int frame_len, ESP32_RC_Peer &peer);  // same for a secondary peer
+    size_t encode_frame(const void *data, uint8_t *frame, size_t frame_cap, uint8_t caps);  // codecs agreed in handshake, 0 = send raw
+    bool decode_frame(const uint8_t *data, int data_len, void *pmsg, uint8_t caps);  // any data frame, false if malformed
+    void recv_data_frame(const uint8_t *frame, int frame_len);  // data frame of the primary -> recv_queue / recv_mailbox
+    uint8_t *pool_buffer(int index);                      // buffer of given index
+    int pool_take(void);                                  // get a free buffer, reuses the oldest queued one of the lowest non-critical lane if none, -1 = failed
+    void pool_put(int index);                             // give buffer back, without queuing it
+    void pool_push(int index, uint8_t lane);              // queue filled buffer for recv(), drops oldest of the lane if full
+    void wait_recv_room(uint8_t lane);                    // stalls_reader: a full BLOCK lane waits for recv(), _RC_RECV_STALL_MAX at most
+    void empty_send_queue(void);                          // drop all messages waiting to be sent
+    void empty_recv_queue(void);                          // drop all queued messages
 
-    void set_value(int *in_varible, int value);           // thread-safe to set varible 
-    void get_value(int *in_varible, int *out_varible);    // thread-safe to get varible 
+    bool uses_mailbox(uint8_t lane);                      // lane goes through send_mailbox / recv_mailbox
+    bool enqueue(const void *data, uint8_t lane);         // put message on its lane by the lane policy, false if dropped
+    bool dequeue(uint8_t lane, void *data);               // next message of the lane for the sender, false if none
 
-    void empty_queue(QueueHandle_t queue);                // clean up all messages in queue
-    bool en_queue(QueueHandle_t queue, Message *pmsg);    // Push to queue
-    bool de_queue(QueueHandle_t queue, Message *pmsg);    // Pop from queue
-    int get_queue_depth(QueueHandle_t queue);             // get queue depth
+    void start_sender(void);                              // start send_task, after handshake
+    void stop_sender(void);                               // stop send_task, before the transport is destroyed
+    void notify_sender(void);                             // wake send_task (new message, send completed)
+    bool wait_sender(TickType_t ticks);                   // called by send_task, sleep until notified, false on timeout
+    bool has_pending_send(void);                          // anything waiting in ctrl_queue / send_queue / send_mailbox / send_window
+    bool post_ctrl(const uint8_t *frame, size_t frame_len, const uint8_t *addr = nullptr);  // receive side: answer from send_task, never blocks, false if full
+    void send_posted_ctrl(void);                          // called by send_task before the data, ctrl_queue -> op_send_posted()
+    void post_reset(void);                                // receive side: send_queue and delta encoder start over in send_task, never blocks
+    void post_heartbeat(void);                            // heartbeat_timer: send_task sends the heartbeat, never blocks
+    void reset_sender(void);                              // send_task, or the task in wait_handshake(): the reset of post_reset(), if due
+    virtual bool op_send_posted(const uint8_t *frame, size_t frame_len, const uint8_t *addr) { return false; }  // transports that post_ctrl()
+    void send_loop(void);                                 // body of send_task
 
-    virtual bool handshake(void)          = 0;
+    void start_receiver(void);                            // start recv_task if on_message() is set, after handshake
+    void stop_receiver(void);
+    void signal_recv(void);                               // a message is ready, wake recv_wait() / recv_task
+    void recv_loop(void);                                 // body of recv_task
+
+    void start_link_monitor(void);                        // start the failure detector, after handshake
+    void stop_link_monitor(void);
+    void link_alive(void);                                // a frame from the peer arrived
+    void check_link(void);                                // called by link_timer, UP -> LOST on timeout
+    void set_link_state(uint8_t state);                   // fires link_handler on change
+    void reconnect(void);                                 // called by send_task while the link is not UP
+    bool wait_handshake(uint32_t timeout_ms);             // wait for _STATUS_CONN_OK, false on timeout
+    void handshake_failed(void);                          // IN_PROG -> ERR, a late ack no longer counts
+    void handshake_done(void);                            // HANDSHAKE / ACK received: link stats and clock start over, _RC_LINK_HANDSHAKE
+    static void link_timer_callback(TimerHandle_t timer);
+
+    virtual bool handshake(uint32_t timeout_ms) = 0;      // false if no ack within timeout_ms
     virtual void send_queue_msg(void)     = 0;
-    virtual bool op_send(Message msg)     = 0;
+    virtual bool op_send(const void *data, int slot) = 0; // send payload of send_window slot (-1 = none)
 
     // ******************************************************************************* //
     // internal functions
@@ -102,3 +300,73 @@ class ESP32RemoteControl : public Task {
 };
 
 
+
+/*
+ *
+ * ESP32_RC<Transport, T>
+ *
+ * Typed front-end of any transport. The payload type is checked at compile time
+ * and the transport queues are sized to sizeof(T).
+ *
+ * Sample:
+ *  struct Joystick { float x; float y; uint8_t buttons; };
+ *  ESP32_RC<ESP32_RC_ESPNOW, Joystick> rc_controller(false, true);
+ *  rc_controller.send(joystick);
+ *  rc_controller.send(estop, _RC_LANE_CRITICAL);       // goes out before anything queued on lower lanes
+ *  if (rc_controller.recv(joystick)) { ... }
+ *
+ *  ESP32RemoteControl::RecvView view;                  // or without copy
+ *  if (const Joystick *js = rc_controller.recv_view(view)) { ...; rc_controller.release(view); }
+ *
+ *  rc_controller.recv(joystick, 10);                   // or wait up to 10ms for the next message
+ *
+ *  void on_joystick(const Joystick &js) { ... }        // or push-style, called from its own task
+ *  rc_controller.on_message(on_joystick);
+ *
+ */
+template <class Transport, typename T = Message>
+class ESP32_RC : public Transport {
+  static_assert(std::is_base_of<ESP32RemoteControl, Transport>::value, "Transport must derive from ESP32RemoteControl");
+  static_assert(std::is_trivially_copyable<T>::value, "Payload type must be trivially copyable, it is sent as raw bytes");
+  static_assert(sizeof(T) <= Transport::MAX_PAYLOAD_LEN, "Payload type is too large for this transport");
+  static_assert(sizeof(T) <= _RC_CODEC_MAX_PAYLOAD, "Payload type is too large for the codec");
+
+  public:
+    ESP32_RC(bool fast_mode = false, bool debug_mode = false) : Transport(fast_mode, debug_mode, sizeof(T)) {}
+
+    void send(const T &data) { Transport::send(&data); }
+    bool recv(T &data)       { return Transport::recv(&data); }
+    void send(const T &data, uint8_t lane) { Transport::send(&data, lane); }
+    bool recv(T &data, uint32_t timeout_ms) { return Transport::recv_wait(&data, timeout_ms); }
+    bool recv_lane(T &data, uint8_t lane)   { return Transport::recv_lane(&data, lane); }
+    bool send(uint8_t peer_id, const T &data) { return Transport::send_to(peer_id, &data); }   // multi-peer, see ESP32_RC_Peers.h
+    int broadcast(const T &data)              { return Transport::broadcast(&data); }
+    bool recv(uint8_t peer_id, T &data)       { return Transport::recv_from(peer_id, &data); }
+    void on_message(void (*handler)(const T &data)) {     // handler runs in the receive task
+      typed_handler      = handler;
+      typed_lane_handler = nullptr;
+      Transport::on_message(dispatch, this);
+    }
+    void on_message(void (*handler)(const T &data, uint8_t lane)) {
+      typed_handler      = nullptr;
+      typed_lane_handler = handler;
+      Transport::on_message(dispatch, this);
+    }
+    const T *recv_view(ESP32RemoteControl::RecvView &view) {   // zero-copy, nullptr if none, release(view) when done
+      return Transport::recv_view(view) ? (const T *)view.data : nullptr;
+    }
+    T recv(void) {                                        // returns T{} if nothing received
+      T data = {};
+      Transport::recv(&data);
+      return data;
+    }
+
+  private:
+    void (*typed_handler)(const T &data)                    = nullptr;
+    void (*typed_lane_handler)(const T &data, uint8_t lane) = nullptr;
+    static void dispatch(const void *data, uint8_t lane, void *context) {
+      ESP32_RC *rc = (ESP32_RC *)context;
+      if (rc->typed_lane_handler != nullptr) rc->typed_lane_handler(*(const T *)data, lane);
+      if (rc->typed_handler != nullptr)      rc->typed_handler(*(const T *)data);
+    }
+};
@@ -0,0 +1,165 @@
+#pragma once
+#include <Arduino.h>
+#include <ESP32_RC.h>
+#include <ESP32_RC_Gatt.h>
+#include <BLEDevice.h>
+#include <BLEServer.h>
+#include <BLE2902.h>
+#include <esp_gap_ble_api.h>
+#include <esp_gatts_api.h>
+#include <esp_gattc_api.h>
+#include <atomic>
+
+/*
+ *
+ * BLE Class
+ *
+ * Bi-directional communication over one BLE connection, see ESP32_RC_Gatt.h for the framing
+ *
+ * Note:
+ *  Roles:              connect() scans for _BLE_SERVICE_UUID for a random time between _BLE_SCAN_TIMEOUT
+ *                      and twice that. A peer found: central, it connects. Nobody found: peripheral,
+ *                      it advertises. Of two peers running the same code one gives up first.
+ *  Connection:         tuned for latency and throughput once connected:
+ *                       - ATT MTU _BLE_MTU, 244 bytes per packet instead of 20.
+ *                       - data length extension, one packet per link layer PDU.
+ *                       - 2M PHY where the controller has it (BLE 5, ESP32-C3 / S3). The ESP32 is
+ *                         BLE 4.2, it stays on 1M.
+ *                       - the shortest connection interval the peer accepts, no slave latency.
+ *  Data:               the peripheral notifies on _BLE_TX_CHARAC_UUID, the central writes without
+ *                      response to _BLE_RX_CHARAC_UUID. No ack on the GATT level, the link layer
+ *                      retransmits, several packets leave in one connection event.
+ *  Handshake:          the central connects again if the connection is gone, the peripheral waits
+ *                      for it while advertising. Heartbeat, link monitor and re-handshake work
+ *                      as with ESPNOW.
+ *  Sending:            send() only en-queues. The sender task puts the frames of one round into the
+ *                      pipe and flushes it, a frame is done once it is in the pipe:
+ *                       - full controller buffers keep the rest in the pipe, sent again shortly.
+ *                       - a lost connection loses what was in the pipe.
+ *                       - no delta format, as with WiFi.
+ *  Receiving:          in the Bluetooth stack task, straight into recv_queue / recv_mailbox.
+ *  Peers:              one peer, its BLE address is the key of peer 0, see find_peer().
+ *
+ */
+
+#define _BLE_MTU                          247                 // ATT MTU, 244 bytes payload, fits one 251 byte PDU
+#define _BLE_DATA_LEN                     251                 // link layer payload, data length extension
+#define _BLE_CONN_INTERVAL_MIN            6                   // x 1.25 ms, 7.5 ms, the shortest allowed
+#define _BLE_CONN_INTERVAL_MAX            12                  // x 1.25 ms, if the peer refuses the shortest
+#define _BLE_SUPERVISION_TIMEOUT          200                 // x 10 ms, connection lost after 2 s of silence
+#define _BLE_SCAN_TIMEOUT                 3                   // s, min time to look for a peripheral before becoming one
+
+/*
+ *
+ * GATT link on the ESP32 (Bluedroid)
+ *
+ * Packets go straight to the stack, esp_ble_gatts_send_indicate() / esp_ble_gattc_write_char(),
+ * not through the value of the characteristic. put_packet() is BUSY while the controller has
+ * no free buffer for the connection.
+ *
+ */
+class ESP32_RC_BleGatt : public ESP32_RC_GattLink {
+  public:
+    ESP32_RC_BleGatt();
+
+    void init(void);                      // start the stack, local MTU
+    void start(uint32_t scan_s);          // central if a peripheral is found within scan_s, else peripheral
+    bool is_central(void) const { return central; }
+
+    bool open(uint32_t timeout_ms) override;
+    void close(void) override;
+    bool is_open(void) override { return is_connected.load(); }
+    size_t packet_len(void) override;
+    uint8_t put_packet(const uint8_t *data, size_t len) override;
+
+  private:
+    class ServerEvents : public BLEServerCallbacks {
+      public:
+        ServerEvents(ESP32_RC_BleGatt *gatt) : gatt(gatt) {}
+        void onConnect(BLEServer *server, esp_ble_gatts_cb_param_t *param) override;
+        void onDisconnect(BLEServer *server) override;
+      private:
+        ESP32_RC_BleGatt *gatt;
+    };
+
+    class ClientEvents : public BLEClientCallbacks {
+      public:
+        ClientEvents(ESP32_RC_BleGatt *gatt) : gatt(gatt) {}
+        void onConnect(BLEClient *client) override {}
+        void onDisconnect(BLEClient *client) override;
+      private:
+        ESP32_RC_BleGatt *gatt;
+    };
+
+    class RxEvents : public BLECharacteristicCallbacks {
+      public:
+        RxEvents(ESP32_RC_BleGatt *gatt) : gatt(gatt) {}
+        void onWrite(BLECharacteristic *charac, esp_ble_gatts_cb_param_t *param) override;
+      private:
+        ESP32_RC_BleGatt *gatt;
+    };
+
+    bool central = false;
+    std::atomic<bool> is_connected{false};
+    uint16_t conn_id = 0;
+    uint8_t peer_addr[ESP_BD_ADDR_LEN];
+
+    // peripheral
+    BLEServer *server         = nullptr;
+    BLECharacteristic *tx     = nullptr;                      // notified
+    ServerEvents server_events;
+    RxEvents rx_events;
+
+    // central
+    BLEClient *client         = nullptr;
+    BLERemoteCharacteristic *remote_rx = nullptr;             // written without response
+    BLEAdvertisedDevice peer_device;                          // last peripheral found
+    bool has_device           = false;
+    ClientEvents client_events;
+
+    bool find_peripheral(uint32_t scan_s);
+    bool open_central(uint32_t timeout_ms);
+    void start_peripheral(void);
+    void on_connected(const uint8_t *addr, uint16_t id);      // tune the connection, UP event
+    void on_disconnected(void);
+};
+
+class ESP32_RC_BLE : public ESP32RemoteControl {
+  public:
+    static constexpr size_t MAX_PAYLOAD_LEN = _RC_MAX_PAYLOAD_LEN;
+
+    // Constructor
+    ESP32_RC_BLE(bool fast_mode=false, bool debug_mode=false, size_t payload_len=sizeof(Message));
+    ~ESP32_RC_BLE();
+
+    // Implement virtual functions
+    void init(void) override;             // Start the Bluetooth stack
+    void connect(void) override;          // Pick the role, connect, then handshake
+    void send(const void *data, uint8_t lane = _RC_LANE_CONTROL) override; // only en-queue the message
+    bool recv(void *data) override;       // Receive data over BLE
+
+  private:
+    ESP32_RC_BleGatt gatt;
+    ESP32_RC_GattPipe pipe;               // frames over the packets of gatt
+    SemaphoreHandle_t pipe_mutex = nullptr;  // pipe, sender task, heartbeat timer and the stack task
+    uint8_t peer_key[_RC_PEER_ADDR_LEN];  // BLE address of the connection
+    uint32_t packet_us = 0;               // micros() of the packet being fed, stack task only
+
+    void run(void* data) override;        // Override the Task class run function
+    void send_queue_msg(void) override;   // send msg in send_queue
+    bool handshake(uint32_t timeout_ms) override;
+    bool op_send(const void *data, int slot) override; // put one data frame into the pipe
+    bool op_send_ctrl(uint8_t type);      // Send control frame
+    bool op_send_ctrl(const uint8_t *frame, size_t frame_len);
+
+    bool pipe_put(const uint8_t *frame, size_t frame_len);  // a full pipe is flushed first, false if no room
+    bool flush_pipe(void);                // false if the link did not take everything
+
+    static void on_gatt_event(uint8_t event, const uint8_t *data, size_t len, void *context);
+    static void on_frame(const uint8_t *frame, size_t frame_len, void *context);
+    void on_datarecv(const uint8_t *data, int data_len, uint32_t rx_us);
+
+    // Timers Tasks
+    static void heartbeat_timer_callback(TimerHandle_t xTimer) ;
+
+};
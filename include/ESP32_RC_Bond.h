@@ -0,0 +1,90 @@
+#pragma once
+#include <Arduino.h>
+#include <ESP32_RC.h>
+
+/*
+ *
+ * Bonded transport
+ *
+ * Two transports as one link, e.g. ESP32_RC_Bond<ESP32_RC_ESPNOW, ESP32_RC_WIFI>. Every message
+ * is sent on both paths, the receiver delivers the first copy and drops the second one. With
+ * independent loss on the paths, a message is only late if both copies are.
+ *
+ *  frame     : [bond seq16 LE] [payload], sent as the payload of each path, so each path keeps
+ *              its own lanes, retries, codecs and link monitor. One sequence per lane.
+ *  dedupe    : one ESP32_RC_SeqWindow per lane over the bond sequence, so bulk copies held back
+ *              behind many control frames are not taken for stale ones. A copy older than the
+ *              window is dropped. A handshake on either path (_RC_LINK_HANDSHAKE, the peer may
+ *              have restarted) starts all windows over.
+ *  failover  : a path that is not connected or whose link is not UP is left out on send, its
+ *              link monitor re-handshakes on its own. The bond is connected while any path is,
+ *              on_link_state() reports the best state of both paths. connect() and blocking
+ *              lanes sleep on path_up until a path reports UP, no polling.
+ *
+ * Note:
+ *  - both ends must bond the same transports in the same order.
+ *  - the paths' on_message() and on_link_state() are used by the bond, configure anything else
+ *    of a path (send window, lanes, heartbeat ...) through path(i) before init().
+ *  - get_link_stats() of each path tells how lossy it is, get_duplicates() how often the
+ *    second copy arrived as well.
+ *
+ */
+
+#define _RC_BOND_PATHS            2
+#define _RC_BOND_HEADER_LEN       2                           // bond sequence
+
+class ESP32_RC_BondBase : public ESP32RemoteControl {
+  public:
+    ESP32_RC_BondBase(bool fast_mode, bool debug_mode, size_t payload_len);
+    ~ESP32_RC_BondBase();
+
+    void init(void) override;                             // init both paths
+    void connect(void) override;                          // connect both paths in parallel, returns once one is up
+    void send(const void *data, uint8_t lane = _RC_LANE_CONTROL) override;  // en-queue on every connected path
+    bool recv(void *data) override;
+
+    ESP32RemoteControl &path(int index) { return *paths[index]; }
+    uint32_t get_duplicates(void) const { return duplicates; }
+
+  protected:
+    ESP32RemoteControl *paths[_RC_BOND_PATHS] = {};
+    void set_paths(ESP32RemoteControl *first, ESP32RemoteControl *second);
+
+  private:
+    SemaphoreHandle_t bond_mutex = nullptr;               // the paths deliver from their own receive tasks
+    SemaphoreHandle_t path_up    = nullptr;               // binary, given while a path is up, see wait_path_up()
+    ESP32_RC_SeqWindow dedupe[_RC_LANE_COUNT];            // per lane, bond_mutex
+    std::atomic<uint16_t> next_seq[_RC_LANE_COUNT] = {};
+    uint32_t duplicates = 0;
+
+    void run(void* data) override;                        // Override the Task class run function
+    bool handshake(uint32_t timeout_ms) override;         // the paths handshake on their own
+    void send_queue_msg(void) override;                   // the paths send on their own
+    bool op_send(const void *data, int slot) override;
+
+    static void on_path_message(const void *data, uint8_t lane, void *context);
+    static void on_path_state(uint8_t state, void *context);
+    void deliver(const uint8_t *frame, uint8_t lane);     // first copy goes to recv_queue / recv_mailbox
+    void resync(void);                                    // a path handshook, all dedupe windows start over
+    void update_state(void);                              // connection and link state from both paths
+    bool is_path_up(int index);                           // connected and the link UP
+    void wait_path_up(void);                              // until any path is up
+};
+
+template <typename First, typename Second>
+class ESP32_RC_Bond : public ESP32_RC_BondBase {
+  public:
+    static constexpr size_t MAX_PAYLOAD_LEN =
+      ((First::MAX_PAYLOAD_LEN < Second::MAX_PAYLOAD_LEN) ? First::MAX_PAYLOAD_LEN : Second::MAX_PAYLOAD_LEN) - _RC_BOND_HEADER_LEN;
+
+    ESP32_RC_Bond(bool fast_mode = false, bool debug_mode = false, size_t payload_len = sizeof(Message))
+      : ESP32_RC_BondBase(fast_mode, debug_mode, payload_len),
+        first(fast_mode, debug_mode, payload_len + _RC_BOND_HEADER_LEN),
+        second(fast_mode, debug_mode, payload_len + _RC_BOND_HEADER_LEN) {
+      set_paths(&first, &second);
+    }
+
+  private:
+    First  first;
+    Second second;
+};
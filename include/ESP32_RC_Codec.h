@@ -0,0 +1,182 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ *
+ * Compact wire format
+ *
+ * The payload is treated as an array of 4-byte slots (the last slot may be shorter).
+ * Only slots which hold data are put on the air, a presence bitmap tells the
+ * receiver where they belong. Everything else is restored as zero.
+ *
+ * Frame layout:
+ *  [0]          _RC_FRAME_COMPACT
+ *  [1 .. B]     presence bitmap, 1 bit per slot, B = ceil(slots / 8)
+ *  [B+1 .. ]    data of the present slots, in slot order
+ *
+ * Note:
+ *  The first byte is the frame type (see ESP32_RC_Common.h), the receiver dispatches on it.
+ *  The lane bits of the type are ignored by the decoders, the sender sets them after encode().
+ *  encode() returns 0 when the compact frame would not be smaller than the raw
+ *  payload, the caller should then send the payload raw.
+ *
+ */
+
+#define _RC_CODEC_SLOT_LEN        4                           // bytes per slot
+#define _RC_CODEC_MAX_SLOTS       64                          // max payload = 256 bytes
+#define _RC_CODEC_MAX_PAYLOAD     (_RC_CODEC_SLOT_LEN * _RC_CODEC_MAX_SLOTS)
+#define _RC_CODEC_BITMAP_LEN(n)   ((((n) + _RC_CODEC_SLOT_LEN - 1) / _RC_CODEC_SLOT_LEN + 7) / 8)
+
+class ESP32_RC_Codec {
+  public:
+    // encode payload into frame, returns frame length, 0 = not encoded
+    static size_t encode(const void *payload, size_t payload_len, uint8_t *frame, size_t frame_cap);
+
+    // decode frame back into payload, returns false if the frame is malformed
+    static bool decode(const uint8_t *frame, size_t frame_len, void *payload, size_t payload_len);
+
+    // check if frame is in compact format
+    static bool is_compact(const uint8_t *frame, size_t frame_len);
+
+    // slot level helpers, shared with the delta codec.
+    // ref = nullptr means a reference of all zeros.
+    static size_t encode_slots(const void *payload, const void *ref, size_t payload_len, uint8_t *out, size_t out_cap);
+    static bool decode_slots(const uint8_t *in, size_t in_len, void *payload, const void *ref, size_t payload_len);
+
+  private:
+    static size_t slot_count(size_t payload_len);
+    static size_t slot_len(size_t payload_len, size_t slot);
+};
+
+
+/*
+ *
+ * Delta wire format
+ *
+ * Same slot bitmap as above, but the reference is the last frame the peer has
+ * confirmed (on_datasent = success) instead of all zeros.
+ *
+ * Frame layout:
+ *  KEY    : [_RC_FRAME_KEY]   [id]          [bitmap] [slots != 0]
+ *  DELTA  : [_RC_FRAME_DELTA] [id] [ref_id] [bitmap] [slots != reference]
+ *
+ * Resync:
+ *  - a KEY frame is sent every _RC_DELTA_KEY_INTERVAL frames, or when the reference
+ *    is older than what the receiver keeps in its history.
+ *  - the receiver keeps the last _RC_DELTA_HISTORY frames, so a lost ack on the sender
+ *    side does not break decoding. A DELTA without known reference is dropped.
+ *  - several frames may be in flight (send window), the encoder keeps the last
+ *    _RC_DELTA_PENDING of them and on_sent(id) confirms one by its id (frame[1]).
+ *  - a failed frame is sent again as it is, same id, same reference (the sender keeps the
+ *    bytes). So a failure leaves it pending, its retry may still confirm it. The reference
+ *    is at most _RC_DELTA_MAX_AGE ids older, the history also covers the frames sent
+ *    meanwhile (send window), so a late retry still finds its reference.
+ *
+ */
+
+#define _RC_DELTA_KEY_INTERVAL    25                          // a KEY frame every X data frames
+#define _RC_DELTA_MAX_AGE         8                           // ids between a DELTA and its reference
+#define _RC_DELTA_HISTORY         16                          // frames kept by the receiver, >= max age + send window
+#define _RC_DELTA_PENDING         8                           // unconfirmed frames kept by the sender
+
+class ESP32_RC_DeltaEncoder {
+  public:
+    void reset(void);
+
+    // encode payload into frame, returns frame length, 0 = not encoded (send raw)
+    size_t encode(const void *payload, size_t payload_len, uint8_t *frame, size_t frame_cap);
+
+    // result of the frame with given id, the frame becomes the reference if delivered, stays pending if not
+    void on_sent(uint8_t id, bool success);
+
+  private:
+    struct Pending {
+      bool    valid;
+      uint8_t id;
+      uint8_t data[_RC_CODEC_MAX_PAYLOAD];
+    };
+    uint8_t ref[_RC_CODEC_MAX_PAYLOAD];
+    Pending pending[_RC_DELTA_PENDING] = {};
+    int     next_pending    = 0;
+    bool    ref_valid       = false;
+    uint8_t ref_id          = 0;
+    uint8_t next_id         = 0;
+    int     since_key       = 0;
+};
+
+class ESP32_RC_DeltaDecoder {
+  public:
+    void reset(void);
+
+    // decode KEY / DELTA frame into payload, returns false if malformed or reference unknown
+    bool decode(const uint8_t *frame, size_t frame_len, void *payload, size_t payload_len);
+
+    static bool is_delta(const uint8_t *frame, size_t frame_len);
+
+  private:
+    struct Entry {
+      bool    valid;
+      uint8_t id;
+      uint8_t data[_RC_CODEC_MAX_PAYLOAD];
+    };
+    Entry history[_RC_DELTA_HISTORY] = {};
+    int   next_slot = 0;
+};
+
+
+/*
+ *
+ * Quantized channels
+ *
+ * Float channels with a declared profile (range, bit width) are packed into a
+ * bitstream instead of 4 bytes each. The quantizer turns the payload into a
+ * shorter "packed payload", which then goes through the compact / delta codec:
+ *
+ *  packed payload = [all slots without a profile, in slot order] [bitstream of the channels]
+ *
+ * Note:
+ *  - every profiled channel must be a 4-byte aligned float, so it covers exactly one slot.
+ *  - both peers must declare the same profiles, this is checked in handshake by
+ *    comparing signature(). On mismatch the channels are sent as plain floats.
+ *
+ * Sample:
+ *  const ESP32_RC_QuantProfile profiles[] = {
+ *    _RC_QUANT_PROFILE(Message, a1, -1.0, 1.0, 12),    // joystick
+ *    _RC_QUANT_PROFILE(Message, b1,  0.0, 5.0, 10),    // battery voltage
+ *  };
+ *  rc_controller.set_quant_profiles(profiles, 2);
+ *
+ */
+
+#define _RC_QUANT_MAX_CHANNELS    32                          // max profiled channels
+#define _RC_QUANT_MAX_BITS        16                          // max bits per channel
+#define _RC_QUANT_PROFILE(type, field, min, max, bits)  { (uint16_t)offsetof(type, field), (float)(min), (float)(max), (uint8_t)(bits) }
+
+struct ESP32_RC_QuantProfile {
+  uint16_t offset;                                            // offset of the float in payload
+  float    min;                                               // range, values are clamped into [min, max]
+  float    max;
+  uint8_t  bits;                                              // bit width on air [1, _RC_QUANT_MAX_BITS]
+};
+
+class ESP32_RC_Quantizer {
+  public:
+    // install profiles, returns false if any profile is invalid (nothing is installed then)
+    bool set_profiles(const ESP32_RC_QuantProfile *profiles, int count, size_t payload_len);
+
+    bool is_active(void) const { return count > 0; }
+    size_t packed_len(void) const { return packed_size; }
+    uint32_t signature(void) const { return sig; }           // FNV-1a of the profiles, 0 = no profiles
+
+    void pack(const void *payload, uint8_t *packed) const;
+    void unpack(const uint8_t *packed, void *payload) const;
+
+  private:
+    ESP32_RC_QuantProfile profiles[_RC_QUANT_MAX_CHANNELS];
+    bool    is_quant_slot[_RC_CODEC_MAX_SLOTS] = {};
+    int     count         = 0;
+    size_t  payload_size  = 0;
+    size_t  packed_size   = 0;
+    uint32_t sig          = 0;
+};
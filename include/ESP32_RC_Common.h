@@ -1,3 +1,4 @@
+#pragma once
 #include <ESP32_RC_Message.h>
 
 
@@ -12,7 +13,7 @@
 
 /* 
   Remote Control Roles 
-  Only support two nodes (in pair), not multi-executors
+  One controller, many executors, see ESP32_RC_Peers.h
 */
 
 #define _ROLE_CONTROLLER        1           // RC Controller Role
@@ -20,6 +21,10 @@
 
 
 #define _MAX_MSG_LEN            250         // max length of each message
+#define _RC_FRAME_HEADER_LEN    1           // frame type
+#define _RC_FRAME_TRAILER_LEN   6           // data frames only: sequence (2) + sender micros() (4)
+#define _RC_FRAME_OVERHEAD      (_RC_FRAME_HEADER_LEN + _RC_FRAME_TRAILER_LEN)
+#define _RC_MAX_PAYLOAD_LEN     (_MAX_MSG_LEN - _RC_FRAME_OVERHEAD)     // max payload of a raw frame
 
 /* 
   ESP32 supported Wireless protocols 
@@ -38,6 +43,7 @@
 
 #define _STATUS_CONN_OK           2
 #define _STATUS_CONN_IN_PROG      200
+#define _STATUS_CONN_ACKED        201                         // hello / ack received in a callback, wait_handshake() resets the send side, then OK
 #define _STATUS_CONN_ERR          -2
 
 #define _STATUS_SEND_READY        4
@@ -47,22 +53,118 @@
 
 
 
-#define _HANDSHAKE_MSG            "ESP32_RC_HANDSHAKE_HELLO"
-#define _HANDSHAKE_ACK_MSG        "ESP32_RC_HANDSHAKE_ACK"
+/* 
+  Frame types
+  - Every frame on air starts with one byte frame type, the receiver dispatches on it.
+  - Control frames are tiny and never carry a Message:
+      HANDSHAKE / HANDSHAKE_ACK   : [type] [capability flags] [quantizer signature, 32 bit LE]
+      HEARTBEAT                   : [type] [t1]
+      HEARTBEAT_ACK               : [type] [t1] [t2] [t3]   (micros(), 32 bit LE, see ESP32_RC_LinkClock)
+  - Data frames carry a Message, either raw or encoded (see ESP32_RC_Codec.h):
+      RAW                         : [type] [Message]                [trailer]
+      COMPACT / KEY / DELTA       : [type] [codec specific]         [trailer]
+  - The trailer is appended after encoding, so the codecs never see it:
+      [sequence, 16 bit LE] [sender micros(), 32 bit LE]   (see ESP32_RC_Stats.h)
+  - Data frame types are 0xC0 - 0xEF, bits 4..5 carry the lane (see Lanes below),
+    e.g. COMPACT on _RC_LANE_BULK = 0xE1. _RC_FRAME_KIND() strips the lane.
+*/
+#define _RC_FRAME_HANDSHAKE       0xA1
+#define _RC_FRAME_HANDSHAKE_ACK   0xA2
+#define _RC_FRAME_HEARTBEAT       0xA3
+#define _RC_FRAME_HEARTBEAT_ACK   0xA4
+
+#define _RC_FRAME_RAW             0xC0
+#define _RC_FRAME_COMPACT         0xC1
+#define _RC_FRAME_KEY             0xC2
+#define _RC_FRAME_DELTA           0xC3
 
-#define _HEARTBEAT_MSG            "ESP32_RC_HEARTBEAT_HELLO"
-#define _HEARTBEAT_ACK_MSG        "ESP32_RC_HEARTBEAT_ACK"
+#define _RC_FRAME_LANE_SHIFT      4
+#define _RC_FRAME_LANE_MASK       0x30
+#define _RC_FRAME_IS_DATA(type)   (((type) & 0xC0) == 0xC0)
+#define _RC_FRAME_KIND(type)      (_RC_FRAME_IS_DATA(type) ? ((type) & ~_RC_FRAME_LANE_MASK) : (type))
+#define _RC_FRAME_LANE(type)      (((type) & _RC_FRAME_LANE_MASK) >> _RC_FRAME_LANE_SHIFT)
+
+#define _RC_CTRL_FRAME_LEN        13                          // max length of a control frame
+#define _RC_CTRL_QUEUE_DEPTH      8                           // acks posted by the receive side for the sender task, see post_ctrl()
+
+/* 
+  Capabilities, exchanged in HANDSHAKE / HANDSHAKE_ACK frames
+  - quantized channels are used only if the quantizer signatures match as well
+*/
+#define _RC_CAP_COMPACT           0x01                        // understands compact frames (ESP32_RC_Codec)
+#define _RC_CAP_DELTA             0x02                        // understands delta frames (ESP32_RC_DeltaEncoder)
+#define _RC_CAP_QUANT             0x04                        // quantized channels with same profiles (ESP32_RC_Quantizer)
+#define _RC_LOCAL_CAPS            (_RC_CAP_COMPACT | _RC_CAP_DELTA)
 
 
 #define _ESP32_RC_DATA_RATE       100                         // X messages/second , better <=100
-#define ESP32_RC_HEARTBEAT_RATE   0.5                         // X messages/second
+#define ESP32_RC_HEARTBEAT_RATE   0.5                         // X messages/second, default of set_heartbeat_rate()
 
 /* =========   ESPNOW  Settings ========= */
 #define _ESPNOW_CHANNEL           2
 #define _ESPNOW_OUTPUT_POWER      82                          // [0, 82] representing [0, 20.5]dBm
+#define _ESPNOW_MAX_INSTANCES     4                           // ESP32_RC_ESPNOW objects sharing the driver
 
 
 #define _RC_QUEUE_DEPTH           int(_ESP32_RC_DATA_RATE/2)    // keep messages queue for max 0.5s only, if overflow, drop the older ones
+#define _RC_RECV_MAX_BORROWED     4                             // buffers the application may hold with recv_view() at once
+#define _RC_RECV_POOL_MAX         128                           // sum of all lane depths + _RC_RECV_MAX_BORROWED, at most
+#define _RC_RECV_STALL_MAX        1000                          // ms, a reader task holds a full BLOCK lane this long, then the oldest is dropped
+
+/* 
+  Lanes
+  - send / recv queues per lane, strict priority: a lower lane is always sent and received first
+  - every lane has its own depth and drop policy, see set_lane()
+  - send(data) uses _RC_LANE_CONTROL, which follows fast_mode and mailbox mode as before
+  - a transport that reads in its own task (UART) also blocks on receive: a full BLOCK lane stalls
+    the reader, and so the wire, until the application takes a message
+*/
+#define _RC_LANE_CRITICAL         0                           // e-stop, failsafe ... never dropped
+#define _RC_LANE_CONTROL          1                           // joystick, commands ...
+#define _RC_LANE_BULK             2                           // telemetry, logs ...
+#define _RC_LANE_COUNT            3
+
+#define _RC_LANE_BLOCK            0                           // send() waits for room, failed frames are retried until delivered
+#define _RC_LANE_DROP_OLDEST      1                           // the oldest queued message makes room
+#define _RC_LANE_DROP_NEWEST      2                           // the new message is dropped if the lane is full
+
+#define _RC_LANE_CRITICAL_DEPTH   4
+#define _RC_LANE_CONTROL_DEPTH    _RC_QUEUE_DEPTH
+#define _RC_LANE_BULK_DEPTH       16
+
+/* =========   Sender task  ========= */
+#define _RC_SEND_TASK_CORE        1                           // radio driver runs on core 0, keep the sender on the app core
+#define _RC_SEND_TASK_PRIORITY    10                          // above loop() (1), below the WiFi driver
+#define _RC_SEND_TASK_STACK       4096
+#define _RC_SEND_DONE_TIMEOUT     10                          // ms, fallback wake-up while waiting for send-complete
+#define _RC_SEND_WINDOW           4                           // frames in flight, see ESP32_RC_SendWindow
+#define _RC_SEND_MAX_RETRY        3                           // dropping lanes only, a failed frame is dropped after X retries
+#define _RC_SEND_EXPIRE           1000                        // ms, a frame without send-complete counts as failed
+#define _RC_SEND_EXPIRE_MIN       50                          // ms, lower bound once the RTT is known
+
+/* 
+  Link state, see on_link_state()
+  - every frame from the peer (data or heartbeat) counts as alive, so the timeout must be
+    longer than the heartbeat period, e.g. 20 Hz heartbeat and 150 ms timeout
+  - LOST fires at most set_link_timeout() + _RC_LINK_CHECK_PERIOD ms after the last frame
+*/
+#define _RC_LINK_UP               0                           // handshake done, frames arriving
+#define _RC_LINK_LOST             1                           // nothing received for set_link_timeout(), re-handshake running
+#define _RC_LINK_DOWN             2                           // re-handshake budget used up, still retrying
+#define _RC_LINK_HANDSHAKE        3                           // event only: the peer (re)handshook, it may have restarted
+
+#define _RC_LINK_TIMEOUT          5000                        // ms, default of set_link_timeout()
+#define _RC_LINK_CHECK_PERIOD     10                          // ms, resolution of the failure detector
+#define _RC_HANDSHAKE_TIMEOUT     10000                       // ms, wait for the handshake ack in connect()
+#define _RC_RESUME_TIMEOUT        50                          // ms, wait for the ack of the unicast handshake to the known peer
+#define _RC_RECONNECT_BUDGET      3000                        // ms, default of set_reconnect_budget(), fast re-handshake before DOWN
+#define _RC_RECONNECT_ATTEMPT     200                         // ms, wait for the ack of one re-handshake
+#define _RC_RECONNECT_BACKOFF     1000                        // ms, between re-handshakes once DOWN
+
+/* =========   Receive task  ========= */
+#define _RC_RECV_TASK_CORE        1                           // on_message() handler runs here
+#define _RC_RECV_TASK_PRIORITY    9                           // just below the sender task
+#define _RC_RECV_TASK_STACK       4096
 
 
 /* =========   BLE  Settings ========= */
@@ -82,3 +184,10 @@
 #define HSPI_SCLK             14  // Clock Pin
 #define HSPI_CS               15  // Chip Selection Pin
 #define NRF24_CE              4   // Chip Enable Pin
+
+
+
+/* =========   ESP32 - UART Specific Settings ========= */
+// UART2, cross TX / RX between the two boards and share GND
+#define UART_TX_PIN           17  // TX pin
+#define UART_RX_PIN           16  // RX pin
@@ -1,6 +1,8 @@
 #pragma once
 #include <Arduino.h>
 #include <ESP32_RC.h>
+#include <ESP32_RC_Codec.h>
+#include <ESP32_RC_PeerStore.h>
 #include <esp_now.h>
 #include <esp_wifi.h>
 #include <WiFi.h>
@@ -16,6 +18,38 @@
  *  fast_mode = false:  The send process is blocking when send_queue is full. This ensures the message delivery.
  *  fast_mode = true:   The send process is non-blocking when send_queue is full. The first message of send_queue will 
  *                      be removed and then en-queue the new messaage. This is to ensure the quick response of client, not getting blocked.
+ *  mailbox mode:       enable_mailbox(true) before init(). No queue on _RC_LANE_CONTROL, send() overwrites a single slot
+ *                      and the sender always transmits the newest value, recv() always returns the newest frame.
+ *                      For control channels, where stale commands are worse than lost ones.
+ *  Payload:            Any trivially copyable struct up to MAX_PAYLOAD_LEN bytes, see ESP32_RC<Transport, T>.
+ *                      Queues are sized to the payload length given to the constructor.
+ *  Sending:            send() only en-queues, the sender task (see ESP32_RC_SendTask) puts the frames on
+ *                      air back-to-back. set_send_task() picks its core and priority.
+ *                      Up to set_send_window() frames are in flight, see ESP32_RC_Window.h.
+ *  Lanes:              send(data, lane), _RC_LANE_CRITICAL goes out before _RC_LANE_CONTROL before _RC_LANE_BULK.
+ *                      Each lane has its own queue depth and drop policy (set_lane()), the receiver queues
+ *                      per lane as well and recv() returns the highest lane first.
+ *  Statistics:         every data frame carries a sequence number and a timestamp, get_link_stats() returns
+ *                      loss, duplicates, reorders and latency histograms (see ESP32_RC_Stats.h).
+ *  Heartbeat:          set_heartbeat_rate(), the heartbeat carries timestamps, get_link_clock() returns the
+ *                      smoothed RTT and the clock offset to the peer. Send-complete timeouts follow the RTT.
+ *  Link loss:          no frame from the peer for set_link_timeout() ms (heartbeats count) marks the link lost,
+ *                      on_link_state() is called and the sender task re-handshakes on its own, see ESP32_RC_Common.h.
+ *  Resume:             the last peer is kept in NVS (see ESP32_RC_PeerStore.h). connect() and every re-handshake
+ *                      say hello to it directly first, the broadcast discovery only runs if it does not answer.
+ *  Multi-peer:         enable_multi_peer(true) on the controller, executors that say hello while the primary link
+ *                      is up get their own peer id instead of taking it over. send(peer_id, data), broadcast(data),
+ *                      recv(peer_id, data), see ESP32_RC_Peers.h. Without it such a hello is ignored.
+ *  Instances:          several ESP32_RC_ESPNOW objects may share the driver, each with its own peers. The driver
+ *                      callbacks are routed by MAC: to the instance that knows the peer, else to one in handshake.
+ *                      Timers carry their instance as timer ID, see pvTimerGetTimerID().
+ *  Callbacks:          the driver callbacks never wait: statuses are atomics, the peer table is looked up
+ *                      without blocking, acks are posted to the sender task (post_ctrl()). A handshake only
+ *                      asks the sender task to drop the old frames and delta reference (post_reset()).
+ *  Receiving:          recv() returns at once, recv(data, timeout) sleeps until a message arrives.
+ *                      Or register on_message(), the handler is called from its own task (set_recv_task()).
+ *  Wire format:        Both peers exchange capabilities in handshake. If both support it, data messages
+ *                      are sent in delta or compact format (see ESP32_RC_Codec.h), otherwise the raw Message is sent.
  *                          
  * 
  * 
@@ -25,32 +59,55 @@
 
 class ESP32_RC_ESPNOW : public ESP32RemoteControl {
   public:
-    ESP32_RC_ESPNOW(bool fast_mode=false, bool debug_mode=false); 
+    static constexpr size_t MAX_PAYLOAD_LEN = ESP_NOW_MAX_DATA_LEN - _RC_FRAME_OVERHEAD;
+
+    ESP32_RC_ESPNOW(bool fast_mode=false, bool debug_mode=false, size_t payload_len=sizeof(Message)); 
     ~ESP32_RC_ESPNOW();
     
     void init(void) override;
     void connect(void) override;                // general wrapper to establish the connection
-    void send(Message data) override;           // only en-queue the message
-    Message recv(void) override;                // general wrapper to receive data
+    void send(const void *data, uint8_t lane = _RC_LANE_CONTROL) override;  // only en-queue the message
+    bool recv(void *data) override;             // general wrapper to receive data
+    void set_peer_store(ESP32_RC_PeerStore *store);  // where the last peer is kept, nullptr = nowhere, call before connect()
+    void forget_peer(void);                     // clear the stored peer, the next handshake discovers again
+    void remove_peer(uint8_t peer_id) override; // also un-pairs it from ESPNOW
 
   
   private:
     void run(void* data) override;              // Override the Task class run function
     void send_queue_msg(void) override;         // send msg in send_queue
-    bool handshake(void) override;              // Handshake process
-    bool op_send(Message msg) override;         // Send operation
-    static ESP32_RC_ESPNOW* instance;           // instance pointer
+    bool handshake(uint32_t timeout_ms) override;  // Handshake process
+    bool op_send(const void *data, int slot) override;  // Send operation
+    bool op_send_to(ESP32_RC_Peer &target, const void *data);  // addressed message to a secondary peer
+    bool op_send_ctrl(uint8_t type, const uint8_t *mac_addr = nullptr);  // Send control frame, nullptr = primary
+    bool op_send_ctrl(const uint8_t *frame, size_t frame_len, const uint8_t *mac_addr = nullptr);  // Send prepared control frame
+    bool op_send_posted(const uint8_t *frame, size_t frame_len, const uint8_t *addr) override;  // acks of the receive callback
+    bool transmit(const uint8_t *frame, size_t frame_len, int slot, int delta_id, const uint8_t *mac_addr);
+    static std::atomic<ESP32_RC_ESPNOW *> instances[_ESPNOW_MAX_INSTANCES];  // the driver has one callback for all
+    static bool is_driver_ready;                // esp_now_init() done, shared by all instances
+    static ESP32_RC_ESPNOW *route(const uint8_t *mac_addr);  // instance a frame from / to this MAC belongs to
+    bool owns(const uint8_t *mac_addr);         // primary or in the peer table, also while the table is busy
 
 
     // ======== ESPNOW specific section ===========
     static uint8_t broadcast_addr[6];
     esp_now_peer_info_t peer;
+
+    ESP32_RC_NvsPeerStore nvs_store;
+    ESP32_RC_PeerStore *peer_store = &nvs_store;
+    uint8_t known_addr[ESP_NOW_ETH_ALEN];      // last paired peer, handshake tries it first
+    bool has_known_peer = false;
+
  
-    static void send_timer_callback(TimerHandle_t xTimer) ; 
     static void heartbeat_timer_callback(TimerHandle_t xTimer) ; 
 
     void pair_peer(const uint8_t *mac_addr);   // ESPNOW - pairing peer
     void unpair_peer(const uint8_t *mac_addr); // ESPNOW - un-pairing peer
+    void set_primary(const uint8_t *mac_addr); // peer 0, the one handshake() connects to
+    void accept_peer(const uint8_t *mac_addr, const uint8_t *data, int data_len);  // hello of a secondary peer
+    void recv_peer(ESP32_RC_Peer &from, const uint8_t *data, int data_len);  // data frame of a secondary peer
+    void load_peer(void);                      // known_addr from peer_store
+    void remember_peer(void);                  // known_addr = paired peer, saved if it changed
     
     static void static_on_datasent(const uint8_t *mac_addr, esp_now_send_status_t status);
     static void static_on_datarecv(const uint8_t *mac_addr, const uint8_t *data, int data_len);
@@ -0,0 +1,79 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <ESP32_RC_Stream.h>
+
+/*
+ *
+ * GATT link and frame pipe
+ *
+ * ESP32_RC_GattLink : one BLE connection carrying packets both ways. The peripheral notifies,
+ *                     the central writes without response, neither waits for the other side,
+ *                     so several packets leave in one connection event.
+ * ESP32_RC_GattPipe : frames over the packets of a link. No Arduino / BLE dependency, runs on
+ *                     the host against any ESP32_RC_GattLink.
+ *
+ * The packets of one connection are one byte stream of length-prefixed frames (ESP32_RC_Stream.h):
+ * a packet is filled up to the ATT payload (MTU - 3), several small frames share one, a frame
+ * larger than the payload spans two. The link layer acknowledges every packet, nothing is lost
+ * or reordered while the connection lasts, a new connection starts a new stream.
+ *
+ * Flow control:
+ *  - put_packet() returns BUSY when the controller has no free buffer. The pipe keeps the rest,
+ *    the next flush() continues where it stopped.
+ *  - put() only collects, one flush() per round of the sender task sends full packets.
+ *
+ * Sample:
+ *  pipe.put(frame, frame_len);                     // any number of frames
+ *  if (pipe.flush(link) == ESP32_RC_GattLink::BUSY) retry_later();
+ *  pipe.feed(packet, packet_len, on_frame, context);   // from the link DATA event
+ *
+ * Note:
+ *  - reset() on every UP / DOWN event, a half sent frame must not reach the next connection.
+ *  - feed() false means the stream is out of step, close the link.
+ *
+ */
+
+#define _RC_GATT_MIN_PACKET       20                          // ATT payload of the default MTU (23)
+
+class ESP32_RC_GattLink {
+  public:
+    enum : uint8_t { SENT = 0, BUSY = 1, CLOSED = 2 };        // put_packet()
+    enum : uint8_t { UP = 0, DOWN = 1, DATA = 2 };            // events, UP carries the 6 byte peer address
+    typedef void (*eventFuncType)(uint8_t event, const uint8_t *data, size_t len, void *context);
+
+    virtual ~ESP32_RC_GattLink() {}
+    void set_handler(eventFuncType handler, void *context) { this->handler = handler; this->context = context; }
+
+    virtual bool open(uint32_t timeout_ms) = 0;               // connected within timeout_ms, true at once if it is
+    virtual void close(void) = 0;
+    virtual bool is_open(void) = 0;
+    virtual size_t packet_len(void) = 0;                      // ATT payload of the connection, MTU - 3
+    virtual uint8_t put_packet(const uint8_t *data, size_t len) = 0;  // one notification / write, len <= packet_len()
+
+  protected:
+    void emit(uint8_t event, const uint8_t *data = nullptr, size_t len = 0) {
+      if (handler != nullptr) handler(event, data, len, context);
+    }
+
+  private:
+    eventFuncType handler = nullptr;
+    void *context         = nullptr;
+};
+
+class ESP32_RC_GattPipe {
+  public:
+    typedef void (*frameFuncType)(const uint8_t *frame, size_t frame_len, void *context);
+
+    void reset(void);                                         // new connection, both directions start over
+    bool put(const uint8_t *frame, size_t frame_len) { return writer.put(frame, frame_len); }  // false if full
+    uint8_t flush(ESP32_RC_GattLink &link);                   // SENT = all out, BUSY = rest kept, CLOSED
+    bool feed(const uint8_t *packet, size_t len, frameFuncType handler, void *context);  // false if out of step
+    size_t pending(void) const { return writer.size(); }      // bytes not taken by the link yet
+    uint32_t packets(void) const { return packet_count; }     // packets sent, for packets per frame
+
+  private:
+    ESP32_RC_StreamParser parser;
+    ESP32_RC_StreamWriter writer;
+    uint32_t packet_count = 0;
+};
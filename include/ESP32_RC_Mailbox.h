@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/*
+ *
+ * Latest-value mailbox
+ *
+ * Single slot register for control channels (joystick ...), where only the newest
+ * value matters. A write always overwrites, a read always returns the newest value
+ * and never the same value twice.
+ *
+ * Implemented as a triple buffer: writer and reader each own one buffer, the third
+ * one is exchanged atomically. Both sides are wait-free, no copy is ever blocked.
+ *
+ * Note:
+ *  - one writer task and one reader task.
+ *  - write_buffer() / publish() let the writer fill the buffer in place (zero-copy).
+ *  - read_view() returns the reader's buffer, valid until the next read by the same reader.
+ *
+ */
+
+class ESP32_RC_Mailbox {
+  public:
+    ~ESP32_RC_Mailbox();
+
+    bool create(size_t item_len);                             // allocate buffers, false if out of memory
+
+    // writer side
+    void write(const void *item);                             // overwrite with newest value
+    uint8_t *write_buffer(void);                              // fill in place, then publish()
+    void publish(void);
+
+    // reader side
+    bool read(void *item);                                    // copy newest value, false if nothing new
+    const uint8_t *read_view(void);                           // newest value without copy, nullptr if nothing new
+
+    void clear(void);                                         // drop unread value
+    bool is_fresh(void) const;                                // unread value available
+    bool is_created(void) const { return buffer != nullptr; }
+
+  private:
+    static const uint8_t FRESH = 0x04;                        // 'middle' holds an unread value
+
+    uint8_t *buffer        = nullptr;                         // 3 buffers of stride bytes
+    size_t   stride        = 0;
+    size_t   item_size     = 0;
+    uint8_t  back          = 0;                               // owned by writer
+    uint8_t  front         = 1;                               // owned by reader
+    std::atomic<uint8_t> middle{2};                           // index + FRESH flag
+
+    uint8_t *slot(uint8_t index) const { return buffer + index * stride; }
+};
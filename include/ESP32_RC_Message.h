@@ -1,11 +1,12 @@
+#pragma once
 /*
-  Define the message struct, 
+  Define the default message struct, 
   - Below sample contains 24 channels.
-  - It can be changed, but make sure it is less than max length. (default = 250)
-  - there is one field should be reserved even with customized struct. The reserved field is for ahndshake and haeartbeat system level messages.
+  - No need to edit it, any other struct can be used with ESP32_RC<Transport, T>. 
+    The size limit of the transport and the trivially copyable layout are checked at compile time.
+  - handshake and heartbeat are sent as their own control frames, they don't need any field in Message.
   struct Message {
-    bool is_set;       // reserved , don't change
-    char sys[40];      // reserved , don't change
+    bool is_set;
     char msg1[40];
     char msg2[40];
     char msg3[40];
@@ -33,8 +34,7 @@
 */
 
 struct Message {
-  bool is_set;       // reserved , don't change
-  char sys[40];      // reserved , don't change
+  bool is_set;
   char msg1[40];
   char msg2[40];
   char msg3[40];
@@ -0,0 +1,121 @@
+#pragma once
+#include <Arduino.h>
+#include <ESP32_RC.h>
+#include <ESP32_RC_Nrf24Radio.h>
+#include <SPI.h>
+
+/*
+ *
+ * NRF24 Class
+ *
+ * Bi-directional communication with an nRF24L01+ on the HSPI pins (HSPI_*, NRF24_CE in ESP32_RC_Common.h)
+ *
+ * Note:
+ *  Roles:              the chip is half duplex, one peer sends (PTX), the other answers in the ack
+ *                      payloads (PRX). connect() listens as PRX for a random time between
+ *                      _NRF24_LISTEN_TIMEOUT and twice that, whoever hears nothing becomes the PTX and
+ *                      says hello. Of two peers running the same code one gives up first.
+ *  Radio:              2 Mbps, auto-ack, dynamic payloads, ack payloads, see ESP32_RC_Nrf24Radio.h.
+ *                      Frames are cut into 32 byte payloads, up to 3 of them in flight in the TX FIFO.
+ *  Radio task:         the only one on the SPI bus (ESP32_RC_Nrf24Task), polls the chip every
+ *                      _NRF24_POLL_PERIOD, there is no IRQ pin. Received frames are decoded in it,
+ *                      into recv_queue / recv_mailbox as with ESPNOW.
+ *  Handshake:          HANDSHAKE in both roles, the PRX one rides in an ack payload. Heartbeat,
+ *                      link monitor and re-handshake work as with ESPNOW, the roles stay.
+ *  Sending:            send() only en-queues, the sender task hands the frames to the radio queue,
+ *                      a frame is done once it is queued:
+ *                       - a full queue keeps the frame, it is sent again after 1 ms.
+ *                       - a payload not acked after _NRF24_RETRIES retransmits loses the frames in
+ *                         the TX FIFO (MAX_RT), get_link_stats() shows the loss.
+ *                       - no delta format, as with WiFi.
+ *  Peers:              one peer, the pipe address is the key of peer 0.
+ *
+ */
+
+#define _NRF24_ADDRESS                    "ESPRC"             // pipe 0 address, both roles, _NRF24_ADDR_LEN bytes
+#define _NRF24_SPI_CLOCK                  8000000             // Hz, the chip takes up to 10 MHz
+#define _NRF24_LISTEN_TIMEOUT             500                 // ms, min time as PRX before becoming the PTX
+
+/* =========   Radio task  ========= */
+#define _NRF24_TASK_CORE                  1
+#define _NRF24_TASK_PRIORITY              11                  // above the sender task, a frame is handled as it arrives
+#define _NRF24_TASK_STACK                 4096
+#define _NRF24_POLL_PERIOD                1                   // ms, receive latency, and how often the PTX polls the PRX
+
+/*
+ *
+ * SPI bus of the chip, HSPI
+ *
+ */
+class ESP32_RC_Nrf24Spi : public ESP32_RC_Nrf24Bus {
+  public:
+    ESP32_RC_Nrf24Spi() : spi(HSPI) {}
+
+    void begin(void);
+    uint8_t transfer(uint8_t cmd, const uint8_t *tx, uint8_t *rx, size_t len) override;
+    void set_ce(bool level) override { digitalWrite(NRF24_CE, level ? HIGH : LOW); }
+
+  private:
+    SPIClass spi;
+};
+
+class ESP32_RC_NRF24;
+
+/*
+ *
+ * Radio task
+ *
+ * Polls the chip every _NRF24_POLL_PERIOD: status, received payloads, refill of the TX FIFO.
+ * Replaces the receive timer, the SPI bus is never shared.
+ *
+ */
+class ESP32_RC_Nrf24Task : public Task {
+  public:
+    ESP32_RC_Nrf24Task(ESP32_RC_NRF24 *rc);
+
+  private:
+    ESP32_RC_NRF24 *rc;
+    void run(void *data) override;                        // loops in rc->radio_loop()
+};
+
+class ESP32_RC_NRF24 : public ESP32RemoteControl {
+  friend class ESP32_RC_Nrf24Task;
+
+  public:
+    static constexpr size_t MAX_PAYLOAD_LEN = _RC_MAX_PAYLOAD_LEN;
+
+    // Constructor
+    ESP32_RC_NRF24(bool fast_mode=false, bool debug_mode=false, size_t payload_len=sizeof(Message));
+    ~ESP32_RC_NRF24();
+
+    // Implement virtual functions
+    void init(void) override;             // Set up the SPI bus and the chip
+    void connect(void) override;          // Pick the role, then handshake
+    void send(const void *data, uint8_t lane = _RC_LANE_CONTROL) override; // only en-queue the message
+    bool recv(void *data) override;       // Receive data over NRF24
+
+  private:
+    ESP32_RC_Nrf24Spi bus;
+    ESP32_RC_Nrf24Radio radio;
+    SemaphoreHandle_t radio_mutex = nullptr;  // radio, recursive: frames are handled inside poll()
+    uint8_t peer_key[_RC_PEER_ADDR_LEN];  // pipe address
+    std::atomic<bool> is_stopping{false};
+    ESP32_RC_Nrf24Task radio_task;        // polls radio, see radio_loop()
+
+    void run(void* data) override;        // Override the Task class run function
+    void send_queue_msg(void) override;   // send msg in send_queue
+    bool handshake(uint32_t timeout_ms) override;
+    bool op_send(const void *data, int slot) override; // queue one data frame on the radio
+    bool op_send_ctrl(uint8_t type);      // Send control frame
+    bool op_send_ctrl(const uint8_t *frame, size_t frame_len);
+    bool radio_put(const uint8_t *frame, size_t frame_len);  // false if the radio queue is full
+    void set_role(uint8_t role);
+
+    void radio_loop(void);                // body of radio_task
+    static void on_frame(const uint8_t *frame, size_t frame_len, void *context);
+    void on_datarecv(const uint8_t *data, int data_len, uint32_t rx_us);
+
+    // Timers Tasks
+    static void heartbeat_timer_callback(TimerHandle_t xTimer) ;
+
+};
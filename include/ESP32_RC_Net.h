@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#ifdef ESP_PLATFORM
+#include <lwip/sockets.h>
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+/*
+ *
+ * Network event loop
+ *
+ * One select() over every socket of a transport, no timeout, no polling. The network task
+ * sleeps in run() until a socket is readable / writable, or until wake() is called.
+ *
+ *  watch     : socket + READ / WRITE interest, any task. Takes effect at once, the loop is
+ *              woken to select() on the new set.
+ *  wake      : a 1 byte datagram to a loopback socket, which is always in the read set.
+ *  handler   : one for all sockets, called from run() with the events that happened.
+ *
+ * Plain BSD sockets, lwIP on the ESP32, the same code runs on Linux for host tests.
+ *
+ * Note:
+ *  - unwatch() a socket before close(). A socket closed while watched fails select(), run()
+ *    drops it from the set, the handler is not told.
+ *  - lwIP reports UDP sockets as always writable, WRITE is only useful for TCP.
+ *  - run() returns after stop(), handler calls in progress finish first.
+ *
+ */
+
+#define _RC_NET_MAX_SOCKETS       4                           // UDP socket, TCP listener, TCP connection, spare
+#define _RC_NET_ERROR_BACKOFF     10                          // ms, select() failed for another reason, try again then
+
+class ESP32_RC_NetLoop {
+  public:
+    enum : uint8_t { READ = 0x01, WRITE = 0x02 };
+    typedef void (*eventFuncType)(int fd, uint8_t events, void *context);
+
+    ESP32_RC_NetLoop();
+    ~ESP32_RC_NetLoop();
+
+    bool create(eventFuncType handler, void *context);      // open the wake-up socket, false if failed
+    bool watch(int fd, uint8_t events);                     // add or change a socket, false if all slots are used
+    void unwatch(int fd) { watch(fd, 0); }
+    void wake(void);                                        // select() returns, from any task
+    void run(void);                                         // body of the network task, until stop()
+    void stop(void);
+
+  private:
+    std::atomic<int>     fds[_RC_NET_MAX_SOCKETS];          // -1 = free slot
+    std::atomic<uint8_t> interest[_RC_NET_MAX_SOCKETS];
+    int wake_sock = -1;
+    struct sockaddr_in wake_addr;
+    std::atomic<bool> is_stopping{false};
+    eventFuncType handler = nullptr;
+    void *context         = nullptr;
+
+    void drop_closed(const int *watched);                   // free the slots of sockets closed while watched
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <ESP32_RC_Stream.h>
+
+/*
+ *
+ * nRF24L01+ driver
+ *
+ * ESP32_RC_Nrf24Bus   : one SPI transaction (command, data, STATUS back) and the CE pin. The bus
+ *                       on the HSPI pins is in ESP32_RC_NRF24.h, a simulated radio in ESP32_RC_Nrf24Sim.h.
+ * ESP32_RC_Nrf24Radio : Enhanced ShockBurst on top of the bus, no Arduino dependency, runs on the host.
+ *
+ *  PTX      : sends, the chip retransmits until acked (auto-ack, _NRF24_RETRIES).
+ *  PRX      : receives, its own frames ride back in the ack payloads. The PTX sends an empty poll
+ *             payload whenever it has nothing else, so the return channel never waits for data.
+ *  Payload  : dynamic length, up to 32 bytes. A frame is cut into fragments of 31 bytes behind a
+ *             one byte header [last | frame | index], the receiver drops a frame with a missing piece.
+ *             frame counts the frames mod 8: with pieces lost in between, the tail of one frame
+ *             does not complete a later one (unless a multiple of 8 frames went missing).
+ *  FIFO     : kept full, up to 3 payloads in flight while the chip sends / acks the first one.
+ *
+ * poll() does all the work: status, receive, loss, refill. One task calls it, every ms or so,
+ * there is no IRQ pin.
+ *
+ * Note:
+ *  - MAX_RT flushes the TX FIFO, what was in it is lost. The peer is gone or its RX FIFO is full.
+ *  - the handler of poll() may call put().
+ *
+ */
+
+/* =========   Registers / commands  ========= */
+#define _NRF24_R_REGISTER         0x00
+#define _NRF24_W_REGISTER         0x20
+#define _NRF24_R_RX_PAYLOAD       0x61
+#define _NRF24_W_TX_PAYLOAD       0xA0
+#define _NRF24_W_ACK_PAYLOAD      0xA8                        // | pipe
+#define _NRF24_R_RX_PL_WID        0x60
+#define _NRF24_FLUSH_TX           0xE1
+#define _NRF24_FLUSH_RX           0xE2
+#define _NRF24_ACTIVATE           0x50                        // nRF24L01 (non +) only, unlocks FEATURE
+#define _NRF24_NOP                0xFF
+
+#define _NRF24_REG_CONFIG         0x00
+#define _NRF24_REG_EN_AA          0x01
+#define _NRF24_REG_EN_RXADDR      0x02
+#define _NRF24_REG_SETUP_AW       0x03
+#define _NRF24_REG_SETUP_RETR     0x04
+#define _NRF24_REG_RF_CH          0x05
+#define _NRF24_REG_RF_SETUP       0x06
+#define _NRF24_REG_STATUS         0x07
+#define _NRF24_REG_RX_ADDR_P0     0x0A
+#define _NRF24_REG_TX_ADDR        0x10
+#define _NRF24_REG_FIFO_STATUS    0x17
+#define _NRF24_REG_DYNPD          0x1C
+#define _NRF24_REG_FEATURE        0x1D
+
+#define _NRF24_CONFIG_PRIM_RX     0x01
+#define _NRF24_CONFIG_PWR_UP      0x02
+#define _NRF24_CONFIG_CRCO        0x04                        // 2 byte CRC
+#define _NRF24_CONFIG_EN_CRC      0x08
+#define _NRF24_STATUS_TX_FULL     0x01
+#define _NRF24_STATUS_RX_P_NO     0x0E                        // 0x0E = RX FIFO empty
+#define _NRF24_STATUS_MAX_RT      0x10
+#define _NRF24_STATUS_TX_DS       0x20
+#define _NRF24_STATUS_RX_DR       0x40
+#define _NRF24_FIFO_RX_EMPTY      0x01
+#define _NRF24_FIFO_TX_EMPTY      0x10
+#define _NRF24_RF_DR_2M           0x08
+#define _NRF24_RF_PWR_MAX         0x06
+#define _NRF24_FEATURE_EN_DPL     0x04
+#define _NRF24_FEATURE_EN_ACK_PAY 0x02
+
+/* =========   Settings  ========= */
+#define _NRF24_PAYLOAD_LEN        32
+#define _NRF24_FIFO_DEPTH         3
+#define _NRF24_ADDR_LEN           5
+#define _NRF24_CHANNEL            108                         // 2508 MHz, above the WiFi channels
+#define _NRF24_RETRIES            15                          // ARC, retransmits before MAX_RT
+#define _NRF24_RETRY_DELAY        1                           // ARD, x 250 us + 250 us, a 32 byte ack payload needs 500 us at 2 Mbps
+#define _NRF24_FRAG_LAST          0x80                        // fragment header: last piece of the frame
+#define _NRF24_FRAG_FRAME         0x70                        // frame counter, mod 8
+#define _NRF24_FRAG_FRAME_SHIFT   4
+#define _NRF24_FRAG_INDEX         0x0F                        // a frame has 9 pieces at most
+#define _NRF24_FRAG_POLL          0xFF                        // one byte payload without data, PTX only
+#define _NRF24_FRAG_DATA          (_NRF24_PAYLOAD_LEN - 1)
+
+static_assert((_RC_STREAM_MAX_FRAME + _NRF24_FRAG_DATA - 1) / _NRF24_FRAG_DATA < _NRF24_FRAG_INDEX,
+              "the pieces of a frame must fit the fragment index, the poll payload has the last one");
+
+class ESP32_RC_Nrf24Bus {
+  public:
+    virtual ~ESP32_RC_Nrf24Bus() {}
+    virtual uint8_t transfer(uint8_t cmd, const uint8_t *tx, uint8_t *rx, size_t len) = 0;  // returns STATUS, tx / rx may be nullptr
+    virtual void set_ce(bool level) = 0;
+};
+
+class ESP32_RC_Nrf24Radio {
+  public:
+    enum : uint8_t { PTX = 0, PRX = 1 };
+    typedef void (*frameFuncType)(const uint8_t *frame, size_t frame_len, void *context);
+
+    bool begin(ESP32_RC_Nrf24Bus *bus, const uint8_t *addr, uint8_t channel = _NRF24_CHANNEL);  // false if no chip answers
+    void set_role(uint8_t role);          // FIFOs and the frames in pieces are dropped
+    uint8_t get_role(void) const { return role; }
+
+    bool put(const uint8_t *frame, size_t frame_len);  // queue one frame, false if full
+    void poll(frameFuncType handler, void *context);   // serve the chip, handler gets the frames received
+
+    uint32_t get_lost(void) const { return lost_count; }      // MAX_RT, TX FIFO dropped
+    uint32_t get_broken(void) const { return broken_count; }  // frames received with a missing piece
+    uint32_t get_payloads(void) const { return payload_count; }  // payloads put into the TX FIFO, polls too
+
+  private:
+    ESP32_RC_Nrf24Bus *bus = nullptr;
+    uint8_t role     = PRX;
+    uint8_t config   = 0;
+
+    ESP32_RC_StreamWriter out;            // frames waiting, length-prefixed
+    size_t  out_offset   = 0;             // bytes of the head frame already in the FIFO
+    uint8_t out_index    = 0;             // next fragment of the head frame
+    uint8_t out_frame    = 0;             // counter of the head frame
+
+    uint8_t frame[_RC_STREAM_MAX_FRAME];  // frame being put together
+    size_t  frame_len    = 0;
+    uint8_t frame_index  = 0;             // next fragment expected
+    uint8_t frame_id     = 0;             // counter bits of its index 0
+    bool    is_skipping  = true;          // a piece was lost, wait for index 0
+
+    uint32_t lost_count    = 0;
+    uint32_t broken_count  = 0;
+    uint32_t payload_count = 0;
+
+    uint8_t read_reg(uint8_t reg);
+    uint8_t write_reg(uint8_t reg, uint8_t value);
+    uint8_t write_reg(uint8_t reg, const uint8_t *data, size_t len);
+    uint8_t command(uint8_t cmd) { return bus->transfer(cmd, nullptr, nullptr, 0); }
+
+    uint8_t receive(uint8_t status, frameFuncType handler, void *context);  // drain the RX FIFO
+    uint8_t refill(uint8_t status);       // fragments into the TX FIFO until full
+    void on_fragment(const uint8_t *payload, size_t len, frameFuncType handler, void *context);
+    void drop_head(void);                 // head frame sent or given up, on to the next
+};
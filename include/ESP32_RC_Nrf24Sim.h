@@ -0,0 +1,89 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <ESP32_RC_Nrf24Radio.h>
+
+/*
+ *
+ * Simulated nRF24L01+
+ *
+ * The chip as ESP32_RC_Nrf24Radio sees it over the bus: registers, 3 deep TX / RX FIFOs, CE,
+ * Enhanced ShockBurst with auto-ack, retransmits, ack payloads and the PID check. Two of them
+ * are linked into one air, for the driver on the host.
+ *
+ *  Time    : every bus byte takes 1 us (8 MHz SPI), advance() lets time pass between two polls.
+ *            A packet goes out once the one before it is done, the packet, its ack, settling and
+ *            retransmit delays take the time they would at 2 Mbps. The outcome of a packet is
+ *            known when it starts.
+ *  Loss    : set_loss() drops packets and acks on the air at random, the PTX retransmits,
+ *            the PRX keeps its ack payload until a new PID shows the ack arrived.
+ *
+ * Sample:
+ *  ESP32_RC_Nrf24Sim sim_a, sim_b;
+ *  sim_a.link(&sim_b);
+ *  radio_a.begin(&sim_a, addr);
+ *  radio_b.begin(&sim_b, addr);
+ *  radio_a.poll(...); radio_b.poll(...); sim_a.advance(1000); sim_b.advance(1000);
+ *
+ * Note:
+ *  - no power-up delay, each sim has its own clock, advance both alike.
+ *
+ */
+
+#define _NRF24_SIM_SETTLE_US      130                         // TX / RX settling
+#define _NRF24_SIM_BYTE_US        1                           // one byte over the bus, 8 MHz SPI
+#define _NRF24_SIM_PACKET_BITS(len) ((1 + _NRF24_ADDR_LEN + 2 + (len)) * 8 + 9)  // preamble, address, CRC, payload, PCF
+
+class ESP32_RC_Nrf24Sim : public ESP32_RC_Nrf24Bus {
+  public:
+    ESP32_RC_Nrf24Sim();
+
+    void link(ESP32_RC_Nrf24Sim *peer);   // both ways
+    void set_loss(uint32_t per_mille, uint32_t seed = 1);  // packets and acks lost on the air
+    void advance(uint32_t us) { now += us; }
+    uint64_t now_us(void) const { return now; }
+    uint64_t air_us(void) const { return air_time; }  // the radio was busy sending
+
+    uint8_t transfer(uint8_t cmd, const uint8_t *tx, uint8_t *rx, size_t len) override;
+    void set_ce(bool level) override { ce = level; }
+
+  private:
+    struct Payload {
+      uint8_t len;
+      uint8_t data[_NRF24_PAYLOAD_LEN];
+    };
+    struct Fifo {
+      Payload items[_NRF24_FIFO_DEPTH];
+      int head  = 0;
+      int count = 0;
+      bool push(const uint8_t *data, size_t len);
+      Payload &front(void) { return items[head]; }
+      void pop(void) { head = (head + 1) % _NRF24_FIFO_DEPTH; count --; }
+      void clear(void) { head = count = 0; }
+    };
+
+    uint8_t regs[0x20];
+    uint8_t tx_addr[_NRF24_ADDR_LEN];
+    uint8_t rx_addr[_NRF24_ADDR_LEN];
+    Fifo tx_fifo;
+    Fifo rx_fifo;
+    bool ce = false;
+    ESP32_RC_Nrf24Sim *peer = nullptr;
+
+    uint8_t pid        = 0;               // PTX: of the payload at the head of the TX FIFO
+    int last_pid       = -1;              // PRX: of the last payload taken
+    Payload last_packet = {};             // PRX: the last payload taken, stands in for its CRC
+    bool is_ack_sent   = false;           // PRX: head of the TX FIFO went out in an ack, not confirmed yet
+    uint32_t loss      = 0;               // per mille
+    uint32_t rand_state = 1;
+    uint64_t air_time  = 0;
+    uint64_t now       = 0;               // us
+    uint64_t tx_free   = 0;               // the radio is done with the last packet
+
+    uint8_t status(void);
+    uint8_t fifo_status(void);
+    bool is_listening(void);              // PRX, powered, CE high
+    void run_air(void);                   // PTX: send the TX FIFO, as far as time allows
+    bool on_air(const Payload &packet, uint8_t packet_pid, Payload &ack);  // PRX side, false if no ack
+    bool is_lost(void);
+};
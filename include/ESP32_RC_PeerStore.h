@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ *
+ * Peer store
+ *
+ * Remembers the last paired peer (MAC + channel) across reboots. At boot the transport
+ * sends its handshake straight to the stored peer (unicast) and only falls back to the
+ * broadcast discovery if that peer does not answer within _RC_RESUME_TIMEOUT.
+ *
+ *  ESP32_RC_NvsPeerStore : default, NVS via Arduino Preferences, namespace _RC_NVS_NAMESPACE
+ *  ESP32_RC_MemPeerStore : RAM only, nothing survives a reboot. For host tests, or to
+ *                          pre-load a fixed peer.
+ *
+ * Note:
+ *  - the transport calls recall() / remember(), only from task context (connect / re-handshake),
+ *    never from a radio callback. remember() saves only when the peer changed, so the flash is
+ *    not worn by reconnects.
+ *
+ */
+
+#define _RC_NVS_NAMESPACE         "esp32_rc"
+#define _RC_PEER_ADDR_LEN         6
+
+class ESP32_RC_PeerStore {
+  public:
+    virtual ~ESP32_RC_PeerStore() {}
+
+    virtual bool load(uint8_t *mac_addr, uint8_t &channel) = 0;     // false if nothing stored
+    virtual bool save(const uint8_t *mac_addr, uint8_t channel) = 0;
+    virtual void clear(void) = 0;
+
+    // stored peer if it was paired on this channel, false if none or stale
+    bool recall(uint8_t *mac_addr, uint8_t channel) {
+      uint8_t stored_addr[_RC_PEER_ADDR_LEN];
+      uint8_t stored_channel = 0;
+      if (!load(stored_addr, stored_channel) || stored_channel != channel) return false;
+      memcpy(mac_addr, stored_addr, _RC_PEER_ADDR_LEN);
+      return true;
+    }
+
+    // save if it differs from the stored peer, false if the save failed
+    bool remember(const uint8_t *mac_addr, uint8_t channel) {
+      uint8_t stored_addr[_RC_PEER_ADDR_LEN];
+      uint8_t stored_channel = 0;
+      if (load(stored_addr, stored_channel) && stored_channel == channel
+          && memcmp(stored_addr, mac_addr, _RC_PEER_ADDR_LEN) == 0) return true;
+      return save(mac_addr, channel);
+    }
+};
+
+class ESP32_RC_NvsPeerStore : public ESP32_RC_PeerStore {
+  public:
+    bool load(uint8_t *mac_addr, uint8_t &channel) override;
+    bool save(const uint8_t *mac_addr, uint8_t channel) override;
+    void clear(void) override;
+};
+
+class ESP32_RC_MemPeerStore : public ESP32_RC_PeerStore {
+  public:
+    bool load(uint8_t *mac_addr, uint8_t &channel) override {
+      if (!is_stored) return false;
+      memcpy(mac_addr, stored_addr, _RC_PEER_ADDR_LEN);
+      channel = stored_channel;
+      return true;
+    }
+
+    bool save(const uint8_t *mac_addr, uint8_t channel) override {
+      memcpy(stored_addr, mac_addr, _RC_PEER_ADDR_LEN);
+      stored_channel = channel;
+      is_stored      = true;
+      save_count ++;
+      return true;
+    }
+
+    void clear(void) override { is_stored = false; }
+
+    int save_count = 0;                                       // writes so far, flash wear in tests
+
+  private:
+    uint8_t stored_addr[_RC_PEER_ADDR_LEN] = {};
+    uint8_t stored_channel = 0;
+    bool    is_stored      = false;
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <ESP32_RC_Common.h>
+#include <ESP32_RC_Ring.h>
+#include <ESP32_RC_Stats.h>
+#include <ESP32_RC_PeerStore.h>
+
+/*
+ *
+ * Peer table
+ *
+ * One controller, many executors. Peer 0 is the primary link, the one connect() and the
+ * re-handshake establish. It is served by the lanes, the send window, the delta codec,
+ * link stats and link clock as before. Every other peer that says hello while the primary
+ * link is up gets its own entry instead of taking the link over:
+ *
+ *  id          : index in the table, stable until remove()
+ *  send_queue  : addressed messages, send(peer_id, data) / broadcast(data). Sent once, no retry.
+ *  recv_queue  : messages from this peer, recv(peer_id, data). The oldest is dropped if full.
+ *  caps        : agreed in handshake, never delta, the codec keeps one reference per link
+ *  link_state  : _RC_LINK_UP / _RC_LINK_LOST, checked by the link monitor like the primary
+ *  stats       : loss / duplicates, like link_stats of the primary
+ *
+ * Lookup by MAC is O(1): open addressing on a hash of the MAC, _RC_PEER_INDEX_SIZE buckets
+ * (at least twice the table), linear probing. The index is rebuilt on remove(), which is rare.
+ *
+ * Note:
+ *  - add() / remove() / set_primary() take the table lock. find() never blocks, it runs in
+ *    the radio callback: it reads the index under a sequence counter (seqlock, odd while a
+ *    writer holds the lock) and reads again if a writer came in between. After
+ *    _RC_PEER_READ_TRIES it gives up with _RC_PEER_BUSY, the caller drops the frame.
+ *  - entries never move, an id found in the receive callback stays valid for the whole callback.
+ *  - queues of an entry are allocated on its first add() and kept for reuse.
+ *
+ */
+
+#define _RC_MAX_PEERS             19                          // ESP_NOW_MAX_TOTAL_PEER_NUM - 1, one kept for the broadcast address
+#define _RC_PEER_INDEX_SIZE       64                          // hash buckets, power of 2, >= 2 * _RC_MAX_PEERS
+#define _RC_PEER_QUEUE_DEPTH      8                           // addressed messages per peer and direction
+#define _RC_PEER_PRIMARY          0
+#define _RC_PEER_NONE             -1
+#define _RC_PEER_BUSY             -2                          // find(): a writer held the table, try again later
+#define _RC_PEER_READ_TRIES       8                           // find() reads before it gives up
+
+struct ESP32_RC_Peer {
+  uint8_t  mac_addr[_RC_PEER_ADDR_LEN];
+  bool     is_used      = false;
+  uint8_t  caps         = 0;                                  // agreed in handshake
+  uint16_t next_seq     = 0;                                  // trailer sequence of addressed messages
+
+  std::atomic<uint8_t>  link_state{_RC_LINK_UP};
+  std::atomic<uint32_t> last_rx_ms{0};                        // millis() of the last frame from this peer
+
+  uint32_t sent         = 0;                                  // confirmed by the radio
+  uint32_t send_errors  = 0;
+  uint32_t received     = 0;
+  uint32_t recv_errors  = 0;
+
+  ESP32_RC_Ring send_queue;
+  ESP32_RC_Ring recv_queue;
+  ESP32_RC_LinkStats stats;
+};
+
+// copy for the application, see get_peer()
+struct ESP32_RC_PeerInfo {
+  uint8_t  mac_addr[_RC_PEER_ADDR_LEN];
+  uint8_t  link_state;
+  uint32_t sent;
+  uint32_t send_errors;
+  uint32_t received;
+  uint32_t recv_errors;
+};
+
+class ESP32_RC_PeerTable {
+  public:
+    ESP32_RC_PeerTable();
+    ~ESP32_RC_PeerTable();
+
+    bool create(size_t item_len);                             // lock, queues hold item_len bytes, false if out of memory
+
+    void set_primary(const uint8_t *mac_addr);                // entry 0, a secondary entry of the same MAC is dropped
+    int add(const uint8_t *mac_addr, uint32_t now_ms);        // (re)start a secondary entry, its id, -1 if full
+    void remove(int id);
+    int find(const uint8_t *mac_addr);                        // id, -1 if unknown, -2 if busy, never blocks
+
+    bool is_used(int id) const { return (id >= 0 && id < _RC_MAX_PEERS && peers[id].is_used); }
+    ESP32_RC_Peer &get(int id) { return peers[id]; }
+    int count(void) const;                                    // entries in use, primary included
+    bool has_pending_send(void) const;                        // addressed messages waiting in any send_queue
+
+    static uint32_t hash(const uint8_t *mac_addr);
+
+  private:
+    ESP32_RC_Peer peers[_RC_MAX_PEERS];
+    int8_t   index[_RC_PEER_INDEX_SIZE];                      // bucket -> id, -1 = empty
+    size_t   item_size  = 0;
+    SemaphoreHandle_t mutex = nullptr;
+    std::atomic<uint32_t> version{0};                         // odd while a writer changes the index
+
+    int probe(const uint8_t *mac_addr) const;                 // bucket holding the MAC, or the empty one ending the probe, -1 if none
+    void rebuild_index(void);
+    void lock(void);                                          // writers, version odd while held
+    void unlock(void);
+};
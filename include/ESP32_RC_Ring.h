@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/*
+ *
+ * Lock-free ring buffer
+ *
+ * Replaces the FreeRTOS queues between application and radio (send_queue, recv_queue).
+ * No kernel critical section on push / pop, items are copied once into the ring.
+ *
+ * Note:
+ *  - single producer : push() / push_overwrite() must be called from one task only.
+ *  - consumer side   : pop() / peek() / consume() / clear() move 'tail' with compare-and-swap,
+ *                      so the producer may drop the oldest item (push_overwrite) and other
+ *                      tasks may clear() the ring. With one producer and one consumer every
+ *                      call completes in a bounded number of steps (wait-free).
+ *  - set_notify()    : optional, the given task gets a task notification on every push,
+ *                      so the consumer can sleep in wait() instead of polling.
+ *
+ */
+
+#define _RC_CACHE_LINE            32                          // ESP32 cache line size
+
+class ESP32_RC_Ring {
+  public:
+    ~ESP32_RC_Ring();
+
+    bool create(size_t capacity, size_t item_len);            // allocate buffer, false if out of memory
+    void set_notify(TaskHandle_t task);                       // task to notify on push, nullptr = none
+
+    // producer side
+    bool push(const void *item);                              // false if full
+    bool push_overwrite(const void *item);                    // drop the oldest item if full, true if dropped
+
+    // consumer side
+    bool pop(void *item);                                     // item = nullptr to discard, false if empty
+    bool peek(void *item, uint32_t *pos = nullptr);           // copy front item, pos for consume()
+    bool consume(uint32_t pos);                               // remove front item, only if it is still 'pos'
+    void clear(void);                                         // remove all items
+    bool wait(TickType_t ticks);                              // wait for push notification, true if not empty
+
+    int depth(void) const;                                    // number of items in ring
+    bool is_created(void) const { return buffer != nullptr; }
+
+  private:
+    alignas(_RC_CACHE_LINE) std::atomic<uint32_t> head{0};    // written by producer only
+    alignas(_RC_CACHE_LINE) std::atomic<uint32_t> tail{0};    // moved by compare-and-swap
+
+    alignas(_RC_CACHE_LINE) uint8_t *buffer = nullptr;
+    size_t   stride       = 0;                                // item_len, 4-byte aligned
+    size_t   item_size    = 0;
+    uint32_t mask         = 0;                                // slots - 1, slots is power of 2
+    uint32_t max_depth    = 0;                                // requested capacity
+    TaskHandle_t notify_task = nullptr;
+
+    uint8_t *slot(uint32_t pos) const { return buffer + (pos & mask) * stride; }
+};
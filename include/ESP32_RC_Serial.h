@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <ESP32_RC_Common.h>
+
+/*
+ *
+ * Serial link
+ *
+ * ESP32_RC_SerialPort   : a byte pipe, a UART on the ESP32 (ESP32_RC_UART.h), a tty / pty on Linux
+ *                         (ESP32_RC_PosixSerial below).
+ * ESP32_RC_SerialLink   : frames over the port, no Arduino dependency, runs on the host.
+ *
+ * Every frame goes on the wire as
+ *
+ *  COBS([frame] [CRC-16/CCITT, LE]) 0x00
+ *
+ * COBS removes every 0x00 from the data, so 0x00 marks the end of a frame and a receiver that
+ * starts in the middle, or lost bytes, finds the next frame at the next 0x00. The overhead is one
+ * byte per 254 plus the delimiter. A frame with a bad CRC is dropped and counted.
+ *
+ *  batch   : put() encodes into one buffer, flush() hands it to the port in one write, the
+ *            driver keeps the hardware FIFO full from it. A failed write keeps the batch, the
+ *            next flush() writes it again. Bytes that did go out before the error are sent twice
+ *            then: a whole frame arrives twice (the sequence tells), a cut one fails its CRC.
+ *
+ * Sample:
+ *  link.put(frame, frame_len);                     // any number of frames
+ *  link.flush(port);
+ *  int len = port.read(buffer, sizeof(buffer), 100);
+ *  if (len > 0) link.feed(buffer, len, on_frame, context);
+ *
+ * Note:
+ *  - the batch side (put / flush) and the receive side (feed) may run in different tasks,
+ *    each side needs one task at a time.
+ *
+ */
+
+#define _RC_SERIAL_MAX_FRAME      _MAX_MSG_LEN
+#define _RC_SERIAL_CRC_LEN        2
+#define _RC_SERIAL_MAX_ENCODED(len) ((len) + _RC_SERIAL_CRC_LEN + ((len) + _RC_SERIAL_CRC_LEN) / 254 + 2)  // code bytes + delimiter
+#define _RC_SERIAL_BATCH          1024                        // one write, several frames
+
+class ESP32_RC_SerialPort {
+  public:
+    virtual ~ESP32_RC_SerialPort() {}
+    virtual bool open(uint32_t baud) = 0;
+    virtual void close(void) = 0;
+    virtual int read(uint8_t *data, size_t len, uint32_t timeout_ms) = 0;  // waits for the first byte, then takes what is there, 0 = timeout, -1 = error
+    virtual int write(const uint8_t *data, size_t len) = 0;  // all of it, blocks while the driver is full, -1 = error
+    virtual int tx_pending(void) { return 0; }            // bytes written but not on the wire yet, 0 if the port cannot tell
+};
+
+class ESP32_RC_SerialLink {
+  public:
+    typedef void (*frameFuncType)(const uint8_t *frame, size_t frame_len, void *context);
+
+    bool put(const uint8_t *frame, size_t frame_len);  // encode into the batch, false if full
+    bool flush(ESP32_RC_SerialPort &port);  // write the batch, false if the port failed, the batch is kept
+    void feed(const uint8_t *data, size_t len, frameFuncType handler, void *context);  // bytes from the port
+    void reset(void);                     // drop the frame being received and the batch
+
+    uint32_t get_errors(void) const { return error_count; }  // CRC, COBS or length errors
+
+    static size_t cobs_encode(const uint8_t *data, size_t len, uint8_t *out);  // no delimiter
+    static size_t cobs_decode(const uint8_t *data, size_t len, uint8_t *out);  // 0 if malformed, out may be data
+    static uint16_t crc16(const uint8_t *data, size_t len);   // CRC-16/CCITT-FALSE
+
+  private:
+    uint8_t batch[_RC_SERIAL_BATCH];
+    size_t  batch_len  = 0;
+    uint8_t rx[_RC_SERIAL_MAX_ENCODED(_RC_SERIAL_MAX_FRAME)];  // encoded frame up to the next 0x00
+    size_t  rx_len     = 0;
+    bool    is_overflow = false;          // too long for a frame, skip to the next 0x00
+    uint32_t error_count = 0;
+
+    void on_packet(frameFuncType handler, void *context);
+};
+
+#ifndef ESP_PLATFORM
+/*
+ *
+ * Linux tty / pty
+ *
+ * Raw mode, 8N1, no flow control. A pty ignores the baud rate and runs as fast as both ends read.
+ *
+ * Sample:
+ *  socat -d -d pty,raw,echo=0 pty,raw,echo=0       // prints the two /dev/pts/N
+ *  ESP32_RC_PosixSerial port("/dev/pts/3");
+ *
+ */
+class ESP32_RC_PosixSerial : public ESP32_RC_SerialPort {
+  public:
+    ESP32_RC_PosixSerial(const char *path) : path(path) {}
+    ~ESP32_RC_PosixSerial() { close(); }
+
+    bool open(uint32_t baud) override;
+    void close(void) override;
+    int read(uint8_t *data, size_t len, uint32_t timeout_ms) override;
+    int write(const uint8_t *data, size_t len) override;
+    int tx_pending(void) override;                        // TIOCOUTQ
+
+  private:
+    const char *path;
+    int fd = -1;
+};
+#endif
@@ -0,0 +1,128 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/*
+ *
+ * Link statistics
+ *
+ * Every data frame carries a 16-bit sequence number and the sender's micros() in its
+ * trailer (see ESP32_RC_Common.h). From these the receiver counts per link:
+ *
+ *  received    : unique data frames
+ *  expected    : frames the sender numbered since the first one seen, lost = expected - received
+ *  duplicates  : same sequence seen again (retry after a lost ack), the frame is dropped
+ *  reordered   : arrived after a newer frame
+ *  one_way     : local receive time - remote send time, translated by ESP32_RC_LinkClock once synced,
+ *                before that the delay above the best one seen (queuing and retry delay)
+ *  rtt         : sender side, frame handed to the radio -> send-complete
+ *
+ * Histograms are log2 bucketed, bucket i counts [2^i, 2^(i+1)) us, the last one everything above.
+ *
+ * Note:
+ *  - one writer task (the radio callbacks), any number of readers.
+ *  - snapshot() is lock-free (sequence lock), it retries while the writer is updating.
+ *
+ */
+
+#define _RC_STATS_BUCKETS         24                          // up to 2^23 us = 8.4 s
+#define _RC_STATS_DUP_WINDOW      64                          // sequences checked for duplicates
+
+// 16-bit sequence numbers seen so far, the newest and a bitmap of the _RC_STATS_DUP_WINDOW before it
+class ESP32_RC_SeqWindow {
+  public:
+    enum : uint8_t {
+      NEW = 0,                                                // newer than any seen, advance = distance to the newest before
+      LATE,                                                   // inside the window, not seen yet (fills a gap)
+      DUPLICATE,                                              // inside the window, seen already
+      STALE                                                   // older than the window, unknown
+    };
+
+    void reset(void);
+    uint8_t check(uint16_t seq, uint16_t *advance = nullptr); // classify and record seq
+
+  private:
+    bool     has_seq   = false;
+    uint16_t max_seq   = 0;                                   // newest sequence seen
+    uint64_t seen      = 0;                                   // bit i = max_seq - i received
+};
+
+class ESP32_RC_LinkStats {
+  public:
+    struct Snapshot {
+      uint32_t received;
+      uint32_t expected;
+      uint32_t lost;
+      uint32_t duplicates;
+      uint32_t reordered;
+      uint32_t one_way[_RC_STATS_BUCKETS];
+      uint32_t rtt[_RC_STATS_BUCKETS];
+    };
+
+    void reset(void);
+
+    // writer side
+    bool on_frame(uint16_t seq, uint32_t remote_us, uint32_t local_us, bool is_synced);  // false = duplicate, drop it
+    void on_rtt(uint32_t rtt_us);
+
+    // reader side
+    void snapshot(Snapshot &snap) const;
+
+    static int bucket(uint32_t us);                           // histogram bucket of a delay
+
+  private:
+    std::atomic<uint32_t> version{0};                         // odd while the writer is updating
+    Snapshot data     = {};
+
+    // receiver state, writer only
+    ESP32_RC_SeqWindow window;
+    bool     has_delta = false;
+    int32_t  min_delta = 0;                                   // best local - remote seen
+
+    void begin_write(void);
+    void end_write(void);
+};
+
+
+/*
+ *
+ * Link clock
+ *
+ * RTT and clock offset from the heartbeat exchange, NTP-style:
+ *
+ *  HEARTBEAT      : [type] [t1]              t1 = sender micros() on send
+ *  HEARTBEAT_ACK  : [type] [t1] [t2] [t3]    t2 = peer micros() on receive, t3 = on reply
+ *                                            t4 = sender micros() when the ack arrives
+ *
+ *  rtt    = (t4 - t1) - (t3 - t2)
+ *  offset = ((t2 - t1) + (t3 - t4)) / 2      remote clock - local clock
+ *
+ * RTT is smoothed like TCP (RFC 6298), srtt += (rtt - srtt) / 8, rttvar += (|rtt - srtt| - rttvar) / 4.
+ * Offset samples with an RTT far above srtt are skipped, the error of a sample is up to rtt / 2.
+ *
+ * Note:
+ *  - one writer task (the radio callback), the fields are atomics, readers never block.
+ *
+ */
+
+#define _RC_CLOCK_RTO_MIN         2000                        // us, lower bound of rto()
+
+class ESP32_RC_LinkClock {
+  public:
+    void reset(void);
+    void on_sample(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4);
+
+    bool is_synced(void) const { return samples.load(std::memory_order_acquire) > 0; }
+    uint32_t srtt(void) const { return srtt_us.load(std::memory_order_relaxed); }
+    uint32_t rttvar(void) const { return rttvar_us.load(std::memory_order_relaxed); }
+    int32_t offset(void) const { return offset_us.load(std::memory_order_relaxed); }
+    uint32_t rto(void) const;                                 // srtt + 4 * rttvar, us
+    uint32_t to_local(uint32_t remote_us) const;              // remote micros() in local micros()
+
+  private:
+    std::atomic<uint32_t> samples{0};
+    std::atomic<uint32_t> srtt_us{0};
+    std::atomic<uint32_t> rttvar_us{0};
+    std::atomic<int32_t>  offset_us{0};
+};
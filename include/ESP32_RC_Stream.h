@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <ESP32_RC_Common.h>
+
+/*
+ *
+ * Stream framing
+ *
+ * A byte stream (TCP) has no message boundaries, a frame may arrive in pieces or several in one
+ * read. Every frame is sent with a length prefix:
+ *
+ *  [length, 16 bit LE] [frame]          length = 1 .. _RC_STREAM_MAX_FRAME
+ *
+ *  parser  : incremental, takes whatever the socket returned, any split of bytes. A frame
+ *            which arrived in one piece is handed out in place, only split frames are copied.
+ *  writer  : collects several frames for one socket write, so a round of the sender task
+ *            leaves in one segment with Nagle turned off. Keeps what the socket did not take.
+ *
+ * Sample:
+ *  while (parser.parse(data, len)) on_frame(parser.frame(), parser.frame_len());
+ *
+ * Note:
+ *  - a length out of range means the stream is out of step, there is no way to find the next
+ *    frame. is_broken() stays true until reset(), the connection should be closed.
+ *  - frame() is valid until the next parse(), and only while the data given to parse() is.
+ *
+ */
+
+#define _RC_STREAM_HEADER_LEN     2                           // length prefix
+#define _RC_STREAM_MAX_FRAME      _MAX_MSG_LEN
+#define _RC_STREAM_BATCH          1436                        // writer buffer, one TCP segment (lwIP TCP_MSS)
+
+class ESP32_RC_StreamParser {
+  public:
+    void reset(void);
+
+    bool parse(const uint8_t *&data, size_t &len);            // consume data until a frame is complete, false = need more
+    const uint8_t *frame(void) const { return frame_ptr; }
+    size_t frame_len(void) const { return expected; }
+    bool is_broken(void) const { return broken; }
+
+  private:
+    uint8_t  buffer[_RC_STREAM_MAX_FRAME];                    // frame split over several reads
+    uint8_t  header[_RC_STREAM_HEADER_LEN];
+    size_t   header_len = 0;                                  // bytes of header received
+    size_t   received   = 0;                                  // bytes of frame received into buffer
+    size_t   expected   = 0;                                  // frame length from the header
+    const uint8_t *frame_ptr = nullptr;                       // complete frame, buffer or in place
+    bool     broken     = false;
+};
+
+class ESP32_RC_StreamWriter {
+  public:
+    bool put(const uint8_t *frame, size_t frame_len);         // append [length] [frame], false if no room
+    const uint8_t *data(void) const { return buffer + head; }
+    size_t size(void) const { return tail - head; }           // bytes waiting for the socket
+    void consume(size_t len);                                 // the socket took len bytes
+    void clear(void) { head = tail = 0; }
+
+  private:
+    uint8_t  buffer[_RC_STREAM_BATCH];
+    size_t   head = 0;
+    size_t   tail = 0;
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include <Arduino.h>
+#include <ESP32_RC.h>
+#include <ESP32_RC_Serial.h>
+#include <driver/uart.h>
+
+/*
+ *
+ * UART Class
+ *
+ * Bi-directional communication over a wire, UART2 on UART_TX_PIN / UART_RX_PIN (ESP32_RC_Common.h)
+ *
+ * Note:
+ *  Framing:            COBS with a CRC-16 and a 0x00 delimiter, see ESP32_RC_Serial.h. A peer that
+ *                      starts late, or a broken byte, costs one frame.
+ *  Baud:               _UART_BAUD, up to 5 Mbaud on the ESP32 (APB clock / 16), both peers the same.
+ *                      The wire is full duplex, there are no roles, both peers say hello.
+ *  Reader task:        the only reader of the port (ESP32_RC_UartTask), blocks in the driver until a
+ *                      byte comes, then takes all that is buffered. The driver hands bytes over after
+ *                      _UART_RX_TOUT symbols of silence, so a frame is read as it ends.
+ *                      Received frames are decoded in it, into recv_queue / recv_mailbox as with ESPNOW.
+ *                      A full BLOCK lane stalls it until the application takes a message. The
+ *                      driver RX ring buffer takes the bytes meanwhile, without flow control on the
+ *                      wire it is the limit (a pty, or RTS / CTS, hold the peer's writes back).
+ *  Sending:            send() only en-queues, the sender task encodes the frames of a round into one
+ *                      batch and writes it at once, the driver ISR refills the 128 byte hardware FIFO
+ *                      from its TX ring buffer. A round only starts once the driver holds one batch
+ *                      at most (tx_pending()), so a critical frame waits for one batch of backlog,
+ *                      not for a full ring buffer. A port error keeps the batch for the next round,
+ *                      nothing is lost on our side. No delta format, as with WiFi: nothing confirms
+ *                      a frame.
+ *  Control frames:     the heartbeat timer and the reader never touch the port, heartbeat and acks
+ *                      go out first in the next batch of the sender task (post_ctrl()).
+ *  Handshake:          heartbeat, link monitor and re-handshake work as with ESPNOW.
+ *  Peers:              one peer, the port is the key of peer 0.
+ *  Other ports:        set_port() before init() runs the transport on any ESP32_RC_SerialPort.
+ *
+ */
+
+#define _UART_PORT                        UART_NUM_2
+#define _UART_BAUD                        2000000             // bps
+#define _UART_RX_BUFFER                   4096                // driver ring buffers, bytes
+#define _UART_TX_BUFFER                   (2 * _RC_SERIAL_BATCH)  // the batch on the wire and the next one, see wait_writable()
+#define _UART_RX_TOUT                     2                   // symbols of silence before the driver hands over the bytes
+#define _UART_PEER_KEY                    "UART2"
+
+/* =========   Reader task  ========= */
+#define _UART_TASK_CORE                   1
+#define _UART_TASK_PRIORITY               11                  // above the sender task, a frame is handled as it arrives
+#define _UART_TASK_STACK                  4096
+#define _UART_READ_TIMEOUT                100                 // ms, how often the reader looks at is_stopping
+#define _UART_READ_LEN                    512                 // bytes per read
+
+/*
+ *
+ * UART port, ESP-IDF driver
+ *
+ */
+class ESP32_RC_UartPort : public ESP32_RC_SerialPort {
+  public:
+    ESP32_RC_UartPort(uart_port_t port = _UART_PORT, int tx_pin = UART_TX_PIN, int rx_pin = UART_RX_PIN)
+      : port(port), tx_pin(tx_pin), rx_pin(rx_pin) {}
+
+    bool open(uint32_t baud) override;
+    void close(void) override;
+    int read(uint8_t *data, size_t len, uint32_t timeout_ms) override;
+    int write(const uint8_t *data, size_t len) override;
+    int tx_pending(void) override;
+
+  private:
+    uart_port_t port;
+    int tx_pin;
+    int rx_pin;
+    bool is_open = false;
+};
+
+class ESP32_RC_UART;
+
+/*
+ *
+ * Reader task
+ *
+ * Blocks on the port, feeds the link. Replaces the receive timer.
+ *
+ */
+class ESP32_RC_UartTask : public Task {
+  public:
+    ESP32_RC_UartTask(ESP32_RC_UART *rc);
+
+  private:
+    ESP32_RC_UART *rc;
+    void run(void *data) override;                        // loops in rc->reader_loop()
+};
+
+class ESP32_RC_UART : public ESP32RemoteControl {
+  friend class ESP32_RC_UartTask;
+
+  public:
+    static constexpr size_t MAX_PAYLOAD_LEN = _RC_MAX_PAYLOAD_LEN;
+
+    // Constructor
+    ESP32_RC_UART(bool fast_mode=false, bool debug_mode=false, size_t payload_len=sizeof(Message));
+    ~ESP32_RC_UART();
+
+    // Implement virtual functions
+    void init(void) override;             // Open the port
+    void connect(void) override;          // Handshake
+    void send(const void *data, uint8_t lane = _RC_LANE_CONTROL) override; // only en-queue the message
+    bool recv(void *data) override;       // Receive data over UART
+
+    void set_port(ESP32_RC_SerialPort *port, uint32_t baud = _UART_BAUD);  // before init()
+
+  private:
+    ESP32_RC_UartPort uart;
+    ESP32_RC_SerialPort *port = &uart;
+    uint32_t baud = _UART_BAUD;
+    ESP32_RC_SerialLink link;             // batch side: connect() until send_task runs, then send_task only
+    uint8_t peer_key[_RC_PEER_ADDR_LEN];  // port name
+    std::atomic<bool> is_stopping{false};
+    bool is_batch_kept = false;           // the last batch failed and is written again, sender task only
+    ESP32_RC_UartTask reader_task;        // reads port, see reader_loop()
+
+    void run(void* data) override;        // Override the Task class run function
+    void send_queue_msg(void) override;   // send msg in send_queue
+    bool handshake(uint32_t timeout_ms) override;
+    bool op_send(const void *data, int slot) override; // put one data frame into the batch
+    bool op_send_ctrl(uint8_t type);      // Send control frame at once, handshake only
+    bool op_send_posted(const uint8_t *frame, size_t frame_len, const uint8_t *addr) override;  // into the batch of this round
+    size_t create_ctrl(uint8_t type, uint8_t *frame);  // control frame without the delta capability
+    void wait_writable(void);             // until the port holds one batch at most
+
+    void reader_loop(void);               // body of reader_task
+    static void on_frame(const uint8_t *frame, size_t frame_len, void *context);
+    void on_datarecv(const uint8_t *data, int data_len, uint32_t rx_us);
+
+    // Timers Tasks
+    static void heartbeat_timer_callback(TimerHandle_t xTimer) ;
+
+};
@@ -1,39 +1,153 @@
 #pragma once
 #include <Arduino.h>
 #include <ESP32_RC.h>
+#include <ESP32_RC_Stream.h>
+#include <ESP32_RC_Net.h>
 #include <WiFi.h>
 
+/*
+ *
+ * WiFi Class
+ *
+ * Bi-directional communication via UDP datagrams over a private WiFi
+ *
+ * Note:
+ *  Network:            connect() first tries to join ESP32_RC_SSID as STA, for a random time between
+ *                      _WIFI_JOIN_TIMEOUT and twice that, so of two peers running the same code one gives
+ *                      up first and becomes the AP, the other joins it. Modem sleep is turned off.
+ *  Socket:             one non-blocking UDP socket on ESP32_RC_UDP_PORT of the own address, so two ends
+ *                      can share one host (the host tests, on loopback). Frames are the same as ESPNOW
+ *                      (type, codec, lane bits, trailer), one frame per datagram. Marked as voice
+ *                      traffic (_WIFI_TOS), so WMM puts it in the highest access category.
+ *  TCP mode:           enable_tcp(true) before connect(), the STA connects to the AP on ESP32_RC_TCP_PORT,
+ *                      frames are length-prefixed on the stream (see ESP32_RC_Stream.h). Nagle is off,
+ *                      the frames of one round of the sender task go out in one write. Nothing is lost,
+ *                      but a lost segment holds back everything after it, UDP is the better choice for
+ *                      control. Every handshake of the STA opens a new connection, the AP takes the
+ *                      newest one.
+ *  Handshake:          HANDSHAKE is sent to the last peer first, then to the broadcast address of
+ *                      the network, whoever hears it answers HANDSHAKE_ACK. Heartbeat, link monitor
+ *                      and re-handshake work as with ESPNOW.
+ *  Receiving:          the network task (ESP32_RC_NetTask) sleeps in one select() over all sockets
+ *                      (ESP32_RC_NetLoop) and decodes a frame as soon as it arrives, into recv_queue /
+ *                      recv_mailbox as with ESPNOW. It also accepts the TCP connection.
+ *  Sending:            send() only en-queues, the sender task hands the frames to the socket.
+ *                      No send-complete, a frame is done once the stack took it:
+ *                       - a full socket buffer keeps the frame queued, it is sent again shortly.
+ *                       - lost datagrams are not retried, _RC_LANE_BLOCK only means none is dropped
+ *                         before the socket. get_link_stats() shows the loss.
+ *                       - no delta format, the delta reference needs the confirmation of the peer.
+ *                      In TCP mode a frame the stack did not take stays in the writer, nothing else
+ *                      leaves before it. The network task writes it once the socket is writable
+ *                      and wakes the sender task.
+ *  Peers:              one peer, its address (IPv4 + port) is the key of peer 0, see find_peer().
+ *                      A hello from another address while the link is up is ignored.
+ *
+ */
+
 #define ESP32_RC_TCP_PORT                 8888
+#define ESP32_RC_UDP_PORT                 8889
 #define ESP32_RC_SSID                     "ESP32_RC_LAN"
 #define ESP32_RC_PASSWORD                 "today123"
 
+#define _WIFI_JOIN_TIMEOUT                5000                // ms, min time to join ESP32_RC_SSID before becoming the AP
+#define _WIFI_TOS                         0xB8                // DSCP EF, WMM voice access category
+
+/* =========   Network task  ========= */
+#define _WIFI_NET_TASK_CORE               1
+#define _WIFI_NET_TASK_PRIORITY           11                  // above the sender task, a datagram is handled as it arrives
+#define _WIFI_NET_TASK_STACK              4096
+
+class ESP32_RC_WIFI;
+
+/*
+ *
+ * Network task
+ *
+ * Runs the network event loop: sleeps in select() until a datagram, a connection or stream
+ * data arrives, or the connection can take more data. Replaces the receive timer, the
+ * receive latency is the wake-up time of the task.
+ *
+ */
+class ESP32_RC_NetTask : public Task {
+  public:
+    ESP32_RC_NetTask(ESP32_RC_WIFI *rc);
+
+  private:
+    ESP32_RC_WIFI *rc;
+    void run(void *data) override;                        // loops in rc->net_loop()
+};
+
 class ESP32_RC_WIFI : public ESP32RemoteControl {
+  friend class ESP32_RC_NetTask;
+
   public:
+    static constexpr size_t MAX_PAYLOAD_LEN = _RC_MAX_PAYLOAD_LEN;
+
     // Constructor
-    ESP32_RC_WIFI(bool fast_mode, bool debug_mode);
+    ESP32_RC_WIFI(bool fast_mode=false, bool debug_mode=false, size_t payload_len=sizeof(Message));
     ~ESP32_RC_WIFI();
 
     // Implement virtual functions
     void init(void) override;             // Initialize WiFi configuration
-    void connect(void) override;          // Establish WiFi connection (auto-switch role)
-    void send(Message data) override;     // Send data over WiFi
-    Message recv(void) override;          // Receive data over WiFi
+    void connect(void) override;          // Join or open the private WiFi, then handshake
+    void send(const void *data, uint8_t lane = _RC_LANE_CONTROL) override; // only en-queue the message
+    bool recv(void *data) override;       // Receive data over WiFi
+    void enable_tcp(bool mode);           // TCP stream instead of UDP datagrams, call before connect()
 
   private:
-    static ESP32_RC_WIFI* instance;
-    WiFiServer server;                    // WiFi Server (AP mode)
-    WiFiClient client;                    // WiFi Client (STA mode)
     bool is_ap = false;                   // Tracks if the ESP32 is in AP mode
+    int sock   = -1;                      // UDP socket, non-blocking
+    uint32_t local_ip = 0;                // own address, network order, own broadcasts are ignored
+    struct sockaddr_in broadcast_sin;     // broadcast address of the network
+    struct sockaddr_in peer_sin;          // primary peer
+    uint8_t peer_key[_RC_PEER_ADDR_LEN];  // peer_sin as peer table key: IPv4 + port
+    bool has_peer = false;                // peer_sin is valid, handshake tries it first
+
+    bool tcp_mode   = false;              // length-prefixed frames over one TCP connection
+    int listen_sock = -1;                 // AP in TCP mode
+    int conn_sock   = -1;                 // TCP connection to the peer, non-blocking
+    uint32_t conn_gen   = 0;              // changes with every new / closed connection
+    uint32_t parser_gen = 0;              // connection the parser is in step with, net_task only
+    uint8_t rx_buffer[_RC_STREAM_BATCH];  // a datagram, or one read of the stream, net_task only
+    struct sockaddr_in server_sin;        // STA in TCP mode: the AP
+    struct sockaddr_in conn_sin;          // other end of conn_sock
+    SemaphoreHandle_t stream_mutex = nullptr;  // conn_sock, conn_gen, conn_sin, writer
+    ESP32_RC_StreamParser parser;         // net_task only
+    ESP32_RC_StreamWriter writer;         // frames waiting for the next write
+
+    ESP32_RC_NetLoop net;                 // select() over sock, listen_sock, conn_sock
+    ESP32_RC_NetTask net_task;            // runs net, see net_loop()
+
     void run(void* data) override;        // Override the Task class run function
     void send_queue_msg(void) override;   // send msg in send_queue
-    bool handshake(void) override;   
-    bool op_send(Message msg) override;   // Send message immediately (not from send queue)   
+    bool handshake(uint32_t timeout_ms) override;
+    bool op_send(const void *data, int slot) override; // hand one data frame to the socket
+    bool op_send_ctrl(uint8_t type, const struct sockaddr_in *to = nullptr);  // Send control frame, nullptr = primary
+    bool op_send_ctrl(const uint8_t *frame, size_t frame_len, const struct sockaddr_in *to = nullptr);
 
-    // Timers Tasks
-    static void send_timer_callback(TimerHandle_t xTimer) ;
-    static void recv_callback(TimerHandle_t xTimer) ;
-    static void heartbeat_timer_callback(TimerHandle_t xTimer) ; 
+    void join_network(void);              // STA, or AP if nobody else is
+    bool open_socket(void);               // bind, non-blocking, broadcast
+    bool open_listener(void);             // AP in TCP mode
+    bool open_connection(uint32_t timeout_ms);  // STA in TCP mode, replaces the old connection
+    void accept_connection(void);         // AP in TCP mode, replaces the old connection
+    void use_connection(int fd, const struct sockaddr_in &addr);  // socket options, make it conn_sock
+    void close_connection(uint32_t gen);  // only if it is still connection gen
+    void drop_connection(void);           // stream_mutex held
+    bool stream_put(const uint8_t *frame, size_t frame_len);  // add to writer, false if not connected or full
+    bool flush_stream(void);              // false if the socket did not take everything
+    bool write_stream(void);              // stream_mutex held
+    void set_primary(const struct sockaddr_in &from);
+    static void make_key(const struct sockaddr_in &addr, uint8_t *key);
 
-};
+    void net_loop(void);                  // body of net_task
+    static void on_net_event(int fd, uint8_t events, void *context);
+    void recv_datagrams(void);            // drain the UDP socket
+    void recv_stream(int fd);             // one read of the connection, into parser
+    void on_writable(int fd);             // write the rest of the writer, wake the sender task
+    void on_datarecv(const struct sockaddr_in &from, const uint8_t *data, int data_len, uint32_t rx_us);
 
+    // Timers Tasks
+    static void heartbeat_timer_callback(TimerHandle_t xTimer) ;
 
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/*
+ *
+ * Send window
+ *
+ * Keeps up to N data frames in flight instead of stop-and-wait. The radio reports
+ * send-complete in the same order the frames were handed to it, so every frame on
+ * air gets a record in send order and complete() matches the oldest one, no id on air.
+ *
+ *  slot    : copy of a payload, stays in the window until the peer confirmed it
+ *            FREE -> QUEUED -> IN_FLIGHT -> DONE    delivered, the sender releases it
+ *                                        -> FAILED  sent again, only this frame
+ *            QUEUED also means the radio refused the frame (driver buffer full)
+ *  record  : one per frame on air, data (slot) or control (slot = -1)
+ *  seq     : every message gets the next sequence number when it enters the window, a retry
+ *            keeps it, so the receiver can tell a duplicate from a new frame.
+ *  frame   : the frame as first handed to the radio, kept with the slot (create() with a
+ *            frame_cap). A retry sends these same bytes, seq and delta id included: the receiver
+ *            drops it as a duplicate if the first copy made it, and the delta reference of later
+ *            frames stays one the receiver has.
+ *  lane    : every slot remembers its lane. With a window > 1 the last free slot is kept
+ *            for lane 0, so a critical frame never waits behind a full window of bulk data.
+ *
+ * Note:
+ *  - acquire() / release() / mark() are called by the sender task only.
+ *  - lock() must be held around track() ... radio send, so the record order is the
+ *    send order, and around complete() / expire() in the send callback.
+ *  - clear() keeps the records, the radio still completes those frames, but detaches them
+ *    from their slots (slot = -1), so a late completion never lands on a reused slot.
+ *  - expire() is a safety net for a lost callback, a late callback afterwards would
+ *    be matched against the next record.
+ *
+ */
+
+#define _RC_SEND_WINDOW_MAX       8                           // max frames in flight
+#define _RC_SEND_RECORDS          (_RC_SEND_WINDOW_MAX + 8)   // data + control frames in flight
+
+class ESP32_RC_SendWindow {
+  public:
+    enum : uint8_t { FREE = 0, QUEUED, IN_FLIGHT, DONE, FAILED };
+
+    struct Record {
+      int8_t   slot;                                          // window slot, -1 = control frame
+      int16_t  delta_id;                                      // id of the KEY / DELTA frame, -1 = not delta
+      uint32_t time;                                          // micros() when handed to the radio
+    };
+
+    ~ESP32_RC_SendWindow();
+
+    bool create(size_t item_len, size_t frame_cap = 0);      // allocate buffers, false if out of memory
+    void set_size(int size);                                  // frames in flight [1, _RC_SEND_WINDOW_MAX]
+    int size(void) const { return active; }
+
+    void lock(void);
+    void unlock(void);
+
+    // sender side
+    int acquire(uint8_t lane);                                // reserve a FREE slot (-> QUEUED), -1 if window full
+    void release(int slot);                                   // back to FREE
+    void mark(int slot, uint8_t state);
+    uint8_t state(int slot) const { return slots[slot].load(std::memory_order_acquire); }
+    uint8_t *buffer(int slot) const { return buffer_base + slot * stride; }
+    uint8_t &retries(int slot) { return retry_count[slot]; }
+    uint8_t lane(int slot) const { return slot_lane[slot]; }
+    uint16_t seq(int slot) const { return slot_seq[slot]; }
+    uint8_t *frame(int slot) const { return frame_base + slot * frame_stride; }
+    uint16_t &frame_len(int slot) { return slot_frame_len[slot]; }   // 0 = not encoded yet
+    int in_use(void) const;                                   // slots not FREE
+
+    // radio side, lock() held
+    bool track(int slot, int delta_id, uint32_t now);         // record the frame about to be sent, slot -> IN_FLIGHT
+    void untrack(void);                                       // radio refused it, drop the newest record, slot -> QUEUED
+    bool complete(bool success, Record &rec);                 // match the oldest record, false if none
+    bool expire(uint32_t now, uint32_t timeout, Record &rec); // fail the oldest record if overdue, in micros()
+
+    void clear(void);                                         // drop all slots, records stay until completed, detached
+
+  private:
+    uint8_t *buffer_base  = nullptr;                          // _RC_SEND_WINDOW_MAX buffers of stride bytes
+    size_t   stride       = 0;
+    uint8_t *frame_base   = nullptr;                          // _RC_SEND_WINDOW_MAX frames of frame_stride bytes
+    size_t   frame_stride = 0;
+    int      active       = 1;
+    SemaphoreHandle_t mutex = nullptr;
+
+    std::atomic<uint8_t> slots[_RC_SEND_WINDOW_MAX] = {};
+    uint8_t  retry_count[_RC_SEND_WINDOW_MAX] = {};
+    uint8_t  slot_lane[_RC_SEND_WINDOW_MAX]   = {};
+    uint16_t slot_seq[_RC_SEND_WINDOW_MAX]    = {};
+    uint16_t slot_frame_len[_RC_SEND_WINDOW_MAX] = {};
+    uint16_t next_seq     = 0;
+
+    Record   records[_RC_SEND_RECORDS];                       // ring, oldest at record_head
+    int      record_head  = 0;
+    int      record_count = 0;
+};
@@ -12,6 +12,7 @@ public:
 	void setPriority(uint8_t priority);
 	void setName(std::string name);
 	void setCore(BaseType_t coreId);
+	TaskHandle_t getHandle() const;
 	void start(void* taskData = nullptr);
 	void stop();
 	/**
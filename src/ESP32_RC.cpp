@@ -1,69 +1,885 @@
 #include <Arduino.h>
 #include <ESP32_RC.h>
 
+// 32 bit little endian, frames are byte aligned
+static void put_u32(uint8_t *p, uint32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = value >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
 // Constructor definition
-ESP32RemoteControl::ESP32RemoteControl (bool fast_mode, bool debug_mode) 
-  : Task("ESP32RemoteControl") {
+ESP32RemoteControl::ESP32RemoteControl (bool fast_mode, bool debug_mode, size_t payload_len) 
+  : Task("ESP32RemoteControl"), payload_len(payload_len), send_task(this), recv_task(this) {
   
   if (this->is_serial_set == false) {
     Serial.begin(115200);
     this->is_serial_set = true;
   }
 
+  set_lane(_RC_LANE_CRITICAL, _RC_LANE_CRITICAL_DEPTH, _RC_LANE_BLOCK);
+  set_lane(_RC_LANE_CONTROL,  _RC_LANE_CONTROL_DEPTH,  _RC_LANE_BLOCK);
+  set_lane(_RC_LANE_BULK,     _RC_LANE_BULK_DEPTH,     _RC_LANE_DROP_OLDEST);
+
   enable_fast(fast_mode);
   enable_debug(debug_mode);
+  set_send_window(_RC_SEND_WINDOW);
     
 }
 
-// Create system message -  like HANDSHAKE, HEARTBEAT ... etc
-Message ESP32RemoteControl::create_sys_msg(String data) {
-  Message msg;
-  strncpy(msg.sys, data.c_str(), sizeof(msg.sys) - 1);
-  msg.sys[sizeof(msg.sys) - 1] = '\0';
-  msg.is_set = true;
-  return msg;
+ESP32RemoteControl::~ESP32RemoteControl() {
+  stop_link_monitor();
+  stop_sender();
+  stop_receiver();
+  free(recv_pool);
+  if (recv_signal != nullptr) vSemaphoreDelete(recv_signal);
+  if (recv_room != nullptr) vSemaphoreDelete(recv_room);
 }
 
-// Extract system message 
-String ESP32RemoteControl::extract_sys_msg(const Message &msg) {
-  return String(msg.sys);
+// Create control frame - like HANDSHAKE, HEARTBEAT ... etc
+// frame must hold at least _RC_CTRL_FRAME_LEN bytes, returns frame length
+size_t ESP32RemoteControl::create_ctrl_frame(uint8_t type, uint8_t *frame) {
+  frame[0] = type;
+  if (type == _RC_FRAME_HANDSHAKE || type == _RC_FRAME_HANDSHAKE_ACK) {
+    frame[1] = local_caps();
+    put_u32(frame + 2, quantizer.signature());
+    return 6;
+  }
+  if (type == _RC_FRAME_HEARTBEAT) {
+    put_u32(frame + 1, micros());
+    return 5;
+  }
+  return 1;
 }
 
-// Set value with mutex
-void ESP32RemoteControl::set_value(int *in_varible, int value) {
-  xSemaphoreTake(mutex, portMAX_DELAY);
-  *in_varible = value;
-  xSemaphoreGive(mutex);      
-};
+// echo t1, add own receive (t2) and reply (t3) time
+size_t ESP32RemoteControl::create_heartbeat_ack(const uint8_t *heartbeat, int heartbeat_len, uint32_t rx_us, uint8_t *frame) {
+  frame[0] = _RC_FRAME_HEARTBEAT_ACK;
+  if (heartbeat_len < 5) return 1;                          // peer without timestamps
+  memcpy(frame + 1, heartbeat + 1, 4);
+  put_u32(frame + 5, rx_us);
+  put_u32(frame + 9, micros());
+  return 13;
+}
 
-// Get value with mutex
-void ESP32RemoteControl::get_value(int *in_varible, int *out_varible) {
-  xSemaphoreTake(mutex, portMAX_DELAY);
-  *out_varible = *in_varible;
-  xSemaphoreGive(mutex);        
-};
+void ESP32RemoteControl::on_heartbeat_ack(const uint8_t *frame, int frame_len, uint32_t rx_us) {
+  if (frame_len < 13) return;
+  link_clock.on_sample(get_u32(frame + 1), get_u32(frame + 5), get_u32(frame + 9), rx_us);
+}
 
-// Empty queue
-void ESP32RemoteControl::empty_queue(QueueHandle_t queue) {
-  Message msg;
-  while(de_queue(queue, &msg) == pdPASS){
-    // do nothing.
+TickType_t ESP32RemoteControl::heartbeat_period(void) {
+  TickType_t ticks = pdMS_TO_TICKS(int(1000 / heartbeat_rate));
+  return (ticks > 0) ? ticks : 1;
+}
+
+void ESP32RemoteControl::set_heartbeat_rate(float rate) {
+  if (rate <= 0) return;
+  heartbeat_rate = rate;
+  if (heartbeat_timer != nullptr) {
+    xTimerChangePeriod(heartbeat_timer, heartbeat_period(), 0);
   }
 }
 
-// Add Message to queue
-bool ESP32RemoteControl::en_queue(QueueHandle_t queue,  Message *pmsg) {
-  return (xQueueSend(queue, pmsg, ( TickType_t ) 10) == pdPASS);
+// 2 x RTO from the heartbeat RTT, the fixed _RC_SEND_EXPIRE until it is known
+uint32_t ESP32RemoteControl::send_timeout(void) {
+  if (!link_clock.is_synced()) return _RC_SEND_EXPIRE * 1000UL;
+  uint32_t timeout = 2 * link_clock.rto();
+  if (timeout < _RC_SEND_EXPIRE_MIN * 1000UL) return _RC_SEND_EXPIRE_MIN * 1000UL;
+  if (timeout > _RC_SEND_EXPIRE * 1000UL) return _RC_SEND_EXPIRE * 1000UL;
+  return timeout;
+}
+
+uint8_t ESP32RemoteControl::local_caps(void) {
+  return _RC_LOCAL_CAPS | (quantizer.is_active() ? _RC_CAP_QUANT : 0);
+}
+
+// quantized channels are only used if both sides declared the very same profiles
+uint8_t ESP32RemoteControl::negotiate_caps(const uint8_t *frame, size_t frame_len) {
+  if (frame_len < 6) return 0;
+  uint8_t caps = frame[1] & local_caps();
+  if (get_u32(frame + 2) != quantizer.signature()) {
+    caps &= ~_RC_CAP_QUANT;
+  }
+  return caps;
+}
+
+void ESP32RemoteControl::set_quant_profiles(const ESP32_RC_QuantProfile *profiles, int count) {
+  if (!quantizer.set_profiles(profiles, count, payload_len)) {
+    _ERROR_("Invalid quantization profiles.");
+  }
+}
+
+// Set value, atomic: the radio callbacks read it and must never wait
+void ESP32RemoteControl::set_value(std::atomic<int> *in_varible, int value) {
+  in_varible->store(value);
 };
 
-// Pop Message to queue
-bool ESP32RemoteControl::de_queue(QueueHandle_t queue,  Message *pmsg) {
-  if (pmsg == nullptr) return false;
-  return (xQueueReceive(queue, pmsg, ( TickType_t ) 10) == pdPASS);
+// Get value, atomic
+void ESP32RemoteControl::get_value(std::atomic<int> *in_varible, int *out_varible) {
+  *out_varible = in_varible->load();
 };
 
 
 
+
+/*
+ =========================================
+ *
+ * Queues and receive buffer pool
+ *  - send_queue / recv_queue are lock-free rings (ESP32_RC_Ring)
+ *  - received frames are decoded straight into a pool buffer
+ *  - recv_queue only carries the buffer index
+ *  - the application either copies it out with recv(), or borrows it with recv_view()
+ *  - free buffers are tracked in an atomic bitmap, no kernel call on take / put
+ *  - one send_queue / recv_queue per lane, all lanes share recv_pool
+ *  - mailbox_mode replaces the queues of _RC_LANE_CONTROL by two ESP32_RC_Mailbox (newest value only)
+ *  - stalls_reader: a full BLOCK lane holds the reader task back instead of dropping
+ * 
+ =========================================
+ */
+
+bool ESP32RemoteControl::create_queues(void) {
+  if (!send_window.create(payload_len, keeps_frames ? _MAX_MSG_LEN : 0)) return false;
+  if (!peers.create(payload_len)) return false;
+  if (!ctrl_queue.create(_RC_CTRL_QUEUE_DEPTH, sizeof(CtrlPost))) return false;
+  recv_signal = xSemaphoreCreateBinary();
+  if (recv_signal == nullptr) return false;
+  if (stalls_reader) {
+    recv_room = xSemaphoreCreateBinary();
+    if (recv_room == nullptr) return false;
+  }
+  if (mailbox_mode) {
+    if (!send_mailbox.create(payload_len) || !recv_mailbox.create(payload_len)) return false;
+  }
+
+  pool_size = _RC_RECV_MAX_BORROWED;
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+    if (uses_mailbox(lane)) continue;
+    if (!send_queue[lane].create(lanes[lane].depth, payload_len)) return false;
+    if (!recv_queue[lane].create(lanes[lane].depth, sizeof(uint8_t))) return false;
+    pool_size += lanes[lane].depth;
+  }
+  if (pool_size > _RC_RECV_POOL_MAX) pool_size = _RC_RECV_POOL_MAX;
+
+  pool_stride = (payload_len + 7) & ~(size_t)7;             // keep every buffer 8-byte aligned
+  recv_pool   = (uint8_t *)malloc(pool_stride * pool_size);
+  if (recv_pool == nullptr) return false;
+
+  for (int i = 0; i < (_RC_RECV_POOL_MAX + 31) / 32; i++) {
+    pool_free[i].store(0);
+  }
+  for (int index = 0; index < pool_size; index++) {
+    pool_free[index / 32].fetch_or(1UL << (index % 32));
+  }
+  return true;
+}
+
+uint8_t *ESP32RemoteControl::pool_buffer(int index) {
+  return recv_pool + index * pool_stride;
+}
+
+int ESP32RemoteControl::pool_take(void) {
+  for (int i = 0; i < (pool_size + 31) / 32; i++) {
+    uint32_t bits = pool_free[i].load();
+    while (bits != 0) {
+      uint32_t bit = bits & (~bits + 1);                     // lowest set bit
+      if (pool_free[i].compare_exchange_weak(bits, bits & ~bit)) {
+        return i * 32 + __builtin_ctz(bit);
+      }
+    }
+  }
+  // all buffers in use, reuse the oldest queued message of the lowest lane, never a critical one
+  uint8_t index;
+  for (int lane = _RC_LANE_COUNT - 1; lane > _RC_LANE_CRITICAL; lane--) {
+    if (recv_queue[lane].is_created() && recv_queue[lane].pop(&index)) return index;
+  }
+  return -1;
+}
+
+void ESP32RemoteControl::pool_put(int index) {
+  pool_free[index / 32].fetch_or(1UL << (index % 32));
+}
+
+void ESP32RemoteControl::pool_push(int index, uint8_t lane) {
+  uint8_t i = (uint8_t)index;
+  uint8_t dropped;
+  // add protection to de-queue front message to avoid queue overflow failure.
+  while (!recv_queue[lane].push(&i)) {
+    if (recv_queue[lane].pop(&dropped)) pool_put(dropped);
+  }
+}
+
+// recv_room is binary, a stale give only costs one more look at the depth
+void ESP32RemoteControl::wait_recv_room(uint8_t lane) {
+  if (recv_room == nullptr || lanes[lane].policy != _RC_LANE_BLOCK) return;
+  unsigned long start_time = millis();
+  while (recv_queue[lane].depth() >= lanes[lane].depth) {
+    unsigned long elapsed = millis() - start_time;
+    if (elapsed >= _RC_RECV_STALL_MAX) return;
+    xSemaphoreTake(recv_room, pdMS_TO_TICKS(_RC_RECV_STALL_MAX - elapsed));
+  }
+}
+
+void ESP32RemoteControl::empty_send_queue(void) {
+  send_window.clear();
+  if (mailbox_mode) send_mailbox.clear();
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+    send_queue[lane].clear();
+  }
+}
+
+void ESP32RemoteControl::empty_recv_queue(void) {
+  if (mailbox_mode) recv_mailbox.clear();
+  uint8_t index;
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+    if (!recv_queue[lane].is_created()) continue;
+    while (recv_queue[lane].pop(&index)) {
+      pool_put(index);
+    }
+  }
+}
+
+bool ESP32RemoteControl::uses_mailbox(uint8_t lane) {
+  return mailbox_mode && lane == _RC_LANE_CONTROL;
+}
+
+// BLOCK waits for room, the sender task drains the lane meanwhile
+bool ESP32RemoteControl::enqueue(const void *data, uint8_t lane) {
+  if (uses_mailbox(lane)) {
+    send_mailbox.write(data);
+    send_metric.in_count ++;
+    notify_sender();
+    return true;
+  }
+
+  ESP32_RC_Ring &queue = send_queue[lane];
+  switch (lanes[lane].policy) {
+    case _RC_LANE_DROP_OLDEST:
+      if (queue.push_overwrite(data)) {
+        send_metric.err_count ++;           // the oldest was dropped, never sent
+      }
+      break;
+    case _RC_LANE_DROP_NEWEST:
+      if (!queue.push(data)) {
+        send_metric.err_count ++;
+        return false;
+      }
+      break;
+    default:
+      while (!queue.push(data)) {
+        _DELAY_(1);
+      }
+      break;
+  }
+  send_metric.in_count ++;
+  return true;
+}
+
+bool ESP32RemoteControl::dequeue(uint8_t lane, void *data) {
+  if (uses_mailbox(lane)) return send_mailbox.read(data);
+  return send_queue[lane].pop(data);
+}
+
+// in mailbox mode the view stays valid until the next recv, release() is a no-op
+bool ESP32RemoteControl::recv_view(RecvView &view, uint8_t lane) {
+  view = RecvView();
+  if (lane >= _RC_LANE_COUNT) return false;
+  if (uses_mailbox(lane)) {
+    view.data = recv_mailbox.is_created() ? recv_mailbox.read_view() : nullptr;
+  } else {
+    uint8_t index;
+    if (recv_queue[lane].is_created() && recv_queue[lane].pop(&index)) {
+      view.data   = pool_buffer(index);
+      view.handle = index;
+      if (recv_room != nullptr) xSemaphoreGive(recv_room);
+    }
+  }
+  if (view.data == nullptr) return false;
+  view.lane = lane;
+  recv_metric.out_count ++;
+  return true;
+}
+
+bool ESP32RemoteControl::recv_view(RecvView &view) {
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+    if (recv_view(view, lane)) return true;
+  }
+  return false;
+}
+
+void ESP32RemoteControl::release(RecvView &view) {
+  if (view.handle >= 0) pool_put(view.handle);
+  view = RecvView();
+}
+
+void ESP32RemoteControl::get_link_stats(ESP32_RC_LinkStats::Snapshot &snap) {
+  link_stats.snapshot(snap);
+}
+
+size_t ESP32RemoteControl::add_trailer(uint8_t *frame, size_t frame_len, uint16_t seq) {
+  uint8_t *p = frame + frame_len;
+  p[0] = seq & 0xFF;
+  p[1] = seq >> 8;
+  put_u32(p + 2, micros());
+  return frame_len + _RC_FRAME_TRAILER_LEN;
+}
+
+// once the clocks are synced, the sender timestamp is translated into local time
+bool ESP32RemoteControl::check_trailer(const uint8_t *frame, int frame_len) {
+  if (frame_len < _RC_FRAME_OVERHEAD) return false;
+  const uint8_t *p = frame + frame_len - _RC_FRAME_TRAILER_LEN;
+  uint16_t seq    = p[0] | (p[1] << 8);
+  uint32_t stamp  = get_u32(p + 2);
+  bool is_synced  = link_clock.is_synced();
+  if (is_synced) stamp = link_clock.to_local(stamp);
+  return link_stats.on_frame(seq, stamp, micros(), is_synced);
+}
+
+// no clock sync with secondary peers, the one-way delay is relative to the best seen
+bool ESP32RemoteControl::check_trailer(const uint8_t *frame, int frame_len, ESP32_RC_Peer &peer) {
+  if (frame_len < _RC_FRAME_OVERHEAD) return false;
+  const uint8_t *p = frame + frame_len - _RC_FRAME_TRAILER_LEN;
+  uint16_t seq    = p[0] | (p[1] << 8);
+  return peer.stats.on_frame(seq, get_u32(p + 2), micros(), false);
+}
+
+// encode data message with the codecs agreed in handshake, returns 0 if it should go raw
+size_t ESP32RemoteControl::encode_frame(const void *data, uint8_t *frame, size_t frame_cap, uint8_t caps) {
+  const void *payload = data;
+  size_t len          = payload_len;
+  uint8_t packed[_RC_MAX_PAYLOAD_LEN];
+
+  if (caps & _RC_CAP_QUANT) {
+    quantizer.pack(data, packed);
+    payload = packed;
+    len     = quantizer.packed_len();
+  }
+
+  if (caps & _RC_CAP_DELTA) {
+    return delta_encoder.encode(payload, len, frame, frame_cap);
+  } 
+  if (caps & _RC_CAP_COMPACT) {
+    return ESP32_RC_Codec::encode(payload, len, frame, frame_cap);
+  }
+  return 0;
+}
+
+// decode any received frame into payload, returns false if malformed
+bool ESP32RemoteControl::decode_frame(const uint8_t *data, int data_len, void *pmsg, uint8_t caps) {
+  uint8_t kind = _RC_FRAME_KIND(data[0]);
+  if (kind == _RC_FRAME_RAW) {
+    if (data_len != (int)(_RC_FRAME_HEADER_LEN + payload_len)) return false;
+    memcpy(pmsg, data + _RC_FRAME_HEADER_LEN, payload_len);
+    return true;
+  }
+  bool is_compact = (kind == _RC_FRAME_COMPACT);
+  if (!is_compact && !(caps & _RC_CAP_DELTA)) return false;
+
+  uint8_t payload[_RC_MAX_PAYLOAD_LEN];
+  bool is_quant = (caps & _RC_CAP_QUANT);
+  size_t len    = is_quant ? quantizer.packed_len() : payload_len;
+  bool ok = is_compact ? ESP32_RC_Codec::decode(data, data_len, payload, len)
+                       : delta_decoder.decode(data, data_len, payload, len);
+  if (!ok) return false;
+
+  if (is_quant) {
+    quantizer.unpack(payload, pmsg);
+  } else {
+    memcpy(pmsg, payload, payload_len);
+  }
+  return true;
+}
+
+// data frame of the primary peer, decoded straight into a pool buffer or the mailbox
+void ESP32RemoteControl::recv_data_frame(const uint8_t *frame, int frame_len) {
+  uint8_t lane = _RC_FRAME_LANE(frame[0]);
+  if (lane >= _RC_LANE_COUNT || frame_len < _RC_FRAME_OVERHEAD) {
+    recv_metric.err_count ++;
+    return;
+  }
+  // duplicates (retry after a lost ack) are counted in link_stats and dropped
+  if (!check_trailer(frame, frame_len)) return;
+  frame_len -= _RC_FRAME_TRAILER_LEN;
+  // mailbox mode: decode straight into the mailbox, newest value wins
+  if (uses_mailbox(lane)) {
+    if (!decode_frame(frame, frame_len, recv_mailbox.write_buffer(), peer_caps)) {
+      recv_metric.err_count ++;
+      return;
+    }
+    recv_metric.in_count ++;
+    recv_mailbox.publish();
+    signal_recv();
+    return;
+  }
+  // only the index of the pool buffer is queued
+  wait_recv_room(lane);
+  int index = pool_take();
+  if (index < 0) {
+    recv_metric.err_count ++;
+    return;
+  }
+  if (!decode_frame(frame, frame_len, pool_buffer(index), peer_caps)) {
+    pool_put(index);
+    recv_metric.err_count ++;
+    return;
+  }
+  recv_metric.in_count ++;
+  pool_push(index, lane);
+  signal_recv();
+}
+
+bool ESP32RemoteControl::recv_lane(void *data, uint8_t lane) {
+  RecvView view;
+  if (!recv_view(view, lane)) return false;
+  memcpy(data, view.data, payload_len);
+  release(view);
+  return true;
+}
+
+// recv_signal is binary, a stale give only costs one more recv() attempt
+bool ESP32RemoteControl::recv_wait(void *data, uint32_t timeout_ms) {
+  unsigned long start_time = millis();
+  while (true) {
+    if (recv(data)) return true;
+    unsigned long elapsed = millis() - start_time;
+    if (recv_signal == nullptr || elapsed >= timeout_ms) return false;
+    xSemaphoreTake(recv_signal, pdMS_TO_TICKS(timeout_ms - elapsed));
+  }
+}
+
+void ESP32RemoteControl::signal_recv(void) {
+  if (recv_signal != nullptr) xSemaphoreGive(recv_signal);
+}
+
+
+
+/*
+ =========================================
+ *
+ * Sender task
+ *  - send_task sleeps while send_queue / send_mailbox is empty
+ *  - send_queue wakes it on push, send() wakes it in mailbox mode
+ *  - the transport wakes it when the radio reports send-complete,
+ *    so send_queue_msg() does not poll send_status
+ *  - a receive side that must not block (a radio callback) posts
+ *    its answers (acks) to ctrl_queue, they leave before the next
+ *    data round, and a handshake reset (post_reset()) before them
+ * 
+ =========================================
+ */
+
+ESP32_RC_SendTask::ESP32_RC_SendTask(ESP32RemoteControl *rc)
+  : Task("ESP32_RC_Send", _RC_SEND_TASK_STACK, _RC_SEND_TASK_PRIORITY), rc(rc) {
+  setCore(_RC_SEND_TASK_CORE);
+}
+
+void ESP32_RC_SendTask::run(void *data) {
+  rc->send_loop();
+}
+
+void ESP32RemoteControl::set_send_window(int size) {
+  send_window.set_size(size);
+}
+
+void ESP32RemoteControl::set_send_task(BaseType_t core, uint8_t priority) {
+  send_task.setCore(core);
+  send_task.setPriority(priority);
+}
+
+void ESP32RemoteControl::start_sender(void) {
+  if (send_task.getHandle() != nullptr) return;
+  send_task.start();
+  ctrl_queue.set_notify(send_task.getHandle());
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+    send_queue[lane].set_notify(send_task.getHandle());
+  }
+  notify_sender();                                          // messages queued before set_notify()
+}
+
+void ESP32RemoteControl::stop_sender(void) {
+  ctrl_queue.set_notify(nullptr);
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+    send_queue[lane].set_notify(nullptr);
+  }
+  send_task.stop();
+}
+
+void ESP32RemoteControl::notify_sender(void) {
+  TaskHandle_t handle = send_task.getHandle();
+  if (handle != nullptr) xTaskNotifyGive(handle);
+}
+
+bool ESP32RemoteControl::wait_sender(TickType_t ticks) {
+  return (ulTaskNotifyTake(pdTRUE, ticks) > 0);
+}
+
+bool ESP32RemoteControl::has_pending_send(void) {
+  if (ctrl_queue.depth() > 0 || is_heartbeat_due.load()) return true;
+  if (send_window.in_use() > 0) return true;
+  if (mailbox_mode && send_mailbox.is_fresh()) return true;
+  if (peers.has_pending_send()) return true;
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+    if (send_queue[lane].depth() > 0) return true;
+  }
+  return false;
+}
+
+// a notification given between has_pending_send() and wait_sender() is kept, nothing is missed
+void ESP32RemoteControl::send_loop(void) {
+  while (true) {
+    reset_sender();
+    if (link_state.load() != _RC_LINK_UP) {
+      reconnect();
+      continue;
+    }
+    if (!has_pending_send()) {
+      wait_sender(portMAX_DELAY);
+      continue;
+    }
+    send_posted_ctrl();
+    send_queue_msg();
+  }
+}
+
+// a full ctrl_queue drops the answer, the peer asks again (hello, next heartbeat)
+bool ESP32RemoteControl::post_ctrl(const uint8_t *frame, size_t frame_len, const uint8_t *addr) {
+  CtrlPost post;
+  if (frame_len > sizeof(post.frame) || !ctrl_queue.is_created()) return false;
+  memcpy(post.frame, frame, frame_len);
+  post.frame_len = frame_len;
+  post.has_addr  = (addr != nullptr);
+  if (post.has_addr) memcpy(post.addr, addr, _RC_PEER_ADDR_LEN);
+  if (ctrl_queue.push(&post)) return true;
+  send_metric.err_count ++;
+  return false;
+}
+
+// one flag, a heartbeat still due is not sent twice
+void ESP32RemoteControl::post_heartbeat(void) {
+  is_heartbeat_due.store(true);
+  notify_sender();
+}
+
+void ESP32RemoteControl::post_reset(void) {
+  is_reset_due.store(true);
+  notify_sender();
+}
+
+// the window lock keeps on_datasent() away from the encoder, clear() takes it itself
+void ESP32RemoteControl::reset_sender(void) {
+  if (!is_reset_due.exchange(false)) return;
+  send_window.lock();
+  delta_encoder.reset();
+  send_window.unlock();
+  empty_send_queue();
+}
+
+// the heartbeat is built here, t1 is the send time, and a heartbeat ack is stamped again as it
+// leaves, t3 is the send time, not the post time
+// a frame the radio refuses is dropped as well, control frames are never retried
+void ESP32RemoteControl::send_posted_ctrl(void) {
+  CtrlPost post;
+  if (is_heartbeat_due.exchange(false)) {
+    post.frame_len = create_ctrl_frame(_RC_FRAME_HEARTBEAT, post.frame);
+    if (!op_send_posted(post.frame, post.frame_len, nullptr)) send_metric.err_count ++;
+  }
+  while (ctrl_queue.pop(&post)) {
+    if (post.frame[0] == _RC_FRAME_HEARTBEAT_ACK && post.frame_len == _RC_CTRL_FRAME_LEN) {
+      put_u32(post.frame + 9, micros());
+    }
+    if (!op_send_posted(post.frame, post.frame_len, post.has_addr ? post.addr : nullptr)) {
+      send_metric.err_count ++;
+    }
+  }
+}
+
+
+/*
+ =========================================
+ *
+ * Link monitor
+ *  - link_timer checks every _RC_LINK_CHECK_PERIOD ms when the peer was last heard
+ *  - on timeout the link goes LOST and the sender task re-handshakes, nothing else is
+ *    sent meanwhile. After reconnect_budget ms without success it goes DOWN and keeps
+ *    trying every _RC_RECONNECT_BACKOFF ms.
+ *  - link_handler runs in the timer task (LOST), the sender task (UP, DOWN) or at the end
+ *    of connect() (UP)
+ * 
+ =========================================
+ */
+
+bool ESP32RemoteControl::is_connected(void) {
+  if (mutex == nullptr) return false;                       // not init() yet
+  int status = 0;
+  get_value(&connection_status, &status);
+  return (status == _STATUS_CONN_OK);
+}
+
+// the receive path sets _STATUS_CONN_OK on HANDSHAKE / HANDSHAKE_ACK, or _STATUS_CONN_ACKED if it
+// runs in a callback: the send side starts over here then, before send() sees OK and queues again.
+// The caller is connect() before send_task runs, or send_task itself in reconnect().
+bool ESP32RemoteControl::wait_handshake(uint32_t timeout_ms) {
+  unsigned long start_time = millis();
+  int status = 0;
+  while (millis() - start_time < timeout_ms) {
+    get_value(&connection_status, &status);
+    if (status == _STATUS_CONN_OK) return true;
+    if (status == _STATUS_CONN_ACKED) {
+      reset_sender();
+      set_value(&connection_status, _STATUS_CONN_OK);
+      return true;
+    }
+    _DELAY_(1);
+  }
+  return false;
+}
+
+// the peer's sequence and clock may have started over, it may have restarted
+void ESP32RemoteControl::handshake_done(void) {
+  link_stats.reset();
+  link_clock.reset();
+  ctrl_queue.clear();                                       // acks to heartbeats of before
+  if (link_handler != nullptr) link_handler(_RC_LINK_HANDSHAKE, link_context);
+}
+
+void ESP32RemoteControl::set_link_timeout(uint32_t timeout_ms) {
+  link_timeout = timeout_ms;
+}
+
+void ESP32RemoteControl::set_reconnect_budget(uint32_t budget_ms) {
+  reconnect_budget = budget_ms;
+}
+
+void ESP32RemoteControl::on_link_state(linkFuncType handler, void *context) {
+  link_context = context;
+  link_handler = handler;
+}
+
+// the end of connect(): the link is UP, also for the first time
+void ESP32RemoteControl::start_link_monitor(void) {
+  link_alive();
+  if (link_handler != nullptr) link_handler(_RC_LINK_UP, link_context);
+  if (link_timer == nullptr) {
+    link_timer = xTimerCreate("LinkTimer", pdMS_TO_TICKS(_RC_LINK_CHECK_PERIOD), pdTRUE, this, link_timer_callback);
+    if (link_timer == nullptr) {
+      _ERROR_("Failed to create link timer.");
+      return;
+    }
+  }
+  xTimerStart(link_timer, 0);
+}
+
+void ESP32RemoteControl::stop_link_monitor(void) {
+  if (link_timer == nullptr) return;
+  xTimerStop(link_timer, 0);
+  xTimerDelete(link_timer, 0);
+  link_timer = nullptr;
+}
+
+void ESP32RemoteControl::link_alive(void) {
+  last_rx_ms.store(millis(), std::memory_order_relaxed);
+}
+
+void ESP32RemoteControl::link_timer_callback(TimerHandle_t timer) {
+  static_cast<ESP32RemoteControl *>(pvTimerGetTimerID(timer))->check_link();
+}
+
+void ESP32RemoteControl::check_link(void) {
+  // secondary peers re-handshake on their own, only mark them
+  uint32_t now = millis();
+  for (int id = 1; id < _RC_MAX_PEERS; id++) {
+    if (!peers.is_used(id)) continue;
+    ESP32_RC_Peer &peer = peers.get(id);
+    if (now - peer.last_rx_ms.load(std::memory_order_relaxed) > link_timeout) {
+      peer.link_state.store(_RC_LINK_LOST);
+    }
+  }
+
+  if (link_state.load() != _RC_LINK_UP) return;
+  if (millis() - last_rx_ms.load(std::memory_order_relaxed) <= link_timeout) return;
+
+  // ERR before LOST: once LOST is seen the sender may start a handshake (IN_PROG),
+  // which must not be overwritten
+  set_value(&connection_status, _STATUS_CONN_ERR);
+  uint8_t expected = _RC_LINK_UP;
+  if (!link_state.compare_exchange_strong(expected, _RC_LINK_LOST)) return;
+  if (link_handler != nullptr) link_handler(_RC_LINK_LOST, link_context);
+  notify_sender();
+}
+
+void ESP32RemoteControl::set_link_state(uint8_t state) {
+  if (link_state.exchange(state) == state) return;
+  if (link_handler != nullptr) link_handler(state, link_context);
+}
+
+void ESP32RemoteControl::reconnect(void) {
+  unsigned long start_time = millis();
+  _DEBUG_("Started.");
+  while (true) {
+    if (handshake(_RC_RECONNECT_ATTEMPT)) {
+      link_alive();
+      set_link_state(_RC_LINK_UP);
+      _DEBUG_("Success.");
+      return;
+    }
+    if (link_state.load() == _RC_LINK_DOWN) {
+      _DELAY_(_RC_RECONNECT_BACKOFF);
+    } else if (millis() - start_time >= reconnect_budget) {
+      _DEBUG_("Budget used up.");
+      set_link_state(_RC_LINK_DOWN);
+    }
+  }
+}
+
+// unless the ack came in meanwhile
+void ESP32RemoteControl::handshake_failed(void) {
+  int status = _STATUS_CONN_IN_PROG;
+  connection_status.compare_exchange_strong(status, _STATUS_CONN_ERR);
+}
+
+
+/*
+ =========================================
+ *
+ * Peers
+ *  - peer 0 goes through the lanes, the others through their own queues
+ *  - addressed messages to a lost peer are dropped, it has to say hello again
+ * 
+ =========================================
+ */
+
+bool ESP32RemoteControl::send_to(uint8_t peer_id, const void *data) {
+  if (peer_id == _RC_PEER_PRIMARY) {
+    send(data);
+    return true;
+  }
+  if (!peers.is_used(peer_id)) return false;
+  ESP32_RC_Peer &peer = peers.get(peer_id);
+  if (peer.link_state.load() != _RC_LINK_UP) return false;
+  bool is_dropped = peer.send_queue.push_overwrite(data);
+  notify_sender();
+  return !is_dropped;
+}
+
+int ESP32RemoteControl::broadcast(const void *data) {
+  int reached = 0;
+  if (link_state.load() == _RC_LINK_UP) {
+    send(data);
+    reached ++;
+  }
+  for (int id = 1; id < _RC_MAX_PEERS; id++) {
+    if (peers.is_used(id) && peers.get(id).link_state.load() == _RC_LINK_UP) {
+      peers.get(id).send_queue.push_overwrite(data);
+      reached ++;
+    }
+  }
+  notify_sender();
+  return reached;
+}
+
+bool ESP32RemoteControl::recv_from(uint8_t peer_id, void *data) {
+  if (peer_id == _RC_PEER_PRIMARY) return recv(data);
+  if (!peers.is_used(peer_id)) return false;
+  return peers.get(peer_id).recv_queue.pop(data);
+}
+
+// the application may wait, the receive callback drops the frame instead
+int ESP32RemoteControl::find_peer(const uint8_t *mac_addr) {
+  int id;
+  while ((id = peers.find(mac_addr)) == _RC_PEER_BUSY) _DELAY_(1);
+  return id;
+}
+
+bool ESP32RemoteControl::get_peer(uint8_t peer_id, ESP32_RC_PeerInfo &info) {
+  if (!peers.is_used(peer_id)) return false;
+  ESP32_RC_Peer &peer = peers.get(peer_id);
+  memcpy(info.mac_addr, peer.mac_addr, _RC_PEER_ADDR_LEN);
+  if (peer_id == _RC_PEER_PRIMARY) {
+    info.link_state  = link_state.load();
+    info.sent        = send_metric.out_count;
+    info.send_errors = send_metric.err_count;
+    info.received    = recv_metric.in_count;
+    info.recv_errors = recv_metric.err_count;
+  } else {
+    info.link_state  = peer.link_state.load();
+    info.sent        = peer.sent;
+    info.send_errors = peer.send_errors;
+    info.received    = peer.received;
+    info.recv_errors = peer.recv_errors;
+  }
+  return true;
+}
+
+void ESP32RemoteControl::remove_peer(uint8_t peer_id) {
+  if (peer_id == _RC_PEER_PRIMARY) return;
+  peers.remove(peer_id);
+}
+
+
+/*
+ =========================================
+ *
+ * Receive task
+ *  - recv_signal is given by the transport for every message put in recv_queue / recv_mailbox
+ *  - recv_wait() and recv_task sleep on it, no polling
+ *  - recv_task hands the pool buffer to the handler without copy
+ * 
+ =========================================
+ */
+
+ESP32_RC_RecvTask::ESP32_RC_RecvTask(ESP32RemoteControl *rc)
+  : Task("ESP32_RC_Recv", _RC_RECV_TASK_STACK, _RC_RECV_TASK_PRIORITY), rc(rc) {
+  setCore(_RC_RECV_TASK_CORE);
+}
+
+void ESP32_RC_RecvTask::run(void *data) {
+  rc->recv_loop();
+}
+
+void ESP32RemoteControl::set_recv_task(BaseType_t core, uint8_t priority) {
+  recv_task.setCore(core);
+  recv_task.setPriority(priority);
+}
+
+// before init() there is no mutex yet, the receive task starts with the handshake then
+void ESP32RemoteControl::on_message(msgFuncType handler, void *context) {
+  msg_context = context;
+  msg_handler = handler;
+  if (mutex == nullptr) return;
+
+  int status = 0;
+  get_value(&connection_status, &status);
+  if (status == _STATUS_CONN_OK) start_receiver();
+}
+
+void ESP32RemoteControl::start_receiver(void) {
+  if (msg_handler == nullptr || recv_task.getHandle() != nullptr) return;
+  recv_task.start();
+}
+
+void ESP32RemoteControl::stop_receiver(void) {
+  recv_task.stop();
+}
+
+void ESP32RemoteControl::recv_loop(void) {
+  RecvView view;
+  while (true) {
+    if (!recv_view(view)) {
+      xSemaphoreTake(recv_signal, portMAX_DELAY);
+      continue;
+    }
+    msg_handler(view.data, view.lane, msg_context);
+    release(view);
+  }
+}
+
+
+
 /*
  =========================================
  *
@@ -91,8 +907,24 @@ void ESP32RemoteControl::enable_debug(bool mode) {
   this->debug_mode=mode;
 }
 
+// fast mode drops the oldest message of the control lane instead of blocking send()
 void ESP32RemoteControl::enable_fast(bool mode) {
   this->fast_mode=mode;
+  lanes[_RC_LANE_CONTROL].policy = mode ? _RC_LANE_DROP_OLDEST : _RC_LANE_BLOCK;
+}
+
+void ESP32RemoteControl::set_lane(uint8_t lane, int depth, uint8_t policy) {
+  if (lane >= _RC_LANE_COUNT) return;
+  lanes[lane].depth  = depth < 1 ? 1 : depth;
+  lanes[lane].policy = policy;
+}
+
+void ESP32RemoteControl::enable_mailbox(bool mode) {
+  this->mailbox_mode=mode;
+}
+
+void ESP32RemoteControl::enable_multi_peer(bool mode) {
+  this->multi_peer_mode=mode;
 }
 
 String ESP32RemoteControl::format_time(unsigned long ms) {
@@ -147,8 +979,3 @@ String ESP32RemoteControl::mac2str(const uint8_t *mac_addr) {
   snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X", mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
   return mac_str;
 }
-
-int ESP32RemoteControl::get_queue_depth(QueueHandle_t queue) {
-  UBaseType_t uxItemsInQueue = uxQueueMessagesWaiting(queue);
-  return (int)uxItemsInQueue; 
-}
\ No newline at end of file
@@ -0,0 +1,534 @@
+#include <ESP32_RC_BLE.h>
+
+/*
+ * ========================================================
+ * GATT link - Bluedroid
+ * ========================================================
+ */
+ESP32_RC_BleGatt::ESP32_RC_BleGatt()
+  : server_events(this), rx_events(this), client_events(this) {
+  memset(peer_addr, 0, sizeof(peer_addr));
+}
+
+void ESP32_RC_BleGatt::init(void) {
+  BLEDevice::init(_BLE_SVR_DEVICE_NAME);
+  BLEDevice::setMTU(_BLE_MTU);            // offered to the peer in the MTU exchange
+}
+
+// a random scan time, so of two peers with the same code one becomes the peripheral first
+void ESP32_RC_BleGatt::start(uint32_t scan_s) {
+  central = find_peripheral(scan_s);
+  if (!central) start_peripheral();
+}
+
+bool ESP32_RC_BleGatt::find_peripheral(uint32_t scan_s) {
+  BLEScan *scan = BLEDevice::getScan();
+  scan->setActiveScan(true);
+  scan->setInterval(100);
+  scan->setWindow(99);
+  BLEScanResults results = scan->start(scan_s, false);
+
+  has_device = false;
+  for (int i = 0; i < results.getCount() && !has_device; i++) {
+    BLEAdvertisedDevice device = results.getDevice(i);
+    if (device.haveServiceUUID() && device.isAdvertisingService(BLEUUID(_BLE_SERVICE_UUID))) {
+      peer_device = device;
+      has_device  = true;
+    }
+  }
+  scan->clearResults();
+  return has_device;
+}
+
+void ESP32_RC_BleGatt::start_peripheral(void) {
+  server = BLEDevice::createServer();
+  server->setCallbacks(&server_events);
+
+  BLEService *service = server->createService(_BLE_SERVICE_UUID);
+  tx = service->createCharacteristic(_BLE_TX_CHARAC_UUID, BLECharacteristic::PROPERTY_NOTIFY);
+  tx->addDescriptor(new BLE2902());
+  BLECharacteristic *rx = service->createCharacteristic(_BLE_RX_CHARAC_UUID, BLECharacteristic::PROPERTY_WRITE_NR);
+  rx->setCallbacks(&rx_events);
+  service->start();
+
+  BLEAdvertising *advertising = BLEDevice::getAdvertising();
+  advertising->addServiceUUID(_BLE_SERVICE_UUID);
+  advertising->setScanResponse(true);
+  BLEDevice::startAdvertising();
+}
+
+// central: connect again, the peripheral advertises after a loss
+// peripheral: wait for the central
+bool ESP32_RC_BleGatt::open(uint32_t timeout_ms) {
+  if (is_connected.load()) return true;
+  if (central) return open_central(timeout_ms);
+
+  unsigned long start_time = millis();
+  while (!is_connected.load() && millis() - start_time < timeout_ms) {
+    _DELAY_(10);
+  }
+  return is_connected.load();
+}
+
+bool ESP32_RC_BleGatt::open_central(uint32_t timeout_ms) {
+  if (!has_device && !find_peripheral((timeout_ms < 1000) ? 1 : timeout_ms / 1000)) return false;
+
+  if (client == nullptr) {
+    client = BLEDevice::createClient();
+    client->setClientCallbacks(&client_events);
+  }
+  if (!client->connect(&peer_device)) {
+    has_device = false;                   // may have moved, scan again next time
+    return false;
+  }
+
+  BLERemoteService *service = client->getService(BLEUUID(_BLE_SERVICE_UUID));
+  BLERemoteCharacteristic *remote_tx = (service != nullptr) ? service->getCharacteristic(BLEUUID(_BLE_TX_CHARAC_UUID)) : nullptr;
+  remote_rx = (service != nullptr) ? service->getCharacteristic(BLEUUID(_BLE_RX_CHARAC_UUID)) : nullptr;
+  if (remote_tx == nullptr || remote_rx == nullptr || !remote_tx->canNotify()) {
+    client->disconnect();
+    has_device = false;
+    return false;
+  }
+
+  client->setMTU(_BLE_MTU);
+  on_connected(*client->getPeerAddress().getNative(), client->getConnId());
+
+  // after UP, the first packet belongs to the new stream
+  remote_tx->registerForNotify([this](BLERemoteCharacteristic *charac, uint8_t *data, size_t len, bool is_notify) {
+    emit(DATA, data, len);
+  });
+  return true;
+}
+
+void ESP32_RC_BleGatt::close(void) {
+  if (!is_connected.load()) return;
+  if (central) client->disconnect();
+  else server->disconnect(conn_id);
+}
+
+size_t ESP32_RC_BleGatt::packet_len(void) {
+  if (!is_connected.load()) return 0;
+  uint16_t mtu = central ? client->getMTU() : server->getPeerMTU(conn_id);
+  return (mtu > 3) ? mtu - 3 : 0;
+}
+
+// no free controller buffer: BUSY, the stack would queue the packet in RAM behind the others
+uint8_t ESP32_RC_BleGatt::put_packet(const uint8_t *data, size_t len) {
+  if (!is_connected.load()) return CLOSED;
+  if (esp_ble_get_cur_sendable_packets_num(conn_id) == 0) return BUSY;
+
+  esp_err_t err = central
+    ? esp_ble_gattc_write_char(client->getGattcIf(), conn_id, remote_rx->getHandle(), len, (uint8_t *)data,
+                               ESP_GATT_WRITE_TYPE_NO_RSP, ESP_GATT_AUTH_REQ_NONE)
+    : esp_ble_gatts_send_indicate(server->getGattsIf(), conn_id, tx->getHandle(), len, (uint8_t *)data, false);
+  return (err == ESP_OK) ? SENT : BUSY;
+}
+
+void ESP32_RC_BleGatt::on_connected(const uint8_t *addr, uint16_t id) {
+  esp_bd_addr_t bda;
+  memcpy(bda, addr, sizeof(bda));
+  memcpy(peer_addr, addr, sizeof(peer_addr));
+  conn_id = id;
+
+  esp_ble_gap_set_pkt_data_len(bda, _BLE_DATA_LEN);
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+  esp_ble_gap_set_preferred_phy(bda, 0, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#endif
+  esp_ble_conn_update_params_t params;
+  memcpy(params.bda, addr, sizeof(params.bda));
+  params.min_int = _BLE_CONN_INTERVAL_MIN;
+  params.max_int = _BLE_CONN_INTERVAL_MAX;
+  params.latency = 0;
+  params.timeout = _BLE_SUPERVISION_TIMEOUT;
+  esp_ble_gap_update_conn_params(&params);
+
+  is_connected.store(true);
+  emit(UP, peer_addr, sizeof(peer_addr));
+}
+
+void ESP32_RC_BleGatt::on_disconnected(void) {
+  is_connected.store(false);
+  emit(DOWN);
+  if (!central) BLEDevice::startAdvertising();
+}
+
+void ESP32_RC_BleGatt::ServerEvents::onConnect(BLEServer *server, esp_ble_gatts_cb_param_t *param) {
+  gatt->on_connected(param->connect.remote_bda, param->connect.conn_id);
+}
+
+void ESP32_RC_BleGatt::ServerEvents::onDisconnect(BLEServer *server) {
+  gatt->on_disconnected();
+}
+
+void ESP32_RC_BleGatt::ClientEvents::onDisconnect(BLEClient *client) {
+  gatt->on_disconnected();
+}
+
+// the raw write, not the value of the characteristic
+void ESP32_RC_BleGatt::RxEvents::onWrite(BLECharacteristic *charac, esp_ble_gatts_cb_param_t *param) {
+  gatt->emit(DATA, param->write.value, param->write.len);
+}
+
+
+/*
+ * ========================================================
+ * ESP32_RC_BLE
+ * ========================================================
+ */
+ESP32_RC_BLE::ESP32_RC_BLE(bool fast_mode, bool debug_mode, size_t payload_len)
+  : ESP32RemoteControl(fast_mode, debug_mode, payload_len) {
+  if (payload_len > MAX_PAYLOAD_LEN) {
+    _ERROR_("Payload length " + String((int)payload_len) + " > " + String((int)MAX_PAYLOAD_LEN));
+  }
+  memset(peer_key, 0, sizeof(peer_key));
+}
+
+ESP32_RC_BLE::~ESP32_RC_BLE() {
+  stop_link_monitor();
+  stop_sender();
+  stop_receiver();
+  if (heartbeat_timer != nullptr) {
+    xTimerStop(heartbeat_timer, 0);
+    xTimerDelete(heartbeat_timer, 0);
+  }
+  gatt.set_handler(nullptr, nullptr);     // the stack may still call back
+  gatt.close();
+  if (pipe_mutex != nullptr) vSemaphoreDelete(pipe_mutex);
+}
+
+// Start the Bluetooth stack
+void ESP32_RC_BLE::init(void) {
+  _DEBUG_("Initializing BLE...");
+  gatt.init();
+  gatt.set_handler(on_gatt_event, this);
+  _DEBUG_("BLE initialized.");
+
+  // Create queues
+  if (create_queues() == false) {
+    _ERROR_("Failed to create queues.");
+  }
+
+  // Create the mutex
+  mutex      = xSemaphoreCreateMutex();
+  pipe_mutex = xSemaphoreCreateMutex();
+
+  // Create Timer Tasks
+  // Messages are sent by send_task and received in the stack task. Only the heartbeat is timed.
+  heartbeat_timer = xTimerCreate("HeartBeatTimer",  heartbeat_period(), pdTRUE, this, heartbeat_timer_callback);
+
+  if (heartbeat_timer == NULL) {
+    _ERROR_("Failed to create timer");
+  }
+  _DEBUG_("Success.");
+}
+
+
+/*
+ * ========================================================
+ * connect - Override
+ *  - pick the role once, re-handshakes only connect again
+ * ========================================================
+ */
+void ESP32_RC_BLE::connect(void) {
+  _DEBUG_ ("Started.");
+  gatt.start(_BLE_SCAN_TIMEOUT + random(_BLE_SCAN_TIMEOUT + 1));
+  _DEBUG_(gatt.is_central() ? "Central." : "Peripheral, advertising.");
+
+  int attempt = 0;
+  int max_retry = 100;
+  while (attempt <= max_retry) {
+    attempt++;
+    if (handshake(_RC_HANDSHAKE_TIMEOUT) == true) break;
+    _DELAY_(10);
+    if (attempt >= max_retry ) {
+      _ERROR_ ("Failed. Attempts >= Max Retry (" + String(max_retry) + ")");
+    }
+  }
+
+  // start processing the send message queue.
+  set_value(&send_status, _STATUS_SEND_READY);
+
+  start_sender();
+  start_receiver();
+  xTimerStart(heartbeat_timer, 0);
+  start_link_monitor();
+  _DEBUG_("Success.");
+}
+
+
+/*
+ * ========================================================
+ * Handshake two peers
+ *  - over the connection, opened first if it is gone
+ *  - it should block send/send_queue_msg
+ * ========================================================
+ */
+bool ESP32_RC_BLE::handshake(uint32_t timeout_ms) {
+  _DEBUG_("Started.");
+
+  // Lock the varible
+  set_value(&connection_status, _STATUS_CONN_IN_PROG);
+
+  unsigned long start_time = millis();
+  if (!gatt.open(timeout_ms)) {
+    handshake_failed();
+    _DEBUG_("Failed.");
+    return false;
+  }
+  op_send_ctrl(_RC_FRAME_HANDSHAKE);
+
+  // Wait Ack
+  uint32_t elapsed = millis() - start_time;
+  if (elapsed < timeout_ms && wait_handshake(timeout_ms - elapsed)) {
+    _DEBUG_("Success.");
+    return true;
+  }
+  handshake_failed();
+  _DEBUG_("Failed.");
+  return false;
+}
+
+
+/*
+ * ========================================================
+ * send - Override
+ * en-queue the message only
+ * ========================================================
+ */
+void ESP32_RC_BLE::send(const void *data, uint8_t lane) {
+  if (lane >= _RC_LANE_COUNT) {
+    send_metric.err_count ++;
+    return;
+  }
+
+  // make sure handshake is completed successfully, blocking lanes wait for it
+  int status = 0;
+  get_value(&connection_status, &status);
+  while (status != _STATUS_CONN_OK) {
+    if (lanes[lane].policy != _RC_LANE_BLOCK || uses_mailbox(lane)) return;
+    _DELAY_(int( 1000/_ESP32_RC_DATA_RATE ));
+    get_value(&connection_status, &status);
+  }
+  enqueue(data, lane);
+}
+
+/*
+ * ========================================================
+ * send_queue_msg - Override
+ *  - a frame is DONE once it is in the pipe, released next round
+ *  - all frames of the round leave in full packets, one flush
+ *  - full controller buffers: sent again after 1 ms, the
+ *    stack has no buffer-free event for the connection
+ * ========================================================
+ */
+void ESP32_RC_BLE::send_queue_msg() {
+  bool is_busy = false;   // pipe full, or the controller took not everything
+
+  for (int slot = 0; slot < _RC_SEND_WINDOW_MAX; slot++) {
+    if (send_window.state(slot) == ESP32_RC_SendWindow::DONE) {
+      send_metric.out_count ++;
+      send_window.release(slot);
+    }
+  }
+
+  // strict priority: lane by lane, first the frames refused before, then new messages
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT && !is_busy; lane++) {
+    for (int slot = 0; slot < _RC_SEND_WINDOW_MAX && !is_busy; slot++) {
+      if (send_window.state(slot) == ESP32_RC_SendWindow::QUEUED && send_window.lane(slot) == lane) {
+        is_busy = !op_send(send_window.buffer(slot), slot);
+      }
+    }
+
+    int slot;
+    while (!is_busy && (slot = send_window.acquire(lane)) >= 0) {
+      if (!dequeue(lane, send_window.buffer(slot))) {
+        send_window.release(slot);
+        break;
+      }
+      is_busy = !op_send(send_window.buffer(slot), slot);
+    }
+  }
+
+  if (!flush_pipe()) is_busy = true;
+  if (is_busy) _DELAY_(1);
+}
+
+// no window lock, nothing waits for a send-complete
+bool ESP32_RC_BLE::op_send(const void *data, int slot) {
+  uint8_t frame[_MAX_MSG_LEN];
+  size_t frame_len = encode_frame(data, frame, sizeof(frame) - _RC_FRAME_TRAILER_LEN, peer_caps);
+  if (frame_len == 0) {
+    frame[0]  = _RC_FRAME_RAW;
+    memcpy(frame + _RC_FRAME_HEADER_LEN, data, payload_len);
+    frame_len = _RC_FRAME_HEADER_LEN + payload_len;
+  }
+  frame[0] |= (send_window.lane(slot) << _RC_FRAME_LANE_SHIFT);
+  frame_len  = add_trailer(frame, frame_len, send_window.seq(slot));
+
+  if (!pipe_put(frame, frame_len)) return false;
+  send_window.mark(slot, ESP32_RC_SendWindow::DONE);
+  return true;
+}
+
+// Send control frame (HANDSHAKE, HEARTBEAT ...), no delta as with WiFi
+bool ESP32_RC_BLE::op_send_ctrl(uint8_t type) {
+  uint8_t frame[_RC_CTRL_FRAME_LEN];
+  size_t frame_len = create_ctrl_frame(type, frame);
+  if (type == _RC_FRAME_HANDSHAKE || type == _RC_FRAME_HANDSHAKE_ACK) {
+    frame[1] &= ~_RC_CAP_DELTA;
+  }
+  return op_send_ctrl(frame, frame_len);
+}
+
+bool ESP32_RC_BLE::op_send_ctrl(const uint8_t *frame, size_t frame_len) {
+  return pipe_put(frame, frame_len) && flush_pipe();
+}
+
+bool ESP32_RC_BLE::pipe_put(const uint8_t *frame, size_t frame_len) {
+  if (!gatt.is_open()) return false;
+  xSemaphoreTake(pipe_mutex, portMAX_DELAY);
+  bool is_put = pipe.put(frame, frame_len);
+  if (!is_put) {
+    pipe.flush(gatt);
+    is_put = pipe.put(frame, frame_len);
+  }
+  xSemaphoreGive(pipe_mutex);
+  return is_put;
+}
+
+bool ESP32_RC_BLE::flush_pipe(void) {
+  xSemaphoreTake(pipe_mutex, portMAX_DELAY);
+  bool is_done = (pipe.flush(gatt) == ESP32_RC_GattLink::SENT);
+  xSemaphoreGive(pipe_mutex);
+  return is_done;
+}
+
+/*
+ * ========================================================
+ * recv - Override
+ * ========================================================
+ */
+bool ESP32_RC_BLE::recv(void *data) {
+  RecvView view;
+  if (!recv_view(view)) return false;
+  memcpy(data, view.data, payload_len);
+  release(view);
+  return true;
+}
+
+
+/*
+ * ========================================================
+ * GATT events
+ *  - called in the Bluetooth stack task, UP of the central
+ *    in the task that connected
+ *  - a new connection is a new stream, the pipe starts over
+ * ========================================================
+ */
+void ESP32_RC_BLE::on_gatt_event(uint8_t event, const uint8_t *data, size_t len, void *context) {
+  ESP32_RC_BLE *rc = static_cast<ESP32_RC_BLE *>(context);
+  switch (event) {
+    case ESP32_RC_GattLink::UP:
+      memcpy(rc->peer_key, data, _RC_PEER_ADDR_LEN);
+      // fall through
+    case ESP32_RC_GattLink::DOWN:
+      xSemaphoreTake(rc->pipe_mutex, portMAX_DELAY);
+      rc->pipe.reset();
+      xSemaphoreGive(rc->pipe_mutex);
+      return;
+
+    case ESP32_RC_GattLink::DATA:
+      rc->packet_us = micros();
+      if (!rc->pipe.feed(data, len, on_frame, rc)) {
+        rc->recv_metric.err_count ++;
+        rc->gatt.close();                 // out of step, the next connection starts a new stream
+      }
+      return;
+  }
+}
+
+void ESP32_RC_BLE::on_frame(const uint8_t *frame, size_t frame_len, void *context) {
+  ESP32_RC_BLE *rc = static_cast<ESP32_RC_BLE *>(context);
+  rc->on_datarecv(frame, frame_len, rc->packet_us);
+}
+
+void ESP32_RC_BLE::on_datarecv(const uint8_t *data, int data_len, uint32_t rx_us) {
+  int status;
+
+  if (data_len < 1) {
+    recv_metric.err_count ++;
+    return;
+  }
+  link_alive();                           // only the peer is on the connection
+
+  get_value(&connection_status, &status);
+
+  switch (_RC_FRAME_KIND(data[0])) {
+    // Handshake Hello received and send Ack
+    // also completes our own handshake, both sides may re-handshake at once after a link loss
+    case _RC_FRAME_HANDSHAKE:
+      peers.set_primary(peer_key);
+      peer_caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+      handshake_done();
+      op_send_ctrl(_RC_FRAME_HANDSHAKE_ACK);
+      empty_send_queue();
+      if (status == _STATUS_CONN_IN_PROG) set_value(&connection_status, _STATUS_CONN_OK);
+      return;
+
+    // check if handshake in progress, and process Ack
+    case _RC_FRAME_HANDSHAKE_ACK:
+      if (status != _STATUS_CONN_IN_PROG) return;
+      peers.set_primary(peer_key);
+      peer_caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+      handshake_done();
+      empty_send_queue();
+      empty_recv_queue();
+      set_value(&connection_status, _STATUS_CONN_OK);
+      return;
+
+    // received heartbeat, then return heartbeat Ack with our timestamps
+    case _RC_FRAME_HEARTBEAT: {
+      uint8_t ack[_RC_CTRL_FRAME_LEN];
+      op_send_ctrl(ack, create_heartbeat_ack(data, data_len, rx_us, ack));
+      return;
+    }
+
+    // received heart beat ack, heart beat cycle completed, then turn off the LED
+    case _RC_FRAME_HEARTBEAT_ACK:
+      on_heartbeat_ack(data, data_len, rx_us);
+      digitalWrite(BUILTIN_LED, LOW);
+      return;
+
+    // regular message
+    case _RC_FRAME_RAW:
+    case _RC_FRAME_COMPACT:
+    case _RC_FRAME_KEY:
+    case _RC_FRAME_DELTA:
+      if (status != _STATUS_CONN_OK) return;
+      recv_data_frame(data, data_len);
+      return;
+
+    default:
+      recv_metric.err_count ++;
+      return;
+  }
+}
+
+
+void ESP32_RC_BLE::heartbeat_timer_callback(TimerHandle_t xTimer) {
+  ESP32_RC_BLE *rc = static_cast<ESP32_RC_BLE *>(pvTimerGetTimerID(xTimer));
+  rc->op_send_ctrl(_RC_FRAME_HEARTBEAT);
+  digitalWrite(BUILTIN_LED, HIGH);
+}
+
+
+/*
+ * ========================================================
+ * run - Override
+ * ========================================================
+ */
+
+void ESP32_RC_BLE::run(void* data) {
+  connect();
+}
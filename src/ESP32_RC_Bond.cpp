@@ -0,0 +1,210 @@
+#include <ESP32_RC_Bond.h>
+
+ESP32_RC_BondBase::ESP32_RC_BondBase(bool fast_mode, bool debug_mode, size_t payload_len)
+  : ESP32RemoteControl(fast_mode, debug_mode, payload_len) {
+}
+
+ESP32_RC_BondBase::~ESP32_RC_BondBase() {
+  stop_receiver();
+  if (bond_mutex != nullptr) vSemaphoreDelete(bond_mutex);
+  if (path_up != nullptr) vSemaphoreDelete(path_up);
+}
+
+void ESP32_RC_BondBase::set_paths(ESP32RemoteControl *first, ESP32RemoteControl *second) {
+  paths[0] = first;
+  paths[1] = second;
+}
+
+
+/*
+ * ========================================================
+ * init - Override
+ *  - lanes, fast and mailbox mode of the bond are handed down to the paths
+ * ========================================================
+ */
+void ESP32_RC_BondBase::init(void) {
+  _DEBUG_("Started");
+
+  if (create_queues() == false) {
+    _ERROR_("Failed to create queues.");
+  }
+  mutex      = xSemaphoreCreateMutex();
+  bond_mutex = xSemaphoreCreateMutex();
+  path_up    = xSemaphoreCreateBinary();
+  set_value(&connection_status, _STATUS_CONN_ERR);
+
+  for (int i = 0; i < _RC_BOND_PATHS; i++) {
+    for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+      paths[i]->set_lane(lane, lanes[lane].depth, lanes[lane].policy);
+    }
+    paths[i]->enable_mailbox(mailbox_mode);
+    paths[i]->init();
+    paths[i]->on_message(on_path_message, this);
+    paths[i]->on_link_state(on_path_state, this);
+  }
+  _DEBUG_("Success.");
+}
+
+/*
+ * ========================================================
+ * connect - Override
+ *  - each path connects in its own task (Task::start -> run -> connect),
+ *    a dead path does not hold the other one up
+ * ========================================================
+ */
+void ESP32_RC_BondBase::connect(void) {
+  _DEBUG_("Started.");
+  for (int i = 0; i < _RC_BOND_PATHS; i++) {
+    paths[i]->start();
+  }
+  wait_path_up();
+  update_state();
+  start_receiver();
+  _DEBUG_("Success.");
+}
+
+void ESP32_RC_BondBase::run(void* data) {
+  connect();
+}
+
+
+/*
+ * ========================================================
+ * send - Override
+ *  - same bond sequence on both copies, one sequence per lane
+ *  - only on paths that are up, a LOST path would hold the
+ *    message until it re-handshook
+ *  - blocking lanes wait until any path is up
+ * ========================================================
+ */
+void ESP32_RC_BondBase::send(const void *data, uint8_t lane) {
+  if (lane >= _RC_LANE_COUNT) {
+    send_metric.err_count ++;
+    return;
+  }
+
+  uint8_t frame[_RC_BOND_HEADER_LEN + _MAX_MSG_LEN];
+  uint16_t seq = next_seq[lane].fetch_add(1);
+  frame[0] = seq & 0xFF;
+  frame[1] = seq >> 8;
+  memcpy(frame + _RC_BOND_HEADER_LEN, data, payload_len);
+
+  bool is_waiting = !uses_mailbox(lane) && lanes[lane].policy == _RC_LANE_BLOCK;
+  int sent = 0;
+  while (true) {
+    for (int i = 0; i < _RC_BOND_PATHS; i++) {
+      if (!is_path_up(i)) continue;
+      paths[i]->send(frame, lane);
+      sent ++;
+    }
+    if (sent > 0 || !is_waiting) break;
+    wait_path_up();
+  }
+
+  if (sent > 0) send_metric.in_count ++;
+  else send_metric.err_count ++;
+}
+
+bool ESP32_RC_BondBase::recv(void *data) {
+  RecvView view;
+  if (!recv_view(view)) return false;
+  memcpy(data, view.data, payload_len);
+  release(view);
+  return true;
+}
+
+bool ESP32_RC_BondBase::handshake(uint32_t timeout_ms) {
+  return is_connected();
+}
+
+void ESP32_RC_BondBase::send_queue_msg(void) {
+}
+
+bool ESP32_RC_BondBase::op_send(const void *data, int slot) {
+  return false;
+}
+
+
+/*
+ * ========================================================
+ * Path callbacks
+ * ========================================================
+ */
+void ESP32_RC_BondBase::on_path_message(const void *data, uint8_t lane, void *context) {
+  static_cast<ESP32_RC_BondBase *>(context)->deliver((const uint8_t *)data, lane);
+}
+
+void ESP32_RC_BondBase::on_path_state(uint8_t state, void *context) {
+  ESP32_RC_BondBase *bond = static_cast<ESP32_RC_BondBase *>(context);
+  if (state == _RC_LINK_HANDSHAKE) bond->resync();
+  else bond->update_state();
+}
+
+void ESP32_RC_BondBase::deliver(const uint8_t *frame, uint8_t lane) {
+  uint16_t seq = frame[0] | (frame[1] << 8);
+  if (lane >= _RC_LANE_COUNT) {
+    recv_metric.err_count ++;
+    return;
+  }
+
+  xSemaphoreTake(bond_mutex, portMAX_DELAY);
+  uint8_t kind = dedupe[lane].check(seq);
+  if (kind == ESP32_RC_SeqWindow::DUPLICATE || kind == ESP32_RC_SeqWindow::STALE) {
+    duplicates ++;
+    xSemaphoreGive(bond_mutex);
+    return;
+  }
+
+  if (uses_mailbox(lane)) {
+    memcpy(recv_mailbox.write_buffer(), frame + _RC_BOND_HEADER_LEN, payload_len);
+    recv_mailbox.publish();
+  } else {
+    int index = pool_take();
+    if (index < 0) {
+      recv_metric.err_count ++;
+      xSemaphoreGive(bond_mutex);
+      return;
+    }
+    memcpy(pool_buffer(index), frame + _RC_BOND_HEADER_LEN, payload_len);
+    pool_push(index, lane);
+  }
+  recv_metric.in_count ++;
+  xSemaphoreGive(bond_mutex);
+  signal_recv();
+}
+
+// the peer's sequences may have started over. A copy still on the other path may come
+// through twice then, which is rare: the path that handshook had lost its link.
+void ESP32_RC_BondBase::resync(void) {
+  xSemaphoreTake(bond_mutex, portMAX_DELAY);
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT; lane++) {
+    dedupe[lane].reset();
+  }
+  xSemaphoreGive(bond_mutex);
+}
+
+// best of both paths: UP if any is up, DOWN only if both gave up
+void ESP32_RC_BondBase::update_state(void) {
+  uint8_t state = _RC_LINK_DOWN;
+  for (int i = 0; i < _RC_BOND_PATHS; i++) {
+    uint8_t path_state = paths[i]->get_link_state();
+    if (path_state == _RC_LINK_UP && !paths[i]->is_connected()) path_state = _RC_LINK_LOST;
+    if (path_state < state) state = path_state;
+  }
+  set_value(&connection_status, (state == _RC_LINK_UP) ? _STATUS_CONN_OK : _STATUS_CONN_ERR);
+  set_link_state(state);
+  if (state == _RC_LINK_UP) xSemaphoreGive(path_up);
+}
+
+bool ESP32_RC_BondBase::is_path_up(int index) {
+  return paths[index]->get_link_state() == _RC_LINK_UP && paths[index]->is_connected();
+}
+
+// path_up stays given while a path is up, every waiter gives it on to the next one.
+// A give left over from before a loss costs one more check, then the wait.
+void ESP32_RC_BondBase::wait_path_up(void) {
+  while (!is_path_up(0) && !is_path_up(1)) {
+    xSemaphoreTake(path_up, portMAX_DELAY);
+  }
+  xSemaphoreGive(path_up);
+}
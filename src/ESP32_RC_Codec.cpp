@@ -0,0 +1,341 @@
+#include <string.h>
+#include <ESP32_RC_Common.h>
+#include <ESP32_RC_Codec.h>
+
+/*
+ * ========================================================
+ * Util functions
+ * ========================================================
+ */
+
+size_t ESP32_RC_Codec::slot_count(size_t payload_len) {
+  return (payload_len + _RC_CODEC_SLOT_LEN - 1) / _RC_CODEC_SLOT_LEN;
+}
+
+// the last slot may be shorter than _RC_CODEC_SLOT_LEN
+size_t ESP32_RC_Codec::slot_len(size_t payload_len, size_t slot) {
+  size_t offset = slot * _RC_CODEC_SLOT_LEN;
+  size_t remain = payload_len - offset;
+  return (remain < _RC_CODEC_SLOT_LEN) ? remain : _RC_CODEC_SLOT_LEN;
+}
+
+bool ESP32_RC_Codec::is_compact(const uint8_t *frame, size_t frame_len) {
+  return (frame != nullptr && frame_len > 0 && _RC_FRAME_KIND(frame[0]) == _RC_FRAME_COMPACT);
+}
+
+
+/*
+ * ========================================================
+ * Slot bitmap encode / decode
+ *  - out = [bitmap] [slots which differ from ref]
+ * ========================================================
+ */
+size_t ESP32_RC_Codec::encode_slots(const void *payload, const void *ref, size_t payload_len, uint8_t *out, size_t out_cap) {
+  const uint8_t *src  = (const uint8_t *)payload;
+  const uint8_t *base = (const uint8_t *)ref;
+  size_t slots        = slot_count(payload_len);
+  size_t bitmap_len   = _RC_CODEC_BITMAP_LEN(payload_len);
+
+  if (slots > _RC_CODEC_MAX_SLOTS || out_cap < bitmap_len) return 0;
+
+  uint8_t *bitmap = out;
+  memset(bitmap, 0, bitmap_len);
+
+  size_t pos = bitmap_len;
+  for (size_t slot = 0; slot < slots; slot++) {
+    size_t offset = slot * _RC_CODEC_SLOT_LEN;
+    size_t len    = slot_len(payload_len, slot);
+
+    // skip unchanged slots
+    bool is_same = true;
+    for (size_t i = 0; i < len; i++) {
+      uint8_t expected = (base == nullptr) ? 0 : base[offset + i];
+      if (src[offset + i] != expected) { is_same = false; break; }
+    }
+    if (is_same) continue;
+
+    if (pos + len > out_cap) return 0;
+
+    bitmap[slot / 8] |= (1 << (slot % 8));
+    memcpy(out + pos, src + offset, len);
+    pos += len;
+  }
+  return pos;
+}
+
+bool ESP32_RC_Codec::decode_slots(const uint8_t *in, size_t in_len, void *payload, const void *ref, size_t payload_len) {
+  uint8_t *dst       = (uint8_t *)payload;
+  size_t slots       = slot_count(payload_len);
+  size_t bitmap_len  = _RC_CODEC_BITMAP_LEN(payload_len);
+
+  if (slots > _RC_CODEC_MAX_SLOTS || in_len < bitmap_len) return false;
+
+  if (ref == nullptr) {
+    memset(dst, 0, payload_len);
+  } else if (ref != payload) {
+    memcpy(dst, ref, payload_len);
+  }
+
+  const uint8_t *bitmap = in;
+  size_t pos = bitmap_len;
+  for (size_t slot = 0; slot < slots; slot++) {
+    if ((bitmap[slot / 8] & (1 << (slot % 8))) == 0) continue;
+    size_t len = slot_len(payload_len, slot);
+    if (pos + len > in_len) return false;   // truncated frame
+    memcpy(dst + slot * _RC_CODEC_SLOT_LEN, in + pos, len);
+    pos += len;
+  }
+  return (pos == in_len);
+}
+
+
+/*
+ * ========================================================
+ * Compact encode / decode
+ * ========================================================
+ */
+size_t ESP32_RC_Codec::encode(const void *payload, size_t payload_len, uint8_t *frame, size_t frame_cap) {
+  if (frame_cap < 1) return 0;
+
+  size_t len = encode_slots(payload, nullptr, payload_len, frame + 1, frame_cap - 1);
+  if (len == 0 || 1 + len >= payload_len) return 0;   // no gain compared to the raw payload
+
+  frame[0] = _RC_FRAME_COMPACT;
+  return 1 + len;
+}
+
+bool ESP32_RC_Codec::decode(const uint8_t *frame, size_t frame_len, void *payload, size_t payload_len) {
+  if (!is_compact(frame, frame_len)) return false;
+  return decode_slots(frame + 1, frame_len - 1, payload, nullptr, payload_len);
+}
+
+
+/*
+ * ========================================================
+ * Delta Encoder
+ * ========================================================
+ */
+// next_id keeps counting, so a late on_sent() of a frame from before reset() is ignored
+void ESP32_RC_DeltaEncoder::reset(void) {
+  ref_valid     = false;
+  since_key     = 0;
+  for (int i = 0; i < _RC_DELTA_PENDING; i++) {
+    pending[i].valid = false;
+  }
+}
+
+size_t ESP32_RC_DeltaEncoder::encode(const void *payload, size_t payload_len, uint8_t *frame, size_t frame_cap) {
+  if (payload_len > _RC_CODEC_MAX_PAYLOAD || frame_cap < 3) return 0;
+
+  uint8_t id  = next_id;
+  size_t  len = 0;
+
+  // reference must still be in the receiver history
+  bool use_ref = ref_valid
+              && since_key < _RC_DELTA_KEY_INTERVAL
+              && (uint8_t)(id - ref_id) <= _RC_DELTA_MAX_AGE;
+
+  if (use_ref) {
+    len = ESP32_RC_Codec::encode_slots(payload, ref, payload_len, frame + 3, frame_cap - 3);
+    if (len > 0 && 3 + len < payload_len) {
+      frame[0] = _RC_FRAME_DELTA;
+      frame[1] = id;
+      frame[2] = ref_id;
+      len += 3;
+      since_key ++;
+    } else {
+      len = 0;
+    }
+  }
+
+  // fall back to KEY frame
+  if (len == 0) {
+    len = ESP32_RC_Codec::encode_slots(payload, nullptr, payload_len, frame + 2, frame_cap - 2);
+    if (len == 0 || 2 + len >= payload_len) return 0;
+    frame[0] = _RC_FRAME_KEY;
+    frame[1] = id;
+    len += 2;
+    since_key = 0;
+  }
+
+  // the oldest unconfirmed frame is overwritten, it can not become the reference any more
+  Pending &entry = pending[next_pending];
+  memcpy(entry.data, payload, payload_len);
+  entry.id     = id;
+  entry.valid  = true;
+  next_pending = (next_pending + 1) % _RC_DELTA_PENDING;
+  next_id ++;
+  return len;
+}
+
+// a failed frame stays pending, the sender retries the same bytes and may still confirm it
+void ESP32_RC_DeltaEncoder::on_sent(uint8_t id, bool success) {
+  if (!success) return;
+  for (int i = 0; i < _RC_DELTA_PENDING; i++) {
+    Pending &entry = pending[i];
+    if (!entry.valid || entry.id != id) continue;
+    // a retry completes after newer frames, never step back to an older reference
+    if (!ref_valid || (int8_t)(id - ref_id) > 0) {
+      memcpy(ref, entry.data, sizeof(ref));
+      ref_id    = id;
+      ref_valid = true;
+    }
+    entry.valid = false;
+    return;
+  }
+}
+
+
+/*
+ * ========================================================
+ * Delta Decoder
+ * ========================================================
+ */
+void ESP32_RC_DeltaDecoder::reset(void) {
+  for (int i = 0; i < _RC_DELTA_HISTORY; i++) {
+    history[i].valid = false;
+  }
+  next_slot = 0;
+}
+
+bool ESP32_RC_DeltaDecoder::is_delta(const uint8_t *frame, size_t frame_len) {
+  return (frame != nullptr && frame_len > 0 && (_RC_FRAME_KIND(frame[0]) == _RC_FRAME_KEY || _RC_FRAME_KIND(frame[0]) == _RC_FRAME_DELTA));
+}
+
+bool ESP32_RC_DeltaDecoder::decode(const uint8_t *frame, size_t frame_len, void *payload, size_t payload_len) {
+  if (!is_delta(frame, frame_len) || payload_len > _RC_CODEC_MAX_PAYLOAD) return false;
+
+  bool ok = false;
+  if (_RC_FRAME_KIND(frame[0]) == _RC_FRAME_KEY) {
+    if (frame_len < 2) return false;
+    ok = ESP32_RC_Codec::decode_slots(frame + 2, frame_len - 2, payload, nullptr, payload_len);
+  } else {
+    if (frame_len < 3) return false;
+    const Entry *base = nullptr;
+    for (int i = 0; i < _RC_DELTA_HISTORY; i++) {
+      if (history[i].valid && history[i].id == frame[2]) {
+        base = &history[i];
+        break;
+      }
+    }
+    if (base == nullptr) return false;   // reference lost, wait for the next KEY frame
+    ok = ESP32_RC_Codec::decode_slots(frame + 3, frame_len - 3, payload, base->data, payload_len);
+  }
+  if (!ok) return false;
+
+  // keep it as a possible reference, older entries with the same id are outdated
+  for (int i = 0; i < _RC_DELTA_HISTORY; i++) {
+    if (history[i].id == frame[1]) history[i].valid = false;
+  }
+  Entry &entry = history[next_slot];
+  next_slot    = (next_slot + 1) % _RC_DELTA_HISTORY;
+  entry.valid  = true;
+  entry.id     = frame[1];
+  memcpy(entry.data, payload, payload_len);
+  return true;
+}
+
+
+/*
+ * ========================================================
+ * Quantizer
+ * ========================================================
+ */
+bool ESP32_RC_Quantizer::set_profiles(const ESP32_RC_QuantProfile *in_profiles, int in_count, size_t payload_len) {
+  if (in_count < 0 || in_count > _RC_QUANT_MAX_CHANNELS || payload_len > _RC_CODEC_MAX_PAYLOAD) return false;
+
+  bool quant_slot[_RC_CODEC_MAX_SLOTS] = {};
+  size_t total_bits = 0;
+  for (int i = 0; i < in_count; i++) {
+    const ESP32_RC_QuantProfile &p = in_profiles[i];
+    if (p.offset % _RC_CODEC_SLOT_LEN != 0 || p.offset + sizeof(float) > payload_len) return false;
+    if (p.bits < 1 || p.bits > _RC_QUANT_MAX_BITS || !(p.max > p.min)) return false;
+    if (quant_slot[p.offset / _RC_CODEC_SLOT_LEN]) return false;   // declared twice
+    quant_slot[p.offset / _RC_CODEC_SLOT_LEN] = true;
+    total_bits += p.bits;
+  }
+
+  // install
+  memcpy(profiles, in_profiles, in_count * sizeof(ESP32_RC_QuantProfile));
+  memcpy(is_quant_slot, quant_slot, sizeof(is_quant_slot));
+  count        = in_count;
+  payload_size = payload_len;
+  packed_size  = payload_len - in_count * _RC_CODEC_SLOT_LEN + (total_bits + 7) / 8;
+
+  // FNV-1a of the profiles, so both peers can verify they speak the same layout
+  // (fields are hashed one by one, struct padding is undefined)
+  sig = 0;
+  if (count > 0) {
+    uint32_t hash = 2166136261UL;
+    for (int i = 0; i < count; i++) {
+      uint8_t bytes[11];
+      memcpy(bytes,     &profiles[i].offset, 2);
+      memcpy(bytes + 2, &profiles[i].min,    4);
+      memcpy(bytes + 6, &profiles[i].max,    4);
+      bytes[10] = profiles[i].bits;
+      for (size_t j = 0; j < sizeof(bytes); j++) {
+        hash = (hash ^ bytes[j]) * 16777619UL;
+      }
+    }
+    sig = (hash == 0) ? 1 : hash;
+  }
+  return true;
+}
+
+void ESP32_RC_Quantizer::pack(const void *payload, uint8_t *packed) const {
+  const uint8_t *src = (const uint8_t *)payload;
+
+  // plain slots
+  size_t pos = 0;
+  for (size_t offset = 0; offset < payload_size; offset += _RC_CODEC_SLOT_LEN) {
+    if (is_quant_slot[offset / _RC_CODEC_SLOT_LEN]) continue;
+    size_t len = (payload_size - offset < _RC_CODEC_SLOT_LEN) ? payload_size - offset : _RC_CODEC_SLOT_LEN;
+    memcpy(packed + pos, src + offset, len);
+    pos += len;
+  }
+
+  // bitstream, LSB first
+  memset(packed + pos, 0, packed_size - pos);
+  size_t bit_pos = 0;
+  for (int i = 0; i < count; i++) {
+    const ESP32_RC_QuantProfile &p = profiles[i];
+    float value;
+    memcpy(&value, src + p.offset, sizeof(float));
+
+    uint32_t steps = (1UL << p.bits) - 1;
+    float ratio = (value - p.min) / (p.max - p.min);
+    if (!(ratio > 0.0f)) ratio = 0.0f;                      // also catches NaN
+    if (ratio > 1.0f)    ratio = 1.0f;
+    uint32_t q = (uint32_t)(ratio * steps + 0.5f);
+
+    for (int b = 0; b < p.bits; b++, bit_pos++) {
+      if (q & (1UL << b)) packed[pos + bit_pos / 8] |= (1 << (bit_pos % 8));
+    }
+  }
+}
+
+void ESP32_RC_Quantizer::unpack(const uint8_t *packed, void *payload) const {
+  uint8_t *dst = (uint8_t *)payload;
+
+  // plain slots
+  size_t pos = 0;
+  for (size_t offset = 0; offset < payload_size; offset += _RC_CODEC_SLOT_LEN) {
+    if (is_quant_slot[offset / _RC_CODEC_SLOT_LEN]) continue;
+    size_t len = (payload_size - offset < _RC_CODEC_SLOT_LEN) ? payload_size - offset : _RC_CODEC_SLOT_LEN;
+    memcpy(dst + offset, packed + pos, len);
+    pos += len;
+  }
+
+  // bitstream, LSB first
+  size_t bit_pos = 0;
+  for (int i = 0; i < count; i++) {
+    const ESP32_RC_QuantProfile &p = profiles[i];
+    uint32_t q = 0;
+    for (int b = 0; b < p.bits; b++, bit_pos++) {
+      if (packed[pos + bit_pos / 8] & (1 << (bit_pos % 8))) q |= (1UL << b);
+    }
+    uint32_t steps = (1UL << p.bits) - 1;
+    float value = p.min + (p.max - p.min) * q / steps;
+    memcpy(dst + p.offset, &value, sizeof(float));
+  }
+}
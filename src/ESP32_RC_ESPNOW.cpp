@@ -1,7 +1,8 @@
 #include <ESP32_RC_ESPNOW.h>
 
 uint8_t ESP32_RC_ESPNOW::broadcast_addr[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-ESP32_RC_ESPNOW* ESP32_RC_ESPNOW::instance = nullptr;
+std::atomic<ESP32_RC_ESPNOW *> ESP32_RC_ESPNOW::instances[_ESPNOW_MAX_INSTANCES] = {};
+bool ESP32_RC_ESPNOW::is_driver_ready = false;
 
 /* 
  * ========================================================
@@ -11,16 +12,35 @@ ESP32_RC_ESPNOW* ESP32_RC_ESPNOW::instance = nullptr;
  * For ESPNOW, the role value is ignored.
  *  
  */
-ESP32_RC_ESPNOW::ESP32_RC_ESPNOW(bool fast_mode, bool debug_mode) : ESP32RemoteControl(fast_mode, debug_mode) {
-  instance = this;
+ESP32_RC_ESPNOW::ESP32_RC_ESPNOW(bool fast_mode, bool debug_mode, size_t payload_len) 
+  : ESP32RemoteControl(fast_mode, debug_mode, payload_len) {
+  if (payload_len > MAX_PAYLOAD_LEN) {
+    _ERROR_("Payload length " + String((int)payload_len) + " > " + String((int)MAX_PAYLOAD_LEN));
+  }
+  keeps_frames = true;                          // failed frames are sent again, see op_send()
+
+  // register for the driver callbacks
+  for (int i = 0; i < _ESPNOW_MAX_INSTANCES; i++) {
+    ESP32_RC_ESPNOW *expected = nullptr;
+    if (instances[i].compare_exchange_strong(expected, this)) return;
+  }
+  _ERROR_("More than " + String(_ESPNOW_MAX_INSTANCES) + " instances.");
 }
 
 ESP32_RC_ESPNOW::~ESP32_RC_ESPNOW() {
+  // stop the sender first, it uses the codecs below
+  stop_link_monitor();
+  stop_sender();
+  stop_receiver();
+
   // clean up existing timers
-  xTimerStop(send_timer, 0);
-  xTimerDelete(send_timer, 0);
   xTimerStop(heartbeat_timer, 0);
   xTimerDelete(heartbeat_timer, 0);  
+
+  for (int i = 0; i < _ESPNOW_MAX_INSTANCES; i++) {
+    ESP32_RC_ESPNOW *expected = this;
+    instances[i].compare_exchange_strong(expected, nullptr);
+  }
 }
 
 
@@ -50,19 +70,20 @@ void ESP32_RC_ESPNOW::init(void)  {
 
   int attempt = 0;
   int max_retry = 100;
-  while (attempt <= max_retry) {
+  while (!is_driver_ready && attempt <= max_retry) {
     attempt++;
-    if (esp_now_init() == ESP_OK)  break;
+    if (esp_now_init() == ESP_OK) {
+      is_driver_ready = true;
+      break;
+    }
     _DELAY_(10);
     if (attempt >= max_retry ) {
       _ERROR_ ("Failed. Attempts >= Max Retry (" + String(max_retry) + ")");
     }  
   }
   
-  // Create queues
-  send_queue = xQueueCreate(_RC_QUEUE_DEPTH, sizeof(Message));
-  recv_queue = xQueueCreate(_RC_QUEUE_DEPTH, sizeof(Message));
-  if (send_queue == NULL || recv_queue == NULL) {
+  // Create queues, sized to the real payload
+  if (create_queues() == false) {
     _ERROR_("Failed to create queues.");
   }
 
@@ -70,12 +91,10 @@ void ESP32_RC_ESPNOW::init(void)  {
   mutex = xSemaphoreCreateMutex();
 
   // Create Timer Tasks
-  // For example : _ESP32_RC_DATA_RATE = 100 (times/sec)
-  //              => int(1000/_ESP32_RC_DATA_RATE) = 10 (ms),  delay 10ms for each timer event
-  send_timer      = xTimerCreate("SendTimer",       pdMS_TO_TICKS(int(1000/_ESP32_RC_DATA_RATE)),     pdTRUE, nullptr, send_timer_callback);
-  heartbeat_timer = xTimerCreate("HeartBeatTimer",  pdMS_TO_TICKS(int(1000/ESP32_RC_HEARTBEAT_RATE)), pdTRUE, nullptr, heartbeat_timer_callback);
+  // Messages are sent by send_task, as soon as the radio is free. Only the heartbeat is timed.
+  heartbeat_timer = xTimerCreate("HeartBeatTimer",  heartbeat_period(), pdTRUE, this, heartbeat_timer_callback);
 
-  if (send_timer == NULL || heartbeat_timer == NULL) {
+  if (heartbeat_timer == NULL) {
     _ERROR_("Failed to create timer");
   }
 
@@ -94,11 +113,12 @@ void ESP32_RC_ESPNOW::init(void)  {
  */
 void ESP32_RC_ESPNOW::connect(void) {
   _DEBUG_ ("Started.");
+  load_peer();
   int attempt = 0;
   int max_retry = 100;
   while (attempt <= max_retry) {
     attempt++;
-    if (handshake() == true) break;
+    if (handshake(_RC_HANDSHAKE_TIMEOUT) == true) break;
     _DELAY_(10);
     if (attempt >= max_retry ) {
       _ERROR_ ("Failed. Attempts >= Max Retry (" + String(max_retry) + ")");
@@ -108,18 +128,17 @@ void ESP32_RC_ESPNOW::connect(void) {
   // start processing the send message queue.
   set_value(&send_status, _STATUS_SEND_READY);
   
-  xTimerStart(send_timer, 0);
+  start_sender();
+  start_receiver();
   xTimerStart(heartbeat_timer, 0);
+  start_link_monitor();
   _DEBUG_("Success.");
 }
 
 
-void ESP32_RC_ESPNOW::send_timer_callback(TimerHandle_t xTimer) {
-  instance->send_queue_msg();
-}
-
 void ESP32_RC_ESPNOW::heartbeat_timer_callback(TimerHandle_t xTimer) {
-  instance->op_send(instance->create_sys_msg(_HEARTBEAT_MSG));
+  ESP32_RC_ESPNOW *rc = static_cast<ESP32_RC_ESPNOW *>(pvTimerGetTimerID(xTimer));
+  rc->op_send_ctrl(_RC_FRAME_HEARTBEAT);
   digitalWrite(BUILTIN_LED, HIGH);
 }
 
@@ -136,13 +155,15 @@ void ESP32_RC_ESPNOW::heartbeat_timer_callback(TimerHandle_t xTimer) {
 
 
 void ESP32_RC_ESPNOW::pair_peer(const uint8_t *mac_addr) {
-  memcpy( &peer.peer_addr, mac_addr, ESP_NOW_ETH_ALEN );
-  if ( ! esp_now_is_peer_exist(peer.peer_addr) ) { // if not exists
+  if ( ! esp_now_is_peer_exist(mac_addr) ) { // if not exists
     // prepare for pairing - RC receiver needs to set ifidx
-    peer.channel = _ESPNOW_CHANNEL;  // pick a channel
-    peer.encrypt = 0;               // no encryption
-    peer.ifidx   = WIFI_IF_STA ;
-    esp_now_add_peer(&peer);
+    esp_now_peer_info_t info;
+    memset(&info, 0, sizeof(info));
+    memcpy(info.peer_addr, mac_addr, ESP_NOW_ETH_ALEN);
+    info.channel = _ESPNOW_CHANNEL;  // pick a channel
+    info.encrypt = 0;               // no encryption
+    info.ifidx   = WIFI_IF_STA ;
+    esp_now_add_peer(&info);
   }; 
 }
 
@@ -150,6 +171,62 @@ void ESP32_RC_ESPNOW::unpair_peer(const uint8_t *mac_addr) {
   esp_now_del_peer(mac_addr);
 }
 
+void ESP32_RC_ESPNOW::set_primary(const uint8_t *mac_addr) {
+  bool is_changed = memcmp(peer.peer_addr, mac_addr, ESP_NOW_ETH_ALEN) != 0;
+  if (is_changed && memcmp(peer.peer_addr, broadcast_addr, ESP_NOW_ETH_ALEN) != 0) {
+    unpair_peer(peer.peer_addr);
+  }
+  pair_peer(mac_addr);
+  memcpy(peer.peer_addr, mac_addr, ESP_NOW_ETH_ALEN);
+  peers.set_primary(mac_addr);
+}
+
+// no delta with secondary peers, the ack tells the peer so
+void ESP32_RC_ESPNOW::accept_peer(const uint8_t *mac_addr, const uint8_t *data, int data_len) {
+  int id = peers.add(mac_addr, millis());
+  if (id <= _RC_PEER_PRIMARY) {
+    recv_metric.err_count ++;
+    return;
+  }
+  peers.get(id).caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+  pair_peer(mac_addr);
+
+  uint8_t ack[_RC_CTRL_FRAME_LEN];
+  size_t ack_len = create_ctrl_frame(_RC_FRAME_HANDSHAKE_ACK, ack);
+  ack[1] &= ~_RC_CAP_DELTA;
+  post_ctrl(ack, ack_len, mac_addr);
+}
+
+void ESP32_RC_ESPNOW::remove_peer(uint8_t peer_id) {
+  if (peer_id == _RC_PEER_PRIMARY || !peers.is_used(peer_id)) return;
+  unpair_peer(peers.get(peer_id).mac_addr);
+  ESP32RemoteControl::remove_peer(peer_id);
+}
+
+// a peer stored for another channel is stale, discover again
+void ESP32_RC_ESPNOW::load_peer(void) {
+  has_known_peer = (peer_store != nullptr) && peer_store->recall(known_addr, _ESPNOW_CHANNEL);
+  if (has_known_peer) _DEBUG_("Known peer " + mac2str(known_addr));
+}
+
+// the store only writes if the peer changed
+void ESP32_RC_ESPNOW::remember_peer(void) {
+  memcpy(known_addr, peer.peer_addr, ESP_NOW_ETH_ALEN);
+  has_known_peer = true;
+  if (peer_store != nullptr && !peer_store->remember(known_addr, _ESPNOW_CHANNEL)) {
+    _DEBUG_("Failed to save peer.");
+  }
+}
+
+void ESP32_RC_ESPNOW::set_peer_store(ESP32_RC_PeerStore *store) {
+  peer_store = store;
+}
+
+void ESP32_RC_ESPNOW::forget_peer(void) {
+  has_known_peer = false;
+  if (peer_store != nullptr) peer_store->clear();
+}
+
 
 
 /* 
@@ -159,94 +236,97 @@ void ESP32_RC_ESPNOW::unpair_peer(const uint8_t *mac_addr) {
  * ========================================================
  */
 
-void ESP32_RC_ESPNOW::send(Message data) {
+void ESP32_RC_ESPNOW::send(const void *data, uint8_t lane) {
+  if (lane >= _RC_LANE_COUNT) {
+    send_metric.err_count ++;
+    return;
+  }
+
+  // make sure handshake is completed successfully, blocking lanes wait for it
   int status = 0;
   get_value(&connection_status, &status);
-  if (fast_mode) {
-    if (status != _STATUS_CONN_OK) { return; }
-    if (get_queue_depth(send_queue) >= _RC_QUEUE_DEPTH ) {
-      Message msg;
-      de_queue(send_queue, &msg);
-      send_metric.out_count --;
-    }
-    en_queue(send_queue, &data);
-    send_metric.in_count ++;
-    return;      
-  } else {
-    while (true) {
-      // make sure handshake is completed successfully, then perform send
-      if( get_queue_depth(send_queue) < _RC_QUEUE_DEPTH && status == _STATUS_CONN_OK ) {
-        //msg = create_sys_msg(data);
-        en_queue(send_queue, &data);
-        send_metric.in_count ++;
-        return;
-      } else {
-        vTaskDelay(pdMS_TO_TICKS(int( 1000/_ESP32_RC_DATA_RATE ))); 
-      }
-    }
+  while (status != _STATUS_CONN_OK) {
+    if (lanes[lane].policy != _RC_LANE_BLOCK || uses_mailbox(lane)) return;
+    _DELAY_(int( 1000/_ESP32_RC_DATA_RATE ));
+    get_value(&connection_status, &status);
   }
+  enqueue(data, lane);
 }
 
+/*
+ * ========================================================
+ * send_queue_msg - Override
+ *  - up to send_window.size() frames in flight, no stop-and-wait
+ *  - on_datasent completes them in send order
+ *  - only failed frames are sent again
+ * ========================================================
+ */
 void ESP32_RC_ESPNOW::send_queue_msg() {
-  int status = 0;
+  bool is_busy = false;   // radio refused a frame, driver buffer full
+
+  // delivered frames leave the window, failed ones are queued again
+  for (int slot = 0; slot < _RC_SEND_WINDOW_MAX; slot++) {
+    uint8_t state = send_window.state(slot);
+    uint8_t lane  = send_window.lane(slot);
+    if (state == ESP32_RC_SendWindow::DONE) {
+      send_metric.out_count ++;
+      send_window.release(slot);
+    } else if (state == ESP32_RC_SendWindow::FAILED) {
+      // mailbox: a newer value replaces it, dropping lanes: give up after a few retries
+      bool is_stale = uses_mailbox(lane) && send_mailbox.is_fresh();
+      bool is_drop  = (lanes[lane].policy != _RC_LANE_BLOCK) && (++ send_window.retries(slot) > _RC_SEND_MAX_RETRY);
+      if (is_stale || is_drop) {
+        send_window.release(slot);
+      } else {
+        send_window.mark(slot, ESP32_RC_SendWindow::QUEUED);
+      }
+    }
+  }
 
-  
-  // Lock the varible
-  get_value(&send_status, &status);
+  // strict priority: lane by lane, first the frames to retry, then new messages
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT && !is_busy; lane++) {
+    for (int slot = 0; slot < _RC_SEND_WINDOW_MAX && !is_busy; slot++) {
+      if (send_window.state(slot) == ESP32_RC_SendWindow::QUEUED && send_window.lane(slot) == lane) {
+        is_busy = !op_send(send_window.buffer(slot), slot);
+      }
+    }
 
-  /*
-  // not ready, last message could be still in progress.
-  if (status != _STATUS_SEND_READY) {
-    vTaskDelay(pdMS_TO_TICKS(2)); 
-    return;
+    int slot;
+    while (!is_busy && (slot = send_window.acquire(lane)) >= 0) {
+      if (!dequeue(lane, send_window.buffer(slot))) {
+        send_window.release(slot);
+        break;
+      }
+      is_busy = !op_send(send_window.buffer(slot), slot);
+    }
   }
-  */
 
-  // if send_queue empty, then done
-  // only wait for new messages while when the queue is empty.
-  if (get_queue_depth(send_queue) == 0 ) {
-    _DELAY_(int( 1000/_ESP32_RC_DATA_RATE/2 ));
-    return;
+  // addressed messages to the other peers, one per peer and round, sent once
+  uint8_t msg[_RC_MAX_PAYLOAD_LEN];
+  for (int id = 1; id < _RC_MAX_PEERS && !is_busy; id++) {
+    if (!peers.is_used(id)) continue;
+    ESP32_RC_Peer &target = peers.get(id);
+    uint32_t pos;
+    if (!target.send_queue.peek(msg, &pos)) continue;
+    is_busy = !op_send_to(target, msg);
+    if (!is_busy) target.send_queue.consume(pos);
   }
 
-  // start sending process ...
-  long start_time = millis();
-  Message msg =  {};
-  while (millis () - start_time < 2000) {
-    // peek the message in send_queue, ** not committed to de-queue **
-    if ( ! msg.is_set ) {
-      if (xQueuePeek(send_queue, &msg, ( TickType_t ) 10) == pdTRUE) { 
-        msg.is_set  = true;
-      } else {
-        continue;
-      } 
-    }
+  // frames overdue, on_datasent got lost
+  ESP32_RC_SendWindow::Record rec;
+  send_window.lock();
+  while (send_window.expire(micros(), send_timeout(), rec)) {
+    send_metric.err_count ++;
+    if (rec.delta_id >= 0) delta_encoder.on_sent(rec.delta_id, false);
+  }
+  send_window.unlock();
 
-    // trigger send operation.
-    // if failed, go to next cycle
-    if (op_send(msg) == false) { 
-      continue;
-    }
-    
-    while (millis () - start_time <= 1000) {  // wait for on_datasent to confirm.
-      // Lock the varible
-      get_value(&send_status, &status);
-
-      if (status == _STATUS_SEND_DONE) { // all good.
-        xQueueReceive(send_queue, &msg, ( TickType_t ) 10);  // de-queue the message
-        msg.is_set  = true;
-        send_metric.out_count ++;
-        set_value(&send_status, _STATUS_SEND_READY);
-        return; 
-      };
-      if (status == _STATUS_SEND_ERR) {
-        send_metric.err_count ++;
-        break; // exit the loop and try again.
-      }
-      _DELAY_(2);   // wait for a while
-    }
+  // wait for the radio, woken by on_datasent or by send()
+  if (is_busy) {
+    _DELAY_(1);
+  } else if (send_window.in_use() > 0) {
+    wait_sender(pdMS_TO_TICKS(_RC_SEND_DONE_TIMEOUT));
   }
-  
 }
 
 /*
@@ -256,9 +336,73 @@ bool ESP32_RC_ESPNOW::op_send(Message msg) {
 }
 */
 
-bool ESP32_RC_ESPNOW::op_send(Message msg) {
-  set_value(&send_status, _STATUS_SEND_IN_PROG);
-  return (esp_now_send(peer.peer_addr, (uint8_t *)&msg, sizeof(Message)) == ESP_OK);
+// encode and send under the window lock, so records, delta ids and frames on air share one order
+// a slot is encoded once, a retry sends the same bytes (same seq, same delta id, same timestamp)
+bool ESP32_RC_ESPNOW::op_send(const void *data, int slot) {
+  uint8_t *frame = send_window.frame(slot);
+  send_window.lock();
+  size_t frame_len = send_window.frame_len(slot);
+  if (frame_len == 0) {
+    // data messages go delta / compact if peer supports it, otherwise raw
+    frame_len = encode_frame(data, frame, _MAX_MSG_LEN - _RC_FRAME_TRAILER_LEN, peer_caps);
+    if (frame_len == 0) {
+      frame[0]  = _RC_FRAME_RAW;
+      memcpy(frame + _RC_FRAME_HEADER_LEN, data, payload_len);
+      frame_len = _RC_FRAME_HEADER_LEN + payload_len;
+    }
+    frame[0] |= (send_window.lane(slot) << _RC_FRAME_LANE_SHIFT);
+    frame_len = add_trailer(frame, frame_len, send_window.seq(slot));
+    send_window.frame_len(slot) = frame_len;
+  }
+  int delta_id = ESP32_RC_DeltaDecoder::is_delta(frame, frame_len) ? frame[1] : -1;
+  bool is_sent = transmit(frame, frame_len, slot, delta_id, peer.peer_addr);
+  send_window.unlock();
+  return is_sent;
+}
+
+// no window slot, the record only keeps the completion order
+bool ESP32_RC_ESPNOW::op_send_to(ESP32_RC_Peer &target, const void *data) {
+  uint8_t frame[_MAX_MSG_LEN];
+  send_window.lock();
+  size_t frame_len = encode_frame(data, frame, sizeof(frame) - _RC_FRAME_TRAILER_LEN, target.caps);
+  if (frame_len == 0) {
+    frame[0]  = _RC_FRAME_RAW;
+    memcpy(frame + _RC_FRAME_HEADER_LEN, data, payload_len);
+    frame_len = _RC_FRAME_HEADER_LEN + payload_len;
+  }
+  frame[0] |= (_RC_LANE_CONTROL << _RC_FRAME_LANE_SHIFT);
+  frame_len  = add_trailer(frame, frame_len, target.next_seq);
+  bool is_sent = transmit(frame, frame_len, -1, -1, target.mac_addr);
+  if (is_sent) target.next_seq ++;
+  send_window.unlock();
+  return is_sent;
+}
+
+// Send control frame (HANDSHAKE, HEARTBEAT ...)
+bool ESP32_RC_ESPNOW::op_send_ctrl(uint8_t type, const uint8_t *mac_addr) {
+  uint8_t frame[_RC_CTRL_FRAME_LEN];
+  size_t frame_len = create_ctrl_frame(type, frame);
+  return op_send_ctrl(frame, frame_len, mac_addr);
+}
+
+bool ESP32_RC_ESPNOW::op_send_ctrl(const uint8_t *frame, size_t frame_len, const uint8_t *mac_addr) {
+  send_window.lock();
+  bool is_sent = transmit(frame, frame_len, -1, -1, (mac_addr != nullptr) ? mac_addr : peer.peer_addr);
+  send_window.unlock();
+  return is_sent;
+}
+
+// the acks of on_datarecv(), in send_task
+bool ESP32_RC_ESPNOW::op_send_posted(const uint8_t *frame, size_t frame_len, const uint8_t *addr) {
+  return op_send_ctrl(frame, frame_len, addr);
+}
+
+// hand frame to the radio and record it for on_datasent, send_window lock held
+bool ESP32_RC_ESPNOW::transmit(const uint8_t *frame, size_t frame_len, int slot, int delta_id, const uint8_t *mac_addr) {
+  if (!send_window.track(slot, delta_id, micros())) return false;
+  if (esp_now_send(mac_addr, frame, frame_len) == ESP_OK) return true;
+  send_window.untrack();
+  return false;
 }
 
 /* 
@@ -275,15 +419,12 @@ void ESP32_RC_ESPNOW::run(void* data) {
  * recv - Override 
  * ========================================================
  */
-Message ESP32_RC_ESPNOW::recv(void) {
-  Message msg;
-  if (get_queue_depth(recv_queue) > 0) {
-    if (xQueueReceive(recv_queue, &msg, ( TickType_t ) 10) == pdTRUE) {
-      recv_metric.out_count ++;
-      return msg;
-    }
-  } 
-  return {};
+bool ESP32_RC_ESPNOW::recv(void *data) {
+  RecvView view;
+  if (!recv_view(view)) return false;
+  memcpy(data, view.data, payload_len);
+  release(view);
+  return true;
 }
 
 
@@ -294,7 +435,7 @@ Message ESP32_RC_ESPNOW::recv(void) {
  *  - it should block send/send_queue_msg 
  * ========================================================
  */
-bool ESP32_RC_ESPNOW::handshake() {
+bool ESP32_RC_ESPNOW::handshake(uint32_t timeout_ms) {
   _DEBUG_("Started.");
   
   // Lock the varible
@@ -302,22 +443,32 @@ bool ESP32_RC_ESPNOW::handshake() {
 
   unsigned long start_time = millis();
 
+  // Known peer, say hello to it directly. No discovery needed if it answers.
+  if (has_known_peer) {
+    pair_peer(known_addr);
+    op_send_ctrl(_RC_FRAME_HANDSHAKE, known_addr);
+    if (wait_handshake((timeout_ms < _RC_RESUME_TIMEOUT) ? timeout_ms : _RC_RESUME_TIMEOUT)) {
+      remember_peer();
+      _DEBUG_("Resumed.");
+      return true;
+    }
+    // no answer, drop the pairing again unless a secondary peer uses it, the ack re-pairs
+    if (find_peer(known_addr) <= _RC_PEER_PRIMARY) unpair_peer(known_addr);
+  }
+
   // Send broadcast
   pair_peer(broadcast_addr);
-  op_send(create_sys_msg(_HANDSHAKE_MSG));
+  op_send_ctrl(_RC_FRAME_HANDSHAKE, broadcast_addr);
   unpair_peer(broadcast_addr);
 
   // Wait Ack 
-  int status = 0;
-  while (millis() - start_time < 10000) {   
-    // read handshake
-    get_value(&connection_status, &status);
-    if (status == _STATUS_CONN_OK) {
-      _DEBUG_("Success.");
-      return true;
-    }
-    _DELAY_(10);
+  uint32_t elapsed = millis() - start_time;
+  if (elapsed < timeout_ms && wait_handshake(timeout_ms - elapsed)) {
+    remember_peer();
+    _DEBUG_("Success.");
+    return true;
   }
+  handshake_failed();
   _DEBUG_("Failed.");
   return false;
 }
@@ -330,75 +481,166 @@ bool ESP32_RC_ESPNOW::handshake() {
  * ==========================================================
  */
 void ESP32_RC_ESPNOW::static_on_datasent(const uint8_t *mac_addr, esp_now_send_status_t op_status) {
-  instance->on_datasent(mac_addr, op_status);
+  ESP32_RC_ESPNOW *rc = route(mac_addr);
+  if (rc != nullptr) rc->on_datasent(mac_addr, op_status);
 }
 
 void ESP32_RC_ESPNOW::static_on_datarecv(const uint8_t *mac_addr, const uint8_t *data, int data_len) {
-  instance->on_datarecv(mac_addr, data, data_len);
+  ESP32_RC_ESPNOW *rc = route(mac_addr);
+  if (rc != nullptr) rc->on_datarecv(mac_addr, data, data_len);
+}
+
+// the owner of the MAC, else an instance in handshake (hello, broadcast), else one that takes new peers
+ESP32_RC_ESPNOW *ESP32_RC_ESPNOW::route(const uint8_t *mac_addr) {
+  ESP32_RC_ESPNOW *discovering = nullptr;
+  ESP32_RC_ESPNOW *fallback    = nullptr;
+  for (int i = 0; i < _ESPNOW_MAX_INSTANCES; i++) {
+    ESP32_RC_ESPNOW *rc = instances[i].load();
+    if (rc == nullptr || rc->mutex == nullptr) continue;    // not init() yet
+    if (rc->owns(mac_addr)) return rc;
+
+    int status = 0;
+    rc->get_value(&rc->connection_status, &status);
+    if (discovering == nullptr && status == _STATUS_CONN_IN_PROG) discovering = rc;
+    if (fallback == nullptr || (rc->multi_peer_mode && !fallback->multi_peer_mode)) fallback = rc;
+  }
+  return (discovering != nullptr) ? discovering : fallback;
+}
+
+bool ESP32_RC_ESPNOW::owns(const uint8_t *mac_addr) {
+  if (memcmp(mac_addr, broadcast_addr, ESP_NOW_ETH_ALEN) == 0) return false;
+  return (memcmp(peer.peer_addr, mac_addr, ESP_NOW_ETH_ALEN) == 0) || peers.find(mac_addr) != _RC_PEER_NONE;
 }
 
 void ESP32_RC_ESPNOW::on_datasent(const uint8_t *mac_addr, esp_now_send_status_t op_status) {
-  if (op_status == ESP_NOW_SEND_SUCCESS) {
+  bool is_success = (op_status == ESP_NOW_SEND_SUCCESS);
+
+  // completions come in send order, match the oldest frame in flight
+  // the delta reference only moves forward once the peer has confirmed the frame
+  ESP32_RC_SendWindow::Record rec = {-1, -1, 0};
+  send_window.lock();
+  if (send_window.complete(is_success, rec) && rec.delta_id >= 0) {
+    delta_encoder.on_sent(rec.delta_id, is_success);
+  }
+  send_window.unlock();
+  if (rec.slot >= 0) {
+    if (is_success) link_stats.on_rtt(micros() - rec.time);
+    else send_metric.err_count ++;
+  }
+  int id = peers.find(mac_addr);
+  if (id > _RC_PEER_PRIMARY) {
+    if (is_success) peers.get(id).sent ++;
+    else peers.get(id).send_errors ++;
+  }
+
+  if (is_success) {
     set_value(&send_status, _STATUS_SEND_DONE);
     //_DEBUG_("to (" + mac2str(mac_addr) + ") Success.");
   } else {
     set_value(&send_status, _STATUS_SEND_ERR);
     //_DEBUG_("to (" + mac2str(mac_addr) + ") Failed.  status = " + String (op_status));
   }
+  notify_sender();
 }
 
 
 
 void ESP32_RC_ESPNOW::on_datarecv(const uint8_t *mac_addr, const uint8_t *data, int data_len) {
+  uint32_t rx_us = micros();                    // t2 / t4 of the heartbeat exchange
   int status;
-  Message msg;
-  String data_recv_str;
-  
-  memcpy(&msg, data, sizeof(Message));
-  
-  
-  // Handshake Hello received and send Ack (priority #1)
-  if (strcmp(msg.sys, _HANDSHAKE_MSG) == 0) {
-    pair_peer(mac_addr);
-    op_send(create_sys_msg(_HANDSHAKE_ACK_MSG));
-    empty_queue(send_queue);
+
+  if (data_len < 1) {
+    recv_metric.err_count ++;
     return;
   }
-
-  // check if handshake in progress, and process Ack
-  get_value(&connection_status, &status);
-  //_DEBUG_( String(status));
-  if (strcmp(msg.sys, _HANDSHAKE_ACK_MSG) == 0 && status == _STATUS_CONN_IN_PROG) {
-    pair_peer(mac_addr);
-    empty_queue(send_queue);
-    empty_queue(recv_queue);
-    set_value(&connection_status, _STATUS_CONN_OK);
+  int id = peers.find(mac_addr);
+  if (id == _RC_PEER_BUSY) {                    // the table is being changed, never wait in the WiFi task
+    recv_metric.err_count ++;
     return;
   }
+  if (id == _RC_PEER_PRIMARY) link_alive();
+  else if (id > _RC_PEER_PRIMARY) peers.get(id).last_rx_ms.store(millis(), std::memory_order_relaxed);
 
-  // received heartbeat, then return heartbeat Ack
-  if (strcmp(msg.sys, _HEARTBEAT_MSG) == 0 ) {
-    op_send(create_sys_msg(_HEARTBEAT_ACK_MSG));
-    return ;
-  }
+  get_value(&connection_status, &status);
 
-  // received heart beat ack, heart beat cycle completed, then turn off the LED
-  if (strcmp(msg.sys, _HEARTBEAT_ACK_MSG) == 0 ) {
-    digitalWrite(BUILTIN_LED,LOW);
-    return ;
-  }
+  switch (_RC_FRAME_KIND(data[0])) {
+    // Handshake Hello received and send Ack (priority #1)
+    // also completes our own handshake, both sides may re-handshake at once after a link loss
+    // another peer while the primary link is up: own entry in multi-peer mode, else ignored (no take-over)
+    case _RC_FRAME_HANDSHAKE: {
+      if (id != _RC_PEER_PRIMARY && status != _STATUS_CONN_IN_PROG && peers.is_used(_RC_PEER_PRIMARY)) {
+        if (multi_peer_mode) accept_peer(mac_addr, data, data_len);
+        return;
+      }
+      set_primary(mac_addr);
+      peer_caps = negotiate_caps(data, data_len);
+      delta_decoder.reset();
+      handshake_done();
+      uint8_t ack[_RC_CTRL_FRAME_LEN];
+      post_ctrl(ack, create_ctrl_frame(_RC_FRAME_HANDSHAKE_ACK, ack));
+      post_reset();                             // the encoder and send_queue belong to send_task
+      if (status == _STATUS_CONN_IN_PROG) set_value(&connection_status, _STATUS_CONN_ACKED);
+      return;
+    }
 
-  // regular message
-  if (status == _STATUS_CONN_OK) {
-    recv_metric.in_count ++;
-    // add protection to de-queue front message to avoid queue overflow failure.
-    while (get_queue_depth(recv_queue) >= _RC_QUEUE_DEPTH )  { 
-      xQueueReceive(recv_queue, &msg, ( TickType_t ) 5); 
-    } 
-    // en-queue the message, ready for send
-    if (xQueueSend(recv_queue, &msg, ( TickType_t ) 10) != pdPASS ) {
-      _ERROR_("'recv_queue' depth = " + String(get_queue_depth(recv_queue)));
+    // check if handshake in progress, and process Ack
+    case _RC_FRAME_HANDSHAKE_ACK:
+      if (status != _STATUS_CONN_IN_PROG) return;
+      set_primary(mac_addr);
+      peer_caps = negotiate_caps(data, data_len);
+      delta_decoder.reset();
+      handshake_done();
+      post_reset();
+      empty_recv_queue();
+      set_value(&connection_status, _STATUS_CONN_ACKED);
+      return;
+
+    // received heartbeat, then return heartbeat Ack with our timestamps
+    case _RC_FRAME_HEARTBEAT: {
+      uint8_t ack[_RC_CTRL_FRAME_LEN];
+      post_ctrl(ack, create_heartbeat_ack(data, data_len, rx_us, ack), mac_addr);
+      return;
     }
+
+    // received heart beat ack, heart beat cycle completed, then turn off the LED
+    case _RC_FRAME_HEARTBEAT_ACK:
+      if (id != _RC_PEER_PRIMARY) return;
+      on_heartbeat_ack(data, data_len, rx_us);
+      digitalWrite(BUILTIN_LED,LOW);
+      return;
+
+    // regular message
+    case _RC_FRAME_RAW:
+    case _RC_FRAME_COMPACT:
+    case _RC_FRAME_KEY:
+    case _RC_FRAME_DELTA:
+      if (id > _RC_PEER_PRIMARY) {
+        recv_peer(peers.get(id), data, data_len);
+        return;
+      }
+      if (id < _RC_PEER_PRIMARY || (status != _STATUS_CONN_OK && status != _STATUS_CONN_ACKED)) return;
+      recv_data_frame(data, data_len);
+      return;
+
+    default:
+      recv_metric.err_count ++;
+      return;
   }
 }
 
+// addressed message of a secondary peer, lanes and mailbox are for the primary only
+void ESP32_RC_ESPNOW::recv_peer(ESP32_RC_Peer &from, const uint8_t *data, int data_len) {
+  uint8_t msg[_RC_MAX_PAYLOAD_LEN];
+  if (data_len < _RC_FRAME_OVERHEAD) {
+    from.recv_errors ++;
+    return;
+  }
+  if (!check_trailer(data, data_len, from)) return;
+  if (!decode_frame(data, data_len - _RC_FRAME_TRAILER_LEN, msg, from.caps)) {
+    from.recv_errors ++;
+    return;
+  }
+  from.received ++;
+  from.recv_queue.push_overwrite(msg);
+  signal_recv();
+}
@@ -0,0 +1,28 @@
+#include <ESP32_RC_Gatt.h>
+
+void ESP32_RC_GattPipe::reset(void) {
+  parser.reset();
+  writer.clear();
+}
+
+// full packets while there is enough, the tail in a packet of its own
+uint8_t ESP32_RC_GattPipe::flush(ESP32_RC_GattLink &link) {
+  while (writer.size() > 0) {
+    size_t len = link.packet_len();
+    if (len < _RC_GATT_MIN_PACKET) len = _RC_GATT_MIN_PACKET;
+    if (len > writer.size()) len = writer.size();
+
+    uint8_t result = link.put_packet(writer.data(), len);
+    if (result != ESP32_RC_GattLink::SENT) return result;
+    writer.consume(len);
+    packet_count ++;
+  }
+  return ESP32_RC_GattLink::SENT;
+}
+
+bool ESP32_RC_GattPipe::feed(const uint8_t *packet, size_t len, frameFuncType handler, void *context) {
+  while (parser.parse(packet, len)) {
+    handler(parser.frame(), parser.frame_len(), context);
+  }
+  return !parser.is_broken();
+}
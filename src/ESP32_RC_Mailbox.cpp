@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ESP32_RC_Mailbox.h>
+
+ESP32_RC_Mailbox::~ESP32_RC_Mailbox() {
+  free(buffer);
+}
+
+bool ESP32_RC_Mailbox::create(size_t item_len) {
+  stride    = (item_len + 7) & ~(size_t)7;                    // keep every buffer 8-byte aligned
+  item_size = item_len;
+  buffer    = (uint8_t *)calloc(3, stride);
+  back      = 0;
+  front     = 1;
+  middle.store(2);
+  return (buffer != nullptr);
+}
+
+
+/*
+ * ========================================================
+ * Writer side
+ * ========================================================
+ */
+void ESP32_RC_Mailbox::write(const void *item) {
+  memcpy(slot(back), item, item_size);
+  publish();
+}
+
+uint8_t *ESP32_RC_Mailbox::write_buffer(void) {
+  return slot(back);
+}
+
+// swap the filled buffer into the middle, take the old middle as next back buffer
+void ESP32_RC_Mailbox::publish(void) {
+  back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+
+/*
+ * ========================================================
+ * Reader side
+ * ========================================================
+ */
+const uint8_t *ESP32_RC_Mailbox::read_view(void) {
+  if (!is_fresh()) return nullptr;
+  front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+  return slot(front);
+}
+
+bool ESP32_RC_Mailbox::read(void *item) {
+  const uint8_t *data = read_view();
+  if (data == nullptr) return false;
+  memcpy(item, data, item_size);
+  return true;
+}
+
+void ESP32_RC_Mailbox::clear(void) {
+  middle.fetch_and((uint8_t)~FRESH, std::memory_order_acq_rel);
+}
+
+bool ESP32_RC_Mailbox::is_fresh(void) const {
+  return (middle.load(std::memory_order_acquire) & FRESH) != 0;
+}
@@ -0,0 +1,389 @@
+#include <ESP32_RC_NRF24.h>
+
+/*
+ * ========================================================
+ * SPI bus - HSPI
+ * ========================================================
+ */
+void ESP32_RC_Nrf24Spi::begin(void) {
+  pinMode(HSPI_CS, OUTPUT);
+  pinMode(NRF24_CE, OUTPUT);
+  digitalWrite(HSPI_CS, HIGH);
+  digitalWrite(NRF24_CE, LOW);
+  spi.begin(HSPI_SCLK, HSPI_MISO, HSPI_MOSI, HSPI_CS);
+}
+
+uint8_t ESP32_RC_Nrf24Spi::transfer(uint8_t cmd, const uint8_t *tx, uint8_t *rx, size_t len) {
+  spi.beginTransaction(SPISettings(_NRF24_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+  digitalWrite(HSPI_CS, LOW);
+  uint8_t status = spi.transfer(cmd);
+  for (size_t i = 0; i < len; i++) {
+    uint8_t value = spi.transfer((tx != nullptr) ? tx[i] : _NRF24_NOP);
+    if (rx != nullptr) rx[i] = value;
+  }
+  digitalWrite(HSPI_CS, HIGH);
+  spi.endTransaction();
+  return status;
+}
+
+
+/*
+ * ========================================================
+ * ESP32_RC_NRF24
+ * ========================================================
+ */
+ESP32_RC_NRF24::ESP32_RC_NRF24(bool fast_mode, bool debug_mode, size_t payload_len)
+  : ESP32RemoteControl(fast_mode, debug_mode, payload_len), radio_task(this) {
+  if (payload_len > MAX_PAYLOAD_LEN) {
+    _ERROR_("Payload length " + String((int)payload_len) + " > " + String((int)MAX_PAYLOAD_LEN));
+  }
+  memset(peer_key, 0, sizeof(peer_key));
+  memcpy(peer_key, _NRF24_ADDRESS, _NRF24_ADDR_LEN);
+}
+
+ESP32_RC_NRF24::~ESP32_RC_NRF24() {
+  stop_link_monitor();
+  stop_sender();
+  stop_receiver();
+
+  // let the radio task finish its poll, it ends itself
+  is_stopping.store(true);
+  while (radio_task.getHandle() != nullptr) {
+    _DELAY_(1);
+  }
+
+  if (heartbeat_timer != nullptr) {
+    xTimerStop(heartbeat_timer, 0);
+    xTimerDelete(heartbeat_timer, 0);
+  }
+  bus.set_ce(false);
+  if (radio_mutex != nullptr) vSemaphoreDelete(radio_mutex);
+}
+
+// Set up the SPI bus and the chip, it listens as PRX
+void ESP32_RC_NRF24::init(void) {
+  _DEBUG_("Initializing NRF24...");
+  bus.begin();
+  if (!radio.begin(&bus, (const uint8_t *)_NRF24_ADDRESS)) {
+    _ERROR_("No nRF24L01 on the SPI bus.");
+  }
+  _DEBUG_("NRF24 initialized.");
+
+  // Create queues
+  if (create_queues() == false) {
+    _ERROR_("Failed to create queues.");
+  }
+
+  // Create the mutex
+  mutex       = xSemaphoreCreateMutex();
+  radio_mutex = xSemaphoreCreateRecursiveMutex();
+
+  // Create Timer Tasks
+  // Messages are sent by send_task and received by radio_task. Only the heartbeat is timed.
+  heartbeat_timer = xTimerCreate("HeartBeatTimer",  heartbeat_period(), pdTRUE, this, heartbeat_timer_callback);
+
+  if (heartbeat_timer == NULL) {
+    _ERROR_("Failed to create timer");
+  }
+  _DEBUG_("Success.");
+}
+
+
+/*
+ * ========================================================
+ * connect - Override
+ *  - listen as PRX first, a hello heard there completes
+ *    the handshake, else become the PTX
+ *  - the roles stay, re-handshakes only say hello again
+ * ========================================================
+ */
+void ESP32_RC_NRF24::connect(void) {
+  _DEBUG_ ("Started.");
+  radio_task.start();
+
+  set_value(&connection_status, _STATUS_CONN_IN_PROG);
+  bool is_connected = wait_handshake(_NRF24_LISTEN_TIMEOUT + random(_NRF24_LISTEN_TIMEOUT));
+  if (!is_connected) {
+    set_role(ESP32_RC_Nrf24Radio::PTX);
+    _DEBUG_("Nobody heard, PTX.");
+  }
+
+  int attempt = 0;
+  int max_retry = 100;
+  while (!is_connected && attempt <= max_retry) {
+    attempt++;
+    if (handshake(_RC_HANDSHAKE_TIMEOUT) == true) break;
+    _DELAY_(10);
+    if (attempt >= max_retry ) {
+      _ERROR_ ("Failed. Attempts >= Max Retry (" + String(max_retry) + ")");
+    }
+  }
+
+  // start processing the send message queue.
+  set_value(&send_status, _STATUS_SEND_READY);
+
+  start_sender();
+  start_receiver();
+  xTimerStart(heartbeat_timer, 0);
+  start_link_monitor();
+  _DEBUG_("Success.");
+}
+
+void ESP32_RC_NRF24::set_role(uint8_t role) {
+  xSemaphoreTakeRecursive(radio_mutex, portMAX_DELAY);
+  radio.set_role(role);
+  xSemaphoreGiveRecursive(radio_mutex);
+}
+
+
+/*
+ * ========================================================
+ * Handshake two peers
+ *  - PTX: sent as a payload, PRX: in the next ack payload
+ *  - it should block send/send_queue_msg
+ * ========================================================
+ */
+bool ESP32_RC_NRF24::handshake(uint32_t timeout_ms) {
+  _DEBUG_("Started.");
+
+  // Lock the varible
+  set_value(&connection_status, _STATUS_CONN_IN_PROG);
+
+  op_send_ctrl(_RC_FRAME_HANDSHAKE);
+
+  // Wait Ack
+  if (wait_handshake(timeout_ms)) {
+    _DEBUG_("Success.");
+    return true;
+  }
+  handshake_failed();
+  _DEBUG_("Failed.");
+  return false;
+}
+
+
+/*
+ * ========================================================
+ * send - Override
+ * en-queue the message only
+ * ========================================================
+ */
+void ESP32_RC_NRF24::send(const void *data, uint8_t lane) {
+  if (lane >= _RC_LANE_COUNT) {
+    send_metric.err_count ++;
+    return;
+  }
+
+  // make sure handshake is completed successfully, blocking lanes wait for it
+  int status = 0;
+  get_value(&connection_status, &status);
+  while (status != _STATUS_CONN_OK) {
+    if (lanes[lane].policy != _RC_LANE_BLOCK || uses_mailbox(lane)) return;
+    _DELAY_(int( 1000/_ESP32_RC_DATA_RATE ));
+    get_value(&connection_status, &status);
+  }
+  enqueue(data, lane);
+}
+
+/*
+ * ========================================================
+ * send_queue_msg - Override
+ *  - a frame is DONE once the radio queued it, released
+ *    next round
+ *  - a full radio queue leaves it QUEUED, the radio task
+ *    drains the queue every _NRF24_POLL_PERIOD
+ * ========================================================
+ */
+void ESP32_RC_NRF24::send_queue_msg() {
+  bool is_busy = false;   // radio queue full
+
+  for (int slot = 0; slot < _RC_SEND_WINDOW_MAX; slot++) {
+    if (send_window.state(slot) == ESP32_RC_SendWindow::DONE) {
+      send_metric.out_count ++;
+      send_window.release(slot);
+    }
+  }
+
+  // strict priority: lane by lane, first the frames refused before, then new messages
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT && !is_busy; lane++) {
+    for (int slot = 0; slot < _RC_SEND_WINDOW_MAX && !is_busy; slot++) {
+      if (send_window.state(slot) == ESP32_RC_SendWindow::QUEUED && send_window.lane(slot) == lane) {
+        is_busy = !op_send(send_window.buffer(slot), slot);
+      }
+    }
+
+    int slot;
+    while (!is_busy && (slot = send_window.acquire(lane)) >= 0) {
+      if (!dequeue(lane, send_window.buffer(slot))) {
+        send_window.release(slot);
+        break;
+      }
+      is_busy = !op_send(send_window.buffer(slot), slot);
+    }
+  }
+
+  if (is_busy) _DELAY_(_NRF24_POLL_PERIOD);
+}
+
+// no window lock, nothing waits for a send-complete
+bool ESP32_RC_NRF24::op_send(const void *data, int slot) {
+  uint8_t frame[_MAX_MSG_LEN];
+  size_t frame_len = encode_frame(data, frame, sizeof(frame) - _RC_FRAME_TRAILER_LEN, peer_caps);
+  if (frame_len == 0) {
+    frame[0]  = _RC_FRAME_RAW;
+    memcpy(frame + _RC_FRAME_HEADER_LEN, data, payload_len);
+    frame_len = _RC_FRAME_HEADER_LEN + payload_len;
+  }
+  frame[0] |= (send_window.lane(slot) << _RC_FRAME_LANE_SHIFT);
+  frame_len  = add_trailer(frame, frame_len, send_window.seq(slot));
+
+  if (!radio_put(frame, frame_len)) return false;
+  send_window.mark(slot, ESP32_RC_SendWindow::DONE);
+  return true;
+}
+
+// Send control frame (HANDSHAKE, HEARTBEAT ...), no delta as with WiFi
+bool ESP32_RC_NRF24::op_send_ctrl(uint8_t type) {
+  uint8_t frame[_RC_CTRL_FRAME_LEN];
+  size_t frame_len = create_ctrl_frame(type, frame);
+  if (type == _RC_FRAME_HANDSHAKE || type == _RC_FRAME_HANDSHAKE_ACK) {
+    frame[1] &= ~_RC_CAP_DELTA;
+  }
+  return op_send_ctrl(frame, frame_len);
+}
+
+bool ESP32_RC_NRF24::op_send_ctrl(const uint8_t *frame, size_t frame_len) {
+  return radio_put(frame, frame_len);
+}
+
+bool ESP32_RC_NRF24::radio_put(const uint8_t *frame, size_t frame_len) {
+  xSemaphoreTakeRecursive(radio_mutex, portMAX_DELAY);
+  bool is_put = radio.put(frame, frame_len);
+  xSemaphoreGiveRecursive(radio_mutex);
+  return is_put;
+}
+
+/*
+ * ========================================================
+ * recv - Override
+ * ========================================================
+ */
+bool ESP32_RC_NRF24::recv(void *data) {
+  RecvView view;
+  if (!recv_view(view)) return false;
+  memcpy(data, view.data, payload_len);
+  release(view);
+  return true;
+}
+
+
+/*
+ * ========================================================
+ * Radio task
+ *  - the only task on the SPI bus
+ *  - frames are handled inside poll(), answers are queued
+ *    with the mutex held, it is recursive
+ * ========================================================
+ */
+ESP32_RC_Nrf24Task::ESP32_RC_Nrf24Task(ESP32_RC_NRF24 *rc)
+  : Task("ESP32_RC_Nrf24", _NRF24_TASK_STACK, _NRF24_TASK_PRIORITY), rc(rc) {
+  setCore(_NRF24_TASK_CORE);
+}
+
+void ESP32_RC_Nrf24Task::run(void *data) {
+  rc->radio_loop();
+}
+
+void ESP32_RC_NRF24::radio_loop(void) {
+  while (!is_stopping.load()) {
+    xSemaphoreTakeRecursive(radio_mutex, portMAX_DELAY);
+    radio.poll(on_frame, this);
+    xSemaphoreGiveRecursive(radio_mutex);
+    _DELAY_(_NRF24_POLL_PERIOD);
+  }
+}
+
+void ESP32_RC_NRF24::on_frame(const uint8_t *frame, size_t frame_len, void *context) {
+  ESP32_RC_NRF24 *rc = static_cast<ESP32_RC_NRF24 *>(context);
+  rc->on_datarecv(frame, frame_len, micros());
+}
+
+void ESP32_RC_NRF24::on_datarecv(const uint8_t *data, int data_len, uint32_t rx_us) {
+  int status;
+
+  if (data_len < 1) {
+    recv_metric.err_count ++;
+    return;
+  }
+  link_alive();                           // only the peer is on the pipe
+
+  get_value(&connection_status, &status);
+
+  switch (_RC_FRAME_KIND(data[0])) {
+    // Handshake Hello received and send Ack
+    // also completes our own handshake, both sides may re-handshake at once after a link loss
+    case _RC_FRAME_HANDSHAKE:
+      peers.set_primary(peer_key);
+      peer_caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+      handshake_done();
+      op_send_ctrl(_RC_FRAME_HANDSHAKE_ACK);
+      empty_send_queue();
+      if (status == _STATUS_CONN_IN_PROG) set_value(&connection_status, _STATUS_CONN_OK);
+      return;
+
+    // check if handshake in progress, and process Ack
+    case _RC_FRAME_HANDSHAKE_ACK:
+      if (status != _STATUS_CONN_IN_PROG) return;
+      peers.set_primary(peer_key);
+      peer_caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+      handshake_done();
+      empty_send_queue();
+      empty_recv_queue();
+      set_value(&connection_status, _STATUS_CONN_OK);
+      return;
+
+    // received heartbeat, then return heartbeat Ack with our timestamps
+    case _RC_FRAME_HEARTBEAT: {
+      uint8_t ack[_RC_CTRL_FRAME_LEN];
+      op_send_ctrl(ack, create_heartbeat_ack(data, data_len, rx_us, ack));
+      return;
+    }
+
+    // received heart beat ack, heart beat cycle completed, then turn off the LED
+    case _RC_FRAME_HEARTBEAT_ACK:
+      on_heartbeat_ack(data, data_len, rx_us);
+      digitalWrite(BUILTIN_LED, LOW);
+      return;
+
+    // regular message
+    case _RC_FRAME_RAW:
+    case _RC_FRAME_COMPACT:
+    case _RC_FRAME_KEY:
+    case _RC_FRAME_DELTA:
+      if (status != _STATUS_CONN_OK) return;
+      recv_data_frame(data, data_len);
+      return;
+
+    default:
+      recv_metric.err_count ++;
+      return;
+  }
+}
+
+
+void ESP32_RC_NRF24::heartbeat_timer_callback(TimerHandle_t xTimer) {
+  ESP32_RC_NRF24 *rc = static_cast<ESP32_RC_NRF24 *>(pvTimerGetTimerID(xTimer));
+  rc->op_send_ctrl(_RC_FRAME_HEARTBEAT);
+  digitalWrite(BUILTIN_LED, HIGH);
+}
+
+
+/*
+ * ========================================================
+ * run - Override
+ * ========================================================
+ */
+
+void ESP32_RC_NRF24::run(void* data) {
+  connect();
+}
@@ -0,0 +1,125 @@
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <ESP32_RC_Net.h>
+
+ESP32_RC_NetLoop::ESP32_RC_NetLoop() {
+  for (int i = 0; i < _RC_NET_MAX_SOCKETS; i++) {
+    fds[i].store(-1);
+    interest[i].store(0);
+  }
+  memset(&wake_addr, 0, sizeof(wake_addr));
+}
+
+ESP32_RC_NetLoop::~ESP32_RC_NetLoop() {
+  if (wake_sock >= 0) close(wake_sock);
+}
+
+// the wake-up socket sends to itself over loopback
+bool ESP32_RC_NetLoop::create(eventFuncType handler, void *context) {
+  this->handler = handler;
+  this->context = context;
+  is_stopping.store(false);
+  if (wake_sock >= 0) return true;
+
+  wake_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (wake_sock < 0) return false;
+  fcntl(wake_sock, F_SETFL, fcntl(wake_sock, F_GETFL, 0) | O_NONBLOCK);
+
+  socklen_t addr_len = sizeof(wake_addr);
+  wake_addr.sin_family      = AF_INET;
+  wake_addr.sin_port        = 0;                            // any free port
+  wake_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(wake_sock, (struct sockaddr *)&wake_addr, sizeof(wake_addr)) < 0
+      || getsockname(wake_sock, (struct sockaddr *)&wake_addr, &addr_len) < 0) {
+    close(wake_sock);
+    wake_sock = -1;
+    return false;
+  }
+  return true;
+}
+
+bool ESP32_RC_NetLoop::watch(int fd, uint8_t events) {
+  if (fd < 0) return false;
+  for (int i = 0; i < _RC_NET_MAX_SOCKETS; i++) {
+    if (fds[i].load() != fd) continue;
+    if (events == 0) {
+      fds[i].store(-1);
+    } else if (interest[i].exchange(events) == events) {
+      return true;                                          // no change, no need to wake
+    }
+    wake();
+    return true;
+  }
+  if (events == 0) return true;
+
+  for (int i = 0; i < _RC_NET_MAX_SOCKETS; i++) {
+    int expected = -1;
+    if (fds[i].compare_exchange_strong(expected, fd)) {
+      interest[i].store(events);                            // a stale set in between is fixed by the wake-up
+      wake();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ESP32_RC_NetLoop::wake(void) {
+  if (wake_sock < 0) return;
+  uint8_t signal = 0;
+  sendto(wake_sock, &signal, 1, 0, (struct sockaddr *)&wake_addr, sizeof(wake_addr));
+}
+
+void ESP32_RC_NetLoop::stop(void) {
+  is_stopping.store(true);
+  wake();
+}
+
+void ESP32_RC_NetLoop::run(void) {
+  int watched[_RC_NET_MAX_SOCKETS];
+  uint8_t drain[16];
+
+  while (!is_stopping.load()) {
+    fd_set readable;
+    fd_set writable;
+    FD_ZERO(&readable);
+    FD_ZERO(&writable);
+    FD_SET(wake_sock, &readable);
+    int max_fd = wake_sock;
+    for (int i = 0; i < _RC_NET_MAX_SOCKETS; i++) {
+      watched[i]     = fds[i].load();
+      uint8_t events = interest[i].load();
+      if (watched[i] < 0) continue;
+      if (events & READ)  FD_SET(watched[i], &readable);
+      if (events & WRITE) FD_SET(watched[i], &writable);
+      if (watched[i] > max_fd) max_fd = watched[i];
+    }
+
+    // no timeout, wake() breaks the wait whenever the set changes
+    int ready = select(max_fd + 1, &readable, &writable, nullptr, nullptr);
+    if (ready < 0) {
+      if (errno == EBADF) drop_closed(watched);
+      else if (errno != EINTR) usleep(_RC_NET_ERROR_BACKOFF * 1000);
+      continue;
+    }
+    if (ready == 0) continue;
+
+    if (FD_ISSET(wake_sock, &readable)) {
+      while (recv(wake_sock, drain, sizeof(drain), 0) > 0) {}
+    }
+    for (int i = 0; i < _RC_NET_MAX_SOCKETS; i++) {
+      if (watched[i] < 0) continue;
+      uint8_t events = (FD_ISSET(watched[i], &readable) ? READ : 0) | (FD_ISSET(watched[i], &writable) ? WRITE : 0);
+      if (events != 0) handler(watched[i], events, context);
+    }
+  }
+}
+
+// F_GETFL, lwIP has no F_GETFD. A slot changed since select() is left alone.
+void ESP32_RC_NetLoop::drop_closed(const int *watched) {
+  for (int i = 0; i < _RC_NET_MAX_SOCKETS; i++) {
+    int fd = watched[i];
+    if (fd < 0 || fcntl(fd, F_GETFL, 0) >= 0 || errno != EBADF) continue;
+    fds[i].compare_exchange_strong(fd, -1);
+  }
+}
@@ -0,0 +1,173 @@
+#include <string.h>
+#include <ESP32_RC_Nrf24Radio.h>
+
+// 2 Mbps, dynamic payloads, ack payloads on pipe 0, the same address for both roles
+bool ESP32_RC_Nrf24Radio::begin(ESP32_RC_Nrf24Bus *bus, const uint8_t *addr, uint8_t channel) {
+  this->bus = bus;
+  bus->set_ce(false);
+
+  write_reg(_NRF24_REG_SETUP_AW, _NRF24_ADDR_LEN - 2);
+  if (read_reg(_NRF24_REG_SETUP_AW) != _NRF24_ADDR_LEN - 2) return false;  // nothing on the bus
+
+  write_reg(_NRF24_REG_EN_AA, 0x01);
+  write_reg(_NRF24_REG_EN_RXADDR, 0x01);
+  write_reg(_NRF24_REG_SETUP_RETR, (_NRF24_RETRY_DELAY << 4) | _NRF24_RETRIES);
+  write_reg(_NRF24_REG_RF_CH, channel);
+  write_reg(_NRF24_REG_RF_SETUP, _NRF24_RF_DR_2M | _NRF24_RF_PWR_MAX);
+  write_reg(_NRF24_REG_RX_ADDR_P0, addr, _NRF24_ADDR_LEN);  // the PTX gets its acks on pipe 0
+  write_reg(_NRF24_REG_TX_ADDR, addr, _NRF24_ADDR_LEN);
+
+  uint8_t feature = _NRF24_FEATURE_EN_DPL | _NRF24_FEATURE_EN_ACK_PAY;
+  write_reg(_NRF24_REG_FEATURE, feature);
+  if (read_reg(_NRF24_REG_FEATURE) != feature) {
+    uint8_t key = 0x73;
+    bus->transfer(_NRF24_ACTIVATE, &key, nullptr, 1);
+    write_reg(_NRF24_REG_FEATURE, feature);
+  }
+  write_reg(_NRF24_REG_DYNPD, 0x01);
+
+  set_role(role);
+  return true;
+}
+
+void ESP32_RC_Nrf24Radio::set_role(uint8_t role) {
+  this->role = role;
+  bus->set_ce(false);
+  config = _NRF24_CONFIG_EN_CRC | _NRF24_CONFIG_CRCO | _NRF24_CONFIG_PWR_UP | ((role == PRX) ? _NRF24_CONFIG_PRIM_RX : 0);
+  write_reg(_NRF24_REG_CONFIG, config);
+  command(_NRF24_FLUSH_TX);
+  command(_NRF24_FLUSH_RX);
+  write_reg(_NRF24_REG_STATUS, _NRF24_STATUS_RX_DR | _NRF24_STATUS_TX_DS | _NRF24_STATUS_MAX_RT);
+
+  if (out_offset > 0) drop_head();        // its first pieces were flushed
+  is_skipping = true;
+  bus->set_ce(true);                      // PRX listens, PTX sends whenever the TX FIFO has a payload
+}
+
+bool ESP32_RC_Nrf24Radio::put(const uint8_t *frame, size_t frame_len) {
+  return out.put(frame, frame_len);
+}
+
+/*
+ * ========================================================
+ * poll
+ *  - one STATUS read when there is nothing to do
+ *  - TX_FULL and RX_P_NO come with every command (as they
+ *    were before it), FIFO_STATUS is not needed
+ * ========================================================
+ */
+void ESP32_RC_Nrf24Radio::poll(frameFuncType handler, void *context) {
+  uint8_t status = command(_NRF24_NOP);
+
+  if (status & _NRF24_STATUS_MAX_RT) {
+    command(_NRF24_FLUSH_TX);
+    if (out_offset > 0) drop_head();
+    lost_count ++;
+  }
+  if (status & (_NRF24_STATUS_MAX_RT | _NRF24_STATUS_TX_DS | _NRF24_STATUS_RX_DR)) {
+    status = write_reg(_NRF24_REG_STATUS, status & (_NRF24_STATUS_MAX_RT | _NRF24_STATUS_TX_DS | _NRF24_STATUS_RX_DR));
+  }
+
+  status = receive(status, handler, context);
+  status = refill(status);
+
+  // PTX with nothing to send: poll, the PRX may have frames for us in its ack payloads
+  if (role == PTX && out.size() == 0 && (read_reg(_NRF24_REG_FIFO_STATUS) & _NRF24_FIFO_TX_EMPTY)) {
+    uint8_t poll = _NRF24_FRAG_POLL;
+    bus->transfer(_NRF24_W_TX_PAYLOAD, &poll, nullptr, 1);
+    payload_count ++;
+  }
+}
+
+uint8_t ESP32_RC_Nrf24Radio::receive(uint8_t status, frameFuncType handler, void *context) {
+  uint8_t payload[_NRF24_PAYLOAD_LEN];
+  while ((status & _NRF24_STATUS_RX_P_NO) != _NRF24_STATUS_RX_P_NO) {
+    uint8_t len = 0;
+    bus->transfer(_NRF24_R_RX_PL_WID, nullptr, &len, 1);
+    if (len == 0 || len > _NRF24_PAYLOAD_LEN) {           // corrupt, the datasheet says flush
+      status = command(_NRF24_FLUSH_RX);
+      is_skipping = true;
+      break;
+    }
+    status = bus->transfer(_NRF24_R_RX_PAYLOAD, nullptr, payload, len);
+    on_fragment(payload, len, handler, context);
+    status = command(_NRF24_NOP);                         // RX_P_NO of the next payload
+  }
+  return status;
+}
+
+// PTX: payloads, PRX: ack payloads of pipe 0
+uint8_t ESP32_RC_Nrf24Radio::refill(uint8_t status) {
+  uint8_t payload[_NRF24_PAYLOAD_LEN];
+  uint8_t cmd = (role == PRX) ? (_NRF24_W_ACK_PAYLOAD | 0) : _NRF24_W_TX_PAYLOAD;
+
+  while (!(status & _NRF24_STATUS_TX_FULL) && out.size() > 0) {
+    const uint8_t *head = out.data();
+    size_t head_len     = head[0] | (head[1] << 8);
+    size_t chunk        = head_len - out_offset;
+    if (chunk > _NRF24_FRAG_DATA) chunk = _NRF24_FRAG_DATA;
+    bool is_last        = (out_offset + chunk == head_len);
+
+    payload[0] = out_index | (out_frame << _NRF24_FRAG_FRAME_SHIFT) | (is_last ? _NRF24_FRAG_LAST : 0);
+    memcpy(payload + 1, head + _RC_STREAM_HEADER_LEN + out_offset, chunk);
+    bus->transfer(cmd, payload, nullptr, chunk + 1);
+    payload_count ++;
+    status = command(_NRF24_NOP);         // STATUS comes before the command, TX_FULL of the write is in the next one
+
+    out_offset += chunk;
+    out_index ++;
+    if (is_last) drop_head();
+  }
+  return status;
+}
+
+void ESP32_RC_Nrf24Radio::on_fragment(const uint8_t *payload, size_t len, frameFuncType handler, void *context) {
+  if (payload[0] == _NRF24_FRAG_POLL) return;
+
+  uint8_t index = payload[0] & _NRF24_FRAG_INDEX;
+  uint8_t id    = payload[0] & _NRF24_FRAG_FRAME;
+  if (index == 0) {
+    if (!is_skipping && frame_index > 0) broken_count ++;  // the rest of the last frame never came
+    frame_len   = 0;
+    frame_index = 0;
+    frame_id    = id;
+    is_skipping = false;
+  }
+  if (is_skipping) return;
+  if (index != frame_index || id != frame_id || frame_len + len - 1 > sizeof(frame)) {
+    broken_count ++;
+    is_skipping = true;
+    return;
+  }
+
+  memcpy(frame + frame_len, payload + 1, len - 1);
+  frame_len += len - 1;
+  frame_index ++;
+  if (payload[0] & _NRF24_FRAG_LAST) {
+    frame_index = 0;
+    is_skipping = true;                   // until the next index 0
+    handler(frame, frame_len, context);
+  }
+}
+
+void ESP32_RC_Nrf24Radio::drop_head(void) {
+  const uint8_t *head = out.data();
+  out.consume(_RC_STREAM_HEADER_LEN + (head[0] | (head[1] << 8)));
+  out_offset = 0;
+  out_index  = 0;
+  out_frame  = (out_frame + 1) & (_NRF24_FRAG_FRAME >> _NRF24_FRAG_FRAME_SHIFT);
+}
+
+uint8_t ESP32_RC_Nrf24Radio::read_reg(uint8_t reg) {
+  uint8_t value = 0;
+  bus->transfer(_NRF24_R_REGISTER | reg, nullptr, &value, 1);
+  return value;
+}
+
+uint8_t ESP32_RC_Nrf24Radio::write_reg(uint8_t reg, uint8_t value) {
+  return bus->transfer(_NRF24_W_REGISTER | reg, &value, nullptr, 1);
+}
+
+uint8_t ESP32_RC_Nrf24Radio::write_reg(uint8_t reg, const uint8_t *data, size_t len) {
+  return bus->transfer(_NRF24_W_REGISTER | reg, data, nullptr, len);
+}
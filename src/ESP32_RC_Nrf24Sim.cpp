@@ -0,0 +1,185 @@
+#include <string.h>
+#include <ESP32_RC_Nrf24Sim.h>
+
+// reset values of the datasheet, as far as the driver reads them
+ESP32_RC_Nrf24Sim::ESP32_RC_Nrf24Sim() {
+  memset(regs, 0, sizeof(regs));
+  regs[_NRF24_REG_CONFIG]     = _NRF24_CONFIG_EN_CRC;
+  regs[_NRF24_REG_SETUP_AW]   = 0x03;
+  regs[_NRF24_REG_SETUP_RETR] = 0x03;
+  regs[_NRF24_REG_RF_CH]      = 0x02;
+  memset(tx_addr, 0xE7, sizeof(tx_addr));
+  memset(rx_addr, 0xE7, sizeof(rx_addr));
+}
+
+void ESP32_RC_Nrf24Sim::link(ESP32_RC_Nrf24Sim *peer) {
+  this->peer = peer;
+  peer->peer = this;
+}
+
+void ESP32_RC_Nrf24Sim::set_loss(uint32_t per_mille, uint32_t seed) {
+  loss       = per_mille;
+  rand_state = seed ? seed : 1;
+}
+
+bool ESP32_RC_Nrf24Sim::Fifo::push(const uint8_t *data, size_t len) {
+  if (count == _NRF24_FIFO_DEPTH) return false;
+  Payload &item = items[(head + count) % _NRF24_FIFO_DEPTH];
+  item.len = len;
+  memcpy(item.data, data, len);
+  count ++;
+  return true;
+}
+
+uint8_t ESP32_RC_Nrf24Sim::status(void) {
+  uint8_t value = regs[_NRF24_REG_STATUS] & (_NRF24_STATUS_RX_DR | _NRF24_STATUS_TX_DS | _NRF24_STATUS_MAX_RT);
+  value |= (rx_fifo.count == 0) ? _NRF24_STATUS_RX_P_NO : 0;   // pipe 0 otherwise
+  value |= (tx_fifo.count == _NRF24_FIFO_DEPTH) ? _NRF24_STATUS_TX_FULL : 0;
+  return value;
+}
+
+uint8_t ESP32_RC_Nrf24Sim::fifo_status(void) {
+  return ((rx_fifo.count == 0) ? _NRF24_FIFO_RX_EMPTY : 0)
+       | ((rx_fifo.count == _NRF24_FIFO_DEPTH) ? 0x02 : 0)
+       | ((tx_fifo.count == 0) ? _NRF24_FIFO_TX_EMPTY : 0)
+       | ((tx_fifo.count == _NRF24_FIFO_DEPTH) ? 0x20 : 0);
+}
+
+uint8_t ESP32_RC_Nrf24Sim::transfer(uint8_t cmd, const uint8_t *tx, uint8_t *rx, size_t len) {
+  now += (1 + len) * _NRF24_SIM_BYTE_US;
+  run_air();
+  uint8_t value = status();
+
+  if (cmd == _NRF24_NOP) return value;
+  if ((cmd & 0xE0) == _NRF24_R_REGISTER || (cmd & 0xE0) == _NRF24_W_REGISTER) {
+    uint8_t reg     = cmd & 0x1F;
+    bool is_write   = (cmd & 0xE0) == _NRF24_W_REGISTER;
+    uint8_t *target = (reg == _NRF24_REG_TX_ADDR) ? tx_addr : (reg == _NRF24_REG_RX_ADDR_P0) ? rx_addr : &regs[reg];
+    size_t width    = (target == &regs[reg]) ? 1 : _NRF24_ADDR_LEN;
+    if (len > width) len = width;
+
+    if (!is_write) {
+      if (reg == _NRF24_REG_STATUS)      target[0] = status();
+      if (reg == _NRF24_REG_FIFO_STATUS) target[0] = fifo_status();
+      if (rx != nullptr) memcpy(rx, target, len);
+    } else if (reg == _NRF24_REG_STATUS) {
+      regs[reg] &= ~(tx[0] & (_NRF24_STATUS_RX_DR | _NRF24_STATUS_TX_DS | _NRF24_STATUS_MAX_RT));  // write 1 to clear
+    } else if (reg != _NRF24_REG_FIFO_STATUS) {
+      memcpy(target, tx, len);
+    }
+    return value;
+  }
+
+  switch (cmd) {
+    case _NRF24_R_RX_PL_WID:
+      if (rx != nullptr) rx[0] = (rx_fifo.count > 0) ? rx_fifo.front().len : 0;
+      break;
+    case _NRF24_R_RX_PAYLOAD:
+      if (rx_fifo.count > 0) {
+        if (rx != nullptr) memcpy(rx, rx_fifo.front().data, (len < rx_fifo.front().len) ? len : rx_fifo.front().len);
+        rx_fifo.pop();
+      }
+      break;
+    case _NRF24_W_TX_PAYLOAD:
+    case _NRF24_W_ACK_PAYLOAD:
+      if (tx_fifo.count == 0 && tx_free < now) tx_free = now;  // idle until now
+      if (len > 0 && len <= _NRF24_PAYLOAD_LEN) tx_fifo.push(tx, len);
+      break;
+    case _NRF24_FLUSH_TX:
+      tx_fifo.clear();
+      is_ack_sent = false;
+      break;
+    case _NRF24_FLUSH_RX:
+      rx_fifo.clear();
+      break;
+    default:                              // ACTIVATE, FEATURE is always unlocked
+      break;
+  }
+  return value;
+}
+
+bool ESP32_RC_Nrf24Sim::is_listening(void) {
+  uint8_t config = regs[_NRF24_REG_CONFIG];
+  return ce && (config & _NRF24_CONFIG_PWR_UP) && (config & _NRF24_CONFIG_PRIM_RX);
+}
+
+/*
+ * ========================================================
+ * Air
+ *  - PTX, CE high: the TX FIFO goes out packet by packet,
+ *    ARC retransmits each, ARD apart, then MAX_RT stops it
+ *  - a packet starts when the radio is free, tx_free moves
+ *    on by the time it takes
+ *  - the PRX acks with the head of its TX FIFO
+ * ========================================================
+ */
+void ESP32_RC_Nrf24Sim::run_air(void) {
+  uint8_t config = regs[_NRF24_REG_CONFIG];
+  if (!ce || !(config & _NRF24_CONFIG_PWR_UP) || (config & _NRF24_CONFIG_PRIM_RX)) return;
+
+  uint32_t retries  = regs[_NRF24_REG_SETUP_RETR] & 0x0F;
+  uint32_t delay_us = ((regs[_NRF24_REG_SETUP_RETR] >> 4) + 1) * 250;
+
+  while (tx_fifo.count > 0 && tx_free <= now && !(regs[_NRF24_REG_STATUS] & _NRF24_STATUS_MAX_RT)) {
+    Payload &packet = tx_fifo.front();
+    Payload ack;
+    bool is_acked = false;
+    uint64_t start = air_time;
+    for (uint32_t attempt = 0; attempt <= retries && !is_acked; attempt++) {
+      air_time += _NRF24_SIM_SETTLE_US + _NRF24_SIM_PACKET_BITS(packet.len) / 2;
+      bool is_heard = !is_lost() && peer != nullptr && peer->is_listening()
+                      && peer->regs[_NRF24_REG_RF_CH] == regs[_NRF24_REG_RF_CH]
+                      && memcmp(peer->rx_addr, tx_addr, _NRF24_ADDR_LEN) == 0;
+      if (is_heard && peer->on_air(packet, pid, ack) && !is_lost()) {
+        air_time += _NRF24_SIM_SETTLE_US + _NRF24_SIM_PACKET_BITS(ack.len) / 2;
+        is_acked  = true;
+      } else {
+        air_time += delay_us;
+      }
+    }
+    tx_free += air_time - start;
+    if (!is_acked) {
+      regs[_NRF24_REG_STATUS] |= _NRF24_STATUS_MAX_RT;   // the payload stays in the FIFO
+      return;
+    }
+
+    tx_fifo.pop();
+    pid = (pid + 1) & 0x03;
+    regs[_NRF24_REG_STATUS] |= _NRF24_STATUS_TX_DS;
+    if (ack.len > 0 && rx_fifo.push(ack.data, ack.len)) {
+      regs[_NRF24_REG_STATUS] |= _NRF24_STATUS_RX_DR;
+    }
+  }
+}
+
+// a full RX FIFO takes nothing and sends no ack, the PTX retries
+bool ESP32_RC_Nrf24Sim::on_air(const Payload &packet, uint8_t packet_pid, Payload &ack) {
+  // PID and CRC, the same PID after a MAX_RT flush still carries a new payload
+  bool is_new = (packet_pid != last_pid || packet.len != last_packet.len
+                 || memcmp(packet.data, last_packet.data, packet.len) != 0);
+  if (is_new) {
+    if (rx_fifo.count == _NRF24_FIFO_DEPTH) return false;
+    if (is_ack_sent) {                    // a new PID, the last ack arrived
+      tx_fifo.pop();
+      is_ack_sent = false;
+      regs[_NRF24_REG_STATUS] |= _NRF24_STATUS_TX_DS;
+    }
+    rx_fifo.push(packet.data, packet.len);
+    last_pid    = packet_pid;
+    last_packet = packet;
+    regs[_NRF24_REG_STATUS] |= _NRF24_STATUS_RX_DR;
+  }
+
+  ack.len = 0;
+  if (tx_fifo.count > 0) {
+    ack         = tx_fifo.front();
+    is_ack_sent = true;
+  }
+  return true;
+}
+
+bool ESP32_RC_Nrf24Sim::is_lost(void) {
+  if (loss == 0) return false;
+  rand_state = rand_state * 1103515245 + 12345;
+  return ((rand_state >> 16) % 1000) < loss;
+}
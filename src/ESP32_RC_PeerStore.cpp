@@ -0,0 +1,28 @@
+#include <Preferences.h>
+#include <ESP32_RC_PeerStore.h>
+
+bool ESP32_RC_NvsPeerStore::load(uint8_t *mac_addr, uint8_t &channel) {
+  Preferences prefs;
+  if (!prefs.begin(_RC_NVS_NAMESPACE, true)) return false;  // read-only, fails if never written
+  bool is_found = (prefs.getBytes("peer_addr", mac_addr, _RC_PEER_ADDR_LEN) == _RC_PEER_ADDR_LEN);
+  channel       = prefs.getUChar("peer_channel", 0);
+  prefs.end();
+  return is_found && channel != 0;
+}
+
+bool ESP32_RC_NvsPeerStore::save(const uint8_t *mac_addr, uint8_t channel) {
+  Preferences prefs;
+  if (!prefs.begin(_RC_NVS_NAMESPACE, false)) return false;
+  bool is_saved = (prefs.putBytes("peer_addr", mac_addr, _RC_PEER_ADDR_LEN) == _RC_PEER_ADDR_LEN)
+               && (prefs.putUChar("peer_channel", channel) == 1);
+  prefs.end();
+  return is_saved;
+}
+
+void ESP32_RC_NvsPeerStore::clear(void) {
+  Preferences prefs;
+  if (!prefs.begin(_RC_NVS_NAMESPACE, false)) return;
+  prefs.remove("peer_addr");
+  prefs.remove("peer_channel");
+  prefs.end();
+}
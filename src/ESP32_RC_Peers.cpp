@@ -0,0 +1,161 @@
+#include <string.h>
+#include <ESP32_RC_Peers.h>
+
+ESP32_RC_PeerTable::ESP32_RC_PeerTable() {
+  memset(index, -1, sizeof(index));                           // find() is safe before create()
+}
+
+ESP32_RC_PeerTable::~ESP32_RC_PeerTable() {
+  if (mutex != nullptr) vSemaphoreDelete(mutex);
+}
+
+bool ESP32_RC_PeerTable::create(size_t item_len) {
+  item_size = item_len;
+  mutex     = xSemaphoreCreateMutex();
+  memset(index, -1, sizeof(index));
+  return (mutex != nullptr);
+}
+
+void ESP32_RC_PeerTable::lock(void) {
+  if (mutex != nullptr) xSemaphoreTake(mutex, portMAX_DELAY);
+  version.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void ESP32_RC_PeerTable::unlock(void) {
+  version.fetch_add(1, std::memory_order_release);
+  if (mutex != nullptr) xSemaphoreGive(mutex);
+}
+
+// FNV-1a, the low bits pick the bucket
+uint32_t ESP32_RC_PeerTable::hash(const uint8_t *mac_addr) {
+  uint32_t value = 2166136261UL;
+  for (int i = 0; i < _RC_PEER_ADDR_LEN; i++) {
+    value = (value ^ mac_addr[i]) * 16777619UL;
+  }
+  return value;
+}
+
+
+/*
+ * ========================================================
+ * Index
+ *  - never full, at least half of the buckets are empty,
+ *    so every probe ends after a few steps
+ *  - find() may read it while a writer rebuilds it, the probe
+ *    is bounded and the result is thrown away then
+ * ========================================================
+ */
+int ESP32_RC_PeerTable::probe(const uint8_t *mac_addr) const {
+  int bucket = hash(mac_addr) & (_RC_PEER_INDEX_SIZE - 1);
+  for (int step = 0; step < _RC_PEER_INDEX_SIZE; step++) {
+    int id = index[bucket];
+    if (id < 0 || memcmp(peers[id].mac_addr, mac_addr, _RC_PEER_ADDR_LEN) == 0) return bucket;
+    bucket = (bucket + 1) & (_RC_PEER_INDEX_SIZE - 1);
+  }
+  return -1;
+}
+
+void ESP32_RC_PeerTable::rebuild_index(void) {
+  memset(index, -1, sizeof(index));
+  for (int id = 0; id < _RC_MAX_PEERS; id++) {
+    if (peers[id].is_used) index[probe(peers[id].mac_addr)] = id;
+  }
+}
+
+int ESP32_RC_PeerTable::find(const uint8_t *mac_addr) {
+  for (int attempt = 0; attempt < _RC_PEER_READ_TRIES; attempt++) {
+    uint32_t before = version.load(std::memory_order_acquire);
+    if (before & 1) continue;                                 // a writer is at it
+    int bucket = probe(mac_addr);
+    int id     = (bucket >= 0) ? index[bucket] : _RC_PEER_NONE;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version.load(std::memory_order_relaxed) == before) return id;
+  }
+  return _RC_PEER_BUSY;
+}
+
+
+/*
+ * ========================================================
+ * Entries
+ * ========================================================
+ */
+void ESP32_RC_PeerTable::set_primary(const uint8_t *mac_addr) {
+  lock();
+  int id = index[probe(mac_addr)];
+  if (id != _RC_PEER_PRIMARY) {
+    if (id > 0) peers[id].is_used = false;                    // promoted from secondary
+    memcpy(peers[_RC_PEER_PRIMARY].mac_addr, mac_addr, _RC_PEER_ADDR_LEN);
+    peers[_RC_PEER_PRIMARY].is_used = true;
+    rebuild_index();
+  }
+  unlock();
+}
+
+int ESP32_RC_PeerTable::add(const uint8_t *mac_addr, uint32_t now_ms) {
+  lock();
+  int bucket = probe(mac_addr);
+  int id     = index[bucket];
+  if (id < 0) {
+    for (int i = 1; i < _RC_MAX_PEERS; i++) {
+      if (!peers[i].is_used) {
+        id = i;
+        break;
+      }
+    }
+  }
+  if (id <= _RC_PEER_PRIMARY) {                               // table full, or it is the primary
+    unlock();
+    return (id == _RC_PEER_PRIMARY) ? _RC_PEER_PRIMARY : _RC_PEER_NONE;
+  }
+
+  ESP32_RC_Peer &peer = peers[id];
+  if (!peer.send_queue.is_created()) {
+    if (!peer.send_queue.create(_RC_PEER_QUEUE_DEPTH, item_size) || !peer.recv_queue.create(_RC_PEER_QUEUE_DEPTH, item_size)) {
+      unlock();
+      return _RC_PEER_NONE;
+    }
+  }
+
+  // new or rebooted peer, start over
+  memcpy(peer.mac_addr, mac_addr, _RC_PEER_ADDR_LEN);
+  peer.caps   = 0;
+  peer.sent   = peer.send_errors = 0;
+  peer.received = peer.recv_errors = 0;
+  peer.send_queue.clear();
+  peer.recv_queue.clear();
+  peer.stats.reset();
+  peer.last_rx_ms.store(now_ms);
+  peer.link_state.store(_RC_LINK_UP);
+  peer.is_used = true;
+  index[bucket] = id;
+  unlock();
+  return id;
+}
+
+void ESP32_RC_PeerTable::remove(int id) {
+  if (!is_used(id)) return;
+  lock();
+  peers[id].is_used = false;
+  if (peers[id].send_queue.is_created()) {
+    peers[id].send_queue.clear();
+    peers[id].recv_queue.clear();
+  }
+  rebuild_index();
+  unlock();
+}
+
+int ESP32_RC_PeerTable::count(void) const {
+  int used = 0;
+  for (int id = 0; id < _RC_MAX_PEERS; id++) {
+    if (peers[id].is_used) used ++;
+  }
+  return used;
+}
+
+bool ESP32_RC_PeerTable::has_pending_send(void) const {
+  for (int id = 1; id < _RC_MAX_PEERS; id++) {
+    if (peers[id].is_used && peers[id].send_queue.depth() > 0) return true;
+  }
+  return false;
+}
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ESP32_RC_Ring.h>
+
+ESP32_RC_Ring::~ESP32_RC_Ring() {
+  free(buffer);
+}
+
+bool ESP32_RC_Ring::create(size_t capacity, size_t item_len) {
+  uint32_t slots = 1;
+  while (slots < capacity) slots <<= 1;
+
+  stride    = (item_len + 3) & ~(size_t)3;
+  item_size = item_len;
+  mask      = slots - 1;
+  max_depth = capacity;
+  buffer    = (uint8_t *)malloc(slots * stride);
+  head.store(0, std::memory_order_relaxed);
+  tail.store(0, std::memory_order_relaxed);
+  return (buffer != nullptr);
+}
+
+void ESP32_RC_Ring::set_notify(TaskHandle_t task) {
+  notify_task = task;
+}
+
+
+/*
+ * ========================================================
+ * Producer side
+ * ========================================================
+ */
+bool ESP32_RC_Ring::push(const void *item) {
+  uint32_t h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) >= max_depth) return false;
+
+  memcpy(slot(h), item, item_size);
+  head.store(h + 1, std::memory_order_release);
+  if (notify_task != nullptr) xTaskNotifyGive(notify_task);
+  return true;
+}
+
+bool ESP32_RC_Ring::push_overwrite(const void *item) {
+  bool is_dropped = false;
+  uint32_t h = head.load(std::memory_order_relaxed);
+  uint32_t t = tail.load(std::memory_order_acquire);
+  while (h - t >= max_depth) {
+    // a failed CAS means the consumer made room meanwhile, t is reloaded
+    if (tail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel)) {
+      is_dropped = true;
+      break;
+    }
+  }
+  push(item);
+  return is_dropped;
+}
+
+
+/*
+ * ========================================================
+ * Consumer side
+ *  - the item is copied before tail moves, a failed CAS means
+ *    it was dropped meanwhile and the copy is thrown away.
+ * ========================================================
+ */
+bool ESP32_RC_Ring::pop(void *item) {
+  uint32_t t = tail.load(std::memory_order_acquire);
+  while (t != head.load(std::memory_order_acquire)) {
+    if (item != nullptr) memcpy(item, slot(t), item_size);
+    if (tail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel)) return true;
+  }
+  return false;
+}
+
+bool ESP32_RC_Ring::peek(void *item, uint32_t *pos) {
+  uint32_t t = tail.load(std::memory_order_acquire);
+  while (t != head.load(std::memory_order_acquire)) {
+    memcpy(item, slot(t), item_size);
+    if (tail.load(std::memory_order_acquire) == t) {        // still valid after copy
+      if (pos != nullptr) *pos = t;
+      return true;
+    }
+    t = tail.load(std::memory_order_acquire);
+  }
+  return false;
+}
+
+bool ESP32_RC_Ring::consume(uint32_t pos) {
+  return tail.compare_exchange_strong(pos, pos + 1, std::memory_order_acq_rel);
+}
+
+void ESP32_RC_Ring::clear(void) {
+  uint32_t t = tail.load(std::memory_order_acquire);
+  while (!tail.compare_exchange_weak(t, head.load(std::memory_order_acquire), std::memory_order_acq_rel)) {
+    // t is reloaded by the failed CAS
+  }
+}
+
+bool ESP32_RC_Ring::wait(TickType_t ticks) {
+  if (depth() > 0) return true;
+  ulTaskNotifyTake(pdTRUE, ticks);
+  return (depth() > 0);
+}
+
+// tail first, so head is never older than tail
+int ESP32_RC_Ring::depth(void) const {
+  uint32_t t = tail.load(std::memory_order_acquire);
+  uint32_t h = head.load(std::memory_order_acquire);
+  return (int)(h - t);
+}
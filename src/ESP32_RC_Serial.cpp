@@ -0,0 +1,198 @@
+#include <string.h>
+#include <ESP32_RC_Serial.h>
+#ifndef ESP_PLATFORM
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+bool ESP32_RC_SerialLink::put(const uint8_t *frame, size_t frame_len) {
+  if (frame_len == 0 || frame_len > _RC_SERIAL_MAX_FRAME) return false;
+  if (batch_len + _RC_SERIAL_MAX_ENCODED(frame_len) > sizeof(batch)) return false;
+
+  uint8_t plain[_RC_SERIAL_MAX_FRAME + _RC_SERIAL_CRC_LEN];
+  uint16_t crc = crc16(frame, frame_len);
+  memcpy(plain, frame, frame_len);
+  plain[frame_len]     = crc & 0xFF;
+  plain[frame_len + 1] = crc >> 8;
+
+  batch_len += cobs_encode(plain, frame_len + _RC_SERIAL_CRC_LEN, batch + batch_len);
+  batch[batch_len ++] = 0x00;
+  return true;
+}
+
+bool ESP32_RC_SerialLink::flush(ESP32_RC_SerialPort &port) {
+  if (batch_len == 0) return true;
+  if (port.write(batch, batch_len) != (int)batch_len) return false;
+  batch_len = 0;
+  return true;
+}
+
+void ESP32_RC_SerialLink::reset(void) {
+  batch_len   = 0;
+  rx_len      = 0;
+  is_overflow = false;
+}
+
+// copy up to the next 0x00 at once, a frame is handled at its delimiter
+void ESP32_RC_SerialLink::feed(const uint8_t *data, size_t len, frameFuncType handler, void *context) {
+  while (len > 0) {
+    const uint8_t *end = (const uint8_t *)memchr(data, 0x00, len);
+    size_t chunk = (end != nullptr) ? end - data : len;
+
+    if (chunk > sizeof(rx) - rx_len) {
+      is_overflow = true;
+    } else if (!is_overflow) {
+      memcpy(rx + rx_len, data, chunk);
+      rx_len += chunk;
+    }
+    if (end == nullptr) return;
+
+    if (is_overflow) error_count ++;
+    else if (rx_len > 0) on_packet(handler, context);
+    rx_len      = 0;
+    is_overflow = false;
+    data += chunk + 1;
+    len  -= chunk + 1;
+  }
+}
+
+void ESP32_RC_SerialLink::on_packet(frameFuncType handler, void *context) {
+  size_t len = cobs_decode(rx, rx_len, rx);
+  if (len <= _RC_SERIAL_CRC_LEN) {
+    error_count ++;
+    return;
+  }
+  len -= _RC_SERIAL_CRC_LEN;
+  if (crc16(rx, len) != (rx[len] | (rx[len + 1] << 8))) {
+    error_count ++;
+    return;
+  }
+  handler(rx, len, context);
+}
+
+size_t ESP32_RC_SerialLink::cobs_encode(const uint8_t *data, size_t len, uint8_t *out) {
+  size_t code_at = 0;                     // where the code of the current block goes
+  size_t out_len = 1;
+  uint8_t code   = 1;
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] != 0x00) {
+      out[out_len ++] = data[i];
+      code ++;
+    }
+    if (data[i] == 0x00 || code == 0xFF) {
+      out[code_at] = code;
+      code_at = out_len ++;
+      code    = 1;
+    }
+  }
+  out[code_at] = code;
+  return out_len;
+}
+
+// decodes in place, the output never gets ahead of the input
+size_t ESP32_RC_SerialLink::cobs_decode(const uint8_t *data, size_t len, uint8_t *out) {
+  size_t in_at  = 0;
+  size_t out_at = 0;
+  while (in_at < len) {
+    uint8_t code = data[in_at ++];
+    if (code == 0x00 || in_at + code - 1 > len) return 0;
+    memmove(out + out_at, data + in_at, code - 1);
+    out_at += code - 1;
+    in_at  += code - 1;
+    if (code != 0xFF && in_at < len) out[out_at ++] = 0x00;
+  }
+  return out_at;
+}
+
+uint16_t ESP32_RC_SerialLink::crc16(const uint8_t *data, size_t len) {
+  static const uint16_t table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+  };
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+    crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+  }
+  return crc;
+}
+
+
+#ifndef ESP_PLATFORM
+/*
+ * ========================================================
+ * Linux tty / pty
+ * ========================================================
+ */
+static speed_t posix_speed(uint32_t baud) {
+  switch (baud) {
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    case 4000000: return B4000000;
+    default:      return B115200;
+  }
+}
+
+bool ESP32_RC_PosixSerial::open(uint32_t baud) {
+  fd = ::open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) return false;
+
+  struct termios tty;
+  if (tcgetattr(fd, &tty) < 0) {
+    close();
+    return false;
+  }
+  cfmakeraw(&tty);
+  tty.c_cflag |= CLOCAL | CREAD;
+  tty.c_cflag &= ~CRTSCTS;
+  cfsetispeed(&tty, posix_speed(baud));
+  cfsetospeed(&tty, posix_speed(baud));
+  if (tcsetattr(fd, TCSANOW, &tty) < 0) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void ESP32_RC_PosixSerial::close(void) {
+  if (fd >= 0) ::close(fd);
+  fd = -1;
+}
+
+int ESP32_RC_PosixSerial::read(uint8_t *data, size_t len, uint32_t timeout_ms) {
+  struct pollfd readable = {fd, POLLIN, 0};
+  int ready = poll(&readable, 1, timeout_ms);
+  if (ready <= 0) return (ready == 0 || errno == EINTR) ? 0 : -1;
+  int got = ::read(fd, data, len);
+  return (got < 0 && (errno == EAGAIN || errno == EINTR)) ? 0 : got;
+}
+
+int ESP32_RC_PosixSerial::write(const uint8_t *data, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    int sent = ::write(fd, data + done, len - done);
+    if (sent < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    done += sent;
+  }
+  return done;
+}
+
+int ESP32_RC_PosixSerial::tx_pending(void) {
+  int pending = 0;
+  if (fd < 0 || ioctl(fd, TIOCOUTQ, &pending) < 0) return 0;
+  return pending;
+}
+#endif
@@ -0,0 +1,173 @@
+#include <string.h>
+#include <ESP32_RC_Stats.h>
+
+/*
+ * ========================================================
+ * Sequence window
+ * ========================================================
+ */
+void ESP32_RC_SeqWindow::reset(void) {
+  has_seq = false;
+  seen    = 0;
+}
+
+uint8_t ESP32_RC_SeqWindow::check(uint16_t seq, uint16_t *advance) {
+  if (!has_seq) {
+    has_seq = true;
+    max_seq = seq;
+    seen    = 1;
+    if (advance != nullptr) *advance = 1;
+    return NEW;
+  }
+  int16_t diff = (int16_t)(seq - max_seq);
+  if (diff > 0) {
+    seen    = (diff < _RC_STATS_DUP_WINDOW) ? (seen << diff) | 1 : 1;
+    max_seq = seq;
+    if (advance != nullptr) *advance = diff;
+    return NEW;
+  }
+  if (-diff >= _RC_STATS_DUP_WINDOW) return STALE;
+  if (seen & (1ULL << -diff)) return DUPLICATE;
+  seen |= (1ULL << -diff);
+  return LATE;
+}
+
+
+/*
+ * ========================================================
+ * Link statistics
+ * ========================================================
+ */
+void ESP32_RC_LinkStats::reset(void) {
+  begin_write();
+  memset(&data, 0, sizeof(data));
+  window.reset();
+  has_delta = false;
+  end_write();
+}
+
+int ESP32_RC_LinkStats::bucket(uint32_t us) {
+  int index = 31 - __builtin_clz(us | 1);
+  return (index < _RC_STATS_BUCKETS) ? index : _RC_STATS_BUCKETS - 1;
+}
+
+
+/*
+ * ========================================================
+ * Writer side
+ * ========================================================
+ */
+void ESP32_RC_LinkStats::begin_write(void) {
+  version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void ESP32_RC_LinkStats::end_write(void) {
+  version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool ESP32_RC_LinkStats::on_frame(uint16_t seq, uint32_t remote_us, uint32_t local_us, bool is_synced) {
+  begin_write();
+
+  uint16_t advance = 0;
+  uint8_t kind = window.check(seq, &advance);
+  bool is_new  = (kind != ESP32_RC_SeqWindow::DUPLICATE);
+  if (kind == ESP32_RC_SeqWindow::NEW) {
+    data.expected += advance;                                 // the gap counts as expected
+  } else if (is_new) {
+    data.reordered ++;                                        // older, fills a gap
+  }
+
+  if (is_new) {
+    data.received ++;
+    // until the clocks are synced, use the best delay seen as zero
+    int32_t delta = (int32_t)(local_us - remote_us);
+    if (!has_delta || delta < min_delta) {
+      min_delta = delta;
+      has_delta = true;
+    }
+    int32_t one_way = is_synced ? delta : delta - min_delta;
+    data.one_way[bucket(one_way > 0 ? (uint32_t)one_way : 0)] ++;
+  } else {
+    data.duplicates ++;
+  }
+  data.lost = (data.expected > data.received) ? data.expected - data.received : 0;
+
+  end_write();
+  return is_new;
+}
+
+void ESP32_RC_LinkStats::on_rtt(uint32_t rtt_us) {
+  begin_write();
+  data.rtt[bucket(rtt_us)] ++;
+  end_write();
+}
+
+
+/*
+ * ========================================================
+ * Reader side
+ * ========================================================
+ */
+void ESP32_RC_LinkStats::snapshot(Snapshot &snap) const {
+  uint32_t before, after;
+  do {
+    before = version.load(std::memory_order_acquire);
+    memcpy(&snap, &data, sizeof(snap));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after  = version.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+}
+
+
+/*
+ * ========================================================
+ * Link clock
+ * ========================================================
+ */
+void ESP32_RC_LinkClock::reset(void) {
+  samples.store(0, std::memory_order_release);
+  srtt_us.store(0);
+  rttvar_us.store(0);
+  offset_us.store(0);
+}
+
+void ESP32_RC_LinkClock::on_sample(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) {
+  int32_t rtt = (int32_t)(t4 - t1) - (int32_t)(t3 - t2);
+  if (rtt < 0) rtt = 0;
+  int32_t off = ((int32_t)(t2 - t1) + (int32_t)(t3 - t4)) / 2;
+
+  uint32_t count = samples.load(std::memory_order_relaxed);
+  if (count == 0) {
+    srtt_us.store(rtt);
+    rttvar_us.store(rtt / 2);
+    offset_us.store(off);
+    samples.store(1, std::memory_order_release);
+    return;
+  }
+
+  int32_t srtt   = srtt_us.load();
+  int32_t rttvar = rttvar_us.load();
+  bool is_outlier = rtt > srtt + 4 * rttvar;
+  int32_t err    = rtt - srtt;
+  rttvar += ((err < 0 ? -err : err) - rttvar) / 4;
+  srtt   += err / 8;
+  srtt_us.store(srtt);
+  rttvar_us.store(rttvar);
+
+  // a slow round trip says little about the offset, keep the old estimate
+  if (!is_outlier) {
+    int32_t offset = offset_us.load();
+    offset_us.store(offset + (off - offset) / 8);
+  }
+  samples.store(count + 1, std::memory_order_release);
+}
+
+uint32_t ESP32_RC_LinkClock::rto(void) const {
+  uint32_t value = srtt() + 4 * rttvar();
+  return (value < _RC_CLOCK_RTO_MIN) ? _RC_CLOCK_RTO_MIN : value;
+}
+
+uint32_t ESP32_RC_LinkClock::to_local(uint32_t remote_us) const {
+  return remote_us - (uint32_t)offset();
+}
@@ -0,0 +1,73 @@
+#include <string.h>
+#include <ESP32_RC_Stream.h>
+
+void ESP32_RC_StreamParser::reset(void) {
+  header_len = 0;
+  received   = 0;
+  expected   = 0;
+  frame_ptr  = nullptr;
+  broken     = false;
+}
+
+bool ESP32_RC_StreamParser::parse(const uint8_t *&data, size_t &len) {
+  // the frame handed out last time is done
+  if (frame_ptr != nullptr) {
+    header_len = 0;
+    received   = 0;
+    frame_ptr  = nullptr;
+  }
+
+  while (len > 0 && !broken) {
+    if (header_len < _RC_STREAM_HEADER_LEN) {
+      header[header_len ++] = *data ++;
+      len --;
+      if (header_len == _RC_STREAM_HEADER_LEN) {
+        expected = header[0] | (header[1] << 8);
+        broken   = (expected == 0 || expected > _RC_STREAM_MAX_FRAME);
+      }
+      continue;
+    }
+
+    // whole frame in this read, no copy
+    if (received == 0 && len >= expected) {
+      frame_ptr = data;
+      data += expected;
+      len  -= expected;
+      return true;
+    }
+
+    size_t chunk = expected - received;
+    if (chunk > len) chunk = len;
+    memcpy(buffer + received, data, chunk);
+    received += chunk;
+    data     += chunk;
+    len      -= chunk;
+    if (received == expected) {
+      frame_ptr = buffer;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ESP32_RC_StreamWriter::put(const uint8_t *frame, size_t frame_len) {
+  if (frame_len == 0 || frame_len > _RC_STREAM_MAX_FRAME) return false;
+  size_t need = _RC_STREAM_HEADER_LEN + frame_len;
+  if (tail + need > sizeof(buffer) && head > 0) {           // move the rest the socket did not take to the front
+    memmove(buffer, buffer + head, tail - head);
+    tail -= head;
+    head  = 0;
+  }
+  if (tail + need > sizeof(buffer)) return false;
+
+  buffer[tail]     = frame_len & 0xFF;
+  buffer[tail + 1] = frame_len >> 8;
+  memcpy(buffer + tail + _RC_STREAM_HEADER_LEN, frame, frame_len);
+  tail += need;
+  return true;
+}
+
+void ESP32_RC_StreamWriter::consume(size_t len) {
+  head += len;
+  if (head >= tail) head = tail = 0;
+}
@@ -0,0 +1,438 @@
+#include <ESP32_RC_UART.h>
+
+/*
+ * ========================================================
+ * UART port - ESP-IDF driver
+ *  - the driver ISR moves bytes between the hardware FIFOs
+ *    and the ring buffers, read / write only touch those
+ * ========================================================
+ */
+bool ESP32_RC_UartPort::open(uint32_t baud) {
+  uart_config_t config = {};
+  config.baud_rate  = baud;
+  config.data_bits  = UART_DATA_8_BITS;
+  config.parity     = UART_PARITY_DISABLE;
+  config.stop_bits  = UART_STOP_BITS_1;
+  config.flow_ctrl  = UART_HW_FLOWCTRL_DISABLE;
+  config.source_clk = UART_SCLK_APB;
+
+  if (uart_driver_install(port, _UART_RX_BUFFER, _UART_TX_BUFFER, 0, nullptr, 0) != ESP_OK) return false;
+  is_open = true;
+  if (uart_param_config(port, &config) != ESP_OK ||
+      uart_set_pin(port, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+    close();
+    return false;
+  }
+  uart_set_rx_timeout(port, _UART_RX_TOUT);
+  return true;
+}
+
+void ESP32_RC_UartPort::close(void) {
+  if (is_open) uart_driver_delete(port);
+  is_open = false;
+}
+
+// wait for the first byte, then take what is buffered without waiting
+int ESP32_RC_UartPort::read(uint8_t *data, size_t len, uint32_t timeout_ms) {
+  int got = uart_read_bytes(port, data, 1, pdMS_TO_TICKS(timeout_ms));
+  if (got <= 0) return got;
+
+  size_t buffered = 0;
+  uart_get_buffered_data_len(port, &buffered);
+  if (buffered > len - 1) buffered = len - 1;
+  if (buffered > 0) {
+    int more = uart_read_bytes(port, data + 1, buffered, 0);
+    if (more > 0) got += more;
+  }
+  return got;
+}
+
+int ESP32_RC_UartPort::write(const uint8_t *data, size_t len) {
+  return uart_write_bytes(port, (const char *)data, len);
+}
+
+// the driver ring buffer only, the 128 byte hardware FIFO is not counted
+int ESP32_RC_UartPort::tx_pending(void) {
+  size_t free_size = 0;
+  if (!is_open || uart_get_tx_buffer_free_size(port, &free_size) != ESP_OK) return 0;
+  return _UART_TX_BUFFER - (int)free_size;
+}
+
+
+/*
+ * ========================================================
+ * ESP32_RC_UART
+ * ========================================================
+ */
+ESP32_RC_UART::ESP32_RC_UART(bool fast_mode, bool debug_mode, size_t payload_len)
+  : ESP32RemoteControl(fast_mode, debug_mode, payload_len), reader_task(this) {
+  if (payload_len > MAX_PAYLOAD_LEN) {
+    _ERROR_("Payload length " + String((int)payload_len) + " > " + String((int)MAX_PAYLOAD_LEN));
+  }
+  memset(peer_key, 0, sizeof(peer_key));
+  memcpy(peer_key, _UART_PEER_KEY, strlen(_UART_PEER_KEY));
+  stalls_reader = true;                         // a full BLOCK lane holds the wire, see wait_recv_room()
+}
+
+ESP32_RC_UART::~ESP32_RC_UART() {
+  stop_link_monitor();
+  stop_sender();
+  stop_receiver();
+
+  // let the reader task finish its read, it ends itself
+  is_stopping.store(true);
+  while (reader_task.getHandle() != nullptr) {
+    _DELAY_(1);
+  }
+
+  if (heartbeat_timer != nullptr) {
+    xTimerStop(heartbeat_timer, 0);
+    xTimerDelete(heartbeat_timer, 0);
+  }
+  port->close();
+}
+
+void ESP32_RC_UART::set_port(ESP32_RC_SerialPort *port, uint32_t baud) {
+  this->port = port;
+  this->baud = baud;
+}
+
+// Open the port
+void ESP32_RC_UART::init(void) {
+  _DEBUG_("Initializing UART...");
+  if (!port->open(baud)) {
+    _ERROR_("Failed to open the serial port.");
+  }
+  _DEBUG_("UART initialized at " + String((unsigned long)baud) + " bps.");
+
+  // Create queues
+  if (create_queues() == false) {
+    _ERROR_("Failed to create queues.");
+  }
+
+  // Create the mutex
+  mutex = xSemaphoreCreateMutex();
+
+  // Create Timer Tasks
+  // Messages are sent by send_task and received by reader_task. Only the heartbeat is timed.
+  heartbeat_timer = xTimerCreate("HeartBeatTimer",  heartbeat_period(), pdTRUE, this, heartbeat_timer_callback);
+
+  if (heartbeat_timer == NULL) {
+    _ERROR_("Failed to create timer");
+  }
+  _DEBUG_("Success.");
+}
+
+
+/*
+ * ========================================================
+ * connect - Override
+ *  - both peers say hello, the later one is heard
+ * ========================================================
+ */
+void ESP32_RC_UART::connect(void) {
+  _DEBUG_ ("Started.");
+  reader_task.start();
+
+  int attempt = 0;
+  int max_retry = 100;
+  while (attempt <= max_retry) {
+    attempt++;
+    if (handshake(_RC_HANDSHAKE_TIMEOUT) == true) break;
+    _DELAY_(10);
+    if (attempt >= max_retry ) {
+      _ERROR_ ("Failed. Attempts >= Max Retry (" + String(max_retry) + ")");
+    }
+  }
+
+  // start processing the send message queue.
+  set_value(&send_status, _STATUS_SEND_READY);
+
+  start_sender();
+  start_receiver();
+  xTimerStart(heartbeat_timer, 0);
+  start_link_monitor();
+  _DEBUG_("Success.");
+}
+
+
+/*
+ * ========================================================
+ * Handshake two peers
+ *  - it should block send/send_queue_msg
+ * ========================================================
+ */
+bool ESP32_RC_UART::handshake(uint32_t timeout_ms) {
+  _DEBUG_("Started.");
+
+  // Lock the varible
+  set_value(&connection_status, _STATUS_CONN_IN_PROG);
+
+  op_send_ctrl(_RC_FRAME_HANDSHAKE);
+
+  // Wait Ack
+  if (wait_handshake(timeout_ms)) {
+    _DEBUG_("Success.");
+    return true;
+  }
+  handshake_failed();
+  _DEBUG_("Failed.");
+  return false;
+}
+
+
+/*
+ * ========================================================
+ * send - Override
+ * en-queue the message only
+ * ========================================================
+ */
+void ESP32_RC_UART::send(const void *data, uint8_t lane) {
+  if (lane >= _RC_LANE_COUNT) {
+    send_metric.err_count ++;
+    return;
+  }
+
+  // make sure handshake is completed successfully, blocking lanes wait for it
+  int status = 0;
+  get_value(&connection_status, &status);
+  while (status != _STATUS_CONN_OK) {
+    if (lanes[lane].policy != _RC_LANE_BLOCK || uses_mailbox(lane)) return;
+    _DELAY_(int( 1000/_ESP32_RC_DATA_RATE ));
+    get_value(&connection_status, &status);
+  }
+  enqueue(data, lane);
+}
+
+/*
+ * ========================================================
+ * send_queue_msg - Override
+ *  - the frames of a round go into one batch, one write,
+ *    after the acks and the heartbeat (send_posted_ctrl())
+ *  - a round starts once the driver holds one batch at
+ *    most, the lanes decide what goes next, not the order
+ *    of the backlog
+ *  - a frame is DONE once it is in the batch, released
+ *    next round. A port error keeps the batch, it is
+ *    written again next round, it counts as one error
+ *    however many rounds it takes
+ *  - a batch that is still full leaves the frame QUEUED
+ * ========================================================
+ */
+void ESP32_RC_UART::send_queue_msg() {
+  bool is_full = false;   // no room left in the batch of this round
+
+  for (int slot = 0; slot < _RC_SEND_WINDOW_MAX; slot++) {
+    if (send_window.state(slot) == ESP32_RC_SendWindow::DONE) {
+      send_metric.out_count ++;
+      send_window.release(slot);
+    }
+  }
+
+  wait_writable();
+
+  // strict priority: lane by lane, first the frames refused before, then new messages
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT && !is_full; lane++) {
+    for (int slot = 0; slot < _RC_SEND_WINDOW_MAX && !is_full; slot++) {
+      if (send_window.state(slot) == ESP32_RC_SendWindow::QUEUED && send_window.lane(slot) == lane) {
+        is_full = !op_send(send_window.buffer(slot), slot);
+      }
+    }
+
+    int slot;
+    while (!is_full && (slot = send_window.acquire(lane)) >= 0) {
+      if (!dequeue(lane, send_window.buffer(slot))) {
+        send_window.release(slot);
+        break;
+      }
+      is_full = !op_send(send_window.buffer(slot), slot);
+    }
+  }
+
+  if (link.flush(*port)) {
+    is_batch_kept = false;
+    return;
+  }
+  if (!is_batch_kept) send_metric.err_count ++;   // one error per failed batch, not per retry
+  is_batch_kept = true;
+  _DELAY_(1);
+}
+
+// until the driver is down to one batch, the sleep is the wire time of the rest (8N1)
+void ESP32_RC_UART::wait_writable(void) {
+  int pending;
+  while ((pending = port->tx_pending()) > _RC_SERIAL_BATCH) {
+    _DELAY_(1 + (uint32_t)(pending - _RC_SERIAL_BATCH) * 10 * 1000 / baud);
+  }
+}
+
+// no window lock, nothing waits for a send-complete
+bool ESP32_RC_UART::op_send(const void *data, int slot) {
+  uint8_t frame[_MAX_MSG_LEN];
+  size_t frame_len = encode_frame(data, frame, sizeof(frame) - _RC_FRAME_TRAILER_LEN, peer_caps);
+  if (frame_len == 0) {
+    frame[0]  = _RC_FRAME_RAW;
+    memcpy(frame + _RC_FRAME_HEADER_LEN, data, payload_len);
+    frame_len = _RC_FRAME_HEADER_LEN + payload_len;
+  }
+  frame[0] |= (send_window.lane(slot) << _RC_FRAME_LANE_SHIFT);
+  frame_len  = add_trailer(frame, frame_len, send_window.seq(slot));
+
+  if (!link.put(frame, frame_len)) return false;
+  send_window.mark(slot, ESP32_RC_SendWindow::DONE);
+  return true;
+}
+
+// control frame (HANDSHAKE, HEARTBEAT ...), no delta as with WiFi
+size_t ESP32_RC_UART::create_ctrl(uint8_t type, uint8_t *frame) {
+  size_t frame_len = create_ctrl_frame(type, frame);
+  if (type == _RC_FRAME_HANDSHAKE || type == _RC_FRAME_HANDSHAKE_ACK) {
+    frame[1] &= ~_RC_CAP_DELTA;
+  }
+  return frame_len;
+}
+
+// handshake, written at once with whatever is batched so far
+// the batch side has one task at a time: connect() before send_task runs, then send_task
+bool ESP32_RC_UART::op_send_ctrl(uint8_t type) {
+  uint8_t frame[_RC_CTRL_FRAME_LEN];
+  size_t frame_len = create_ctrl(type, frame);
+  bool is_put = link.put(frame, frame_len) || (link.flush(*port) && link.put(frame, frame_len));
+  return is_put && link.flush(*port);
+}
+
+// the acks of the reader and the heartbeat, first in the batch of this round
+bool ESP32_RC_UART::op_send_posted(const uint8_t *frame, size_t frame_len, const uint8_t *addr) {
+  return link.put(frame, frame_len);
+}
+
+/*
+ * ========================================================
+ * recv - Override
+ * ========================================================
+ */
+bool ESP32_RC_UART::recv(void *data) {
+  RecvView view;
+  if (!recv_view(view)) return false;
+  memcpy(data, view.data, payload_len);
+  release(view);
+  return true;
+}
+
+
+/*
+ * ========================================================
+ * Reader task
+ *  - the only reader of the port, frames are handled as
+ *    their delimiter arrives
+ *  - never writes, the answers are posted to send_task
+ * ========================================================
+ */
+ESP32_RC_UartTask::ESP32_RC_UartTask(ESP32_RC_UART *rc)
+  : Task("ESP32_RC_Uart", _UART_TASK_STACK, _UART_TASK_PRIORITY), rc(rc) {
+  setCore(_UART_TASK_CORE);
+}
+
+void ESP32_RC_UartTask::run(void *data) {
+  rc->reader_loop();
+}
+
+void ESP32_RC_UART::reader_loop(void) {
+  uint8_t buffer[_UART_READ_LEN];
+  while (!is_stopping.load()) {
+    int len = port->read(buffer, sizeof(buffer), _UART_READ_TIMEOUT);
+    if (len < 0) {
+      recv_metric.err_count ++;
+      _DELAY_(_UART_READ_TIMEOUT);
+      continue;
+    }
+    link.feed(buffer, len, on_frame, this);
+  }
+}
+
+void ESP32_RC_UART::on_frame(const uint8_t *frame, size_t frame_len, void *context) {
+  ESP32_RC_UART *rc = static_cast<ESP32_RC_UART *>(context);
+  rc->on_datarecv(frame, frame_len, micros());
+}
+
+void ESP32_RC_UART::on_datarecv(const uint8_t *data, int data_len, uint32_t rx_us) {
+  int status;
+
+  if (data_len < 1) {
+    recv_metric.err_count ++;
+    return;
+  }
+  link_alive();                           // only the peer is on the wire
+
+  get_value(&connection_status, &status);
+
+  switch (_RC_FRAME_KIND(data[0])) {
+    // Handshake Hello received and send Ack
+    // also completes our own handshake, both sides say hello at once
+    case _RC_FRAME_HANDSHAKE: {
+      peers.set_primary(peer_key);
+      peer_caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+      handshake_done();
+      uint8_t ack[_RC_CTRL_FRAME_LEN];
+      post_ctrl(ack, create_ctrl(_RC_FRAME_HANDSHAKE_ACK, ack));
+      post_reset();                             // send_queue belongs to send_task
+      if (status == _STATUS_CONN_IN_PROG) set_value(&connection_status, _STATUS_CONN_ACKED);
+      return;
+    }
+
+    // check if handshake in progress, and process Ack
+    case _RC_FRAME_HANDSHAKE_ACK:
+      if (status != _STATUS_CONN_IN_PROG) return;
+      peers.set_primary(peer_key);
+      peer_caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+      handshake_done();
+      post_reset();
+      empty_recv_queue();
+      set_value(&connection_status, _STATUS_CONN_ACKED);
+      return;
+
+    // received heartbeat, then return heartbeat Ack with our timestamps
+    case _RC_FRAME_HEARTBEAT: {
+      uint8_t ack[_RC_CTRL_FRAME_LEN];
+      post_ctrl(ack, create_heartbeat_ack(data, data_len, rx_us, ack));
+      return;
+    }
+
+    // received heart beat ack, heart beat cycle completed, then turn off the LED
+    case _RC_FRAME_HEARTBEAT_ACK:
+      on_heartbeat_ack(data, data_len, rx_us);
+      digitalWrite(BUILTIN_LED, LOW);
+      return;
+
+    // regular message
+    case _RC_FRAME_RAW:
+    case _RC_FRAME_COMPACT:
+    case _RC_FRAME_KEY:
+    case _RC_FRAME_DELTA:
+      if (status != _STATUS_CONN_OK && status != _STATUS_CONN_ACKED) return;
+      recv_data_frame(data, data_len);
+      return;
+
+    default:
+      recv_metric.err_count ++;
+      return;
+  }
+}
+
+
+void ESP32_RC_UART::heartbeat_timer_callback(TimerHandle_t xTimer) {
+  ESP32_RC_UART *rc = static_cast<ESP32_RC_UART *>(pvTimerGetTimerID(xTimer));
+  rc->post_heartbeat();                         // never waits for the port in the timer task
+  digitalWrite(BUILTIN_LED, HIGH);
+}
+
+
+/*
+ * ========================================================
+ * run - Override
+ * ========================================================
+ */
+
+void ESP32_RC_UART::run(void* data) {
+  connect();
+}
@@ -1,219 +1,658 @@
 #include <ESP32_RC_WIFI.h>
 
-ESP32_RC_WIFI* ESP32_RC_WIFI::instance = nullptr;
+ESP32_RC_WIFI::ESP32_RC_WIFI(bool fast_mode, bool debug_mode, size_t payload_len)
+  : ESP32RemoteControl(fast_mode, debug_mode, payload_len), net_task(this) {
+  if (payload_len > MAX_PAYLOAD_LEN) {
+    _ERROR_("Payload length " + String((int)payload_len) + " > " + String((int)MAX_PAYLOAD_LEN));
+  }
+  memset(&broadcast_sin, 0, sizeof(broadcast_sin));
+  memset(&peer_sin, 0, sizeof(peer_sin));
+  memset(&server_sin, 0, sizeof(server_sin));
+  memset(&conn_sin, 0, sizeof(conn_sin));
+}
+
+ESP32_RC_WIFI::~ESP32_RC_WIFI() {
+  stop_link_monitor();
+  stop_sender();
+  stop_receiver();
+
+  // let the network task leave select(), it ends itself
+  net.stop();
+  while (net_task.getHandle() != nullptr) {
+    _DELAY_(1);
+  }
 
-ESP32_RC_WIFI::ESP32_RC_WIFI(bool fast_mode, bool debug_mode) : ESP32RemoteControl(fast_mode, debug_mode) {
-  server = WiFiServer(ESP32_RC_TCP_PORT);
-  instance = this;
+  if (heartbeat_timer != nullptr) {
+    xTimerStop(heartbeat_timer, 0);
+    xTimerDelete(heartbeat_timer, 0);
+  }
+  if (sock >= 0) close(sock);
+  if (listen_sock >= 0) close(listen_sock);
+  if (conn_sock >= 0) close(conn_sock);
+  if (stream_mutex != nullptr) vSemaphoreDelete(stream_mutex);
 }
 
 // Initialize WiFi configuration
 void ESP32_RC_WIFI::init(void) {
   _DEBUG_("Initializing private WiFi...");
   WiFi.mode(WIFI_AP_STA);  // Enable both AP and STA modes
+  WiFi.setSleep(false);    // modem sleep holds frames back until the next beacon
   _DEBUG_("WiFi initialized.");
 
   // Create queues
-  send_queue = xQueueCreate(_RC_QUEUE_DEPTH, sizeof(Message));
-  recv_queue = xQueueCreate(_RC_QUEUE_DEPTH, sizeof(Message));
-  if (send_queue == NULL || recv_queue == NULL) {
+  if (create_queues() == false) {
     _ERROR_("Failed to create queues.");
   }
 
   // Create the mutex
-  mutex = xSemaphoreCreateMutex();
+  mutex        = xSemaphoreCreateMutex();
+  stream_mutex = xSemaphoreCreateMutex();
+  if (!net.create(on_net_event, this)) {
+    _ERROR_("Failed to create network loop.");
+  }
 
   // Create Timer Tasks
-  // For example : _ESP32_RC_DATA_RATE = 100 (times/sec)
-  //              => int(1000/_ESP32_RC_DATA_RATE) = 10 (ms),  delay 10ms for each timer event
-  send_timer      = xTimerCreate("SendTimer",       pdMS_TO_TICKS(int(1000/_ESP32_RC_DATA_RATE)),       pdTRUE, nullptr, send_timer_callback);
-  recv_timer      = xTimerCreate("RecvTimer",       pdMS_TO_TICKS(int(1000/_ESP32_RC_DATA_RATE)),       pdTRUE, nullptr, recv_callback);
-  heartbeat_timer = xTimerCreate("HeartBeatTimer",  pdMS_TO_TICKS( int(1000/ESP32_RC_HEARTBEAT_RATE) ), pdTRUE, nullptr, heartbeat_timer_callback);
+  // Messages are sent by send_task and received by net_task. Only the heartbeat is timed.
+  heartbeat_timer = xTimerCreate("HeartBeatTimer",  heartbeat_period(), pdTRUE, this, heartbeat_timer_callback);
 
-  if (send_timer == NULL || heartbeat_timer == NULL || recv_timer == NULL) {
+  if (heartbeat_timer == NULL) {
     _ERROR_("Failed to create timer");
-  }  
-
-  xTimerStart(recv_timer, 0);
+  }
+  _DEBUG_("Success.");
 }
 
 
-/* 
+/*
  * ========================================================
- * Handshake two peers
- *  - Needs to be done before pairing 
- *  - it should block send/send_queue_msg 
+ * connect - Override
+ *  - join or open the network once, re-handshakes only
+ *    say hello again
  * ========================================================
  */
-bool ESP32_RC_WIFI::handshake() {
-  _DEBUG_("Setting up private WiFi...");
-  
-  // Lock the varible
-  set_value(&connection_status, _STATUS_CONN_IN_PROG);
+void ESP32_RC_WIFI::connect(void) {
+  _DEBUG_ ("Started.");
+  join_network();
+  bool is_open = tcp_mode ? (!is_ap || open_listener()) : open_socket();
+  if (!is_open) {
+    _ERROR_("Failed to open socket.");
+  }
+  net_task.start();
+
+  int attempt = 0;
+  int max_retry = 100;
+  while (attempt <= max_retry) {
+    attempt++;
+    if (handshake(_RC_HANDSHAKE_TIMEOUT) == true) break;
+    _DELAY_(10);
+    if (attempt >= max_retry ) {
+      _ERROR_ ("Failed. Attempts >= Max Retry (" + String(max_retry) + ")");
+    }
+  }
 
+  // start processing the send message queue.
+  set_value(&send_status, _STATUS_SEND_READY);
+
+  start_sender();
+  start_receiver();
+  xTimerStart(heartbeat_timer, 0);
+  start_link_monitor();
+  _DEBUG_("Success.");
+}
 
-  // Try connecting as STA
+// a random join time, so of two peers with the same code one becomes the AP first
+void ESP32_RC_WIFI::join_network(void) {
+  uint32_t join_timeout = _WIFI_JOIN_TIMEOUT + random(_WIFI_JOIN_TIMEOUT);
   WiFi.begin(ESP32_RC_SSID, ESP32_RC_PASSWORD);
-  int retry = 10;  // Retry limit
-  while (WiFi.status() != WL_CONNECTED && retry > 0) {
-    _DELAY_(1000);
-    _DEBUG_("Retrying STA mode...");
-    retry--;
+  unsigned long start_time = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - start_time < join_timeout) {
+    _DELAY_(100);
   }
 
-  // Connected as STA
   if (WiFi.status() == WL_CONNECTED) {
+    is_ap    = false;
+    local_ip = WiFi.localIP();
+    broadcast_sin.sin_addr.s_addr = WiFi.broadcastIP();
+    server_sin.sin_family      = AF_INET;
+    server_sin.sin_port        = htons(ESP32_RC_TCP_PORT);
+    server_sin.sin_addr.s_addr = WiFi.gatewayIP();
     _DEBUG_("Connected to AP as STA.");
-    is_ap = false;
+  } else {
+    // STA is not avaliable, fall back to AP mode
+    WiFi.disconnect();
+    WiFi.softAP(ESP32_RC_SSID, ESP32_RC_PASSWORD);
+    is_ap    = true;
+    local_ip = WiFi.softAPIP();
+    broadcast_sin.sin_addr.s_addr = WiFi.softAPBroadcastIP();
+    _DEBUG_("AP mode active.");
+  }
+  broadcast_sin.sin_family = AF_INET;
+  broadcast_sin.sin_port   = htons(ESP32_RC_UDP_PORT);
+}
 
-    // Step 1: Establish a persistent TCP connection to the AP
-    if (!client.connect(ESP32_RC_SSID, ESP32_RC_TCP_PORT)) {
-      _DEBUG_("Failed to establish TCP connection to AP.");
-      return false;
-    }
-      
-    // Step 2: Send handshake message to AP
-    op_send(create_sys_msg(_HANDSHAKE_MSG));
+bool ESP32_RC_WIFI::open_socket(void) {
+  if (sock >= 0) return true;
+  sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock < 0) return false;
+
+  int on  = 1;
+  int tos = _WIFI_TOS;
+  setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  setsockopt(sock, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family      = AF_INET;
+  local.sin_port        = htons(ESP32_RC_UDP_PORT);
+  local.sin_addr.s_addr = local_ip;                         // lwIP still hands it the broadcasts of the subnet
+  if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+    close(sock);
+    sock = -1;
+    return false;
+  }
+  net.watch(sock, ESP32_RC_NetLoop::READ);
+  return true;
+}
 
-    // Step 3: Wait for handshake ack
-    retry = 10;
 
+bool ESP32_RC_WIFI::open_listener(void) {
+  if (listen_sock >= 0) return true;
+  listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listen_sock < 0) return false;
+
+  int on = 1;
+  setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  fcntl(listen_sock, F_SETFL, fcntl(listen_sock, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family      = AF_INET;
+  local.sin_port        = htons(ESP32_RC_TCP_PORT);
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(listen_sock, (struct sockaddr *)&local, sizeof(local)) < 0 || listen(listen_sock, 1) < 0) {
+    close(listen_sock);
+    listen_sock = -1;
+    return false;
+  }
+  net.watch(listen_sock, ESP32_RC_NetLoop::READ);
+  return true;
+}
 
-  } else {
 
+/*
+ * ========================================================
+ * TCP connection
+ *  - one connection, a new one replaces the old one
+ *  - conn_gen tells the net task the connection was replaced,
+ *    the parser starts over
+ * ========================================================
+ */
+bool ESP32_RC_WIFI::open_connection(uint32_t timeout_ms) {
+  int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) return false;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  // from the own address, the AP ignores its own
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family      = AF_INET;
+  local.sin_addr.s_addr = local_ip;
+  if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+    close(fd);
+    return false;
+  }
 
-    // STA is not avaliable
-    // Fall back to AP mode
-    _DEBUG_("Switching to AP mode...");
-    WiFi.softAP(ESP32_RC_SSID, ESP32_RC_PASSWORD);
-    server.begin();
-    is_ap = true;
-    _DEBUG_("AP mode active.");
+  // non-blocking connect, done when the socket is writable
+  if (::connect(fd, (struct sockaddr *)&server_sin, sizeof(server_sin)) < 0 && errno != EINPROGRESS) {
+    close(fd);
+    return false;
+  }
+  fd_set writable;
+  FD_ZERO(&writable);
+  FD_SET(fd, &writable);
+  struct timeval timeout = {(long)(timeout_ms / 1000), (long)(timeout_ms % 1000) * 1000};
+  int error = 0;
+  socklen_t error_len = sizeof(error);
+  if (select(fd + 1, nullptr, &writable, nullptr, &timeout) <= 0
+      || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) < 0 || error != 0) {
+    close(fd);
+    return false;
+  }
+  use_connection(fd, server_sin);
+  return true;
+}
 
-    // Step 1: Wait for handshake message from STA
-    while (true) {  // wait forever
-      WiFiClient _client = server.available();
-      if (client) {
+void ESP32_RC_WIFI::accept_connection(void) {
+  struct sockaddr_in from;
+  socklen_t from_len = sizeof(from);
+  int fd = accept(listen_sock, (struct sockaddr *)&from, &from_len);
+  if (fd < 0) return;
+  use_connection(fd, from);
+}
 
+void ESP32_RC_WIFI::use_connection(int fd, const struct sockaddr_in &addr) {
+  int on  = 1;
+  int tos = _WIFI_TOS;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  xSemaphoreTake(stream_mutex, portMAX_DELAY);
+  drop_connection();
+  conn_sock = fd;
+  conn_sin  = addr;
+  net.watch(fd, ESP32_RC_NetLoop::READ);
+  xSemaphoreGive(stream_mutex);
+}
 
-      }
+void ESP32_RC_WIFI::close_connection(uint32_t gen) {
+  xSemaphoreTake(stream_mutex, portMAX_DELAY);
+  if (gen == conn_gen) drop_connection();
+  xSemaphoreGive(stream_mutex);
+}
+
+void ESP32_RC_WIFI::drop_connection(void) {
+  if (conn_sock >= 0) {
+    net.unwatch(conn_sock);
+    close(conn_sock);
+  }
+  conn_sock = -1;
+  conn_gen ++;
+  writer.clear();
+}
+
+// a full writer is written out first, to make room
+bool ESP32_RC_WIFI::stream_put(const uint8_t *frame, size_t frame_len) {
+  bool is_put = false;
+  xSemaphoreTake(stream_mutex, portMAX_DELAY);
+  if (conn_sock >= 0) {
+    is_put = writer.put(frame, frame_len);
+    if (!is_put) {
+      write_stream();
+      is_put = writer.put(frame, frame_len);
     }
+  }
+  xSemaphoreGive(stream_mutex);
+  return is_put;
+}
 
+bool ESP32_RC_WIFI::flush_stream(void) {
+  xSemaphoreTake(stream_mutex, portMAX_DELAY);
+  bool is_done = write_stream();
+  xSemaphoreGive(stream_mutex);
+  return is_done;
+}
+
+bool ESP32_RC_WIFI::write_stream(void) {
+  while (writer.size() > 0) {
+    if (conn_sock < 0) return false;
+    int len = ::send(conn_sock, writer.data(), writer.size(), 0);
+    if (len > 0) {
+      writer.consume(len);
+      continue;
+    }
+    if (len == 0 || (errno != EWOULDBLOCK && errno != EAGAIN)) {
+      drop_connection();
+    } else {
+      net.watch(conn_sock, ESP32_RC_NetLoop::READ | ESP32_RC_NetLoop::WRITE);  // the network task writes the rest
+    }
+    return false;
   }
+  return true;
+}
 
+void ESP32_RC_WIFI::enable_tcp(bool mode) {
+  tcp_mode = mode;
+}
 
 
+/*
+ * ========================================================
+ * Handshake two peers
+ *  - the last peer first, then the whole network
+ *  - it should block send/send_queue_msg
+ * ========================================================
+ */
+bool ESP32_RC_WIFI::handshake(uint32_t timeout_ms) {
+  _DEBUG_("Started.");
 
+  // Lock the varible
+  set_value(&connection_status, _STATUS_CONN_IN_PROG);
+
+  unsigned long start_time = millis();
+
+  // TCP: the STA opens a new connection every time, the AP waits for it,
+  // or says hello on the one it has (the STA may not have noticed the loss)
+  if (tcp_mode) {
+    if (!is_ap && !open_connection(timeout_ms)) {
+      handshake_failed();
+      _DEBUG_("Failed.");
+      return false;
+    }
+    op_send_ctrl(_RC_FRAME_HANDSHAKE);
+    uint32_t elapsed = millis() - start_time;
+    if (elapsed < timeout_ms && wait_handshake(timeout_ms - elapsed)) {
+      _DEBUG_("Success.");
+      return true;
+    }
+    handshake_failed();
+    _DEBUG_("Failed.");
+    return false;
+  }
 
+  // Known peer, say hello to it directly. No broadcast needed if it answers.
+  if (has_peer) {
+    op_send_ctrl(_RC_FRAME_HANDSHAKE, &peer_sin);
+    if (wait_handshake((timeout_ms < _RC_RESUME_TIMEOUT) ? timeout_ms : _RC_RESUME_TIMEOUT)) {
+      _DEBUG_("Resumed.");
+      return true;
+    }
+  }
 
+  // Send broadcast
+  op_send_ctrl(_RC_FRAME_HANDSHAKE, &broadcast_sin);
+
+  // Wait Ack
+  uint32_t elapsed = millis() - start_time;
+  if (elapsed < timeout_ms && wait_handshake(timeout_ms - elapsed)) {
+    _DEBUG_("Success.");
+    return true;
+  }
+  handshake_failed();
   _DEBUG_("Failed.");
   return false;
 }
 
-bool ESP32_RC_WIFI::op_send(Message msg) {
-  set_value(&send_status, _STATUS_SEND_IN_PROG);
-  client.write((const uint8_t*)&msg, sizeof(msg));
-  client.flush(); // Ensure all data is sent
+void ESP32_RC_WIFI::set_primary(const struct sockaddr_in &from) {
+  peer_sin = from;
+  make_key(from, peer_key);
+  has_peer = true;
+  peers.set_primary(peer_key);
 }
 
+void ESP32_RC_WIFI::make_key(const struct sockaddr_in &addr, uint8_t *key) {
+  memcpy(key, &addr.sin_addr.s_addr, 4);
+  memcpy(key + 4, &addr.sin_port, 2);
+}
 
 
-void ESP32_RC_WIFI::connect(void) {
-  _DEBUG_ ("Started.");
-  int attempt = 0;
-  int max_retry = 100;
-  while (attempt <= max_retry) {
-    attempt++;
-    if (handshake() == true) break;
-    _DELAY_(10);
-    if (attempt >= max_retry ) {
-      _ERROR_ ("Failed. Attempts >= Max Retry (" + String(max_retry) + ")");
-    }  
+/*
+ * ========================================================
+ * send - Override
+ * en-queue the message only
+ * ========================================================
+ */
+void ESP32_RC_WIFI::send(const void *data, uint8_t lane) {
+  if (lane >= _RC_LANE_COUNT) {
+    send_metric.err_count ++;
+    return;
   }
 
-  // start processing the send message queue.
-  set_value(&send_status, _STATUS_SEND_READY);
-  
-  xTimerStart(send_timer, 0);
-  xTimerStart(heartbeat_timer, 0);
-  _DEBUG_("Success.");
-
+  // make sure handshake is completed successfully, blocking lanes wait for it
+  int status = 0;
+  get_value(&connection_status, &status);
+  while (status != _STATUS_CONN_OK) {
+    if (lanes[lane].policy != _RC_LANE_BLOCK || uses_mailbox(lane)) return;
+    _DELAY_(int( 1000/_ESP32_RC_DATA_RATE ));
+    get_value(&connection_status, &status);
+  }
+  enqueue(data, lane);
 }
 
-void ESP32_RC_WIFI::send(Message data) {
-  /*
-  if (is_ap) {
-    WiFiClient new_client = server.available();
-    if (new_client) {
-      new_client.write((uint8_t*)&data, sizeof(Message));
-      _DEBUG_("Message sent to client.");
-    } else {
-      _ERROR_("No client connected.");
-    }
-  } else {
-    if (client.connected()) {
-      client.write((uint8_t*)&data, sizeof(Message));
-      _DEBUG_("Message sent to AP.");
-    } else {
-      _ERROR_("Not connected to AP.");
+/*
+ * ========================================================
+ * send_queue_msg - Override
+ *  - a frame is DONE once the socket took it, released next round
+ *  - a full socket buffer leaves it QUEUED
+ *  - TCP: all frames of the round leave in one write, the network task
+ *    wakes the sender once the socket takes more
+ * ========================================================
+ */
+void ESP32_RC_WIFI::send_queue_msg() {
+  bool is_busy = false;   // socket refused a frame, buffer full
+
+  for (int slot = 0; slot < _RC_SEND_WINDOW_MAX; slot++) {
+    if (send_window.state(slot) == ESP32_RC_SendWindow::DONE) {
+      send_metric.out_count ++;
+      send_window.release(slot);
     }
   }
-  */
-}
 
-// Receive data over private WiFi
-Message ESP32_RC_WIFI::recv(void) {
-  
-  Message data = {0};
-  /*
-  if (is_ap) {
-    WiFiClient new_client = server.available();
-    if (new_client && new_client.available()) {
-      new_client.read((uint8_t*)&data, sizeof(Message));
-      _DEBUG_("Message received from client.");
-    } else {
-      _DEBUG_("No data available.");
+  // strict priority: lane by lane, first the frames refused before, then new messages
+  for (uint8_t lane = 0; lane < _RC_LANE_COUNT && !is_busy; lane++) {
+    for (int slot = 0; slot < _RC_SEND_WINDOW_MAX && !is_busy; slot++) {
+      if (send_window.state(slot) == ESP32_RC_SendWindow::QUEUED && send_window.lane(slot) == lane) {
+        is_busy = !op_send(send_window.buffer(slot), slot);
+      }
     }
-  } else {
-    if (client.connected() && client.available()) {
-      client.read((uint8_t*)&data, sizeof(Message));
-      _DEBUG_("Message received from AP.");
-    } else {
-      _DEBUG_("No data available.");
+
+    int slot;
+    while (!is_busy && (slot = send_window.acquire(lane)) >= 0) {
+      if (!dequeue(lane, send_window.buffer(slot))) {
+        send_window.release(slot);
+        break;
+      }
+      is_busy = !op_send(send_window.buffer(slot), slot);
     }
   }
-  */
-  return data;
-  
-};
 
-ESP32_RC_WIFI::~ESP32_RC_WIFI() {
-  if (send_queue) vQueueDelete(send_queue);
-  if (recv_queue) vQueueDelete(recv_queue);
-  if (send_timer) {
-    xTimerStop(send_timer, 0);
-    xTimerDelete(send_timer, 0);
+  if (tcp_mode && !flush_stream()) is_busy = true;
+
+  // UDP: lwIP reports a UDP socket as always writable, just retry shortly
+  if (is_busy) {
+    if (tcp_mode) wait_sender(pdMS_TO_TICKS(_RC_SEND_DONE_TIMEOUT));
+    else _DELAY_(1);
   }
-};
+}
 
-void ESP32_RC_WIFI::send_queue_msg() {
+// no window lock, nothing waits for a send-complete
+// TCP: only added to the writer, send_queue_msg() writes the whole round
+bool ESP32_RC_WIFI::op_send(const void *data, int slot) {
+  uint8_t frame[_MAX_MSG_LEN];
+  size_t frame_len = encode_frame(data, frame, sizeof(frame) - _RC_FRAME_TRAILER_LEN, peer_caps);
+  if (frame_len == 0) {
+    frame[0]  = _RC_FRAME_RAW;
+    memcpy(frame + _RC_FRAME_HEADER_LEN, data, payload_len);
+    frame_len = _RC_FRAME_HEADER_LEN + payload_len;
+  }
+  frame[0] |= (send_window.lane(slot) << _RC_FRAME_LANE_SHIFT);
+  frame_len  = add_trailer(frame, frame_len, send_window.seq(slot));
+
+  bool is_sent = tcp_mode ? stream_put(frame, frame_len)
+                          : (sendto(sock, frame, frame_len, 0, (struct sockaddr *)&peer_sin, sizeof(peer_sin)) == (int)frame_len);
+  if (!is_sent) return false;
+  send_window.mark(slot, ESP32_RC_SendWindow::DONE);
+  return true;
+}
 
+// Send control frame (HANDSHAKE, HEARTBEAT ...)
+// no delta over UDP, the HANDSHAKE / HANDSHAKE_ACK does not offer it
+bool ESP32_RC_WIFI::op_send_ctrl(uint8_t type, const struct sockaddr_in *to) {
+  uint8_t frame[_RC_CTRL_FRAME_LEN];
+  size_t frame_len = create_ctrl_frame(type, frame);
+  if (type == _RC_FRAME_HANDSHAKE || type == _RC_FRAME_HANDSHAKE_ACK) {
+    frame[1] &= ~_RC_CAP_DELTA;
+  }
+  return op_send_ctrl(frame, frame_len, to);
+}
 
+// TCP: one peer on the stream, to is ignored
+bool ESP32_RC_WIFI::op_send_ctrl(const uint8_t *frame, size_t frame_len, const struct sockaddr_in *to) {
+  if (tcp_mode) return stream_put(frame, frame_len) && flush_stream();
+  if (sock < 0) return false;
+  if (to == nullptr) to = &peer_sin;
+  return (sendto(sock, frame, frame_len, 0, (const struct sockaddr *)to, sizeof(*to)) == (int)frame_len);
 }
 
+/*
+ * ========================================================
+ * recv - Override
+ * ========================================================
+ */
+bool ESP32_RC_WIFI::recv(void *data) {
+  RecvView view;
+  if (!recv_view(view)) return false;
+  memcpy(data, view.data, payload_len);
+  release(view);
+  return true;
+}
+
+
+/*
+ * ========================================================
+ * Network task
+ *  - one select() over all sockets, see ESP32_RC_NetLoop
+ *  - datagrams, connections and stream data are handled
+ *    as they arrive, no timer
+ * ========================================================
+ */
+ESP32_RC_NetTask::ESP32_RC_NetTask(ESP32_RC_WIFI *rc)
+  : Task("ESP32_RC_Net", _WIFI_NET_TASK_STACK, _WIFI_NET_TASK_PRIORITY), rc(rc) {
+  setCore(_WIFI_NET_TASK_CORE);
+}
 
-void ESP32_RC_WIFI::send_timer_callback(TimerHandle_t xTimer) {
-  //ESP32_RC_ESPNOW* this_instance = static_cast<ESP32_RC_ESPNOW*>(pvTimerGetTimerID(xTimer));
-  instance->send_queue_msg();
+void ESP32_RC_NetTask::run(void *data) {
+  rc->net_loop();
 }
 
+void ESP32_RC_WIFI::net_loop(void) {
+  net.run();
+}
 
-void ESP32_RC_WIFI::recv_callback(TimerHandle_t xTimer) {
-  
+void ESP32_RC_WIFI::on_net_event(int fd, uint8_t events, void *context) {
+  ESP32_RC_WIFI *rc = static_cast<ESP32_RC_WIFI *>(context);
+  if (fd == rc->sock) {
+    rc->recv_datagrams();
+  } else if (fd == rc->listen_sock) {
+    rc->accept_connection();
+  } else {
+    if (events & ESP32_RC_NetLoop::WRITE) rc->on_writable(fd);
+    if (events & ESP32_RC_NetLoop::READ)  rc->recv_stream(fd);
+  }
 }
 
+void ESP32_RC_WIFI::recv_datagrams(void) {
+  struct sockaddr_in from;
+  while (true) {
+    socklen_t from_len = sizeof(from);
+    int data_len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), 0, (struct sockaddr *)&from, &from_len);
+    if (data_len < 0) return;                               // EWOULDBLOCK, drained
+    on_datarecv(from, rx_buffer, data_len, micros());
+  }
+}
+
+// read under the lock, so the socket cannot be replaced meanwhile, frames are handled outside of it
+void ESP32_RC_WIFI::recv_stream(int fd) {
+  xSemaphoreTake(stream_mutex, portMAX_DELAY);
+  if (fd != conn_sock) {                                    // replaced since select()
+    xSemaphoreGive(stream_mutex);
+    return;
+  }
+  uint32_t gen = conn_gen;
+  int len = ::recv(fd, rx_buffer, sizeof(rx_buffer), 0);
+  if (len == 0 || (len < 0 && errno != EWOULDBLOCK && errno != EAGAIN)) drop_connection();
+  struct sockaddr_in from = conn_sin;
+  xSemaphoreGive(stream_mutex);
+
+  uint32_t rx_us = micros();
+  if (gen != parser_gen) {                                  // new connection, new stream
+    parser.reset();
+    parser_gen = gen;
+  }
+  if (len <= 0) return;
+
+  const uint8_t *data = rx_buffer;
+  size_t data_len     = len;
+  while (parser.parse(data, data_len)) {
+    on_datarecv(from, parser.frame(), parser.frame_len(), rx_us);
+  }
+  if (parser.is_broken()) {
+    recv_metric.err_count ++;
+    close_connection(gen);
+  }
+}
+
+void ESP32_RC_WIFI::on_writable(int fd) {
+  xSemaphoreTake(stream_mutex, portMAX_DELAY);
+  if (fd == conn_sock && write_stream()) net.watch(fd, ESP32_RC_NetLoop::READ);
+  xSemaphoreGive(stream_mutex);
+  notify_sender();
+}
+
+void ESP32_RC_WIFI::on_datarecv(const struct sockaddr_in &from, const uint8_t *data, int data_len, uint32_t rx_us) {
+  int status;
+
+  if (from.sin_addr.s_addr == local_ip) return;             // own broadcast
+  if (data_len < 1) {
+    recv_metric.err_count ++;
+    return;
+  }
+  uint8_t key[_RC_PEER_ADDR_LEN];
+  make_key(from, key);
+  bool is_peer = has_peer && memcmp(key, peer_key, _RC_PEER_ADDR_LEN) == 0;
+  if (is_peer) link_alive();
+
+  get_value(&connection_status, &status);
+
+  switch (_RC_FRAME_KIND(data[0])) {
+    // Handshake Hello received and send Ack
+    // also completes our own handshake, both sides may re-handshake at once after a link loss
+    // another address while the link is up is ignored, no take-over (TCP: the AP took the newest connection)
+    case _RC_FRAME_HANDSHAKE:
+      if (!tcp_mode && !is_peer && has_peer && status != _STATUS_CONN_IN_PROG) return;
+      set_primary(from);
+      peer_caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+      handshake_done();
+      op_send_ctrl(_RC_FRAME_HANDSHAKE_ACK);
+      empty_send_queue();
+      if (status == _STATUS_CONN_IN_PROG) set_value(&connection_status, _STATUS_CONN_OK);
+      return;
+
+    // check if handshake in progress, and process Ack
+    case _RC_FRAME_HANDSHAKE_ACK:
+      if (status != _STATUS_CONN_IN_PROG) return;
+      set_primary(from);
+      peer_caps = negotiate_caps(data, data_len) & ~_RC_CAP_DELTA;
+      handshake_done();
+      empty_send_queue();
+      empty_recv_queue();
+      set_value(&connection_status, _STATUS_CONN_OK);
+      return;
+
+    // received heartbeat, then return heartbeat Ack with our timestamps
+    case _RC_FRAME_HEARTBEAT: {
+      uint8_t ack[_RC_CTRL_FRAME_LEN];
+      op_send_ctrl(ack, create_heartbeat_ack(data, data_len, rx_us, ack), &from);
+      return;
+    }
+
+    // received heart beat ack, heart beat cycle completed, then turn off the LED
+    case _RC_FRAME_HEARTBEAT_ACK:
+      if (!is_peer) return;
+      on_heartbeat_ack(data, data_len, rx_us);
+      digitalWrite(BUILTIN_LED, LOW);
+      return;
+
+    // regular message
+    case _RC_FRAME_RAW:
+    case _RC_FRAME_COMPACT:
+    case _RC_FRAME_KEY:
+    case _RC_FRAME_DELTA:
+      if (!is_peer || status != _STATUS_CONN_OK) return;
+      recv_data_frame(data, data_len);
+      return;
+
+    default:
+      recv_metric.err_count ++;
+      return;
+  }
+}
+
+
 void ESP32_RC_WIFI::heartbeat_timer_callback(TimerHandle_t xTimer) {
-  instance->send_queue_msg();
+  ESP32_RC_WIFI *rc = static_cast<ESP32_RC_WIFI *>(pvTimerGetTimerID(xTimer));
+  rc->op_send_ctrl(_RC_FRAME_HEARTBEAT);
   digitalWrite(BUILTIN_LED, HIGH);
 }
 
@@ -225,9 +664,5 @@ void ESP32_RC_WIFI::heartbeat_timer_callback(TimerHandle_t xTimer) {
  */
 
 void ESP32_RC_WIFI::run(void* data) {
-  // Example: Add your task logic here
-  while (true) {
-    _DEBUG_("Running WiFi task...");
-    _DELAY_(1000);  // Simulate some work
-  }
-}
\ No newline at end of file
+  connect();
+}
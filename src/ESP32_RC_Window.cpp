@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ESP32_RC_Window.h>
+
+ESP32_RC_SendWindow::~ESP32_RC_SendWindow() {
+  free(buffer_base);
+  free(frame_base);
+  if (mutex != nullptr) vSemaphoreDelete(mutex);
+}
+
+bool ESP32_RC_SendWindow::create(size_t item_len, size_t frame_cap) {
+  stride       = (item_len + 7) & ~(size_t)7;                 // keep every buffer 8-byte aligned
+  buffer_base  = (uint8_t *)malloc(stride * _RC_SEND_WINDOW_MAX);
+  frame_stride = frame_cap;
+  frame_base   = (frame_cap > 0) ? (uint8_t *)malloc(frame_cap * _RC_SEND_WINDOW_MAX) : nullptr;
+  mutex        = xSemaphoreCreateMutex();
+  for (int i = 0; i < _RC_SEND_WINDOW_MAX; i++) {
+    slots[i].store(FREE);
+  }
+  record_head  = 0;
+  record_count = 0;
+  return (buffer_base != nullptr && mutex != nullptr && (frame_cap == 0 || frame_base != nullptr));
+}
+
+void ESP32_RC_SendWindow::set_size(int size) {
+  if (size < 1) size = 1;
+  if (size > _RC_SEND_WINDOW_MAX) size = _RC_SEND_WINDOW_MAX;
+  active = size;
+}
+
+void ESP32_RC_SendWindow::lock(void) {
+  if (mutex != nullptr) xSemaphoreTake(mutex, portMAX_DELAY);
+}
+
+void ESP32_RC_SendWindow::unlock(void) {
+  if (mutex != nullptr) xSemaphoreGive(mutex);
+}
+
+
+/*
+ * ========================================================
+ * Sender side
+ * ========================================================
+ */
+int ESP32_RC_SendWindow::acquire(uint8_t lane) {
+  int limit = (lane == 0 || active == 1) ? active : active - 1;
+  if (in_use() >= limit) return -1;
+  for (int i = 0; i < _RC_SEND_WINDOW_MAX; i++) {
+    if (slots[i].load(std::memory_order_acquire) == FREE) {
+      retry_count[i] = 0;
+      slot_lane[i]   = lane;
+      slot_seq[i]    = next_seq ++;
+      slot_frame_len[i] = 0;
+      slots[i].store(QUEUED, std::memory_order_release);
+      return i;
+    }
+  }
+  return -1;
+}
+
+void ESP32_RC_SendWindow::release(int slot) {
+  slots[slot].store(FREE, std::memory_order_release);
+}
+
+void ESP32_RC_SendWindow::mark(int slot, uint8_t state) {
+  slots[slot].store(state, std::memory_order_release);
+}
+
+int ESP32_RC_SendWindow::in_use(void) const {
+  int count = 0;
+  for (int i = 0; i < _RC_SEND_WINDOW_MAX; i++) {
+    if (slots[i].load(std::memory_order_acquire) != FREE) count ++;
+  }
+  return count;
+}
+
+
+/*
+ * ========================================================
+ * Radio side
+ *  - records are kept in send order, the radio completes in the same order
+ * ========================================================
+ */
+bool ESP32_RC_SendWindow::track(int slot, int delta_id, uint32_t now) {
+  if (record_count >= _RC_SEND_RECORDS) return false;
+  Record &rec  = records[(record_head + record_count) % _RC_SEND_RECORDS];
+  rec.slot     = (int8_t)slot;
+  rec.delta_id = (int16_t)delta_id;
+  rec.time     = now;
+  record_count ++;
+  if (slot >= 0) mark(slot, IN_FLIGHT);
+  return true;
+}
+
+void ESP32_RC_SendWindow::untrack(void) {
+  if (record_count == 0) return;
+  record_count --;
+  int slot = records[(record_head + record_count) % _RC_SEND_RECORDS].slot;
+  if (slot >= 0) mark(slot, QUEUED);
+}
+
+bool ESP32_RC_SendWindow::complete(bool success, Record &rec) {
+  if (record_count == 0) return false;
+  rec = records[record_head];
+  record_head = (record_head + 1) % _RC_SEND_RECORDS;
+  record_count --;
+
+  // records of cleared slots were detached by clear(), slot = -1
+  if (rec.slot >= 0) {
+    uint8_t expected = IN_FLIGHT;
+    slots[rec.slot].compare_exchange_strong(expected, success ? DONE : FAILED);
+  }
+  return true;
+}
+
+bool ESP32_RC_SendWindow::expire(uint32_t now, uint32_t timeout, Record &rec) {
+  if (record_count == 0 || now - records[record_head].time <= timeout) return false;
+  return complete(false, rec);
+}
+
+// the records stay, the radio still completes those frames, but they no longer point at a
+// slot: a freed slot is acquired again and its late completion must not touch the new frame
+void ESP32_RC_SendWindow::clear(void) {
+  lock();
+  for (int i = 0; i < record_count; i++) {
+    Record &rec  = records[(record_head + i) % _RC_SEND_RECORDS];
+    rec.slot     = -1;
+    rec.delta_id = -1;                                        // the codec starts over after a handshake
+  }
+  for (int i = 0; i < _RC_SEND_WINDOW_MAX; i++) {
+    slots[i].store(FREE);
+  }
+  unlock();
+}
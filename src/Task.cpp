@@ -115,4 +115,13 @@ void Task::setName(std::string name) {
  */
 void Task::setCore(BaseType_t coreId) {
 	m_coreId = coreId;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Get the FreeRTOS handle of the running task.
+ *
+ * @return The task handle, nullptr if the task is not started.
+ */
+TaskHandle_t Task::getHandle() const {
+	return m_handle;
+} // getHandle
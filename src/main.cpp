@@ -1,17 +1,25 @@
 #include <Arduino.h>
 #include <ESP32_RC_ESPNOW.h>
 #include <ESP32_RC_WIFI.h>
+#include <ESP32_RC_BLE.h>
+#include <ESP32_RC_NRF24.h>
+#include <ESP32_RC_UART.h>
 /*
  * ESPNOW bi-directional communication sample
  * Both controllor/executor using the exactly same code as blow.
+ * Swap the transport below to compare ESPNOW, WiFi (UDP), BLE, nRF24 and UART, the printout is the same:
+ *  count : ms per message : RTT us : lost : last message
  *
 */
 
 
 
-ESP32_RC_ESPNOW rc_controller(false, true);
-//ESP32_RC_WIFI   rc_controller(false, true);
-//ESP32_RC_ESPNOW rc_controller(_ROLE_EXECUTOR, false, true);
+ESP32_RC<ESP32_RC_ESPNOW> rc_controller(false, true);
+//ESP32_RC<ESP32_RC_WIFI>   rc_controller(false, true);
+//ESP32_RC<ESP32_RC_BLE>    rc_controller(false, true);
+//ESP32_RC<ESP32_RC_NRF24>  rc_controller(false, true);
+//ESP32_RC<ESP32_RC_UART>   rc_controller(false, true);
+//ESP32_RC<ESP32_RC_ESPNOW, MyMessage> rc_controller(false, true);   // any trivially copyable struct
 unsigned long count = 0; 
 
 
@@ -19,6 +27,7 @@ unsigned long start_time = millis();
 unsigned long total_bytes = 0;
 Message send_data;
 Message recv_data;
+ESP32_RC_LinkStats::Snapshot stats;
 int cycle_count = 100;
 
 
@@ -40,11 +49,12 @@ void loop() {
   strcpy(send_data.msg1, str.c_str());
   send_data.a1 = millis();
   rc_controller.send(send_data);
-  recv_data = rc_controller.recv();
-  _DELAY_(10);
+  rc_controller.recv(recv_data, 10);         // returns as soon as a message arrives
   if (count % cycle_count == 0) {
     unsigned long time_taken = millis() - start_time;
-    Serial.println(String(count) + " : " + String((float)int(time_taken/cycle_count*100)/100) + " : " + String(recv_data.msg1) + " : " + String(recv_data.a1) );
+    rc_controller.get_link_stats(stats);
+    Serial.println(String(count) + " : " + String((float)int(time_taken/cycle_count*100)/100) + " : " + String(rc_controller.get_link_clock().srtt())
+                   + " : " + String(stats.lost) + " : " + String(recv_data.msg1) + " : " + String(recv_data.a1) );
     start_time = millis();
     total_bytes = 0;
   };
@@ -0,0 +1,76 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+
+/*
+ *
+ * Host Arduino
+ *
+ * The part of the Arduino core the library uses, see host_arduino.cpp. Serial prints to stderr,
+ * the pins do nothing, millis() / micros() count from the start of the process and wrap at
+ * 32 bit like on the ESP32.
+ *
+ */
+
+#define BUILTIN_LED               2
+#define INPUT                     0x01
+#define OUTPUT                    0x03
+#define LOW                       0
+#define HIGH                      1
+
+class String {
+  public:
+    String(const char *text = "") : text(text != nullptr ? text : "") {}
+    String(const std::string &text) : text(text) {}
+    String(char c) : text(1, c) {}
+    String(int value) : text(std::to_string(value)) {}
+    String(unsigned int value) : text(std::to_string(value)) {}
+    String(long value) : text(std::to_string(value)) {}
+    String(unsigned long value) : text(std::to_string(value)) {}
+    String(long long value) : text(std::to_string(value)) {}
+    String(unsigned long long value) : text(std::to_string(value)) {}
+    String(double value, unsigned int decimals = 2);
+
+    String operator+(const String &other) const { return String(text + other.text); }
+    friend String operator+(const char *left, const String &right) { return String(left) + right; }
+    String &operator+=(const String &other) { text += other.text; return *this; }
+    bool operator==(const String &other) const { return text == other.text; }
+
+    const char *c_str(void) const { return text.c_str(); }
+    size_t length(void) const { return text.size(); }
+    bool isEmpty(void) const { return text.empty(); }
+
+  private:
+    std::string text;
+};
+
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud) {}
+    void print(const String &text);
+    void println(const String &text = String());
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
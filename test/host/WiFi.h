@@ -0,0 +1,54 @@
+#pragma once
+#include <stdint.h>
+#include <arpa/inet.h>
+
+/*
+ *
+ * Host Arduino WiFi
+ *
+ * One private network on loopback, for two ESP32_RC_WIFI in one process, see host_wifi.cpp.
+ * softAP() opens it as 127.0.0.1, begin() joins it as 127.0.0.2 once another thread opened
+ * it, so of two connect() at once the first to give up joining is the AP, like on the air.
+ * Loopback has no broadcast, the broadcast address of each end is the other end.
+ *
+ * Note:
+ *  - host_wifi_reset() closes the network, the next pair starts over.
+ *
+ */
+
+#define WIFI_AP_STA               3
+#define WL_CONNECTED              3
+#define WL_DISCONNECTED           6
+
+#define HOST_WIFI_AP_IP           "127.0.0.1"
+#define HOST_WIFI_STA_IP          "127.0.0.2"
+
+// an IPv4 address in network order, like the Arduino one converts to uint32_t
+class IPAddress {
+  public:
+    IPAddress(uint32_t addr = 0) : addr(addr) {}
+    operator uint32_t() const { return addr; }
+
+  private:
+    uint32_t addr;
+};
+
+class WiFiClass {
+  public:
+    bool mode(int mode) { return true; }
+    bool setSleep(bool enable) { return true; }
+    int begin(const char *ssid, const char *password);
+    int status(void);
+    bool disconnect(void) { return true; }
+    bool softAP(const char *ssid, const char *password);
+
+    IPAddress localIP(void)             { return IPAddress(inet_addr(HOST_WIFI_STA_IP)); }
+    IPAddress gatewayIP(void)           { return IPAddress(inet_addr(HOST_WIFI_AP_IP)); }
+    IPAddress broadcastIP(void)         { return IPAddress(inet_addr(HOST_WIFI_AP_IP)); }
+    IPAddress softAPIP(void)            { return IPAddress(inet_addr(HOST_WIFI_AP_IP)); }
+    IPAddress softAPBroadcastIP(void)   { return IPAddress(inet_addr(HOST_WIFI_STA_IP)); }
+};
+
+extern WiFiClass WiFi;
+
+void host_wifi_reset(void);
@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+
+/*
+ *
+ * Host ESP-IDF UART driver
+ *
+ * Only so ESP32_RC_UartPort compiles, every call fails. Host tests give ESP32_RC_UART a port
+ * of their own with set_port().
+ *
+ */
+
+typedef int esp_err_t;
+#define ESP_OK                    0
+#define ESP_FAIL                  -1
+
+typedef int uart_port_t;
+#define UART_NUM_0                0
+#define UART_NUM_1                1
+#define UART_NUM_2                2
+#define UART_PIN_NO_CHANGE        -1
+
+enum { UART_DATA_8_BITS = 3 };
+enum { UART_PARITY_DISABLE = 0 };
+enum { UART_STOP_BITS_1 = 1 };
+enum { UART_HW_FLOWCTRL_DISABLE = 0 };
+enum { UART_SCLK_APB = 1 };
+
+struct uart_config_t {
+  int baud_rate;
+  int data_bits;
+  int parity;
+  int stop_bits;
+  int flow_ctrl;
+  uint8_t rx_flow_ctrl_thresh;
+  int source_clk;
+};
+
+inline esp_err_t uart_driver_install(uart_port_t, int, int, int, void *, int) { return ESP_FAIL; }
+inline esp_err_t uart_driver_delete(uart_port_t) { return ESP_OK; }
+inline esp_err_t uart_param_config(uart_port_t, const uart_config_t *) { return ESP_FAIL; }
+inline esp_err_t uart_set_pin(uart_port_t, int, int, int, int) { return ESP_FAIL; }
+inline esp_err_t uart_set_rx_timeout(uart_port_t, uint8_t) { return ESP_FAIL; }
+inline int uart_read_bytes(uart_port_t, void *, uint32_t, TickType_t) { return -1; }
+inline int uart_write_bytes(uart_port_t, const void *, size_t) { return -1; }
+inline esp_err_t uart_get_buffered_data_len(uart_port_t, size_t *size) { *size = 0; return ESP_FAIL; }
+inline esp_err_t uart_get_tx_buffer_free_size(uart_port_t, size_t *size) { *size = 0; return ESP_FAIL; }
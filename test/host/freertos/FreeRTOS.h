@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ *
+ * Host FreeRTOS
+ *
+ * Just enough of the ESP-IDF FreeRTOS API for the library to run on Linux, see host_rtos.cpp.
+ * One tick is one millisecond, a task is a std::thread, a timer callback runs in one timer thread
+ * like the FreeRTOS timer task.
+ *
+ * Note:
+ *  - vTaskDelete() of another task only forgets it, a thread can not be killed. Tests keep every
+ *    transport alive until the process ends.
+ *  - priorities and cores are ignored, the host scheduler decides.
+ *
+ */
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+struct HostTask;
+struct HostSemaphore;
+struct HostTimer;
+typedef HostTask      *TaskHandle_t;
+typedef TaskHandle_t   xTaskHandle;
+typedef HostSemaphore *SemaphoreHandle_t;
+typedef HostTimer     *TimerHandle_t;
+
+#define pdTRUE                    1
+#define pdFALSE                   0
+#define pdPASS                    pdTRUE
+#define pdFAIL                    pdFALSE
+#define portMAX_DELAY             ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS        1
+#define configTICK_RATE_HZ        1000
+#define pdMS_TO_TICKS(ms)         ((TickType_t)(ms))
+#define tskNO_AFFINITY            0x7FFFFFFF
+
+BaseType_t xPortGetCoreID(void);
@@ -0,0 +1,61 @@
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <Arduino.h>
+
+HardwareSerial Serial;
+
+static const auto start_time = std::chrono::steady_clock::now();
+static std::mt19937 generator(1);
+static std::mutex generator_mutex;
+
+String::String(double value, unsigned int decimals) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+  text = buffer;
+}
+
+void HardwareSerial::print(const String &text) {
+  fputs(text.c_str(), stderr);
+}
+
+void HardwareSerial::println(const String &text) {
+  fprintf(stderr, "%s\n", text.c_str());
+}
+
+unsigned long millis(void) {
+  auto elapsed = std::chrono::steady_clock::now() - start_time;
+  return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+}
+
+unsigned long micros(void) {
+  auto elapsed = std::chrono::steady_clock::now() - start_time;
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+int digitalRead(uint8_t pin) { return LOW; }
+
+long random(long max) {
+  std::lock_guard<std::mutex> guard(generator_mutex);
+  return (max > 0) ? (long)(generator() % (unsigned long)max) : 0;
+}
+
+long random(long min, long max) {
+  return (max > min) ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+  std::lock_guard<std::mutex> guard(generator_mutex);
+  generator.seed(seed);
+}
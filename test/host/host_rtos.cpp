@@ -0,0 +1,278 @@
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/timers.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static const Clock::time_point start_time = Clock::now();
+
+// portMAX_DELAY waits for ever, anything else is a deadline in ms
+static bool wait_for(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks,
+                     const std::function<bool()> &ready) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+BaseType_t xPortGetCoreID(void) {
+  return 0;
+}
+
+
+/*
+ * ========================================================
+ * Tasks
+ *  - a thread each, the notification value is a counter
+ *  - threads not created here (main, timer) get their
+ *    HostTask on first use
+ * ========================================================
+ */
+struct HostTask {
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+};
+
+struct HostTaskExit {};                                       // vTaskDelete(self) unwinds the thread
+
+static thread_local HostTask *current_task = nullptr;
+
+static HostTask *self(void) {
+  if (current_task == nullptr) current_task = new HostTask();
+  return current_task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stack_depth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id) {
+  HostTask *task = new HostTask();
+  if (created_task != nullptr) *created_task = task;
+  std::thread([code, parameters, task]() {
+    current_task = task;
+    try {
+      code(parameters);
+    } catch (HostTaskExit &) {
+    }
+  }).detach();
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr || task == current_task) throw HostTaskExit();
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start_time).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  return self();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  {
+    std::lock_guard<std::mutex> guard(task->mutex);
+    task->notify ++;
+  }
+  task->cv.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+  HostTask *task = self();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  wait_for(task->cv, lock, ticks, [task] { return task->notify > 0; });
+  uint32_t value = task->notify;
+  if (value > 0) task->notify = clear_on_exit ? 0 : value - 1;
+  return value;
+}
+
+
+/*
+ * ========================================================
+ * Semaphores
+ *  - mutex = binary semaphore given once at create
+ *  - recursive mutex counts the takes of its owner
+ * ========================================================
+ */
+struct HostSemaphore {
+  std::mutex mutex;
+  std::condition_variable cv;
+  int count = 0;
+  int depth = 0;                                              // recursive only
+  std::thread::id owner;
+};
+
+static SemaphoreHandle_t create_semaphore(int count) {
+  HostSemaphore *semaphore = new HostSemaphore();
+  semaphore->count = count;
+  return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return create_semaphore(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+  return create_semaphore(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+  return create_semaphore(0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+  delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  if (!wait_for(semaphore->cv, lock, ticks, [semaphore] { return semaphore->count > 0; })) return pdFALSE;
+  semaphore->count = 0;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  {
+    std::lock_guard<std::mutex> guard(semaphore->mutex);
+    if (semaphore->count > 0) return pdFALSE;
+    semaphore->count = 1;
+  }
+  semaphore->cv.notify_one();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  if (semaphore->depth > 0 && semaphore->owner == std::this_thread::get_id()) {
+    semaphore->depth ++;
+    return pdTRUE;
+  }
+  if (!wait_for(semaphore->cv, lock, ticks, [semaphore] { return semaphore->count > 0; })) return pdFALSE;
+  semaphore->count = 0;
+  semaphore->depth = 1;
+  semaphore->owner = std::this_thread::get_id();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+  {
+    std::lock_guard<std::mutex> guard(semaphore->mutex);
+    if (semaphore->depth == 0 || semaphore->owner != std::this_thread::get_id()) return pdFALSE;
+    if (-- semaphore->depth > 0) return pdTRUE;
+    semaphore->owner = std::thread::id();
+    semaphore->count = 1;
+  }
+  semaphore->cv.notify_one();
+  return pdTRUE;
+}
+
+
+/*
+ * ========================================================
+ * Timers
+ *  - one timer thread runs all callbacks, in due order
+ *  - deleted timers are only stopped, a callback may be
+ *    running on them
+ * ========================================================
+ */
+struct HostTimer {
+  TickType_t period = 0;
+  bool is_auto_reload = false;
+  void *timer_id = nullptr;
+  TimerCallbackFunction_t callback = nullptr;
+  bool is_active = false;
+  Clock::time_point due;
+};
+
+static std::mutex timer_mutex;
+static std::condition_variable timer_cv;
+static std::vector<HostTimer *> timers;
+
+static void timer_loop(void) {
+  std::unique_lock<std::mutex> lock(timer_mutex);
+  while (true) {
+    HostTimer *next = nullptr;
+    for (HostTimer *timer : timers) {
+      if (timer->is_active && (next == nullptr || timer->due < next->due)) next = timer;
+    }
+    if (next == nullptr) {
+      timer_cv.wait(lock);
+      continue;
+    }
+    if (Clock::now() < next->due) {
+      timer_cv.wait_until(lock, next->due);
+      continue;
+    }
+    if (next->is_auto_reload) next->due += std::chrono::milliseconds(next->period);
+    else next->is_active = false;
+
+    lock.unlock();
+    next->callback(next);
+    lock.lock();
+  }
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *timer_id,
+                           TimerCallbackFunction_t callback) {
+  static std::once_flag started;
+  std::call_once(started, [] { std::thread(timer_loop).detach(); });
+
+  HostTimer *timer      = new HostTimer();
+  timer->period         = period;
+  timer->is_auto_reload = (auto_reload != pdFALSE);
+  timer->timer_id       = timer_id;
+  timer->callback       = callback;
+  std::lock_guard<std::mutex> guard(timer_mutex);
+  timers.push_back(timer);
+  return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks) {
+  {
+    std::lock_guard<std::mutex> guard(timer_mutex);
+    timer->is_active = true;
+    timer->due       = Clock::now() + std::chrono::milliseconds(timer->period);
+  }
+  timer_cv.notify_one();
+  return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks) {
+  return xTimerStart(timer, ticks);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks) {
+  std::lock_guard<std::mutex> guard(timer_mutex);
+  timer->is_active = false;
+  return pdPASS;
+}
+
+// as in FreeRTOS, a dormant timer starts
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks) {
+  {
+    std::lock_guard<std::mutex> guard(timer_mutex);
+    timer->period = period;
+  }
+  return xTimerStart(timer, ticks);
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks) {
+  return xTimerStop(timer, ticks);
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) {
+  return timer->timer_id;
+}
@@ -0,0 +1,29 @@
+#include <mutex>
+#include <thread>
+#include <WiFi.h>
+
+WiFiClass WiFi;
+
+static std::mutex network_mutex;
+static std::thread::id ap_thread;                           // opened the network, none = closed
+
+int WiFiClass::begin(const char *ssid, const char *password) {
+  return status();
+}
+
+int WiFiClass::status(void) {
+  std::lock_guard<std::mutex> guard(network_mutex);
+  bool is_joined = ap_thread != std::thread::id() && ap_thread != std::this_thread::get_id();
+  return is_joined ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+bool WiFiClass::softAP(const char *ssid, const char *password) {
+  std::lock_guard<std::mutex> guard(network_mutex);
+  if (ap_thread == std::thread::id()) ap_thread = std::this_thread::get_id();
+  return true;
+}
+
+void host_wifi_reset(void) {
+  std::lock_guard<std::mutex> guard(network_mutex);
+  ap_thread = std::thread::id();
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *
+ * Host test helpers
+ *
+ * A test is a plain executable, CHECK() counts failures and rc_finish() ends the process with
+ * the result. Benchmarks print their numbers and only CHECK() what must hold on any machine
+ * (ordering, loose bounds), never absolute timings.
+ *
+ * Note:
+ *  - rc_finish() calls _exit(), the transports and their tasks are never destroyed (a thread
+ *    can not be killed, see freertos/FreeRTOS.h).
+ *
+ * Benchmark runners, shared by every transport:
+ *  rc_round_trips()  : request / reply, one at a time, the latency of each
+ *  rc_throughput()   : send as fast as send() returns, messages / second that arrived
+ *  rc_paced()        : the same with at most window messages in flight, for links without
+ *                      flow control (UDP), which lose what the receiver does not take in time
+ * The transport side only has to send message i and post(i) what arrives to ESP32_RC_Arrivals.
+ *
+ * Sample:
+ *  ESP32_RC_Latency latency;
+ *  uint64_t start = rc_now_us();
+ *  ...
+ *  latency.add(rc_now_us() - start);
+ *  latency.print("udp");
+ *  CHECK(latency.percentile(99) < 50000);
+ *  return rc_finish();
+ *
+ */
+
+static int rc_failures = 0;
+
+#define CHECK(cond)                                                                     \
+  do {                                                                                  \
+    if (!(cond)) {                                                                      \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);          \
+      rc_failures ++;                                                                   \
+    }                                                                                   \
+  } while (0)
+
+inline int rc_finish(void) {
+  printf("%s\n", rc_failures ? "FAILED" : "OK");
+  fflush(stdout);
+  fflush(stderr);
+  _exit(rc_failures ? 1 : 0);
+}
+
+inline uint64_t rc_now_us(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t rc_now_ns(void) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class ESP32_RC_Latency {
+  public:
+    void add(uint64_t sample) { samples.push_back(sample); }
+    size_t count(void) const { return samples.size(); }
+
+    // nearest rank, 0 if empty
+    uint64_t percentile(double p) {
+      if (samples.empty()) return 0;
+      std::sort(samples.begin(), samples.end());
+      size_t rank = (size_t)(p / 100.0 * (samples.size() - 1) + 0.5);
+      return samples[std::min(rank, samples.size() - 1)];
+    }
+
+    uint64_t max(void) { return percentile(100); }
+
+    void print(const char *name, const char *unit = "us") {
+      printf("%-28s n=%-7zu p50=%-8llu p99=%-8llu max=%llu %s\n", name, count(),
+             (unsigned long long)percentile(50), (unsigned long long)percentile(99),
+             (unsigned long long)max(), unit);
+    }
+
+  private:
+    std::vector<uint64_t> samples;
+};
+
+// connect() blocks until the handshake is done, both peers at once
+template <class A, class B>
+void rc_connect_pair(A &a, B &b) {
+  std::thread other([&b] { b.connect(); });
+  a.connect();
+  other.join();
+}
+
+// what arrived so far, posted from a receive task, waited for by the benchmark
+class ESP32_RC_Arrivals {
+  public:
+    void post(int index) {
+      std::lock_guard<std::mutex> guard(mutex);
+      last = index;
+      count ++;
+      cv.notify_all();
+    }
+
+    bool wait(int index, uint32_t timeout_ms) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return last == index; });
+    }
+
+    // at least count arrived, for senders that keep a window in flight
+    bool wait_received(int count, uint32_t timeout_ms) {
+      std::unique_lock<std::mutex> lock(mutex);
+      return cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return this->count >= count; });
+    }
+
+    int received(void) {
+      std::lock_guard<std::mutex> guard(mutex);
+      return count;
+    }
+
+    void reset(void) {
+      std::lock_guard<std::mutex> guard(mutex);
+      last  = -1;
+      count = 0;
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int last  = -1;
+    int count = 0;
+};
+
+// send(i) sends request i, the reply must be posted as i, a lost one counts as timeout_ms
+template <class Send>
+ESP32_RC_Latency rc_round_trips(int rounds, ESP32_RC_Arrivals &replies, Send send, int &timeouts,
+                                uint32_t timeout_ms = 200) {
+  ESP32_RC_Latency latency;
+  timeouts = 0;
+  replies.reset();
+  for (int i = 0; i < rounds; i++) {
+    uint64_t start = rc_now_us();
+    send(i);
+    if (replies.wait(i, timeout_ms)) {
+      latency.add(rc_now_us() - start);
+    } else {
+      latency.add(timeout_ms * 1000ULL);
+      timeouts ++;
+    }
+  }
+  return latency;
+}
+
+// send(i) for every message, then waits drain_ms for the rest, messages / second received
+template <class Send>
+double rc_throughput(int count, ESP32_RC_Arrivals &arrivals, Send send, uint32_t drain_ms = 200) {
+  arrivals.reset();
+  uint64_t start = rc_now_us();
+  for (int i = 0; i < count; i++) {
+    send(i);
+  }
+  arrivals.wait(count - 1, drain_ms);
+  return arrivals.received() / ((rc_now_us() - start) / 1e6);
+}
+
+// send(i) once fewer than window messages are in flight, a lost one holds the window for
+// wait_ms, messages / second received
+template <class Send>
+double rc_paced(int count, ESP32_RC_Arrivals &arrivals, Send send, int window, uint32_t wait_ms = 200) {
+  arrivals.reset();
+  uint64_t start = rc_now_us();
+  for (int i = 0; i < count; i++) {
+    if (i >= window) arrivals.wait_received(i - window + 1, wait_ms);
+    send(i);
+  }
+  arrivals.wait_received(count, wait_ms);
+  return arrivals.received() / ((rc_now_us() - start) / 1e6);
+}
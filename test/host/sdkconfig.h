@@ -0,0 +1,2 @@
+#pragma once
+// host build, no ESP-IDF configuration
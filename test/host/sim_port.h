@@ -0,0 +1,170 @@
+#pragma once
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <ESP32_RC_Serial.h>
+
+/*
+ *
+ * Simulated serial wire
+ *
+ * Two ESP32_RC_SerialPort ends in memory. A write takes len * 10 / baud seconds on the wire
+ * (8N1), in write order. Like the UART driver the receiver gets the bytes per rx_threshold
+ * (the RX FIFO threshold) as they come in, and the rest at the end of the write (RX timeout).
+ * The TX side holds at most tx_buffer bytes not yet on the wire, a write blocks until its bytes
+ * fit, tx_pending() tells how many are left.
+ *
+ *  loss_percent    : a whole write is lost (the receiver resyncs at the next 0x00)
+ *  spike_percent   : a write is held back spike_us more, and everything behind it
+ *  is_failing      : write() returns -1, nothing is sent
+ *
+ * Sample:
+ *  ESP32_RC_SimWire wire(460800);
+ *  rc_a.set_port(&wire.a, 460800);
+ *  rc_b.set_port(&wire.b, 460800);
+ *
+ */
+
+struct ESP32_RC_SimLine {
+  typedef std::chrono::steady_clock Clock;
+
+  struct Chunk {
+    Clock::time_point ready;
+    std::vector<uint8_t> data;
+    size_t offset;
+  };
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Chunk> chunks;
+  Clock::time_point tx_free = Clock::now();                   // the wire is busy until then
+  Clock::time_point last_ready = Clock::now();
+  std::mt19937 rng{7};
+
+  uint32_t baud          = 115200;
+  size_t   tx_buffer     = 4096;
+  size_t   rx_threshold  = 120;
+  int      loss_percent  = 0;
+  int      spike_percent = 0;
+  uint32_t spike_us      = 0;
+  bool     is_failing    = false;
+  uint32_t write_count   = 0;
+  uint32_t lost_count    = 0;
+  uint32_t failed_count  = 0;
+
+  std::chrono::microseconds wire_time(size_t len) const {
+    return std::chrono::microseconds((uint64_t)len * 10 * 1000000 / baud);
+  }
+
+  int write(const uint8_t *data, size_t len) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (is_failing) {
+      failed_count ++;
+      return -1;
+    }
+
+    // wait for room in the TX buffer, a write longer than the buffer goes once it is empty
+    while (true) {
+      Clock::time_point now = Clock::now();
+      Clock::duration pending = std::max(now, tx_free) - now;
+      Clock::duration excess  = pending + wire_time(len) - wire_time(tx_buffer);
+      if (excess <= Clock::duration::zero() || pending == Clock::duration::zero()) break;
+      lock.unlock();
+      std::this_thread::sleep_for(excess);
+      lock.lock();
+    }
+    tx_free = std::max(Clock::now(), tx_free) + wire_time(len);
+    write_count ++;
+
+    if ((int)(rng() % 100) < loss_percent) {
+      lost_count ++;
+      return (int)len;
+    }
+    Clock::time_point ready = tx_free;
+    if ((int)(rng() % 100) < spike_percent) ready += std::chrono::microseconds(spike_us);
+    ready      = std::max(ready, last_ready);
+    last_ready = ready;
+    chunks.push_back({ready, std::vector<uint8_t>(data, data + len), 0});
+    cv.notify_all();
+    return (int)len;
+  }
+
+  int pending(void) {
+    std::lock_guard<std::mutex> guard(mutex);
+    Clock::time_point now = Clock::now();
+    if (tx_free <= now) return 0;
+    return (int)((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(tx_free - now).count() * baud / 10 / 1000000);
+  }
+
+  // bytes of the chunk handed over by now, whole rx_threshold blocks until its last byte is in
+  size_t arrived(const Chunk &chunk, Clock::time_point now) const {
+    if (now >= chunk.ready) return chunk.data.size();
+    Clock::time_point start = chunk.ready - wire_time(chunk.data.size());
+    if (now <= start) return 0;
+    size_t bytes = (size_t)((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(now - start).count() * baud / 10 / 1000000);
+    return std::min(bytes / rx_threshold * rx_threshold, chunk.data.size());
+  }
+
+  // when the next block of the chunk is handed over
+  Clock::time_point next_arrival(const Chunk &chunk) const {
+    size_t next = std::min((chunk.offset / rx_threshold + 1) * rx_threshold, chunk.data.size());
+    if (next == chunk.data.size()) return chunk.ready;
+    return chunk.ready - wire_time(chunk.data.size()) + wire_time(next);
+  }
+
+  int read(uint8_t *data, size_t len, uint32_t timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (chunks.empty() || arrived(chunks.front(), Clock::now()) <= chunks.front().offset) {
+      Clock::time_point until = chunks.empty() ? deadline : std::min(deadline, next_arrival(chunks.front()));
+      if (Clock::now() >= deadline) return 0;
+      cv.wait_until(lock, until);
+    }
+
+    size_t got = 0;
+    Clock::time_point now = Clock::now();
+    while (got < len && !chunks.empty()) {
+      Chunk &chunk = chunks.front();
+      size_t n = std::min(len - got, arrived(chunk, now) - chunk.offset);
+      if (n == 0) break;
+      memcpy(data + got, chunk.data.data() + chunk.offset, n);
+      got += n;
+      chunk.offset += n;
+      if (chunk.offset == chunk.data.size()) chunks.pop_front();
+    }
+    return (int)got;
+  }
+};
+
+class ESP32_RC_SimPort : public ESP32_RC_SerialPort {
+  public:
+    ESP32_RC_SimPort(ESP32_RC_SimLine &tx, ESP32_RC_SimLine &rx) : tx(tx), rx(rx) {}
+
+    bool open(uint32_t baud) override { tx.baud = baud; return true; }
+    void close(void) override {}
+    int read(uint8_t *data, size_t len, uint32_t timeout_ms) override { return rx.read(data, len, timeout_ms); }
+    int write(const uint8_t *data, size_t len) override { return tx.write(data, len); }
+    int tx_pending(void) override { return tx.pending(); }
+
+  private:
+    ESP32_RC_SimLine &tx;
+    ESP32_RC_SimLine &rx;
+};
+
+struct ESP32_RC_SimWire {
+  ESP32_RC_SimLine a_to_b;
+  ESP32_RC_SimLine b_to_a;
+  ESP32_RC_SimPort a{a_to_b, b_to_a};
+  ESP32_RC_SimPort b{b_to_a, a_to_b};
+
+  ESP32_RC_SimWire(uint32_t baud) {
+    a_to_b.baud = baud;
+    b_to_a.baud = baud;
+  }
+};
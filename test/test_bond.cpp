@@ -0,0 +1,136 @@
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ESP32_RC_UART.h>
+#include <ESP32_RC_Bond.h>
+#include "rc_test.h"
+#include "sim_port.h"
+
+/*
+ * Bond benchmark: ESP32_RC_Bond<UART, UART> against a single UART path. Every wire loses
+ * LOSS_PERCENT of its writes and holds SPIKE_PERCENT of them back SPIKE_US, independently.
+ * A message every PERIOD_MS, latency is send() to on_message() of the messages that arrived,
+ * the lost ones are counted apart: loss and the spikes of the delivered ones each on their own.
+ */
+
+#define BAUD            460800
+#define MESSAGES        400
+#define PERIOD_MS       10
+#define LOSS_PERCENT    5
+#define SPIKE_PERCENT   5
+#define SPIKE_US        30000
+
+typedef ESP32_RC<ESP32_RC_UART> UartRC;
+typedef ESP32_RC<ESP32_RC_Bond<ESP32_RC_UART, ESP32_RC_UART>> BondRC;
+
+static std::mutex result_mutex;
+static std::vector<uint64_t> arrival_us;                     // by message index, 0 = not yet
+static std::atomic<int> duplicates{0};
+
+static void on_message(const Message &msg) {
+  int index;
+  uint64_t sent;
+  memcpy(&index, msg.msg1, sizeof(index));
+  memcpy(&sent, msg.msg3, sizeof(sent));
+  std::lock_guard<std::mutex> guard(result_mutex);
+  if (index < 0 || index >= MESSAGES) return;
+  if (arrival_us[index] != 0) duplicates ++;
+  else arrival_us[index] = rc_now_us() - sent + 1;
+}
+
+static void impair(ESP32_RC_SimWire &wire, uint32_t seed) {
+  for (ESP32_RC_SimLine *line : {&wire.a_to_b, &wire.b_to_a}) {
+    std::lock_guard<std::mutex> guard(line->mutex);
+    line->rng.seed(seed++);
+    line->loss_percent  = LOSS_PERCENT;
+    line->spike_percent = SPIKE_PERCENT;
+    line->spike_us      = SPIKE_US;
+  }
+}
+
+template <class RC>
+static ESP32_RC_Latency run(const char *name, RC &sender, int &lost) {
+  {
+    std::lock_guard<std::mutex> guard(result_mutex);
+    arrival_us.assign(MESSAGES, 0);
+    duplicates = 0;
+  }
+  Message msg = {};
+  msg.is_set = true;
+  for (int i = 0; i < MESSAGES; i++) {
+    uint64_t now = rc_now_us();
+    memcpy(msg.msg1, &i, sizeof(i));
+    memcpy(msg.msg3, &now, sizeof(now));
+    msg.a1 = (float)i;
+    sender.send(msg);
+    std::this_thread::sleep_for(std::chrono::milliseconds(PERIOD_MS));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+  ESP32_RC_Latency latency;
+  lost = 0;
+  std::lock_guard<std::mutex> guard(result_mutex);
+  for (uint64_t us : arrival_us) {
+    if (us == 0) lost ++;
+    else latency.add(us);
+  }
+  printf("%-12s lost %3d / %d  duplicates %3d  ", name, lost, MESSAGES, duplicates.load());
+  latency.print("latency", "us");
+  return latency;
+}
+
+int main(void) {
+  arrival_us.assign(MESSAGES, 0);
+
+  static ESP32_RC_SimWire single_wire(BAUD);
+  static UartRC single_a, single_b;
+  single_a.set_port(&single_wire.a, BAUD);
+  single_b.set_port(&single_wire.b, BAUD);
+  single_b.on_message(on_message);
+  single_a.init();
+  single_b.init();
+  rc_connect_pair(single_a, single_b);
+
+  static ESP32_RC_SimWire wire_1(BAUD), wire_2(BAUD);
+  static BondRC bond_a, bond_b;
+  static_cast<ESP32_RC_UART &>(bond_a.path(0)).set_port(&wire_1.a, BAUD);
+  static_cast<ESP32_RC_UART &>(bond_b.path(0)).set_port(&wire_1.b, BAUD);
+  static_cast<ESP32_RC_UART &>(bond_a.path(1)).set_port(&wire_2.a, BAUD);
+  static_cast<ESP32_RC_UART &>(bond_b.path(1)).set_port(&wire_2.b, BAUD);
+  bond_b.on_message(on_message);
+  bond_a.init();
+  bond_b.init();
+  rc_connect_pair(bond_a, bond_b);
+  for (int wait = 0; wait < 2000; wait++) {
+    bool is_up = true;
+    for (int i = 0; i < _RC_BOND_PATHS; i++) {
+      is_up = is_up && bond_a.path(i).is_connected() && bond_b.path(i).is_connected();
+    }
+    if (is_up) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  // loss and spikes only once connected, a lost hello costs a handshake timeout
+  impair(single_wire, 1);
+  impair(wire_1, 11);
+  impair(wire_2, 21);
+
+  printf("%d baud, %d%% writes lost, %d%% held back %d ms, one message every %d ms\n",
+         BAUD, LOSS_PERCENT, SPIKE_PERCENT, SPIKE_US / 1000, PERIOD_MS);
+  int single_lost, bond_lost;
+  ESP32_RC_Latency single = run("single path", single_a, single_lost);
+  ESP32_RC_Latency bond   = run("bond", bond_a, bond_lost);
+
+  printf("bond dropped %u second copies\n", bond_b.get_duplicates());
+
+  // a message is only late or lost if both copies are: fewer lost, and of the ones that
+  // arrived fewer held back, one spiked copy in 20 is above p99 of a single path
+  CHECK(single_lost > 0);
+  CHECK(duplicates == 0 && bond_b.get_duplicates() > 0);
+  CHECK(bond_lost < single_lost);
+  CHECK(bond.percentile(99) < single.percentile(99));
+  CHECK(bond.percentile(50) < 3 * single.percentile(50) + 1000);
+
+  return rc_finish();
+}
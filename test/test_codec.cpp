@@ -0,0 +1,187 @@
+#include <string.h>
+#include <math.h>
+#include <set>
+#include <ESP32_RC_Common.h>
+#include <ESP32_RC_Codec.h>
+#include "rc_test.h"
+
+/*
+ * Codec benchmark: bytes on air and encode / decode cost per frame of the raw, compact, delta
+ * and quantized + delta formats, for a telemetry stream where a few channels move per frame.
+ * Every frame is decoded again and compared, so the numbers are for working codecs.
+ */
+
+#define FRAMES          20000
+#define STEP(lo, hi, b) (((hi) - (lo)) / ((1 << (b)) - 1))
+
+static const ESP32_RC_QuantProfile profiles[] = {
+  _RC_QUANT_PROFILE(Message, a1, -1.0, 1.0, 12),
+  _RC_QUANT_PROFILE(Message, a2, -1.0, 1.0, 12),
+  _RC_QUANT_PROFILE(Message, a3, -1.0, 1.0, 12),
+  _RC_QUANT_PROFILE(Message, a4, -1.0, 1.0, 12),
+  _RC_QUANT_PROFILE(Message, b1,  0.0, 5.0, 10),
+  _RC_QUANT_PROFILE(Message, b2,  0.0, 5.0, 10),
+};
+static const int profile_count = sizeof(profiles) / sizeof(profiles[0]);
+
+// sticks move every frame, the battery now and then, the rest stays
+static void make_stream(Message *stream, int count) {
+  Message msg = {};
+  msg.is_set = true;
+  strcpy(msg.msg1, "executor ok");
+  msg.b1 = 4.2f;
+  msg.b2 = 3.7f;
+  for (int i = 0; i < count; i++) {
+    float t = i * 0.01f;
+    msg.a1 = sinf(t);
+    msg.a2 = cosf(t * 0.7f);
+    msg.a3 = (i / 50 % 2) ? 0.5f : -0.5f;
+    msg.a4 = 0.0f;
+    if (i % 100 == 0) msg.b1 -= 0.001f;
+    stream[i] = msg;
+  }
+}
+
+static bool same_quantized(const Message &a, const Message &b) {
+  bool ok = fabsf(a.a1 - b.a1) <= STEP(-1.0f, 1.0f, 12) && fabsf(a.a2 - b.a2) <= STEP(-1.0f, 1.0f, 12)
+         && fabsf(a.a3 - b.a3) <= STEP(-1.0f, 1.0f, 12) && fabsf(a.b1 - b.b1) <= STEP(0.0f, 5.0f, 10);
+  return ok && a.is_set == b.is_set && strcmp(a.msg1, b.msg1) == 0 && a.a5 == b.a5;
+}
+
+struct Result {
+  const char *name;
+  double bytes;
+  double encode_ns;
+  double decode_ns;
+};
+
+static void print(const Result &r, double raw_bytes) {
+  printf("%-16s %7.1f B/frame  %5.1f%% of raw  encode %7.1f ns  decode %7.1f ns\n",
+         r.name, r.bytes, 100.0 * r.bytes / raw_bytes, r.encode_ns, r.decode_ns);
+}
+
+int main(void) {
+  static Message stream[FRAMES];
+  static uint8_t frames[FRAMES][_MAX_MSG_LEN];
+  static size_t lens[FRAMES];
+  make_stream(stream, FRAMES);
+  const size_t len = sizeof(Message);
+
+  // raw = frame type + Message
+  Result raw = {"raw", 1.0 + len, 0, 0};
+  uint64_t start = rc_now_ns();
+  for (int i = 0; i < FRAMES; i++) {
+    frames[i][0] = _RC_FRAME_RAW;
+    memcpy(frames[i] + 1, &stream[i], len);
+  }
+  raw.encode_ns = (double)(rc_now_ns() - start) / FRAMES;
+  start = rc_now_ns();
+  for (int i = 0; i < FRAMES; i++) {
+    Message out;
+    memcpy(&out, frames[i] + 1, len);
+    CHECK(memcmp(&out, &stream[i], len) == 0);
+  }
+  raw.decode_ns = (double)(rc_now_ns() - start) / FRAMES;
+
+  // compact
+  Result compact = {"compact", 0, 0, 0};
+  start = rc_now_ns();
+  for (int i = 0; i < FRAMES; i++) {
+    lens[i] = ESP32_RC_Codec::encode(&stream[i], len, frames[i], _MAX_MSG_LEN);
+  }
+  compact.encode_ns = (double)(rc_now_ns() - start) / FRAMES;
+  start = rc_now_ns();
+  for (int i = 0; i < FRAMES; i++) {
+    Message out;
+    CHECK(lens[i] > 0 && ESP32_RC_Codec::decode(frames[i], lens[i], &out, len));
+    CHECK(memcmp(&out, &stream[i], len) == 0);
+    compact.bytes += lens[i];
+  }
+  compact.decode_ns = (double)(rc_now_ns() - start) / FRAMES;
+  compact.bytes /= FRAMES;
+
+  // delta, every frame is acked right after it is sent
+  Result delta = {"delta", 0, 0, 0};
+  ESP32_RC_DeltaEncoder encoder;
+  ESP32_RC_DeltaDecoder decoder;
+  encoder.reset();
+  decoder.reset();
+  start = rc_now_ns();
+  for (int i = 0; i < FRAMES; i++) {
+    lens[i] = encoder.encode(&stream[i], len, frames[i], _MAX_MSG_LEN);
+    encoder.on_sent(frames[i][1], true);
+  }
+  delta.encode_ns = (double)(rc_now_ns() - start) / FRAMES;
+  start = rc_now_ns();
+  for (int i = 0; i < FRAMES; i++) {
+    Message out;
+    CHECK(lens[i] > 0 && decoder.decode(frames[i], lens[i], &out, len));
+    CHECK(memcmp(&out, &stream[i], len) == 0);
+    delta.bytes += lens[i];
+  }
+  delta.decode_ns = (double)(rc_now_ns() - start) / FRAMES;
+  delta.bytes /= FRAMES;
+
+  // quantized channels, then delta on the packed payload
+  Result quant = {"quant + delta", 0, 0, 0};
+  ESP32_RC_Quantizer quantizer;
+  CHECK(quantizer.set_profiles(profiles, profile_count, len));
+  CHECK(quantizer.packed_len() < len);
+  encoder.reset();
+  decoder.reset();
+  start = rc_now_ns();
+  for (int i = 0; i < FRAMES; i++) {
+    uint8_t packed[_RC_CODEC_MAX_PAYLOAD];
+    quantizer.pack(&stream[i], packed);
+    lens[i] = encoder.encode(packed, quantizer.packed_len(), frames[i], _MAX_MSG_LEN);
+    encoder.on_sent(frames[i][1], true);
+  }
+  quant.encode_ns = (double)(rc_now_ns() - start) / FRAMES;
+  start = rc_now_ns();
+  for (int i = 0; i < FRAMES; i++) {
+    uint8_t packed[_RC_CODEC_MAX_PAYLOAD];
+    Message out = {};
+    CHECK(lens[i] > 0 && decoder.decode(frames[i], lens[i], packed, quantizer.packed_len()));
+    quantizer.unpack(packed, &out);
+    CHECK(same_quantized(out, stream[i]));
+    quant.bytes += lens[i];
+  }
+  quant.decode_ns = (double)(rc_now_ns() - start) / FRAMES;
+  quant.bytes /= FRAMES;
+
+  printf("%d frames, sizeof(Message) = %zu, packed = %zu\n", FRAMES, len, quantizer.packed_len());
+  print(raw, raw.bytes);
+  print(compact, raw.bytes);
+  print(delta, raw.bytes);
+  print(quant, raw.bytes);
+
+  CHECK(compact.bytes < raw.bytes);
+  CHECK(delta.bytes < compact.bytes);
+  CHECK(quant.bytes < delta.bytes);
+
+  // the handshake compares 32 bits of signature: any change of a profile shows, no two of
+  // many near-identical layouts share one
+  ESP32_RC_Quantizer other;
+  CHECK(other.signature() == 0);
+  CHECK(other.set_profiles(profiles, profile_count, len) && other.signature() == quantizer.signature());
+  std::set<uint32_t> signatures;
+  int variants = 0;
+  for (int bits = 1; bits <= _RC_QUANT_MAX_BITS; bits++) {
+    for (int step = 0; step < 1000; step++, variants++) {
+      ESP32_RC_QuantProfile changed[_RC_QUANT_MAX_CHANNELS];
+      memcpy(changed, profiles, profile_count * sizeof(ESP32_RC_QuantProfile));
+      changed[0].bits = bits;
+      changed[0].max  = 1.0f + step * 0.001f;
+      CHECK(other.set_profiles(changed, profile_count, len));
+      signatures.insert(other.signature());
+    }
+  }
+  CHECK((int)signatures.size() == variants);
+
+  // a profile outside the payload or wider than _RC_QUANT_MAX_BITS is refused
+  const ESP32_RC_QuantProfile bad[] = {{(uint16_t)len, 0.0f, 1.0f, 8}, {0, 0.0f, 1.0f, _RC_QUANT_MAX_BITS + 1}};
+  CHECK(!quantizer.set_profiles(&bad[0], 1, len));
+  CHECK(!quantizer.set_profiles(&bad[1], 1, len));
+
+  return rc_finish();
+}
@@ -0,0 +1,169 @@
+#include <string.h>
+#include <math.h>
+#include <deque>
+#include <random>
+#include <vector>
+#include <ESP32_RC_Common.h>
+#include <ESP32_RC_Codec.h>
+#include <ESP32_RC_Stats.h>
+#include <ESP32_RC_Window.h>
+#include "rc_test.h"
+
+/*
+ * Delta frames across lost acks, the ESP-NOW send path without the radio: a send window with
+ * stored frames, the delta codec, and a receiver that drops duplicates by sequence like
+ * check_trailer(). A frame may be lost (send-complete fails) or arrive with its ack lost (the
+ * receiver has it, the sender retries it). Every message must arrive once and decode to what
+ * was sent.
+ *
+ * The same run with a frame encoded again on every retry (new delta id, same sequence) shows
+ * the failure the stored frames prevent: the receiver drops the retry as a duplicate, the
+ * sender confirms its id and later DELTAs name a reference the receiver never decoded.
+ */
+
+#define MESSAGES        20000
+#define WINDOW          4
+#define LOSS_PERCENT    5                                     // frame lost
+#define ACK_LOSS_PERCENT 10                                   // frame arrived, ack lost
+
+struct Outcome {
+  int delivered;                                              // unique messages decoded
+  int decode_errors;                                          // reference unknown or malformed
+  int wrong_payload;
+  int duplicates;
+  int sent;
+};
+
+static void make_message(int index, Message &msg) {
+  msg = {};
+  msg.is_set = true;
+  strcpy(msg.msg1, "telemetry");
+  msg.a1 = sinf(index * 0.01f);
+  msg.a2 = (float)(index / 40);
+  msg.b1 = 4.2f;
+}
+
+static Outcome run(bool keeps_frames, uint32_t seed) {
+  ESP32_RC_SendWindow window;
+  CHECK(window.create(sizeof(Message), _MAX_MSG_LEN));
+  window.set_size(WINDOW);
+  ESP32_RC_DeltaEncoder encoder;
+  ESP32_RC_DeltaDecoder decoder;
+  ESP32_RC_SeqWindow dedupe;
+  encoder.reset();
+  decoder.reset();
+  dedupe.reset();
+
+  struct Air {
+    int  slot;
+    bool arrives;
+    bool acked;
+    uint8_t frame[_MAX_MSG_LEN];
+    size_t frame_len;
+  };
+  std::mt19937 rng(seed);
+  std::deque<int> to_send;
+  std::deque<Air> on_air;                                     // completed in send order
+  std::vector<int> index_of_seq(65536, -1);
+  std::vector<bool> is_received(MESSAGES, false);
+  Outcome out = {};
+  int queued = 0, released = 0;
+
+  while (released < MESSAGES) {
+    int slot;
+    while (queued < MESSAGES && (slot = window.acquire(_RC_LANE_CONTROL)) >= 0) {
+      make_message(queued, *(Message *)window.buffer(slot));
+      index_of_seq[window.seq(slot)] = queued;
+      to_send.push_back(slot);
+      queued ++;
+    }
+
+    // op_send(): encoded once, or again on every retry
+    while (!to_send.empty()) {
+      slot = to_send.front();
+      to_send.pop_front();
+      uint8_t *frame = window.frame(slot);
+      if (!keeps_frames || window.frame_len(slot) == 0) {
+        size_t len = encoder.encode(window.buffer(slot), sizeof(Message), frame, _MAX_MSG_LEN - _RC_FRAME_TRAILER_LEN);
+        CHECK(len > 0);
+        uint16_t seq = window.seq(slot);
+        frame[len++] = seq & 0xFF;
+        frame[len++] = seq >> 8;
+        memset(frame + len, 0, 4);
+        window.frame_len(slot) = len + 4;
+      }
+      Air air;
+      air.slot      = slot;
+      air.frame_len = window.frame_len(slot);
+      memcpy(air.frame, frame, air.frame_len);
+      int roll      = rng() % 100;
+      air.arrives   = roll >= LOSS_PERCENT;
+      air.acked     = roll >= LOSS_PERCENT + ACK_LOSS_PERCENT;
+      window.lock();
+      CHECK(window.track(slot, air.frame[1], 0));
+      window.unlock();
+      on_air.push_back(air);
+      out.sent ++;
+    }
+
+    // receiver: duplicates dropped by sequence, then decoded
+    Air air = on_air.front();
+    on_air.pop_front();
+    if (air.arrives) {
+      size_t len   = air.frame_len - _RC_FRAME_TRAILER_LEN;
+      uint16_t seq = air.frame[len] | (air.frame[len + 1] << 8);
+      uint8_t kind = dedupe.check(seq);
+      Message msg;
+      if (kind == ESP32_RC_SeqWindow::DUPLICATE || kind == ESP32_RC_SeqWindow::STALE) {
+        out.duplicates ++;
+      } else if (!decoder.decode(air.frame, len, &msg, sizeof(msg))) {
+        out.decode_errors ++;
+      } else {
+        Message expected;
+        int index = index_of_seq[seq];
+        make_message(index, expected);
+        if (memcmp(&msg, &expected, sizeof(msg)) != 0) out.wrong_payload ++;
+        if (!is_received[index]) out.delivered ++;
+        is_received[index] = true;
+      }
+    }
+
+    // send callback
+    ESP32_RC_SendWindow::Record rec;
+    window.lock();
+    CHECK(window.complete(air.acked, rec));
+    window.unlock();
+    if (rec.delta_id >= 0) encoder.on_sent(rec.delta_id, air.acked);
+    if (air.acked) {
+      window.release(rec.slot);
+      released ++;
+    } else {
+      window.mark(rec.slot, ESP32_RC_SendWindow::QUEUED);
+      to_send.push_back(rec.slot);
+    }
+  }
+  return out;
+}
+
+static void print(const char *name, const Outcome &out) {
+  printf("%-20s delivered %5d / %d  decode errors %5d  wrong payload %d  duplicates %5d  frames sent %d\n",
+         name, out.delivered, MESSAGES, out.decode_errors, out.wrong_payload, out.duplicates, out.sent);
+}
+
+int main(void) {
+  printf("window %d, %d%% frames lost, %d%% acks lost\n", WINDOW, LOSS_PERCENT, ACK_LOSS_PERCENT);
+  Outcome stored = run(true, 1);
+  Outcome encoded_again = run(false, 1);
+  print("stored frame retry", stored);
+  print("encode on retry", encoded_again);
+
+  CHECK(stored.delivered == MESSAGES);
+  CHECK(stored.decode_errors == 0);
+  CHECK(stored.wrong_payload == 0);
+  CHECK(stored.duplicates > 0);                               // acks were lost, retries arrived twice
+
+  CHECK(encoded_again.decode_errors > 0);
+  CHECK(encoded_again.delivered < MESSAGES);
+
+  return rc_finish();
+}
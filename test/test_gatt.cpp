@@ -0,0 +1,239 @@
+#include <string.h>
+#include <random>
+#include <vector>
+#include <ESP32_RC_Gatt.h>
+#include "rc_test.h"
+
+/*
+ * GATT pipe on a fake link: the link hands every packet it takes straight to the pipe of the
+ * other end, like the link layer that loses and reorders nothing, and answers BUSY at random
+ * like a controller out of buffers. Every frame must come out once, in order, unchanged, the
+ * packets must be full but the last of a flush, small frames must share packets. Then packets
+ * per frame and pipe throughput for the default MTU and the 247 byte MTU.
+ */
+
+#define FRAMES          20000
+#define FRAME_LEN       (_RC_FRAME_HEADER_LEN + sizeof(Message) + _RC_FRAME_TRAILER_LEN)
+#define COMPACT_LEN     40                                    // a compact frame, see test_codec
+
+typedef std::vector<std::vector<uint8_t>> Frames;
+
+class FakeLink : public ESP32_RC_GattLink {
+  public:
+    size_t payload     = _RC_GATT_MIN_PACKET;
+    int busy_percent   = 0;
+    int budget         = -1;                                  // packets taken before BUSY, -1 = no limit
+    bool is_up         = true;
+    std::mt19937 rng{23};
+    uint32_t put_count  = 0;
+    uint32_t busy_count = 0;
+    uint32_t short_count = 0;                                 // packets below payload
+    size_t max_len      = 0;
+
+    bool open(uint32_t timeout_ms) override { return is_up; }
+    void close(void) override { is_up = false; }
+    bool is_open(void) override { return is_up; }
+    size_t packet_len(void) override { return payload; }
+
+    uint8_t put_packet(const uint8_t *data, size_t len) override {
+      put_count ++;
+      if (!is_up) return CLOSED;
+      if (busy_percent > 0 && (int)(rng() % 100) < busy_percent) {
+        busy_count ++;
+        return BUSY;
+      }
+      if (budget == 0) return BUSY;
+      if (budget > 0) budget --;
+      if (len > max_len) max_len = len;
+      if (len < payload) short_count ++;
+      emit(DATA, data, len);
+      return SENT;
+    }
+};
+
+struct Receiver {
+  ESP32_RC_GattPipe pipe;
+  const Frames *expected = nullptr;
+  size_t count = 0;
+  bool is_in_step = true;
+
+  static void on_frame(const uint8_t *frame, size_t frame_len, void *context) {
+    Receiver *rx = static_cast<Receiver *>(context);
+    if (rx->expected != nullptr) {
+      const std::vector<uint8_t> &want = (*rx->expected)[rx->count];
+      CHECK(frame_len == want.size() && memcmp(frame, want.data(), frame_len) == 0);
+    }
+    rx->count ++;
+  }
+
+  static void on_event(uint8_t event, const uint8_t *data, size_t len, void *context) {
+    Receiver *rx = static_cast<Receiver *>(context);
+    if (event == ESP32_RC_GattLink::DATA) rx->is_in_step = rx->pipe.feed(data, len, on_frame, rx) && rx->is_in_step;
+    else rx->pipe.reset();
+  }
+};
+
+static Frames make_frames(std::mt19937 &rng, int count, size_t fixed_len = 0) {
+  Frames frames(count);
+  for (auto &frame : frames) {
+    frame.resize(fixed_len ? fixed_len : 1 + rng() % _RC_STREAM_MAX_FRAME);
+    for (auto &byte : frame) byte = rng();
+  }
+  return frames;
+}
+
+// like ESP32_RC_BLE::pipe_put(), a full pipe is flushed before the frame is put again
+static uint32_t send_all(ESP32_RC_GattPipe &pipe, FakeLink &link, const Frames &frames) {
+  uint32_t busy_rounds = 0;
+  for (const auto &frame : frames) {
+    while (!pipe.put(frame.data(), frame.size())) {
+      if (pipe.flush(link) == ESP32_RC_GattLink::BUSY) busy_rounds ++;
+    }
+    if (pipe.flush(link) == ESP32_RC_GattLink::BUSY) busy_rounds ++;
+  }
+  while (pipe.flush(link) == ESP32_RC_GattLink::BUSY) busy_rounds ++;
+  return busy_rounds;
+}
+
+static double bench(const char *name, size_t payload, const Frames &frames, size_t batch) {
+  FakeLink link;
+  link.payload = payload;
+  Receiver rx;
+  rx.pipe.reset();
+  link.set_handler(Receiver::on_event, &rx);
+  ESP32_RC_GattPipe pipe;
+  pipe.reset();
+
+  uint64_t start = rc_now_ns();
+  for (int round = 0; round < 10; round++) {
+    for (size_t i = 0; i < frames.size(); i++) {
+      while (!pipe.put(frames[i].data(), frames[i].size())) pipe.flush(link);
+      if ((i + 1) % batch == 0) pipe.flush(link);
+    }
+    pipe.flush(link);
+  }
+  double seconds = (rc_now_ns() - start) / 1e9;
+  double per_frame = (double)pipe.packets() / (10 * frames.size());
+  printf("%3zu byte frames  %-16s %3zu byte packets  %5.2f packets / frame  %10.0f frames/s\n",
+         frames[0].size(), name, payload, per_frame, rx.count / seconds);
+  CHECK(rx.count == 10 * frames.size() && rx.is_in_step);
+  return per_frame;
+}
+
+int main(void) {
+  std::mt19937 rng(23);
+  Frames frames = make_frames(rng, FRAMES);
+
+  // every payload size, the controller BUSY for a third of the packets
+  for (size_t payload : {(size_t)_RC_GATT_MIN_PACKET, (size_t)100, (size_t)244}) {
+    FakeLink link;
+    link.payload      = payload;
+    link.busy_percent = 33;
+    Receiver rx;
+    rx.expected = &frames;
+    rx.pipe.reset();
+    link.set_handler(Receiver::on_event, &rx);
+    ESP32_RC_GattPipe pipe;
+    pipe.reset();
+
+    uint32_t busy_rounds = send_all(pipe, link, frames);
+    CHECK(rx.count == FRAMES && rx.is_in_step);
+    CHECK(pipe.pending() == 0);
+    CHECK(link.busy_count > 0 && busy_rounds > 0);
+    CHECK(link.max_len == payload);
+    CHECK(pipe.packets() == link.put_count - link.busy_count);
+    CHECK(link.short_count <= FRAMES);                        // one short tail per flush at most
+  }
+
+  // small frames share a packet, a frame larger than the payload spans two
+  {
+    FakeLink link;
+    Receiver rx;
+    rx.pipe.reset();
+    link.set_handler(Receiver::on_event, &rx);
+    ESP32_RC_GattPipe pipe;
+    pipe.reset();
+    const uint8_t small[4] = {1, 2, 3, 4};
+    for (int i = 0; i < 4; i++) CHECK(pipe.put(small, sizeof(small)));   // 4 x 6 bytes on the stream
+    CHECK(pipe.flush(link) == ESP32_RC_GattLink::SENT);
+    CHECK(pipe.packets() == 2 && rx.count == 4);
+    uint8_t large[30] = {};
+    CHECK(pipe.put(large, sizeof(large)));                    // 32 bytes
+    CHECK(pipe.flush(link) == ESP32_RC_GattLink::SENT);
+    CHECK(pipe.packets() == 4 && rx.count == 5);
+  }
+
+  // BUSY keeps the rest, the next flush() continues, CLOSED is passed on
+  {
+    FakeLink link;
+    Receiver rx;
+    rx.pipe.reset();
+    link.set_handler(Receiver::on_event, &rx);
+    ESP32_RC_GattPipe pipe;
+    pipe.reset();
+    uint8_t frame[50] = {};
+    CHECK(pipe.put(frame, sizeof(frame)));
+    link.busy_percent = 100;
+    CHECK(pipe.flush(link) == ESP32_RC_GattLink::BUSY);
+    CHECK(pipe.pending() == 52 && rx.count == 0);
+    link.busy_percent = 0;
+    CHECK(pipe.flush(link) == ESP32_RC_GattLink::SENT);
+    CHECK(pipe.pending() == 0 && rx.count == 1);
+
+    CHECK(pipe.put(frame, sizeof(frame)));
+    link.close();
+    CHECK(pipe.flush(link) == ESP32_RC_GattLink::CLOSED);
+    CHECK(pipe.pending() == 52);
+  }
+
+  // a half sent frame does not reach the next connection
+  {
+    FakeLink link;
+    Receiver rx;
+    rx.pipe.reset();
+    link.set_handler(Receiver::on_event, &rx);
+    ESP32_RC_GattPipe pipe;
+    pipe.reset();
+    uint8_t frame[50];
+    memset(frame, 0xAA, sizeof(frame));
+    CHECK(pipe.put(frame, sizeof(frame)));
+    link.budget = 1;
+    CHECK(pipe.flush(link) == ESP32_RC_GattLink::BUSY);       // 20 of 52 bytes out
+    CHECK(rx.count == 0);
+
+    // DOWN, then UP: both ends start over
+    Receiver::on_event(ESP32_RC_GattLink::DOWN, nullptr, 0, &rx);
+    pipe.reset();
+    CHECK(pipe.pending() == 0);
+    link.budget = -1;
+    memset(frame, 0x55, sizeof(frame));
+    Frames next(1, std::vector<uint8_t>(frame, frame + sizeof(frame)));
+    rx.expected = &next;
+    CHECK(pipe.put(frame, sizeof(frame)));
+    CHECK(pipe.flush(link) == ESP32_RC_GattLink::SENT);
+    CHECK(rx.count == 1 && rx.is_in_step);
+
+  }
+
+  // a length no frame has, feed() false: the stream is out of step, the link is closed
+  {
+    Receiver rx;
+    rx.pipe.reset();
+    const uint8_t bad[] = {0x00, 0x00, 0x01};
+    CHECK(!rx.pipe.feed(bad, sizeof(bad), Receiver::on_frame, &rx));
+    CHECK(rx.count == 0);
+  }
+
+  // packets per frame and throughput, raw and compact data frames, one flush per frame or per 4
+  for (size_t frame_len : {(size_t)FRAME_LEN, (size_t)COMPACT_LEN}) {
+    Frames data_frames = make_frames(rng, FRAMES / 10, frame_len);
+    double mtu_23  = bench("default MTU", _RC_GATT_MIN_PACKET, data_frames, 1);
+    double mtu_247 = bench("MTU 247", 244, data_frames, 1);
+    double batched = bench("MTU 247, batch 4", 244, data_frames, 4);
+    CHECK(mtu_247 < mtu_23);
+    CHECK(batched <= mtu_247);
+    if (frame_len == COMPACT_LEN) CHECK(batched < 1.0);       // several frames per packet
+  }
+
+  return rc_finish();
+}
@@ -0,0 +1,118 @@
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <ESP32_RC_UART.h>
+#include "rc_test.h"
+#include "sim_port.h"
+
+/*
+ * Lanes: two ESP32_RC_UART peers on a simulated 460800 baud wire, the UART driver TX buffer as on
+ * the ESP32. A producer keeps the bulk lane full of telemetry, probes go out every PROBE_MS, first
+ * on the critical lane, then on the bulk lane behind the telemetry. Latency is send() to on_message().
+ * The sender keeps one batch in the driver at most, a critical probe waits for that backlog and
+ * its own frame time, however long the bulk queue is.
+ */
+
+#define BAUD            460800
+#define PROBES          60
+#define PROBE_MS        25
+#define FRAME_LEN       (_RC_FRAME_HEADER_LEN + sizeof(Message) + _RC_FRAME_TRAILER_LEN)
+#define WIRE_US(bytes)  ((uint64_t)(bytes) * 10 * 1000000 / BAUD)   // 8N1
+#define BATCH_US        WIRE_US(_RC_SERIAL_BATCH)
+#define FRAME_US        WIRE_US(_RC_SERIAL_MAX_ENCODED(FRAME_LEN))
+
+typedef ESP32_RC<ESP32_RC_UART> UartRC;
+
+static std::mutex latency_mutex;
+static ESP32_RC_Latency *probe_latency = nullptr;
+static std::atomic<int> probe_count{0};
+static std::atomic<int> bulk_count{0};
+static std::atomic<bool> is_probe_critical{true};
+static std::atomic<int> wrong_lane{0};
+
+static void stamp(Message &msg, char kind) {
+  uint64_t now = rc_now_us();
+  msg.msg1[0] = kind;
+  memcpy(msg.msg3, &now, sizeof(now));
+}
+
+static void on_message(const Message &msg, uint8_t lane) {
+  if (msg.msg1[0] != 'P') {
+    bulk_count ++;
+    return;
+  }
+  uint64_t sent;
+  memcpy(&sent, msg.msg3, sizeof(sent));
+  std::lock_guard<std::mutex> guard(latency_mutex);
+  probe_latency->add(rc_now_us() - sent);
+  probe_count ++;
+  if (lane != (is_probe_critical ? _RC_LANE_CRITICAL : _RC_LANE_BULK)) wrong_lane ++;
+}
+
+static void run_probes(UartRC &sender, uint8_t lane, ESP32_RC_Latency &latency) {
+  {
+    std::lock_guard<std::mutex> guard(latency_mutex);
+    probe_latency = &latency;
+    probe_count   = 0;
+    is_probe_critical = (lane == _RC_LANE_CRITICAL);
+  }
+  Message probe = {};
+  for (int i = 0; i < PROBES; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(PROBE_MS));
+    stamp(probe, 'P');
+    sender.send(probe, lane);
+  }
+  for (int wait = 0; wait < 500 && probe_count < PROBES; wait++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+int main(void) {
+  static ESP32_RC_SimWire wire(BAUD);
+  wire.a_to_b.tx_buffer = _UART_TX_BUFFER;
+  wire.b_to_a.tx_buffer = _UART_TX_BUFFER;
+  static UartRC a, b;
+  for (UartRC *rc : {&a, &b}) {
+    rc->set_lane(_RC_LANE_CRITICAL, _RC_LANE_CRITICAL_DEPTH, _RC_LANE_BLOCK);
+    rc->set_lane(_RC_LANE_BULK, _RC_LANE_BULK_DEPTH, _RC_LANE_BLOCK);
+  }
+  a.set_port(&wire.a, BAUD);
+  b.set_port(&wire.b, BAUD);
+  b.on_message(on_message);
+  a.init();
+  b.init();
+  rc_connect_pair(a, b);
+
+  // telemetry that does not shrink in the codec, the bulk lane stays full
+  std::thread producer([] {
+    Message telemetry = {};
+    for (uint32_t i = 0; ; i++) {
+      memset(telemetry.msg2, 'a' + i % 26, sizeof(telemetry.msg2) - 1);
+      telemetry.a1 = (float)i;
+      stamp(telemetry, 'T');
+      a.send(telemetry, _RC_LANE_BULK);
+    }
+  });
+  producer.detach();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+  ESP32_RC_Latency critical, bulk;
+  run_probes(a, _RC_LANE_CRITICAL, critical);
+  CHECK(probe_count == PROBES);
+  run_probes(a, _RC_LANE_BULK, bulk);
+  CHECK(probe_count == PROBES);
+
+  printf("%d baud, bulk lane saturated, %d telemetry messages received, batch %llu us, frame %llu us\n",
+         BAUD, bulk_count.load(), (unsigned long long)BATCH_US, (unsigned long long)FRAME_US);
+  critical.print("probe on critical lane", "us");
+  bulk.print("probe on bulk lane", "us");
+
+  // the critical lane skips the bulk queue, it waits for one batch in the driver and its own frame,
+  // one more frame time for the sender to wake up and the receiver to take the bytes
+  CHECK(wrong_lane == 0);
+  CHECK(bulk_count > 100);
+  CHECK(critical.percentile(99) < BATCH_US + 2 * FRAME_US);
+  CHECK(critical.percentile(99) < bulk.percentile(50));
+
+  return rc_finish();
+}
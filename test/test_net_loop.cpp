@@ -0,0 +1,177 @@
+#include <string.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ESP32_RC_Net.h>
+#include "rc_test.h"
+
+/*
+ * Network event loop on Linux sockets: a socket watched while run() already sleeps in select(),
+ * UDP reads, a TCP accept and a writable connection, unwatch(), the slot limit, a socket closed
+ * while watched and stop().
+ * Also the wake-up latency from sendto() to the handler, the floor the WiFi receive path has
+ * now that no timer polls the socket.
+ */
+
+struct Events {
+  std::mutex mutex;
+  std::vector<std::pair<int, uint8_t>> seen;
+  std::atomic<uint64_t> last_read_us{0};
+  int listen_sock = -1;
+  std::atomic<int> accepted{-1};
+  ESP32_RC_NetLoop *net = nullptr;
+
+  int count(int fd, uint8_t event) {
+    std::lock_guard<std::mutex> guard(mutex);
+    int n = 0;
+    for (auto &e : seen) n += (e.first == fd && (e.second & event)) ? 1 : 0;
+    return n;
+  }
+};
+
+static Events events;
+
+static void on_event(int fd, uint8_t mask, void *context) {
+  Events *ev = static_cast<Events *>(context);
+  {
+    std::lock_guard<std::mutex> guard(ev->mutex);
+    ev->seen.push_back({fd, mask});
+  }
+  if (fd == ev->listen_sock) {
+    int conn = accept(fd, nullptr, nullptr);
+    if (conn >= 0) {
+      fcntl(conn, F_SETFL, fcntl(conn, F_GETFL, 0) | O_NONBLOCK);
+      ev->accepted = conn;
+      ev->net->watch(conn, ESP32_RC_NetLoop::READ | ESP32_RC_NetLoop::WRITE);
+    }
+    return;
+  }
+  if (mask & ESP32_RC_NetLoop::READ) {
+    uint8_t buffer[256];
+    while (recv(fd, buffer, sizeof(buffer), 0) > 0) {}
+    ev->last_read_us = rc_now_us();
+  }
+  // writable once is enough, keep reading
+  if (mask & ESP32_RC_NetLoop::WRITE) ev->net->watch(fd, ESP32_RC_NetLoop::READ);
+}
+
+static int udp_socket(struct sockaddr_in &addr) {
+  int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len   = sizeof(addr);
+  bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+  getsockname(sock, (struct sockaddr *)&addr, &addr_len);
+  return sock;
+}
+
+static uint64_t cpu_us(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+template <class Ready>
+static bool wait_until(Ready ready, uint32_t timeout_ms = 1000) {
+  for (uint32_t i = 0; i < timeout_ms && !ready(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return ready();
+}
+
+int main(void) {
+  ESP32_RC_NetLoop net;
+  events.net = &net;
+  CHECK(net.create(on_event, &events));
+  std::atomic<bool> is_running{true};
+  std::thread loop([&] {
+    net.run();
+    is_running = false;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));   // asleep in select() with nothing watched
+
+  // a socket watched now is served at once
+  struct sockaddr_in udp_addr, sender_addr;
+  int udp    = udp_socket(udp_addr);
+  int sender = udp_socket(sender_addr);
+  CHECK(net.watch(udp, ESP32_RC_NetLoop::READ));
+  uint8_t byte = 1;
+  sendto(sender, &byte, 1, 0, (struct sockaddr *)&udp_addr, sizeof(udp_addr));
+  CHECK(wait_until([&] { return events.count(udp, ESP32_RC_NetLoop::READ) > 0; }));
+
+  // sendto() -> handler, no timer in between
+  ESP32_RC_Latency latency;
+  for (int i = 0; i < 1000; i++) {
+    uint64_t start = rc_now_us();
+    events.last_read_us = 0;
+    sendto(sender, &byte, 1, 0, (struct sockaddr *)&udp_addr, sizeof(udp_addr));
+    CHECK(wait_until([&] { return events.last_read_us.load() != 0; }));
+    latency.add(events.last_read_us.load() - start);
+  }
+  latency.print("udp sendto -> handler", "us");
+  CHECK(latency.percentile(50) < 5000);
+
+  // TCP: the listener is readable on connect, the connection reports writable once, then data
+  int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  struct sockaddr_in tcp_addr = {};
+  tcp_addr.sin_family      = AF_INET;
+  tcp_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len       = sizeof(tcp_addr);
+  CHECK(bind(listener, (struct sockaddr *)&tcp_addr, sizeof(tcp_addr)) == 0);
+  CHECK(listen(listener, 1) == 0);
+  getsockname(listener, (struct sockaddr *)&tcp_addr, &addr_len);
+  fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+  events.listen_sock = listener;
+  CHECK(net.watch(listener, ESP32_RC_NetLoop::READ));
+
+  int client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  CHECK(connect(client, (struct sockaddr *)&tcp_addr, sizeof(tcp_addr)) == 0);
+  CHECK(wait_until([&] { return events.accepted >= 0; }));
+  int conn = events.accepted;
+  CHECK(wait_until([&] { return events.count(conn, ESP32_RC_NetLoop::WRITE) > 0; }));
+  CHECK(send(client, "hello", 5, 0) == 5);
+  CHECK(wait_until([&] { return events.count(conn, ESP32_RC_NetLoop::READ) > 0; }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(events.count(conn, ESP32_RC_NetLoop::WRITE) == 1);
+
+  // all slots used: udp, listener, conn, one more
+  CHECK(net.watch(sender, ESP32_RC_NetLoop::READ));
+  CHECK(!net.watch(client, ESP32_RC_NetLoop::READ));
+
+  // an unwatched socket is left alone
+  net.unwatch(udp);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  int before = events.count(udp, ESP32_RC_NetLoop::READ);
+  sendto(sender, &byte, 1, 0, (struct sockaddr *)&udp_addr, sizeof(udp_addr));
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(events.count(udp, ESP32_RC_NetLoop::READ) == before);
+  CHECK(net.watch(client, ESP32_RC_NetLoop::READ));         // the slot is free again
+
+  // closed without unwatch(): select() fails with EBADF, the slot is freed instead of the loop
+  // spinning on the error, the other sockets are still served
+  struct sockaddr_in probe_addr;
+  int probe = udp_socket(probe_addr);                       // before close(), not to get the same fd
+  close(sender);
+  net.wake();
+  CHECK(wait_until([&] { return net.watch(udp, ESP32_RC_NetLoop::READ); }));
+  uint64_t cpu_start = cpu_us();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  uint64_t cpu_used = cpu_us() - cpu_start;
+  printf("closed socket: %llu us cpu in 100 ms\n", (unsigned long long)cpu_used);
+  CHECK(cpu_used < 50000);
+  before = events.count(udp, ESP32_RC_NetLoop::READ);
+  sendto(probe, &byte, 1, 0, (struct sockaddr *)&udp_addr, sizeof(udp_addr));
+  CHECK(wait_until([&] { return events.count(udp, ESP32_RC_NetLoop::READ) > before; }));
+
+  // stop() ends run()
+  net.stop();
+  CHECK(wait_until([&] { return !is_running.load(); }));
+  if (!is_running) loop.join();
+  else loop.detach();
+
+  return rc_finish();
+}
@@ -0,0 +1,173 @@
+#include <string.h>
+#include <random>
+#include <vector>
+#include <ESP32_RC_Nrf24Radio.h>
+#include <ESP32_RC_Nrf24Sim.h>
+#include "rc_test.h"
+
+/*
+ * nRF24L01+ driver on two simulated chips: a PTX and a PRX, each polled every period like the
+ * radio task of ESP32_RC_NRF24, frames both ways at once, the PRX ones in ack payloads. In
+ * simulated time, so the numbers are those of 2 Mbps air and 8 MHz SPI, not of this machine.
+ *
+ *  lossless : every frame once, in order, unchanged, nothing lost or broken.
+ *  loss     : retransmits hide some loss, heavy loss ends in MAX_RT. What arrives is still
+ *             whole and in order, the rest is counted by get_lost() / get_broken().
+ *  chip     : a bus without a chip fails begin(), a PRX out of range costs MAX_RT.
+ */
+
+#define FRAMES          2000
+#define FRAME_LEN       (_RC_FRAME_HEADER_LEN + sizeof(Message) + _RC_FRAME_TRAILER_LEN)
+#define POLL_US         1000                                  // _NRF24_POLL_PERIOD of ESP32_RC_NRF24.h
+#define MAX_TICKS       200000
+
+typedef std::vector<std::vector<uint8_t>> Frames;
+
+static const uint8_t address[_NRF24_ADDR_LEN] = {'R', 'C', 'N', 'R', 'F'};
+
+struct End {
+  ESP32_RC_Nrf24Sim sim;
+  ESP32_RC_Nrf24Radio radio;
+  const Frames *out = nullptr;            // to send
+  const Frames *expected = nullptr;       // to receive
+  size_t sent     = 0;
+  size_t received = 0;
+  size_t next     = 0;                    // index in expected the next frame may have
+  bool is_in_order = true;
+
+  static void on_frame(const uint8_t *frame, size_t frame_len, void *context) {
+    End *end = static_cast<End *>(context);
+    end->received ++;
+    while (end->next < end->expected->size()) {   // skip the frames lost on the way
+      const std::vector<uint8_t> &want = (*end->expected)[end->next ++];
+      if (want.size() == frame_len && memcmp(want.data(), frame, frame_len) == 0) return;
+    }
+    end->is_in_order = false;
+  }
+
+  void tick(void) {
+    while (sent < out->size() && radio.put((*out)[sent].data(), (*out)[sent].size())) sent ++;
+    radio.poll(on_frame, this);
+  }
+};
+
+struct Result {
+  double seconds;
+  size_t a_received;
+  size_t b_received;
+  uint32_t lost;
+  uint32_t broken;
+  bool is_in_order;
+};
+
+static Frames make_frames(std::mt19937 &rng, int count, size_t fixed_len = 0) {
+  Frames frames(count);
+  for (auto &frame : frames) {
+    frame.resize(fixed_len ? fixed_len : 1 + rng() % _RC_STREAM_MAX_FRAME);
+    for (auto &byte : frame) byte = rng();
+  }
+  return frames;
+}
+
+// a sends a_to_b, b sends b_to_a, until both are out and the air is quiet
+static Result run(const char *name, const Frames &a_to_b, const Frames &b_to_a, uint32_t loss, uint32_t poll_us) {
+  End a, b;
+  a.sim.link(&b.sim);
+  a.sim.set_loss(loss, 7);
+  b.sim.set_loss(loss, 8);
+  CHECK(a.radio.begin(&a.sim, address) && b.radio.begin(&b.sim, address));
+  a.radio.set_role(ESP32_RC_Nrf24Radio::PTX);
+  b.radio.set_role(ESP32_RC_Nrf24Radio::PRX);
+  a.out = &a_to_b;
+  b.out = &b_to_a;
+  a.expected = &b_to_a;
+  b.expected = &a_to_b;
+
+  uint64_t start = a.sim.now_us();
+  int quiet = 0;
+  for (int tick = 0; tick < MAX_TICKS && quiet < 100; tick++) {
+    a.tick();
+    b.tick();
+    a.sim.advance(poll_us);
+    b.sim.advance(poll_us);
+    bool is_done = (a.sent == a_to_b.size() && b.sent == b_to_a.size());
+    quiet = is_done ? quiet + 1 : 0;
+  }
+
+  Result result;
+  result.seconds     = (a.sim.now_us() - start) / 1e6;
+  result.a_received  = a.received;
+  result.b_received  = b.received;
+  result.lost        = a.radio.get_lost() + b.radio.get_lost();
+  result.broken      = a.radio.get_broken() + b.radio.get_broken();
+  result.is_in_order = a.is_in_order && b.is_in_order;
+  size_t bytes = 0;
+  for (auto &frame : a_to_b) bytes += frame.size();
+  for (auto &frame : b_to_a) bytes += frame.size();
+  printf("%-18s poll %4u us  loss %3u %%o  %6.2f s  a->b %4zu / %4zu  b->a %4zu / %4zu  %6.1f kbit/s  lost %4u  broken %4u  air %5.1f %%\n",
+         name, poll_us, loss, result.seconds, result.b_received, a_to_b.size(), result.a_received, b_to_a.size(),
+         bytes * 8 / result.seconds / 1e3, result.lost, result.broken, 100.0 * a.sim.air_us() / (a.sim.now_us() - start));
+  return result;
+}
+
+// a bus nobody answers on, every read is 0
+class NoChip : public ESP32_RC_Nrf24Bus {
+  public:
+    uint8_t transfer(uint8_t cmd, const uint8_t *tx, uint8_t *rx, size_t len) override {
+      if (rx != nullptr) memset(rx, 0, len);
+      return 0;
+    }
+    void set_ce(bool level) override {}
+};
+
+int main(void) {
+  std::mt19937 rng(24);
+  Frames a_to_b = make_frames(rng, FRAMES);
+  Frames b_to_a = make_frames(rng, FRAMES);
+  Frames data   = make_frames(rng, FRAMES, FRAME_LEN);
+  Frames none;
+
+  // lossless, both ways at once, every frame exact
+  Result clean = run("random frames", a_to_b, b_to_a, 0, POLL_US);
+  CHECK(clean.b_received == FRAMES && clean.a_received == FRAMES);
+  CHECK(clean.lost == 0 && clean.broken == 0 && clean.is_in_order);
+
+  // throughput one way, data frames, the return channel only polls
+  Result ptx = run("data frames a->b", data, none, 0, POLL_US);
+  Result prx = run("data frames b->a", none, data, 0, POLL_US);
+  Result fast = run("data frames a->b", data, none, 0, POLL_US / 4);
+  CHECK(ptx.b_received == FRAMES && prx.a_received == FRAMES && fast.b_received == FRAMES);
+  CHECK(fast.seconds <= ptx.seconds);                       // 3 payloads in flight keep the air busy at 1 ms already
+  CHECK(prx.seconds > ptx.seconds);                         // an idle PTX polls once per period, one ack payload each
+
+  // 10 % loss: ARC retransmits hide it
+  Result lossy = run("random frames", a_to_b, b_to_a, 100, POLL_US);
+  CHECK(lossy.b_received == FRAMES && lossy.a_received == FRAMES);
+  CHECK(lossy.lost == 0 && lossy.broken == 0 && lossy.is_in_order);
+  CHECK(lossy.seconds > clean.seconds);
+
+  // 75 % loss: MAX_RT, frames lost whole or broken, what arrives is exact
+  Result heavy = run("random frames", a_to_b, b_to_a, 750, POLL_US);
+  CHECK(heavy.lost > 0);
+  CHECK(heavy.b_received < FRAMES && heavy.b_received > 0);
+  CHECK(heavy.is_in_order);
+
+  // no chip on the bus
+  NoChip no_chip;
+  ESP32_RC_Nrf24Radio radio;
+  CHECK(!radio.begin(&no_chip, address));
+
+  // the PRX out of range: MAX_RT, the frame is dropped, the queue goes on
+  static ESP32_RC_Nrf24Sim lonely;
+  CHECK(radio.begin(&lonely, address));
+  radio.set_role(ESP32_RC_Nrf24Radio::PTX);
+  uint8_t frame[100] = {};
+  CHECK(radio.put(frame, sizeof(frame)));
+  for (int tick = 0; tick < 100; tick++) {
+    radio.poll([](const uint8_t *, size_t, void *) { CHECK(false); }, nullptr);
+    lonely.advance(POLL_US);
+  }
+  CHECK(radio.get_lost() > 0);
+
+  return rc_finish();
+}
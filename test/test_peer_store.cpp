@@ -0,0 +1,57 @@
+#include <ESP32_RC_PeerStore.h>
+#include "rc_test.h"
+
+/*
+ * Peer store: what the ESP-NOW transport relies on at boot (recall) and after every handshake
+ * (remember), on ESP32_RC_MemPeerStore. Reconnects to the same peer must not write.
+ */
+
+class FailingPeerStore : public ESP32_RC_MemPeerStore {
+  public:
+    bool save(const uint8_t *mac_addr, uint8_t channel) override { return false; }
+};
+
+int main(void) {
+  const uint8_t peer_a[_RC_PEER_ADDR_LEN] = {0x24, 0x6F, 0x28, 0x01, 0x02, 0x03};
+  const uint8_t peer_b[_RC_PEER_ADDR_LEN] = {0x24, 0x6F, 0x28, 0x0A, 0x0B, 0x0C};
+  uint8_t addr[_RC_PEER_ADDR_LEN] = {};
+  uint8_t channel = 0;
+
+  ESP32_RC_MemPeerStore store;
+  CHECK(!store.load(addr, channel));
+  CHECK(!store.recall(addr, 1));
+
+  // first pairing is saved, reconnects to the same peer are not
+  CHECK(store.remember(peer_a, 1));
+  CHECK(store.save_count == 1);
+  for (int i = 0; i < 100; i++) CHECK(store.remember(peer_a, 1));
+  CHECK(store.save_count == 1);
+  CHECK(store.recall(addr, 1) && memcmp(addr, peer_a, _RC_PEER_ADDR_LEN) == 0);
+
+  // another peer, or the same peer on another channel, is saved
+  CHECK(store.remember(peer_b, 1));
+  CHECK(store.save_count == 2);
+  CHECK(store.remember(peer_b, 6));
+  CHECK(store.save_count == 3);
+
+  // a peer of another channel is stale, recall() leaves the address alone
+  memset(addr, 0xEE, sizeof(addr));
+  CHECK(!store.recall(addr, 1));
+  CHECK(addr[0] == 0xEE);
+  CHECK(store.recall(addr, 6) && memcmp(addr, peer_b, _RC_PEER_ADDR_LEN) == 0);
+
+  // forget_peer() clears it, the next pairing is saved again
+  store.clear();
+  CHECK(!store.recall(addr, 6));
+  CHECK(store.remember(peer_b, 6));
+  CHECK(store.save_count == 4);
+
+  // a failed save is reported, a peer already stored is not written
+  FailingPeerStore failing;
+  CHECK(!failing.remember(peer_a, 1));
+  CHECK(!failing.recall(addr, 1));
+  failing.ESP32_RC_MemPeerStore::save(peer_a, 1);
+  CHECK(failing.remember(peer_a, 1));
+
+  return rc_finish();
+}
@@ -0,0 +1,115 @@
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <ESP32_RC_Common.h>
+#include <ESP32_RC_Ring.h>
+#include "rc_test.h"
+
+/*
+ * Ring benchmark: one producer, one consumer, Message sized items. The ring is compared with
+ * what it replaced, a locked queue which copies in and out (a FreeRTOS queue is a critical
+ * section around memcpy, a mutex + deque is the host counterpart). Both sides poll and yield,
+ * the latency is push to pop of each item.
+ */
+
+#define ITEMS           200000
+#define DEPTH           16
+
+struct Item {
+  uint32_t seq;
+  uint64_t pushed_ns;
+  uint8_t  data[sizeof(Message) - 12];
+};
+
+class LockedQueue {
+  public:
+    bool push(const Item &item) {
+      std::lock_guard<std::mutex> guard(mutex);
+      if (items.size() >= DEPTH) return false;
+      items.push_back(item);
+      return true;
+    }
+
+    bool pop(Item &item) {
+      std::lock_guard<std::mutex> guard(mutex);
+      if (items.empty()) return false;
+      item = items.front();
+      items.pop_front();
+      return true;
+    }
+
+  private:
+    std::mutex mutex;
+    std::deque<Item> items;
+};
+
+// runs producer and consumer, checks order, returns items per second
+template <typename Push, typename Pop>
+static double run(const char *name, Push push, Pop pop) {
+  ESP32_RC_Latency latency;
+  uint64_t start = rc_now_ns();
+
+  std::thread producer([&] {
+    Item item = {};
+    for (uint32_t i = 0; i < ITEMS; i++) {
+      item.seq = i;
+      item.pushed_ns = rc_now_ns();
+      while (!push(item)) std::this_thread::yield();
+    }
+  });
+
+  uint32_t expected = 0;
+  bool is_ordered   = true;
+  Item item;
+  while (expected < ITEMS) {
+    if (!pop(item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    latency.add(rc_now_ns() - item.pushed_ns);
+    is_ordered = is_ordered && (item.seq == expected);
+    expected ++;
+  }
+  producer.join();
+
+  double rate = ITEMS / ((rc_now_ns() - start) / 1e9);
+  CHECK(is_ordered);
+  printf("%-12s %10.0f items/s  ", name, rate);
+  latency.print("push -> pop", "ns");
+  return rate;
+}
+
+int main(void) {
+  ESP32_RC_Ring ring;
+  CHECK(ring.create(DEPTH, sizeof(Item)));
+  LockedQueue queue;
+
+  printf("%d items of %zu bytes, depth %d, %u cpu(s)\n", ITEMS, sizeof(Item), DEPTH, std::thread::hardware_concurrency());
+  double ring_rate  = run("ring", [&](const Item &i) { return ring.push(&i); }, [&](Item &i) { return ring.pop(&i); });
+  double queue_rate = run("locked queue", [&](const Item &i) { return queue.push(i); }, [&](Item &i) { return queue.pop(i); });
+  CHECK(ring_rate > 0 && queue_rate > 0);
+
+  // push_overwrite keeps the newest DEPTH items
+  Item item = {};
+  for (uint32_t i = 0; i < DEPTH + 5; i++) {
+    item.seq = i;
+    CHECK(ring.push_overwrite(&item) == (i >= DEPTH));
+  }
+  CHECK(ring.depth() == DEPTH);
+  CHECK(ring.pop(&item) && item.seq == 5);
+
+  // peek / consume fails once the item was dropped meanwhile
+  uint32_t pos;
+  CHECK(ring.peek(&item, &pos) && item.seq == 6);
+  item.seq = 100;
+  ring.push_overwrite(&item);
+  ring.push_overwrite(&item);
+  CHECK(!ring.consume(pos));
+
+  ring.clear();
+  CHECK(ring.depth() == 0 && !ring.pop(nullptr));
+
+  return rc_finish();
+}
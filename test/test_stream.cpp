@@ -0,0 +1,111 @@
+#include <string.h>
+#include <random>
+#include <vector>
+#include <ESP32_RC_Stream.h>
+#include "rc_test.h"
+
+/*
+ * Stream framing: random frames through ESP32_RC_StreamWriter (the socket takes a random part of
+ * each batch), then through ESP32_RC_StreamParser in random splits, from single bytes to whole
+ * segments. Every frame must come out once, in order, unchanged. Then the parse throughput for
+ * segment sized reads, random splits and single bytes.
+ */
+
+#define FRAMES          20000
+
+typedef std::vector<std::vector<uint8_t>> Frames;
+
+static Frames make_frames(std::mt19937 &rng, int count) {
+  Frames frames(count);
+  for (auto &frame : frames) {
+    frame.resize(1 + rng() % _RC_STREAM_MAX_FRAME);
+    for (auto &byte : frame) byte = rng();
+  }
+  return frames;
+}
+
+// the writer batches frames, the socket takes what it likes of each batch
+static std::vector<uint8_t> write_stream(std::mt19937 &rng, const Frames &frames) {
+  ESP32_RC_StreamWriter writer;
+  std::vector<uint8_t> stream;
+  size_t next = 0;
+  while (next < frames.size() || writer.size() > 0) {
+    while (next < frames.size() && writer.put(frames[next].data(), frames[next].size())) next ++;
+    size_t taken = (rng() % 4 == 0) ? writer.size() : rng() % (writer.size() + 1);
+    stream.insert(stream.end(), writer.data(), writer.data() + taken);
+    writer.consume(taken);
+  }
+  return stream;
+}
+
+// split 0 = random reads of 1 .. _RC_STREAM_BATCH bytes, else reads of split bytes, frames checked against expected
+static size_t parse_stream(std::mt19937 &rng, const std::vector<uint8_t> &stream, size_t split, const Frames *expected) {
+  ESP32_RC_StreamParser parser;
+  parser.reset();
+  size_t count = 0, offset = 0;
+  while (offset < stream.size()) {
+    size_t read_len = split ? split : 1 + rng() % _RC_STREAM_BATCH;
+    if (read_len > stream.size() - offset) read_len = stream.size() - offset;
+    const uint8_t *data = stream.data() + offset;
+    size_t len = read_len;
+    while (parser.parse(data, len)) {
+      if (expected != nullptr) {
+        const std::vector<uint8_t> &frame = (*expected)[count];
+        CHECK(parser.frame_len() == frame.size() && memcmp(parser.frame(), frame.data(), frame.size()) == 0);
+      }
+      count ++;
+    }
+    CHECK(len == 0 && !parser.is_broken());
+    offset += read_len;
+  }
+  return count;
+}
+
+int main(void) {
+  std::mt19937 rng(21);
+  Frames frames = make_frames(rng, FRAMES);
+  std::vector<uint8_t> stream = write_stream(rng, frames);
+
+  // every split, checked
+  for (size_t split : {(size_t)0, (size_t)1, (size_t)2, (size_t)3, (size_t)_RC_STREAM_BATCH}) {
+    CHECK(parse_stream(rng, stream, split, &frames) == FRAMES);
+  }
+
+  // throughput, unchecked
+  printf("%d frames, %zu bytes on the stream\n", FRAMES, stream.size());
+  for (size_t split : {(size_t)_RC_STREAM_BATCH, (size_t)0, (size_t)1}) {
+    uint64_t start = rc_now_ns();
+    size_t count   = 0;
+    for (int round = 0; round < 10; round++) count += parse_stream(rng, stream, split, nullptr);
+    double seconds = (rc_now_ns() - start) / 1e9;
+    printf("%-20s %8.1f MB/s  %10.0f frames/s\n", split == 0 ? "random splits" : split == 1 ? "single bytes" : "segment reads",
+           10 * stream.size() / seconds / 1e6, count / seconds);
+    CHECK(count == 10 * FRAMES);
+  }
+
+  // a length out of range breaks the stream until reset()
+  ESP32_RC_StreamParser parser;
+  parser.reset();
+  const uint8_t zero[] = {0x00, 0x00, 0x01};
+  const uint8_t *data = zero;
+  size_t len = sizeof(zero);
+  CHECK(!parser.parse(data, len) && parser.is_broken());
+  const uint8_t too_long[] = {(uint8_t)((_RC_STREAM_MAX_FRAME + 1) & 0xFF), (uint8_t)((_RC_STREAM_MAX_FRAME + 1) >> 8)};
+  parser.reset();
+  data = too_long;
+  len  = sizeof(too_long);
+  CHECK(!parser.parse(data, len) && parser.is_broken());
+  parser.reset();
+  const uint8_t good[] = {0x01, 0x00, 0xAB};
+  data = good;
+  len  = sizeof(good);
+  CHECK(parser.parse(data, len) && parser.frame_len() == 1 && parser.frame()[0] == 0xAB);
+
+  // the writer refuses what can not be a frame
+  ESP32_RC_StreamWriter writer;
+  uint8_t frame[_RC_STREAM_MAX_FRAME + 1] = {};
+  CHECK(!writer.put(frame, 0));
+  CHECK(!writer.put(frame, sizeof(frame)));
+
+  return rc_finish();
+}
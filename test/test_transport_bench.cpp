@@ -0,0 +1,145 @@
+#include <atomic>
+#include <thread>
+#include <ESP32_RC_WIFI.h>
+#include <ESP32_RC_UART.h>
+#include "rc_test.h"
+#include "sim_port.h"
+
+/*
+ * Transport benchmark: round trip latency and one-way throughput of Message sized data frames,
+ * with the shared runners of rc_test.h, on the transports that run on the host. Both are the
+ * whole transport (queues, sender task, codec, receive side), only the medium differs:
+ *
+ *  udp   : ESP32_RC_WIFI over the loopback network of host/WiFi.h. The WiFi driver and the
+ *          air are not in it. UDP has no flow control: the paced run keeps PACE messages in
+ *          flight and must lose nothing, the burst shows what a sender that outruns the
+ *          receiver loses.
+ *  uart  : ESP32_RC_UART on a simulated wire at _UART_BAUD, lossless, a full receiver
+ *          stalls the sender.
+ *
+ * ESP-NOW needs the radio, run the same send / post pairs on two boards to compare.
+ */
+
+#define ROUNDS          500
+#define MESSAGES        5000
+#define UART_MESSAGES   1000
+#define PACE            16                                    // udp messages in flight
+#define FRAME_LEN       (_RC_FRAME_HEADER_LEN + sizeof(Message) + _RC_FRAME_TRAILER_LEN)
+
+static ESP32_RC_Arrivals arrivals;
+
+static void print(const char *name, ESP32_RC_Latency &latency, int timeouts, double rate, int lost) {
+  printf("%-10s %8.0f msg/s  %6.1f Mbit/s payload  lost %4d  timeouts %d  ", name, rate, rate * sizeof(Message) * 8 / 1e6, lost, timeouts);
+  latency.print("round trip", "us");
+}
+
+static void make_msg(Message &msg, int index) {
+  msg = {};
+  msg.is_set = true;
+  memcpy(msg.msg1, &index, sizeof(index));
+  memset(msg.msg2, 'x', sizeof(msg.msg2) - 1);              // about as long as a raw frame
+}
+
+static void post_index(const Message &msg) {
+  int index;
+  memcpy(&index, msg.msg1, sizeof(index));
+  arrivals.post(index);
+}
+
+
+/*
+ * ========================================================
+ * ESP32_RC_WIFI, UDP, b echoes while is_echo
+ * ========================================================
+ */
+typedef ESP32_RC<ESP32_RC_WIFI> WifiRC;
+
+static WifiRC udp_a, udp_b;
+static std::atomic<bool> is_udp_echo{false};
+
+static void on_udp_b(const Message &msg) {
+  if (is_udp_echo) {
+    udp_b.send(msg);
+    return;
+  }
+  post_index(msg);
+}
+
+static void send_udp(WifiRC &from, int index) {
+  Message msg;
+  make_msg(msg, index);
+  from.send(msg);
+}
+
+
+/*
+ * ========================================================
+ * ESP32_RC_UART, b echoes while is_echo
+ * ========================================================
+ */
+typedef ESP32_RC<ESP32_RC_UART> UartRC;
+
+static UartRC uart_a, uart_b;
+static std::atomic<bool> is_uart_echo{false};
+
+static void on_uart_b(const Message &msg) {
+  if (is_uart_echo) {
+    uart_b.send(msg);
+    return;
+  }
+  post_index(msg);
+}
+
+static void send_uart(UartRC &from, int index) {
+  Message msg;
+  make_msg(msg, index);
+  from.send(msg);
+}
+
+int main(void) {
+  int timeouts;
+
+  udp_a.on_message(post_index);
+  udp_b.on_message(on_udp_b);
+  udp_a.init();
+  udp_b.init();
+  rc_connect_pair(udp_a, udp_b);
+  is_udp_echo = true;
+  ESP32_RC_Latency udp = rc_round_trips(ROUNDS, arrivals, [](int i) { send_udp(udp_a, i); }, timeouts);
+  int udp_timeouts = timeouts;
+  is_udp_echo = false;
+  double udp_rate = rc_paced(MESSAGES, arrivals, [](int i) { send_udp(udp_a, i); }, PACE);
+  int udp_received = arrivals.received();
+  double burst_rate = rc_throughput(MESSAGES, arrivals, [](int i) { send_udp(udp_a, i); });
+  int burst_received = arrivals.received();
+
+  static ESP32_RC_SimWire wire(_UART_BAUD);
+  uart_a.set_port(&wire.a, _UART_BAUD);
+  uart_b.set_port(&wire.b, _UART_BAUD);
+  uart_a.on_message(post_index);
+  uart_b.on_message(on_uart_b);
+  uart_a.init();
+  uart_b.init();
+  rc_connect_pair(uart_a, uart_b);
+  is_uart_echo = true;
+  ESP32_RC_Latency uart = rc_round_trips(ROUNDS, arrivals, [](int i) { send_uart(uart_a, i); }, timeouts);
+  int uart_timeouts = timeouts;
+  is_uart_echo = false;
+  double uart_rate = rc_throughput(UART_MESSAGES, arrivals, [](int i) { send_uart(uart_a, i); }, 1000);
+  int uart_received = arrivals.received();
+
+  printf("%zu byte data frames, %d round trips, %d / %d messages one way\n", FRAME_LEN, ROUNDS, MESSAGES, UART_MESSAGES);
+  print("udp", udp, udp_timeouts, udp_rate, MESSAGES - udp_received);
+  printf("%-10s %8.0f msg/s  %6.1f Mbit/s payload  lost %4d  (not paced)\n", "udp burst", burst_rate,
+         burst_rate * sizeof(Message) * 8 / 1e6, MESSAGES - burst_received);
+  print("uart", uart, uart_timeouts, uart_rate, UART_MESSAGES - uart_received);
+
+  // paced UDP and the wire lose nothing, the burst is only reported. Both round trips go
+  // through the whole transport, loopback is faster than the frame time of the wire
+  CHECK(udp_timeouts == 0 && uart_timeouts == 0);
+  CHECK(udp_received == MESSAGES);
+  CHECK(uart_received == UART_MESSAGES);
+  CHECK(udp.percentile(50) < uart.percentile(50));
+
+  return rc_finish();
+}
@@ -0,0 +1,178 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ESP32_RC_UART.h>
+#include "rc_test.h"
+#include "sim_port.h"
+
+/*
+ * ESP32_RC_UART on Linux:
+ *
+ *  pty     : the whole transport on ESP32_RC_PosixSerial at both ends, two pty pairs joined
+ *            master to master like `socat pty pty`. Round trips and one-way throughput with the
+ *            shared runners, the regression numbers for the upper layers at the speed of the host.
+ *            Nothing may be lost: a full BLOCK lane stalls the reader instead of dropping.
+ *  failing : a port whose write() returns -1 for a while. The batch of the failed write is kept,
+ *            every message sent meanwhile arrives once the port is back, once and in order.
+ */
+
+#define ROUNDS          500
+#define MESSAGES        2000
+#define FAILING_COUNT   20
+#define FAILING_MS      300
+
+typedef ESP32_RC<ESP32_RC_UART> UartRC;
+
+static ESP32_RC_Arrivals arrivals;
+
+static void send_index(UartRC &from, int index) {
+  Message msg = {};
+  msg.is_set = true;
+  memcpy(msg.msg1, &index, sizeof(index));
+  memset(msg.msg2, 'x', sizeof(msg.msg2) - 1);
+  from.send(msg);
+}
+
+static int index_of(const Message &msg) {
+  int index;
+  memcpy(&index, msg.msg1, sizeof(index));
+  return index;
+}
+
+
+/*
+ * ========================================================
+ * pty pairs, the masters copied into each other
+ * ========================================================
+ */
+struct Pty {
+  int master = -1;
+  char path[64] = {};
+
+  bool open(void) {
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) return false;
+    return ptsname_r(master, path, sizeof(path)) == 0;
+  }
+};
+
+static void bridge(int fd_1, int fd_2) {
+  struct pollfd fds[2] = {{fd_1, POLLIN, 0}, {fd_2, POLLIN, 0}};
+  uint8_t buffer[4096];
+  while (true) {
+    if (poll(fds, 2, -1) < 0 && errno != EINTR) return;
+    for (int i = 0; i < 2; i++) {
+      if (!(fds[i].revents & POLLIN)) continue;
+      int len = read(fds[i].fd, buffer, sizeof(buffer));
+      if (len <= 0) continue;
+      for (int done = 0; done < len;) {
+        int sent = write(fds[1 - i].fd, buffer + done, len - done);
+        if (sent < 0 && errno != EINTR) return;
+        if (sent > 0) done += sent;
+      }
+    }
+  }
+}
+
+static UartRC pty_a, pty_b;
+static std::atomic<bool> is_pty_echo{false};
+
+static void on_pty_a(const Message &msg) {
+  arrivals.post(index_of(msg));
+}
+
+static void on_pty_b(const Message &msg) {
+  if (is_pty_echo) pty_b.send(msg);
+  else arrivals.post(index_of(msg));
+}
+
+
+/*
+ * ========================================================
+ * a simulated wire, a -> b fails for a while
+ * ========================================================
+ */
+static UartRC fail_a, fail_b;
+static std::mutex seen_mutex;
+static std::vector<int> seen;                                 // message indices in arrival order
+
+static void on_fail_b(const Message &msg) {
+  std::lock_guard<std::mutex> guard(seen_mutex);
+  seen.push_back(index_of(msg));
+}
+
+static size_t seen_count(void) {
+  std::lock_guard<std::mutex> guard(seen_mutex);
+  return seen.size();
+}
+
+int main(void) {
+  int timeouts;
+
+  // pty
+  static Pty pty_1, pty_2;
+  CHECK(pty_1.open() && pty_2.open());
+  std::thread(bridge, pty_1.master, pty_2.master).detach();
+  static ESP32_RC_PosixSerial port_a(pty_1.path), port_b(pty_2.path);
+  pty_a.set_port(&port_a);
+  pty_b.set_port(&port_b);
+  pty_a.on_message(on_pty_a);
+  pty_b.on_message(on_pty_b);
+  pty_a.init();
+  pty_b.init();
+  rc_connect_pair(pty_a, pty_b);
+  CHECK(pty_a.is_connected() && pty_b.is_connected());
+
+  is_pty_echo = true;
+  ESP32_RC_Latency latency = rc_round_trips(ROUNDS, arrivals, [](int i) { send_index(pty_a, i); }, timeouts);
+  is_pty_echo = false;
+  double rate = rc_throughput(MESSAGES, arrivals, [](int i) { send_index(pty_a, i); }, 1000);
+  int received = arrivals.received();
+  printf("pty    %8.0f msg/s  %6.1f Mbit/s payload  lost %4d  timeouts %d  ",
+         rate, rate * sizeof(Message) * 8 / 1e6, MESSAGES - received, timeouts);
+  latency.print("round trip", "us");
+  // the pty does not lose bytes, a handler task that falls behind stalls the reader, and
+  // through the pty the sender, nothing is dropped
+  CHECK(timeouts == 0);
+  CHECK(received == MESSAGES);
+
+  // failing port
+  static ESP32_RC_SimWire wire(_UART_BAUD);
+  fail_a.set_port(&wire.a);
+  fail_b.set_port(&wire.b);
+  fail_b.on_message(on_fail_b);
+  fail_a.init();
+  fail_b.init();
+  rc_connect_pair(fail_a, fail_b);
+
+  {
+    std::lock_guard<std::mutex> guard(wire.a_to_b.mutex);
+    wire.a_to_b.is_failing = true;
+  }
+  for (int i = 0; i < FAILING_COUNT; i++) send_index(fail_a, i);
+  std::this_thread::sleep_for(std::chrono::milliseconds(FAILING_MS));
+  CHECK(seen_count() == 0);
+  uint32_t failed;
+  {
+    std::lock_guard<std::mutex> guard(wire.a_to_b.mutex);
+    failed = wire.a_to_b.failed_count;
+    wire.a_to_b.is_failing = false;
+  }
+  CHECK(failed > 1);                                        // written again, round after round
+  for (int wait = 0; wait < 1000 && seen_count() < FAILING_COUNT; wait++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));   // duplicates would come now
+  std::lock_guard<std::mutex> guard(seen_mutex);
+  printf("failing port: %zu / %d messages after %d ms, %u failed writes\n", seen.size(), FAILING_COUNT, FAILING_MS, failed);
+  CHECK(seen.size() == FAILING_COUNT);
+  for (size_t i = 0; i < seen.size(); i++) CHECK(seen[i] == (int)i);
+
+  return rc_finish();
+}
@@ -0,0 +1,128 @@
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ESP32_RC_WIFI.h>
+#include "rc_test.h"
+
+/*
+ * ESP32_RC_WIFI on Linux: two ends in one process on the loopback network of host/WiFi.h, the
+ * whole transport (join, handshake, sender task, network task, codec) over real sockets.
+ *
+ *  udp : one end becomes the AP, the other joins it. Messages both ways, paced so the receive
+ *        task keeps up: UDP has no flow control, the socket is the only buffer. Every message
+ *        arrives once, in order.
+ *  tcp : enable_tcp(), the STA connects to the AP. Messages as fast as send() returns, the
+ *        stream loses nothing and keeps the order.
+ */
+
+#define MESSAGES        2000
+#define PACE            16                                    // messages in flight, then wait for the last
+#define WAIT_MS         1000
+
+typedef ESP32_RC<ESP32_RC_WIFI> WifiRC;
+
+struct Seen {
+  std::mutex mutex;
+  std::vector<int> indices;                                   // in arrival order
+  ESP32_RC_Arrivals arrivals;
+
+  void post(int index) {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      indices.push_back(index);
+    }
+    arrivals.post(index);
+  }
+
+  void reset(void) {
+    std::lock_guard<std::mutex> guard(mutex);
+    indices.clear();
+    arrivals.reset();
+  }
+
+  size_t count(void) {
+    std::lock_guard<std::mutex> guard(mutex);
+    return indices.size();
+  }
+
+  bool is_in_order(int count) {
+    std::lock_guard<std::mutex> guard(mutex);
+    if ((int)indices.size() != count) return false;
+    for (int i = 0; i < count; i++) {
+      if (indices[i] != i) return false;
+    }
+    return true;
+  }
+};
+
+static Seen seen_a, seen_b;
+
+static void send_index(WifiRC &from, int index) {
+  Message msg = {};
+  msg.is_set = true;
+  memcpy(msg.msg1, &index, sizeof(index));
+  memset(msg.msg2, 'x', sizeof(msg.msg2) - 1);
+  from.send(msg);
+}
+
+static int index_of(const Message &msg) {
+  int index;
+  memcpy(&index, msg.msg1, sizeof(index));
+  return index;
+}
+
+// PACE messages, then wait until the last of them arrived
+static void send_paced(WifiRC &from, Seen &to, int count) {
+  to.reset();
+  for (int i = 0; i < count; i++) {
+    send_index(from, i);
+    if ((i + 1) % PACE == 0 || i == count - 1) to.arrivals.wait(i, WAIT_MS);
+  }
+}
+
+static void send_all(WifiRC &from, Seen &to, int count) {
+  to.reset();
+  for (int i = 0; i < count; i++) send_index(from, i);
+  to.arrivals.wait(count - 1, WAIT_MS);
+}
+
+static WifiRC udp_a(false, true), udp_b(false, true);
+static WifiRC tcp_a, tcp_b;
+
+int main(void) {
+  // udp
+  udp_a.on_message([](const Message &msg) { seen_a.post(index_of(msg)); });
+  udp_b.on_message([](const Message &msg) { seen_b.post(index_of(msg)); });
+  udp_a.init();
+  udp_b.init();
+  rc_connect_pair(udp_a, udp_b);
+  CHECK(udp_a.is_connected() && udp_b.is_connected());
+
+  send_paced(udp_a, seen_b, MESSAGES);
+  printf("udp  a -> b  %4zu / %d\n", seen_b.count(), MESSAGES);
+  CHECK(seen_b.is_in_order(MESSAGES));
+  send_paced(udp_b, seen_a, MESSAGES);
+  printf("udp  b -> a  %4zu / %d\n", seen_a.count(), MESSAGES);
+  CHECK(seen_a.is_in_order(MESSAGES));
+
+  // tcp, a new network
+  host_wifi_reset();
+  tcp_a.enable_tcp(true);
+  tcp_b.enable_tcp(true);
+  tcp_a.on_message([](const Message &msg) { seen_a.post(index_of(msg)); });
+  tcp_b.on_message([](const Message &msg) { seen_b.post(index_of(msg)); });
+  tcp_a.init();
+  tcp_b.init();
+  rc_connect_pair(tcp_a, tcp_b);
+  CHECK(tcp_a.is_connected() && tcp_b.is_connected());
+
+  send_all(tcp_a, seen_b, MESSAGES);
+  printf("tcp  a -> b  %4zu / %d\n", seen_b.count(), MESSAGES);
+  CHECK(seen_b.is_in_order(MESSAGES));
+  send_all(tcp_b, seen_a, MESSAGES);
+  printf("tcp  b -> a  %4zu / %d\n", seen_a.count(), MESSAGES);
+  CHECK(seen_a.is_in_order(MESSAGES));
+
+  return rc_finish();
+}
@@ -0,0 +1,114 @@
+#include <string.h>
+#include <deque>
+#include <random>
+#include <ESP32_RC_Common.h>
+#include <ESP32_RC_Window.h>
+#include "rc_test.h"
+
+/*
+ * Send window benchmark in simulated time: a radio which sends one frame per AIR_US and
+ * reports each frame ACK_US after it left, in order, like the ESP-NOW send callback. The
+ * sender keeps up to N frames in flight through ESP32_RC_SendWindow, failed frames are sent
+ * again. Throughput is delivered frames per simulated second for N = 1 .. _RC_SEND_WINDOW_MAX.
+ */
+
+#define MESSAGES        20000
+#define AIR_US          2100                                  // 250 byte frame at 1 Mbit/s
+#define ACK_US          1500                                  // ack wait + send callback
+#define LOSS_PERCENT    5
+
+struct Completion {
+  uint32_t time;
+  bool     success;
+};
+
+static double run(int window_size, uint32_t seed) {
+  ESP32_RC_SendWindow window;
+  CHECK(window.create(sizeof(Message)));
+  window.set_size(window_size);
+
+  std::mt19937 rng(seed);
+  std::deque<int> to_send;                                    // QUEUED slots, send order
+  std::deque<Completion> completions;                         // callbacks due, in send order
+  uint32_t now = 0, radio_free = 0;
+  int queued = 0, delivered = 0, sent = 0;
+
+  while (delivered < MESSAGES) {
+    int slot;
+    while (queued < MESSAGES && (slot = window.acquire(_RC_LANE_BULK)) >= 0) {
+      memcpy(window.buffer(slot), &queued, sizeof(queued));
+      to_send.push_back(slot);
+      queued ++;
+    }
+    while (!to_send.empty()) {
+      slot = to_send.front();
+      to_send.pop_front();
+      radio_free = std::max(now, radio_free) + AIR_US;
+      window.lock();
+      CHECK(window.track(slot, -1, radio_free - AIR_US));
+      window.unlock();
+      completions.push_back({radio_free + ACK_US, (int)(rng() % 100) >= LOSS_PERCENT});
+      sent ++;
+    }
+
+    Completion done = completions.front();
+    completions.pop_front();
+    now = done.time;
+    ESP32_RC_SendWindow::Record rec;
+    window.lock();
+    CHECK(window.complete(done.success, rec));
+    window.unlock();
+    if (window.state(rec.slot) == ESP32_RC_SendWindow::DONE) {
+      window.release(rec.slot);
+      delivered ++;
+    } else {
+      window.mark(rec.slot, ESP32_RC_SendWindow::QUEUED);
+      to_send.push_back(rec.slot);
+    }
+  }
+
+  double rate = delivered / (now / 1e6);
+  printf("window %d  %7.1f msg/s  %6.1f kbit/s  %5.1f%% of air time  (%d sent)\n", window_size, rate,
+         rate * sizeof(Message) * 8 / 1000, 100.0 * rate * AIR_US / 1e6, sent);
+  return rate;
+}
+
+int main(void) {
+  printf("%d messages, air %d us, ack %d us, loss %d%%\n", MESSAGES, AIR_US, ACK_US, LOSS_PERCENT);
+  double rate[_RC_SEND_WINDOW_MAX + 1] = {};
+  for (int size = 1; size <= _RC_SEND_WINDOW_MAX; size *= 2) {
+    rate[size] = run(size, 1);
+  }
+  // stop-and-wait pays the ack per frame, a window hides it behind the next frames.
+  // window 2 keeps its second slot for lane 0, bulk alone still waits like window 1
+  CHECK(rate[1] < 0.65 * 1e6 / AIR_US);
+  CHECK(rate[4] > 1.3 * rate[1]);
+  CHECK(rate[8] >= rate[4] * 0.99);
+  CHECK(rate[8] > 0.85 * 1e6 / AIR_US);
+
+  // the last free slot is kept for lane 0
+  ESP32_RC_SendWindow window;
+  CHECK(window.create(sizeof(Message)));
+  window.set_size(4);
+  for (int i = 0; i < 3; i++) CHECK(window.acquire(_RC_LANE_BULK) >= 0);
+  CHECK(window.acquire(_RC_LANE_BULK) < 0);
+  int critical = window.acquire(_RC_LANE_CRITICAL);
+  CHECK(critical >= 0);
+
+  // a completion after clear() does not land on the slot acquired again
+  window.lock();
+  CHECK(window.track(critical, 7, 0));
+  window.unlock();
+  window.clear();
+  int reused = window.acquire(_RC_LANE_CRITICAL);
+  window.lock();
+  CHECK(window.track(reused, -1, 0));
+  ESP32_RC_SendWindow::Record rec;
+  CHECK(window.complete(true, rec) && rec.slot == -1 && rec.delta_id == -1);
+  CHECK(window.state(reused) == ESP32_RC_SendWindow::IN_FLIGHT);
+  CHECK(window.complete(true, rec) && rec.slot == reused);
+  window.unlock();
+  CHECK(window.state(reused) == ESP32_RC_SendWindow::DONE);
+
+  return rc_finish();
+}